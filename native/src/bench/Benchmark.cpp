@@ -0,0 +1,329 @@
+/**
+ * Copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "bench/Benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <numeric>
+#include <regex>
+
+#include <fmt/format.h>
+
+namespace warmonger {
+namespace bench {
+
+using Nanoseconds = std::chrono::duration<double, std::nano>;
+
+struct Aggregate
+{
+    const char* name;
+    double (*calculate)(std::vector<double>);
+};
+
+static Nanoseconds threadCpuTime();
+static double mean(std::vector<double> values);
+static double median(std::vector<double> values);
+static double stddev(std::vector<double> values);
+static std::vector<double> toNanoseconds(const std::vector<Nanoseconds>& times);
+static std::string escapeJson(const std::string& str);
+static void writeJsonRun(std::ostream& out,
+    const BenchmarkResult& result,
+    const std::string& name,
+    const char* runType,
+    const std::string& extra,
+    double realTime,
+    double cpuTime);
+
+BenchmarkRunner::BenchmarkRunner(BenchmarkConfig config)
+    : config(std::move(config))
+{
+}
+
+void BenchmarkRunner::add(std::string name, BenchmarkFunc func, std::size_t itemsPerIteration)
+{
+    this->benchmarks.push_back(Benchmark{std::move(name), std::move(func), itemsPerIteration});
+}
+
+std::vector<BenchmarkResult> BenchmarkRunner::run(std::ostream& progress)
+{
+    const std::regex filter(this->config.filter);
+
+    std::vector<BenchmarkResult> results;
+
+    for (const auto& benchmark : this->benchmarks)
+    {
+        if (!std::regex_search(benchmark.name, filter))
+            continue;
+
+        progress << "Running " << benchmark.name << "..." << std::endl;
+
+        results.push_back(this->run(benchmark));
+    }
+
+    return results;
+}
+
+BenchmarkResult BenchmarkRunner::run(const Benchmark& benchmark)
+{
+    const auto minTime = std::chrono::duration_cast<Nanoseconds>(this->config.minTime);
+    const std::size_t maxIterations{1000000000};
+
+    // Find the number of iterations which take at least minTime, overshoot
+    // the estimate a bit so that it's found in a few rounds.
+    std::size_t iterations{1};
+    while (true)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        benchmark.func(iterations);
+        const Nanoseconds elapsed = std::chrono::steady_clock::now() - start;
+
+        if (elapsed >= minTime || iterations >= maxIterations)
+            break;
+
+        const double multiplier = elapsed.count() > 0.0 ? minTime / elapsed * 1.4 : 10.0;
+        iterations = std::min(maxIterations,
+            std::max(iterations * 2, static_cast<std::size_t>(std::ceil(iterations * std::min(multiplier, 10.0)))));
+    }
+
+    BenchmarkResult result{benchmark.name, iterations, {}, {}, benchmark.itemsPerIteration};
+
+    for (unsigned int i = 0; i < this->config.repetitions; ++i)
+    {
+        const auto cpuStart = threadCpuTime();
+        const auto start = std::chrono::steady_clock::now();
+        benchmark.func(iterations);
+        const Nanoseconds elapsed = std::chrono::steady_clock::now() - start;
+        const auto cpuElapsed = threadCpuTime() - cpuStart;
+
+        result.realTimes.push_back(elapsed / iterations);
+        result.cpuTimes.push_back(cpuElapsed / iterations);
+    }
+
+    return result;
+}
+
+void writeConsoleReport(std::ostream& out, const std::vector<BenchmarkResult>& results)
+{
+    std::size_t nameWidth{9};
+    for (const auto& result : results)
+        nameWidth = std::max(nameWidth, result.name.size());
+
+    out << fmt::format("{:<{}} {:>14} {:>14} {:>10} {:>12} {:>14}\n",
+        "benchmark",
+        nameWidth,
+        "time [ns]",
+        "cpu [ns]",
+        "stddev [%]",
+        "iterations",
+        "items/s");
+
+    for (const auto& result : results)
+    {
+        const auto realTimes = toNanoseconds(result.realTimes);
+        const double realTime = median(realTimes);
+        const double cpuTime = median(toNanoseconds(result.cpuTimes));
+        const double deviation = realTime > 0.0 ? stddev(realTimes) / realTime * 100.0 : 0.0;
+
+        out << fmt::format("{:<{}} {:>14.1f} {:>14.1f} {:>10.1f} {:>12}",
+            result.name,
+            nameWidth,
+            realTime,
+            cpuTime,
+            deviation,
+            result.iterations);
+
+        if (result.itemsPerIteration > 0 && realTime > 0.0)
+            out << fmt::format(" {:>14.4g}", result.itemsPerIteration / realTime * 1e9);
+
+        out << "\n";
+    }
+}
+
+void writeJsonReport(std::ostream& out,
+    const std::vector<BenchmarkResult>& results,
+    const std::vector<std::pair<std::string, std::string>>& context)
+{
+    static const Aggregate aggregates[] = {{"mean", mean}, {"median", median}, {"stddev", stddev}};
+
+    out << "{\n  \"context\": {";
+
+    const char* separator = "\n";
+    for (const auto& entry : context)
+    {
+        out << separator << "    \"" << escapeJson(entry.first) << "\": \"" << escapeJson(entry.second) << "\"";
+        separator = ",\n";
+    }
+
+    out << "\n  },\n  \"benchmarks\": [";
+
+    separator = "\n";
+    for (const auto& result : results)
+    {
+        const auto realTimes = toNanoseconds(result.realTimes);
+        const auto cpuTimes = toNanoseconds(result.cpuTimes);
+
+        for (std::size_t i = 0; i < realTimes.size(); ++i)
+        {
+            out << separator;
+            writeJsonRun(out,
+                result,
+                result.name,
+                "iteration",
+                fmt::format("\"repetition_index\": {}", i),
+                realTimes[i],
+                cpuTimes[i]);
+            separator = ",\n";
+        }
+
+        for (const auto& aggregate : aggregates)
+        {
+            out << separator;
+            writeJsonRun(out,
+                result,
+                result.name + "_" + aggregate.name,
+                "aggregate",
+                fmt::format("\"aggregate_name\": \"{}\"", aggregate.name),
+                aggregate.calculate(realTimes),
+                aggregate.calculate(cpuTimes));
+        }
+    }
+
+    out << "\n  ]\n}\n";
+}
+
+static Nanoseconds threadCpuTime()
+{
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+}
+
+static double mean(std::vector<double> values)
+{
+    if (values.empty())
+        return 0.0;
+
+    return std::accumulate(values.begin(), values.end(), 0.0) / values.size();
+}
+
+static double median(std::vector<double> values)
+{
+    if (values.empty())
+        return 0.0;
+
+    std::sort(values.begin(), values.end());
+
+    const std::size_t middle = values.size() / 2;
+    return values.size() % 2 ? values[middle] : (values[middle - 1] + values[middle]) / 2.0;
+}
+
+static double stddev(std::vector<double> values)
+{
+    if (values.size() < 2)
+        return 0.0;
+
+    const double average = mean(values);
+    const double sumOfSquares = std::accumulate(values.begin(), values.end(), 0.0, [average](double sum, double v) {
+        return sum + (v - average) * (v - average);
+    });
+
+    return std::sqrt(sumOfSquares / (values.size() - 1));
+}
+
+static std::vector<double> toNanoseconds(const std::vector<Nanoseconds>& times)
+{
+    std::vector<double> values;
+    values.reserve(times.size());
+
+    for (const auto& time : times)
+        values.push_back(time.count());
+
+    return values;
+}
+
+static std::string escapeJson(const std::string& str)
+{
+    std::string escaped;
+    escaped.reserve(str.size());
+
+    for (const char c : str)
+    {
+        switch (c)
+        {
+            case '"':
+                escaped += "\\\"";
+                break;
+            case '\\':
+                escaped += "\\\\";
+                break;
+            case '\n':
+                escaped += "\\n";
+                break;
+            case '\t':
+                escaped += "\\t";
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20)
+                    escaped += fmt::format("\\u{:04x}", static_cast<int>(c));
+                else
+                    escaped += c;
+        }
+    }
+
+    return escaped;
+}
+
+static void writeJsonRun(std::ostream& out,
+    const BenchmarkResult& result,
+    const std::string& name,
+    const char* runType,
+    const std::string& extra,
+    double realTime,
+    double cpuTime)
+{
+    out << fmt::format(
+        "    {{\n"
+        "      \"name\": \"{}\",\n"
+        "      \"run_name\": \"{}\",\n"
+        "      \"run_type\": \"{}\",\n"
+        "      \"repetitions\": {},\n"
+        "      {},\n"
+        "      \"threads\": 1,\n"
+        "      \"iterations\": {},\n"
+        "      \"real_time\": {:.4f},\n"
+        "      \"cpu_time\": {:.4f},\n"
+        "      \"time_unit\": \"ns\"",
+        escapeJson(name),
+        escapeJson(result.name),
+        runType,
+        result.realTimes.size(),
+        extra,
+        result.iterations,
+        realTime,
+        cpuTime);
+
+    if (result.itemsPerIteration > 0 && realTime > 0.0)
+        out << fmt::format(",\n      \"items_per_second\": {:.4f}", result.itemsPerIteration / realTime * 1e9);
+
+    out << "\n    }";
+}
+
+} // namespace bench
+} // namespace warmonger
@@ -0,0 +1,141 @@
+/** \file
+ * Benchmark runner.
+ *
+ * \copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef W_BENCH_BENCHMARK_H
+#define W_BENCH_BENCHMARK_H
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace warmonger {
+namespace bench {
+
+/**
+ * Prevent the compiler from optimizing away the computation of value.
+ */
+template <typename T>
+inline void doNotOptimize(const T& value)
+{
+    __asm__ __volatile__("" : : "r,m"(value) : "memory");
+}
+
+/**
+ * A benchmark, runs the measured code iterations times.
+ */
+using BenchmarkFunc = std::function<void(std::size_t iterations)>;
+
+struct BenchmarkConfig
+{
+    // Only benchmarks whose name matches this (ECMAScript) regex are run.
+    std::string filter{".*"};
+    // The minimum time a repetition has to run for.
+    std::chrono::duration<double> minTime{0.5};
+    unsigned int repetitions{3};
+};
+
+/**
+ * The result of running a benchmark.
+ */
+struct BenchmarkResult
+{
+    std::string name;
+    std::size_t iterations;
+    // The per-iteration wall-clock time of each repetition.
+    std::vector<std::chrono::duration<double, std::nano>> realTimes;
+    // The per-iteration CPU time (of the running thread) of each repetition.
+    std::vector<std::chrono::duration<double, std::nano>> cpuTimes;
+    // Items processed per iteration, 0 if not applicable.
+    std::size_t itemsPerIteration;
+};
+
+/**
+ * Collects and runs benchmarks.
+ *
+ * The number of iterations is grown until a run takes at least
+ * BenchmarkConfig::minTime, then the benchmark is repeated
+ * BenchmarkConfig::repetitions times with that many iterations.
+ */
+class BenchmarkRunner
+{
+public:
+    explicit BenchmarkRunner(BenchmarkConfig config);
+
+    /**
+     * Register a benchmark.
+     *
+     * \param name the name, by convention: `group/benchmark[/argument]'
+     * \param func the benchmark
+     * \param itemsPerIteration the number of items processed by an
+     * iteration, used to report the throughput
+     */
+    void add(std::string name, BenchmarkFunc func, std::size_t itemsPerIteration = 0);
+
+    /**
+     * Run the benchmarks matching the filter, in registration order.
+     *
+     * \param progress stream to report the progress to
+     *
+     * \returns the results
+     */
+    std::vector<BenchmarkResult> run(std::ostream& progress);
+
+private:
+    struct Benchmark
+    {
+        std::string name;
+        BenchmarkFunc func;
+        std::size_t itemsPerIteration;
+    };
+
+    BenchmarkResult run(const Benchmark& benchmark);
+
+    BenchmarkConfig config;
+    std::vector<Benchmark> benchmarks;
+};
+
+/**
+ * Write the results as a human-readable table.
+ */
+void writeConsoleReport(std::ostream& out, const std::vector<BenchmarkResult>& results);
+
+/**
+ * Write the results as JSON.
+ *
+ * The format is that of Google Benchmark's `--benchmark_format=json', so
+ * the results can be compared with its tools/compare.py. Each repetition
+ * is written as a separate run, followed by the mean, median and stddev
+ * aggregates.
+ *
+ * \param out the stream to write to
+ * \param results the results
+ * \param context additional key-value pairs for the context object
+ */
+void writeJsonReport(std::ostream& out,
+    const std::vector<BenchmarkResult>& results,
+    const std::vector<std::pair<std::string, std::string>>& context);
+
+} // namespace bench
+} // namespace warmonger
+
+#endif // W_BENCH_BENCHMARK_H
@@ -0,0 +1,857 @@
+/**
+ * Copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <backward.hpp>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <thread>
+
+#include <QDateTime>
+#include <QFileInfo>
+#include <QGuiApplication>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QQuickRenderControl>
+#include <QQuickWindow>
+#include <QSGNode>
+#include <QSysInfo>
+#include <QTemporaryDir>
+#include <fmt/format.h>
+
+#include "Version.h"
+#include "bench/Benchmark.h"
+#include "core/HexGrid.h"
+#include "core/HierarchicalPathfinder.h"
+#include "core/Map.h"
+#include "core/MapSnapshot.h"
+#include "core/Pathfinder.h"
+#include "core/Settlement.h"
+#include "core/Territory.h"
+#include "io/File.h"
+#include "io/JsonSerializer.h"
+#include "tools/Utils.h"
+#include "ui/Banner.h"
+#include "ui/MapUtil.h"
+#include "ui/Render.h"
+#include "ui/WorldSurface.h"
+#include "utils/Logging.h"
+
+namespace backward {
+
+backward::SignalHandling sh;
+
+} // namespace backward
+
+using namespace warmonger;
+
+namespace {
+
+struct Options
+{
+    bench::BenchmarkConfig config;
+    std::string format{"console"};
+    std::string outPath;
+    QString worldPath;
+    QString worldSurfacePath;
+};
+
+/*
+ * A scene-graph without an on-screen window.
+ *
+ * Allows creating textures and building scene-graph nodes, the way
+ * MapView::updatePaintNode() does, without displaying anything.
+ */
+struct OffscreenScene
+{
+    QOpenGLContext context;
+    QOffscreenSurface surface;
+    QQuickRenderControl renderControl;
+    QQuickWindow window;
+
+    OffscreenScene()
+        : window(&renderControl)
+    {
+    }
+
+    bool init()
+    {
+        if (!this->context.create())
+            return false;
+
+        this->surface.setFormat(this->context.format());
+        this->surface.create();
+
+        if (!this->context.makeCurrent(&this->surface))
+            return false;
+
+        this->renderControl.initialize(&this->context);
+
+        return true;
+    }
+};
+
+} // namespace
+
+static bool parseOptions(int argc, char* const argv[], Options& options);
+static std::unique_ptr<core::World> makeWorld();
+static std::unique_ptr<core::Map> makeMap(core::World* world, unsigned int radius);
+static QImage makeBannerImage(int size);
+static core::ir::Value toMapFormatVersion1(core::ir::Value serializedMap);
+static void addCoreBenchmarks(bench::BenchmarkRunner& runner,
+    core::World* world,
+    const QString& tmpDir,
+    std::vector<std::pair<std::string, std::string>>& context);
+static void addMapFormatBenchmarks(bench::BenchmarkRunner& runner,
+    core::World* world,
+    const QString& tmpDir,
+    std::vector<std::pair<std::string, std::string>>& context);
+static void addPathfindingBenchmarks(bench::BenchmarkRunner& runner);
+static void addTerritoryBenchmarks(bench::BenchmarkRunner& runner);
+static void addWorldBenchmarks(bench::BenchmarkRunner& runner, core::World* world);
+static void addWorldSurfaceBenchmarks(
+    bench::BenchmarkRunner& runner, core::World* world, ui::WorldSurface* worldSurface, OffscreenScene* scene);
+static std::vector<std::pair<std::string, std::string>> makeContext(const char* executable);
+
+/**
+ * Performance benchmark suite.
+ *
+ * Measures the hot paths of the engine: map generation, serialization,
+ * map saving and loading (also compressed and in older formats),
+ * map-node positioning and lookup, the world and world-surface rules,
+ * scene-graph building and banner recoloring. The compression ratios and
+ * the map file sizes are reported in the context of the JSON results.
+ * The benchmarks that need real world data are only run if a world and a
+ * world-surface are passed, the rest work with synthetic data.
+ * Results are written as a table or as JSON in Google Benchmark's format,
+ * so they can be archived and compared between releases.
+ */
+int main(int argc, char* const argv[])
+{
+    Options options;
+
+    if (!parseOptions(argc, argv, options))
+    {
+        std::cout << "Usage: bench_warmonger [--filter=regex] [--min-time=seconds] [--repetitions=n]"
+                     " [--format=console|json] [--out=path] [--world=/path/to/world.wwd"
+                     " [--world-surface=/path/to/worldsurface.wsp]]"
+                  << std::endl;
+        return 1;
+    }
+
+    // Nothing is shown, render offscreen unless told otherwise.
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+
+    int appArgc{1};
+    QGuiApplication app(appArgc, const_cast<char**>(argv));
+
+    std::shared_ptr<std::stringstream> logStream = tools::setupLogging();
+
+    QTemporaryDir tmpDir;
+    if (!tmpDir.isValid())
+        tools::die(logStream, "Failed to create temporary directory");
+
+    bench::BenchmarkRunner runner(options.config);
+    auto context = makeContext(argv[0]);
+
+    const auto syntheticWorld = makeWorld();
+    addCoreBenchmarks(runner, syntheticWorld.get(), tmpDir.path(), context);
+    addMapFormatBenchmarks(runner, syntheticWorld.get(), tmpDir.path(), context);
+    addPathfindingBenchmarks(runner);
+    addTerritoryBenchmarks(runner);
+
+    std::unique_ptr<core::World> world;
+    std::unique_ptr<OffscreenScene> scene;
+    std::unique_ptr<ui::WorldSurface> worldSurface;
+
+    try
+    {
+        if (!options.worldPath.isEmpty())
+        {
+            world = io::readWorld(options.worldPath);
+            addWorldBenchmarks(runner, world.get());
+        }
+
+        if (!options.worldSurfacePath.isEmpty())
+        {
+            scene = std::make_unique<OffscreenScene>();
+            if (!scene->init())
+            {
+                std::cerr << "Failed to set up an OpenGL context, skipping the scene-graph benchmarks" << std::endl;
+                scene.reset();
+            }
+
+            // Destroyed before the scene, so that its textures are
+            // released while the context is still alive.
+            worldSurface = std::make_unique<ui::WorldSurface>(options.worldSurfacePath, world.get());
+            worldSurface->activate();
+            worldSurface->waitForAssets();
+
+            addWorldSurfaceBenchmarks(runner, world.get(), worldSurface.get(), scene.get());
+        }
+    }
+    catch (std::exception& e)
+    {
+        tools::die(logStream, "Failed to load the world or world-surface: {}", e.what());
+    }
+
+    std::vector<bench::BenchmarkResult> results;
+
+    try
+    {
+        results = runner.run(std::cerr);
+    }
+    catch (std::exception& e)
+    {
+        tools::die(logStream, "Benchmark failed: {}", e.what());
+    }
+
+    std::ofstream outFile;
+    if (!options.outPath.empty())
+    {
+        outFile.open(options.outPath);
+        if (!outFile)
+            tools::die(logStream, "Failed to open output file `{}'", options.outPath);
+    }
+
+    std::ostream& out = outFile.is_open() ? outFile : std::cout;
+
+    if (options.format == "json")
+        bench::writeJsonReport(out, results, context);
+    else
+        bench::writeConsoleReport(out, results);
+
+    return 0;
+}
+
+static bool parseOptions(int argc, char* const argv[], Options& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg{argv[i]};
+        const auto separator = arg.find('=');
+
+        if (separator == std::string::npos)
+            return false;
+
+        const std::string name = arg.substr(0, separator);
+        const std::string value = arg.substr(separator + 1);
+
+        if (name == "--filter")
+            options.config.filter = value;
+        else if (name == "--min-time")
+            options.config.minTime = std::chrono::duration<double>(std::atof(value.c_str()));
+        else if (name == "--repetitions")
+            options.config.repetitions = std::atoi(value.c_str());
+        else if (name == "--format")
+            options.format = value;
+        else if (name == "--out")
+            options.outPath = value;
+        else if (name == "--world")
+            options.worldPath = QString::fromStdString(value);
+        else if (name == "--world-surface")
+            options.worldSurfacePath = QString::fromStdString(value);
+        else
+            return false;
+    }
+
+    const bool worldSurfaceWithoutWorld = !options.worldSurfacePath.isEmpty() && options.worldPath.isEmpty();
+
+    return options.config.minTime.count() > 0.0 && options.config.repetitions > 0 &&
+        (options.format == "console" || options.format == "json") && !worldSurfaceWithoutWorld;
+}
+
+/*
+ * Minimal world, enough for maps to be serialized and unserialized.
+ */
+static std::unique_ptr<core::World> makeWorld()
+{
+    auto world = std::make_unique<core::World>("bench", core::WorldRules::Type::Lua);
+
+    world->setName("Benchmark world");
+    world->createBanner("Striped");
+    world->createBanner("Medusa");
+    world->createColor("Red");
+    world->createColor("Blue");
+    world->createCivilization("Persians");
+    world->createCivilization("Greeks");
+
+    return world;
+}
+
+static std::unique_ptr<core::Map> makeMap(core::World* world, unsigned int radius)
+{
+    auto map = std::make_unique<core::Map>();
+
+    map->setName(QString("Benchmark map of radius %1").arg(radius));
+    map->setWorld(world);
+    map->generateMapNodes(radius);
+
+    const auto& banners = world->getBanners();
+    const auto& colors = world->getColors();
+    const auto& civilizations = world->getCivilizations();
+
+    for (std::size_t i = 0; i < civilizations.size(); ++i)
+    {
+        auto* faction = map->createFaction();
+        faction->setName(QString("Faction %1").arg(i));
+        faction->setCivilization(civilizations[i]);
+        faction->setBanner(banners[i % banners.size()]);
+        faction->setPrimaryColor(colors[i % colors.size()]);
+        faction->setSecondaryColor(colors[(i + 1) % colors.size()]);
+    }
+
+    return map;
+}
+
+/*
+ * Square banner, the top half is the foreground placeholder, the bottom
+ * half is the background placeholder, with a frame of another color.
+ */
+static QImage makeBannerImage(int size)
+{
+    QImage image(size, size, QImage::Format_ARGB32);
+    image.fill(QColor("white"));
+
+    for (int y = 0; y < size / 2; ++y)
+    {
+        for (int x = 0; x < size; ++x)
+            image.setPixel(x, y, QColor("black").rgba());
+    }
+
+    for (int i = 0; i < size; ++i)
+    {
+        image.setPixel(i, 0, QColor("gray").rgba());
+        image.setPixel(i, size - 1, QColor("gray").rgba());
+        image.setPixel(0, i, QColor("gray").rgba());
+        image.setPixel(size - 1, i, QColor("gray").rgba());
+    }
+
+    return image;
+}
+
+/*
+ * Version 1 had no version entry and had the neighbours of the map-nodes
+ * as references keyed by the direction.
+ */
+static core::ir::Value toMapFormatVersion1(core::ir::Value serializedMap)
+{
+    auto obj = std::move(serializedMap).asMap();
+    obj.erase("version");
+
+    const QString mapClassName(core::Map::staticMetaObject.className());
+    const QString mapNodeClassName(core::MapNode::staticMetaObject.className());
+
+    auto serializedMapNodes = std::move(obj["mapNodes"]).asList();
+    for (auto& serializedMapNode : serializedMapNodes)
+    {
+        auto mapNodeObj = std::move(serializedMapNode).asMap();
+        const auto& ids = mapNodeObj["neighbours"].asList();
+
+        std::unordered_map<QString, core::ir::Value> neighbours;
+        for (std::size_t i = 0; i < core::directions.size(); ++i)
+        {
+            const int id = ids[i].asInteger();
+            neighbours.emplace(core::direction2str(core::directions[i]),
+                id < 0 ? core::ir::Reference{QString(), QString(), core::ObjectId::Invalid}
+                       : core::ir::Reference{mapClassName, mapNodeClassName, core::ObjectId(id)});
+        }
+
+        mapNodeObj["neighbours"] = std::move(neighbours);
+        serializedMapNode = std::move(mapNodeObj);
+    }
+    obj["mapNodes"] = std::move(serializedMapNodes);
+
+    return obj;
+}
+
+static void addCoreBenchmarks(bench::BenchmarkRunner& runner,
+    core::World* world,
+    const QString& tmpDir,
+    std::vector<std::pair<std::string, std::string>>& context)
+{
+    for (const unsigned int radius : {4u, 16u, 32u, 64u})
+    {
+        const std::size_t mapNodeCount = makeMap(world, radius)->getMapNodes().size();
+
+        runner.add(fmt::format("map/generate_map_nodes/{}", radius),
+            [radius](std::size_t iterations) {
+                for (std::size_t i = 0; i < iterations; ++i)
+                {
+                    core::Map map;
+                    map.generateMapNodes(radius);
+                    bench::doNotOptimize(map.getMapNodes().data());
+                }
+            },
+            mapNodeCount);
+    }
+
+    for (const unsigned int radius : {16u, 64u})
+    {
+        std::shared_ptr<core::Map> map = makeMap(world, radius);
+        const std::size_t mapNodeCount = map->getMapNodes().size();
+
+        const auto serializer = std::make_shared<io::JsonSerializer>();
+        const auto json = std::make_shared<QByteArray>(serializer->serialize(map->serialize()));
+
+        runner.add(fmt::format("serializer/json_serialize/{}", radius),
+            [map, serializer](std::size_t iterations) {
+                for (std::size_t i = 0; i < iterations; ++i)
+                {
+                    const QByteArray json = serializer->serialize(map->serialize());
+                    bench::doNotOptimize(json.constData());
+                }
+            },
+            mapNodeCount);
+
+        runner.add(fmt::format("serializer/json_unserialize/{}", radius),
+            [world, serializer, json](std::size_t iterations) {
+                for (std::size_t i = 0; i < iterations; ++i)
+                {
+                    core::Map map(serializer->unserialize(*json), *world, nullptr);
+                    bench::doNotOptimize(map.getMapNodes().data());
+                }
+            },
+            mapNodeCount);
+
+        const QString path = QString("%1/map_%2.wmd").arg(tmpDir).arg(radius);
+        io::writeMap(map.get(), path);
+
+        runner.add(fmt::format("io/write_map/{}", radius),
+            [map, tmpDir](std::size_t iterations) {
+                const QString path = tmpDir + "/write_map.wmd";
+                for (std::size_t i = 0; i < iterations; ++i)
+                    io::writeMap(map.get(), path);
+            },
+            mapNodeCount);
+
+        // The part of a background save done by the worker, the part done by
+        // the caller is measured by rules/snapshot_map.
+        const auto snapshot = std::make_shared<const core::MapSnapshot>(*map);
+
+        runner.add(fmt::format("io/write_map_snapshot/{}", radius),
+            [snapshot, tmpDir](std::size_t iterations) {
+                const QString path = tmpDir + "/write_map_snapshot.wmd";
+                for (std::size_t i = 0; i < iterations; ++i)
+                    io::writeMap(*snapshot, path);
+            },
+            mapNodeCount);
+
+        runner.add(fmt::format("io/read_map/{}", radius),
+            [world, path](std::size_t iterations) {
+                for (std::size_t i = 0; i < iterations; ++i)
+                {
+                    const auto map = io::readMap(path, world);
+                    bench::doNotOptimize(map->getMapNodes().data());
+                }
+            },
+            mapNodeCount);
+
+        const QString compressedPath = QString("%1/map_%2_zlib.wmd").arg(tmpDir).arg(radius);
+        io::writeMap(map.get(), compressedPath, io::Compression::Zlib);
+
+        // The ratio is not a timing, it's reported in the context.
+        context.emplace_back(fmt::format("compression_ratio/json/zlib/{}", radius),
+            fmt::format("{:.2f}", static_cast<double>(json->size()) / QFileInfo(compressedPath).size()));
+
+        runner.add(fmt::format("io/write_map_zlib/{}", radius),
+            [map, tmpDir](std::size_t iterations) {
+                const QString path = tmpDir + "/write_map_zlib.wmd";
+                for (std::size_t i = 0; i < iterations; ++i)
+                    io::writeMap(map.get(), path, io::Compression::Zlib);
+            },
+            mapNodeCount);
+
+        runner.add(fmt::format("io/read_map_zlib/{}", radius),
+            [world, compressedPath](std::size_t iterations) {
+                for (std::size_t i = 0; i < iterations; ++i)
+                {
+                    const auto map = io::readMap(compressedPath, world);
+                    bench::doNotOptimize(map->getMapNodes().data());
+                }
+            },
+            mapNodeCount);
+
+        runner.add(fmt::format("ui/position_map_nodes/{}", radius),
+            [map](std::size_t iterations) {
+                for (std::size_t i = 0; i < iterations; ++i)
+                {
+                    const auto mapNodesPos = ui::positionMapNodes(map->getMapNodes()[0], 128);
+                    bench::doNotOptimize(mapNodesPos.size());
+                }
+            },
+            mapNodeCount);
+    }
+
+    for (const int size : {64, 256})
+    {
+        const auto image = std::make_shared<QImage>(makeBannerImage(size));
+        const QRgb foregroundPlaceholder{QColor("black").rgba()};
+        const QRgb backgroundPlaceholder{QColor("white").rgba()};
+
+        // The image is recolored in place, the placeholders are gone after
+        // the first pass, but the loop is branch-free so the cost is the
+        // same.
+        runner.add(fmt::format("ui/recolor_banner/{}", size),
+            [=](std::size_t iterations) {
+                for (std::size_t i = 0; i < iterations; ++i)
+                {
+                    ui::recolor(*image, foregroundPlaceholder, 0xffff0000, backgroundPlaceholder, 0xff0000ff);
+                    bench::doNotOptimize(image->constBits());
+                }
+            },
+            static_cast<std::size_t>(size) * size);
+    }
+}
+
+/*
+ * Compares reading the current map format with reading version 1, see
+ * core::Map::formatVersion. The file sizes are reported in the context.
+ * Radius 578 is a map of ~1M map-nodes.
+ */
+static void addMapFormatBenchmarks(bench::BenchmarkRunner& runner,
+    core::World* world,
+    const QString& tmpDir,
+    std::vector<std::pair<std::string, std::string>>& context)
+{
+    for (const unsigned int radius : {64u, 578u})
+    {
+        std::size_t mapNodeCount{0};
+        const QString path = QString("%1/map_format_%2.wmd").arg(tmpDir).arg(radius);
+        const QString version1Path = QString("%1/map_format_%2_v1.wmd").arg(tmpDir).arg(radius);
+
+        {
+            const auto map = makeMap(world, radius);
+            mapNodeCount = map->getMapNodes().size();
+
+            const io::JsonSerializer serializer;
+            io::writeMap(map.get(), path);
+            io::writeFile(version1Path, serializer.serialize(toMapFormatVersion1(map->serialize())));
+        }
+
+        context.emplace_back(fmt::format("map_file_size/v{}/{}", core::Map::formatVersion, radius),
+            std::to_string(QFileInfo(path).size()));
+        context.emplace_back(
+            fmt::format("map_file_size/v1/{}", radius), std::to_string(QFileInfo(version1Path).size()));
+
+        runner.add(fmt::format("io/read_map_format/v{}/{}", core::Map::formatVersion, radius),
+            [world, path](std::size_t iterations) {
+                for (std::size_t i = 0; i < iterations; ++i)
+                {
+                    const auto map = io::readMap(path, world);
+                    bench::doNotOptimize(map->getMapNodes().data());
+                }
+            },
+            mapNodeCount);
+
+        runner.add(fmt::format("io/read_map_format/v1/{}", radius),
+            [world, version1Path](std::size_t iterations) {
+                for (std::size_t i = 0; i < iterations; ++i)
+                {
+                    const auto map = io::readMap(version1Path, world);
+                    bench::doNotOptimize(map->getMapNodes().data());
+                }
+            },
+            mapNodeCount);
+    }
+}
+
+/*
+ * Radius 578 is a map of ~1M map-nodes.
+ */
+static void addPathfindingBenchmarks(bench::BenchmarkRunner& runner)
+{
+    for (const unsigned int radius : {64u, 578u})
+    {
+        auto map = std::make_shared<core::Map>();
+        map->generateMapNodes(radius);
+
+        // Sprinkle some impassable terrain around, so that paths aren't
+        // straight lines.
+        std::mt19937 gen(0);
+        std::bernoulli_distribution isWater(0.2);
+        for (core::MapNode* mapNode : map->getMapNodes())
+            mapNode->setTerrainType(isWater(gen) ? "water" : "grassland");
+
+        const std::size_t mapNodeCount = map->getMapNodes().size();
+
+        runner.add(fmt::format("pathfinding/build/{}", radius),
+            [map](std::size_t iterations) {
+                for (std::size_t i = 0; i < iterations; ++i)
+                {
+                    core::Pathfinder pathfinder(*map);
+                    bench::doNotOptimize(&pathfinder);
+                }
+            },
+            mapNodeCount);
+
+        auto pathfinder = std::make_shared<core::Pathfinder>(*map);
+        pathfinder->setTerrainCost("water", -1);
+
+        core::MapNode* center = map->getMapNodes()[0];
+        core::MapNode* west = core::walk(center, core::Direction::West, static_cast<int>(radius) - 1);
+        core::MapNode* east = core::walk(center, core::Direction::East, static_cast<int>(radius) - 1);
+        core::MapNode* near = core::walk(center, core::Direction::East, 16);
+
+        runner.add(fmt::format("pathfinding/find_path_across/{}", radius),
+            [map, pathfinder, west, east](std::size_t iterations) {
+                for (std::size_t i = 0; i < iterations; ++i)
+                    bench::doNotOptimize(pathfinder->findPath(west, east).cost);
+            });
+
+        runner.add(fmt::format("pathfinding/find_path_near/{}", radius),
+            [map, pathfinder, center, near](std::size_t iterations) {
+                for (std::size_t i = 0; i < iterations; ++i)
+                    bench::doNotOptimize(pathfinder->findPath(center, near).cost);
+            });
+
+        runner.add(fmt::format("pathfinding/movement_range_20/{}", radius),
+            [map, pathfinder, center](std::size_t iterations) {
+                for (std::size_t i = 0; i < iterations; ++i)
+                    bench::doNotOptimize(pathfinder->findMovementRange(center, 20).size());
+            });
+
+        const std::vector<core::MapNode*> sources{center, west, east, near};
+
+        runner.add(fmt::format("pathfinding/multi_source_movement_range_20/{}", radius),
+            [map, pathfinder, sources](std::size_t iterations) {
+                for (std::size_t i = 0; i < iterations; ++i)
+                    bench::doNotOptimize(pathfinder->findMovementRange(sources, 20).size());
+            });
+
+        runner.add(fmt::format("pathfinding/hierarchical_build/{}", radius),
+            [map](std::size_t iterations) {
+                for (std::size_t i = 0; i < iterations; ++i)
+                {
+                    core::HierarchicalPathfinder hierarchicalPathfinder(*map);
+                    bench::doNotOptimize(&hierarchicalPathfinder);
+                }
+            },
+            mapNodeCount);
+
+        auto hierarchicalPathfinder = std::make_shared<core::HierarchicalPathfinder>(*map);
+        hierarchicalPathfinder->setTerrainCost("water", -1);
+
+        runner.add(fmt::format("pathfinding/hierarchical_find_path_across/{}", radius),
+            [map, hierarchicalPathfinder, west, east](std::size_t iterations) {
+                for (std::size_t i = 0; i < iterations; ++i)
+                    bench::doNotOptimize(hierarchicalPathfinder->findPath(west, east).cost);
+            });
+
+        runner.add(fmt::format("pathfinding/hierarchical_update/{}", radius),
+            [map, hierarchicalPathfinder, near](std::size_t iterations) {
+                for (std::size_t i = 0; i < iterations; ++i)
+                {
+                    near->setTerrainType(i % 2 ? "grassland" : "water");
+                    hierarchicalPathfinder->updateTerrainType(near);
+                    bench::doNotOptimize(hierarchicalPathfinder->getPortalCount());
+                }
+            });
+    }
+}
+
+/*
+ * One settlement per ~200 map-nodes, owned by 8 factions.
+ */
+static void addTerritoryBenchmarks(bench::BenchmarkRunner& runner)
+{
+    for (const unsigned int radius : {64u, 578u})
+    {
+        auto map = std::make_shared<core::Map>();
+        map->generateMapNodes(radius);
+
+        const auto& mapNodes = map->getMapNodes();
+        const std::size_t mapNodeCount = mapNodes.size();
+
+        std::vector<core::Faction*> factions;
+        for (int i = 0; i < 8; ++i)
+            factions.push_back(map->createFaction());
+
+        std::mt19937 gen(0);
+        std::uniform_int_distribution<std::size_t> mapNodeDist(0, mapNodeCount - 1);
+        for (std::size_t i = 0; i < mapNodeCount / 200; ++i)
+        {
+            core::Settlement* settlement = map->createSettlement();
+            settlement->setPosition(mapNodes[mapNodeDist(gen)]);
+            settlement->setOwner(factions[i % factions.size()]);
+        }
+
+        runner.add(fmt::format("territory/build/{}", radius),
+            [map](std::size_t iterations) {
+                for (std::size_t i = 0; i < iterations; ++i)
+                {
+                    core::Territory territory(*map);
+                    bench::doNotOptimize(territory.getOwnerIndexes().data());
+                }
+            },
+            mapNodeCount);
+
+        auto territory = std::make_shared<core::Territory>(*map);
+
+        runner.add(fmt::format("territory/move_settlement/{}", radius),
+            [map, territory, mapNodeDist, gen](std::size_t iterations) mutable {
+                core::Settlement* settlement = map->getSettlements().front();
+                for (std::size_t i = 0; i < iterations; ++i)
+                {
+                    settlement->setPosition(map->getMapNodes()[mapNodeDist(gen)]);
+                    territory->updateSettlements();
+                }
+            });
+
+        runner.add(fmt::format("territory/change_owner/{}", radius),
+            [map, territory, factions](std::size_t iterations) {
+                core::Settlement* settlement = map->getSettlements().front();
+                for (std::size_t i = 0; i < iterations; ++i)
+                {
+                    settlement->setOwner(factions[i % factions.size()]);
+                    territory->updateSettlements();
+                }
+            });
+    }
+}
+
+static void addWorldBenchmarks(bench::BenchmarkRunner& runner, core::World* world)
+{
+    for (const unsigned int radius : {8u, 32u})
+    {
+        runner.add(fmt::format("rules/generate_map/{}", radius), [world, radius](std::size_t iterations) {
+            for (std::size_t i = 0; i < iterations; ++i)
+            {
+                const auto map = world->getRules()->generateMap(static_cast<int>(i), radius, {});
+                bench::doNotOptimize(map->getMapNodes().data());
+            }
+        });
+
+        std::shared_ptr<core::Map> map = world->getRules()->generateMap(0, radius, {});
+
+        runner.add(fmt::format("rules/map_init/{}", radius), [world, map](std::size_t iterations) {
+            for (std::size_t i = 0; i < iterations; ++i)
+                world->getRules()->mapInit(map.get());
+        });
+    }
+}
+
+static void addWorldSurfaceBenchmarks(
+    bench::BenchmarkRunner& runner, core::World* world, ui::WorldSurface* worldSurface, OffscreenScene* scene)
+{
+    const int tileSize = worldSurface->getTileSize();
+    std::shared_ptr<ui::WorldSurfaceRules> rules = worldSurface->createRules();
+
+    for (const unsigned int radius : {8u, 32u})
+    {
+        std::shared_ptr<core::Map> map = world->getRules()->generateMap(0, radius, {});
+        const std::size_t mapNodeCount = map->getMapNodes().size();
+
+        const auto mapNodesPos = std::make_shared<std::unordered_map<core::MapNode*, QPoint>>(
+            ui::positionMapNodes(map->getMapNodes()[0], tileSize));
+        const QRect mapRect = ui::calculateBoundingRect(*mapNodesPos, tileSize);
+
+        // Includes out-of-map points, like the mouse-pointer would.
+        std::mt19937 gen(0);
+        std::uniform_int_distribution<int> xDist(mapRect.left() - tileSize, mapRect.right() + tileSize);
+        std::uniform_int_distribution<int> yDist(mapRect.top() - tileSize, mapRect.bottom() + tileSize);
+        auto points = std::make_shared<std::vector<QPoint>>(1024);
+        for (auto& point : *points)
+            point = QPoint(xDist(gen), yDist(gen));
+
+        runner.add(fmt::format("ui/map_node_at_pos/{}", radius),
+            [worldSurface, mapNodesPos, points](std::size_t iterations) {
+                for (std::size_t i = 0; i < iterations; ++i)
+                {
+                    for (const auto& point : *points)
+                        bench::doNotOptimize(ui::mapNodeAtPos(point, *mapNodesPos, worldSurface));
+                }
+            },
+            points->size());
+
+        runner.add(fmt::format("rules/snapshot_map/{}", radius),
+            [map](std::size_t iterations) {
+                for (std::size_t i = 0; i < iterations; ++i)
+                {
+                    const core::MapSnapshot snapshot(*map);
+                    bench::doNotOptimize(snapshot.getMapNodes().data());
+                }
+            },
+            mapNodeCount);
+
+        const auto snapshot = std::make_shared<const core::MapSnapshot>(*map);
+
+        runner.add(fmt::format("rules/render_map/{}", radius),
+            [rules, snapshot](std::size_t iterations) {
+                for (std::size_t i = 0; i < iterations; ++i)
+                {
+                    const auto graphicMap = rules->renderMap(*snapshot);
+                    bench::doNotOptimize(graphicMap.gridTiles.data());
+                }
+            },
+            mapNodeCount);
+
+        if (!scene)
+            continue;
+
+        const auto graphicMap = std::make_shared<const ui::graphics::Map>(rules->renderMap(*snapshot));
+
+        runner.add(fmt::format("ui/build_scene_graph/{}", radius),
+            [worldSurface, scene, mapNodesPos, mapRect, graphicMap](std::size_t iterations) {
+                const ui::RenderContext ctx{worldSurface, &scene->window, *mapNodesPos, mapRect};
+
+                for (std::size_t i = 0; i < iterations; ++i)
+                {
+                    worldSurface->prepareTextures(&scene->window);
+                    std::unique_ptr<QSGNode> node(ui::renderMap(*graphicMap, nullptr, ctx));
+                    bench::doNotOptimize(node.get());
+                }
+            },
+            mapNodeCount);
+
+        runner.add(fmt::format("ui/update_scene_graph/{}", radius),
+            [worldSurface, scene, mapNodesPos, mapRect, graphicMap](std::size_t iterations) {
+                const ui::RenderContext ctx{worldSurface, &scene->window, *mapNodesPos, mapRect};
+                std::unique_ptr<QSGNode> node;
+
+                for (std::size_t i = 0; i < iterations; ++i)
+                {
+                    worldSurface->prepareTextures(&scene->window);
+                    QSGNode* oldNode = node.release();
+                    node.reset(ui::renderMap(*graphicMap, oldNode, ctx));
+                    bench::doNotOptimize(node.get());
+                }
+            },
+            mapNodeCount);
+    }
+}
+
+static std::vector<std::pair<std::string, std::string>> makeContext(const char* executable)
+{
+#ifdef NDEBUG
+    const char* buildType{"release"};
+#else
+    const char* buildType{"debug"};
+#endif
+
+    return {{"date", QDateTime::currentDateTime().toString(Qt::ISODate).toStdString()},
+        {"host_name", QSysInfo::machineHostName().toStdString()},
+        {"executable", executable},
+        {"num_cpus", std::to_string(std::thread::hardware_concurrency())},
+        {"library_build_type", buildType},
+        {"warmonger_version", version.toStdString()},
+        {"warmonger_git_commit", gitCommit.toStdString()}};
+}
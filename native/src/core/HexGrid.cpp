@@ -0,0 +1,125 @@
+/**
+ * Copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "core/HexGrid.h"
+
+#include <cstdlib>
+
+#include "core/MapNode.h"
+
+namespace warmonger {
+namespace core {
+
+// In the order of Direction.
+static const std::array<HexCoordinates, 6> directionOffsets{{{-1, 0}, {0, -1}, {1, -1}, {1, 0}, {0, 1}, {-1, 1}}};
+
+const HexCoordinates& hexOffset(const Direction d)
+{
+    return directionOffsets[static_cast<std::size_t>(d)];
+}
+
+int hexDistance(const HexCoordinates& a, const HexCoordinates& b)
+{
+    const int dq = a.q - b.q;
+    const int dr = a.r - b.r;
+
+    return (std::abs(dq) + std::abs(dr) + std::abs(dq + dr)) / 2;
+}
+
+std::unordered_map<const MapNode*, MapNodeIndex> indexMapNodes(const std::vector<MapNode*>& mapNodes)
+{
+    std::unordered_map<const MapNode*, MapNodeIndex> indexes;
+
+    indexes.reserve(mapNodes.size());
+    for (std::size_t i = 0; i < mapNodes.size(); ++i)
+        indexes.emplace(mapNodes[i], static_cast<MapNodeIndex>(i));
+
+    return indexes;
+}
+
+std::vector<std::array<MapNodeIndex, 6>> indexNeighbours(
+    const std::vector<MapNode*>& mapNodes, const std::unordered_map<const MapNode*, MapNodeIndex>& indexes)
+{
+    std::vector<std::array<MapNodeIndex, 6>> neighbours(mapNodes.size());
+
+    for (std::size_t i = 0; i < mapNodes.size(); ++i)
+    {
+        for (std::size_t d = 0; d < directions.size(); ++d)
+        {
+            const auto it = indexes.find(mapNodes[i]->getNeighbour(directions[d]));
+            neighbours[i][d] = it == indexes.end() ? invalidMapNodeIndex : it->second;
+        }
+    }
+
+    return neighbours;
+}
+
+std::vector<std::int32_t> placeMapNodes(
+    const std::vector<std::array<MapNodeIndex, 6>>& neighbours, std::vector<HexCoordinates>& coordinates)
+{
+    const std::size_t size = neighbours.size();
+
+    std::vector<std::int32_t> components(size, -1);
+    std::vector<MapNodeIndex> pending;
+    std::int32_t component{0};
+
+    coordinates.assign(size, HexCoordinates{0, 0});
+
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        if (components[i] != -1)
+            continue;
+
+        components[i] = component;
+        pending.push_back(static_cast<MapNodeIndex>(i));
+
+        while (!pending.empty())
+        {
+            const MapNodeIndex node = pending.back();
+            pending.pop_back();
+
+            for (std::size_t d = 0; d < directions.size(); ++d)
+            {
+                const MapNodeIndex neighbour = neighbours[node][d];
+                if (neighbour == invalidMapNodeIndex || components[neighbour] != -1)
+                    continue;
+
+                components[neighbour] = component;
+                const HexCoordinates& position = coordinates[node];
+                coordinates[neighbour] =
+                    HexCoordinates{position.q + directionOffsets[d].q, position.r + directionOffsets[d].r};
+                pending.push_back(neighbour);
+            }
+        }
+
+        ++component;
+    }
+
+    return components;
+}
+
+MapNode* walk(MapNode* mapNode, const Direction direction, int steps)
+{
+    for (int i = 0; i < steps && mapNode != nullptr; ++i)
+        mapNode = mapNode->getNeighbour(direction);
+
+    return mapNode;
+}
+
+} // namespace core
+} // namespace warmonger
@@ -0,0 +1,126 @@
+/** \file
+ * Hex-grid functions.
+ *
+ * \copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef W_CORE_HEX_GRID_H
+#define W_CORE_HEX_GRID_H
+
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "core/Hexagon.h"
+
+namespace warmonger {
+namespace core {
+
+class MapNode;
+
+/**
+ * Axial hex-coordinates.
+ */
+struct HexCoordinates
+{
+    int q;
+    int r;
+};
+
+/**
+ * The index of a map-node in a dense, index-based copy of the map-graph.
+ */
+using MapNodeIndex = std::int32_t;
+
+constexpr MapNodeIndex invalidMapNodeIndex{-1};
+
+/**
+ * The offset of the neighbour in direction d, in axial hex-coordinates.
+ *
+ * \param d the direction
+ *
+ * \return the offset
+ */
+const HexCoordinates& hexOffset(const Direction d);
+
+/**
+ * The distance of two hexes, in steps.
+ *
+ * \param a the first hex
+ * \param b the second hex
+ *
+ * \return the distance
+ */
+int hexDistance(const HexCoordinates& a, const HexCoordinates& b);
+
+/**
+ * Index the map-nodes by their position in mapNodes.
+ *
+ * \param mapNodes the map-nodes
+ *
+ * \return the index of each map-node
+ */
+std::unordered_map<const MapNode*, MapNodeIndex> indexMapNodes(const std::vector<MapNode*>& mapNodes);
+
+/**
+ * The indexes of the neighbours of each map-node, in the order of
+ * directions.
+ *
+ * Missing neighbours and neighbours without an index are
+ * invalidMapNodeIndex.
+ *
+ * \param mapNodes the map-nodes
+ * \param indexes the index of each map-node (see indexMapNodes())
+ *
+ * \return the neighbour indexes, in the order of mapNodes
+ */
+std::vector<std::array<MapNodeIndex, 6>> indexNeighbours(
+    const std::vector<MapNode*>& mapNodes, const std::unordered_map<const MapNode*, MapNodeIndex>& indexes);
+
+/**
+ * Derive the hex-coordinates of the map-nodes from their neighbourhood.
+ *
+ * The map-nodes are placed one connected component at a time, the first
+ * map-node (in index order) of each component is placed at (0, 0).
+ * Components are unreachable from each other so their coordinates are
+ * not consistent with each other, they can overlap.
+ *
+ * \param neighbours the neighbour indexes (see indexNeighbours())
+ * \param coordinates the coordinates of each map-node, in index order
+ *
+ * \return the component of each map-node, in index order, the
+ * components are numbered from 0 in the order of their first map-node
+ */
+std::vector<std::int32_t> placeMapNodes(
+    const std::vector<std::array<MapNodeIndex, 6>>& neighbours, std::vector<HexCoordinates>& coordinates);
+
+/**
+ * Walk steps map-nodes from mapNode in direction.
+ *
+ * \param mapNode the map-node to start from
+ * \param direction the direction to walk in
+ * \param steps the number of steps
+ *
+ * \return the reached map-node, nullptr if the walk leaves the map
+ */
+MapNode* walk(MapNode* mapNode, const Direction direction, int steps);
+
+} // namespace core
+} // namespace warmonger
+
+#endif // W_CORE_HEX_GRID_H
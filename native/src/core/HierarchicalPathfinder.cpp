@@ -0,0 +1,580 @@
+/**
+ * Copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "core/HierarchicalPathfinder.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <tuple>
+
+#include "utils/Exception.h"
+
+namespace warmonger {
+namespace core {
+
+// Entrances with at least this many edges get two transitions.
+static const std::size_t longEntranceSize{6};
+
+static int floorDiv(int a, int b);
+static std::size_t findRoot(std::vector<std::size_t>& roots, std::size_t i);
+static bool isDetour(const std::vector<std::vector<int>>& costs, std::size_t from, std::size_t to);
+
+HierarchicalPathfinder::HierarchicalPathfinder(const Map& map, int clusterSize)
+    : pathfinder(map)
+    , clusterSize(clusterSize)
+    , dirty(false)
+    , slotsDirty(false)
+    , searchGeneration(0)
+{
+    if (clusterSize < 2)
+        throw utils::ValueError("Cluster-size must be at least 2");
+
+    this->buildClusters();
+    this->update();
+}
+
+void HierarchicalPathfinder::rebuild()
+{
+    this->pathfinder.rebuild();
+    this->buildClusters();
+    this->update();
+}
+
+void HierarchicalPathfinder::updateTerrainType(MapNode* mapNode)
+{
+    this->pathfinder.updateTerrainType(mapNode);
+
+    this->clusters[this->nodeClusters[this->pathfinder.indexOf(mapNode)]].dirty = true;
+    this->dirty = true;
+}
+
+void HierarchicalPathfinder::setTerrainCost(const QString& terrainType, int cost)
+{
+    this->pathfinder.setTerrainCost(terrainType, cost);
+
+    for (auto& cluster : this->clusters)
+        cluster.dirty = true;
+
+    this->dirty = true;
+}
+
+Path HierarchicalPathfinder::findPath(MapNode* from, MapNode* to)
+{
+    const Index source = this->pathfinder.indexOf(from);
+    const Index destination = this->pathfinder.indexOf(to);
+
+    if (this->pathfinder.hexDistance(source, destination) <= 2 * this->clusterSize)
+        return this->pathfinder.findPath(from, to);
+
+    this->update();
+    this->updatePortalSlots();
+
+    Path path{{}, -1};
+    std::vector<Index> abstractPath;
+
+    if (this->pathfinder.getNodeCost(destination) < 0 ||
+        !this->findAbstractPath(source, destination, abstractPath, path.cost))
+        return path;
+
+    this->refine(abstractPath, path.mapNodes);
+
+    return path;
+}
+
+std::size_t HierarchicalPathfinder::getPortalCount()
+{
+    this->update();
+
+    return std::accumulate(this->clusters.begin(),
+        this->clusters.end(),
+        std::size_t{0},
+        [](std::size_t count, const Cluster& cluster) { return count + cluster.portals.size(); });
+}
+
+void HierarchicalPathfinder::buildClusters()
+{
+    const auto& nodes = this->pathfinder.nodes;
+
+    std::map<std::pair<int, int>, std::int32_t> clusterIds;
+
+    this->clusters.clear();
+    this->transitions.clear();
+    this->nodeClusters.resize(nodes.size());
+    this->nodePortals.assign(nodes.size(), -1);
+
+    for (std::size_t i = 0; i < nodes.size(); ++i)
+    {
+        const std::pair<int, int> position{
+            floorDiv(nodes[i].position.q, this->clusterSize), floorDiv(nodes[i].position.r, this->clusterSize)};
+        const auto inserted = clusterIds.emplace(position, static_cast<std::int32_t>(this->clusters.size()));
+
+        if (inserted.second)
+            this->clusters.push_back(Cluster{{}, {}, {}, true});
+
+        this->nodeClusters[i] = inserted.first->second;
+        this->clusters[inserted.first->second].nodes.push_back(static_cast<Index>(i));
+    }
+
+    for (std::size_t i = 0; i < nodes.size(); ++i)
+    {
+        Cluster& cluster = this->clusters[this->nodeClusters[i]];
+
+        for (const Index neighbour : nodes[i].neighbours)
+        {
+            if (neighbour != Pathfinder::invalidIndex && this->nodeClusters[neighbour] != this->nodeClusters[i])
+                cluster.neighbours.push_back(this->nodeClusters[neighbour]);
+        }
+    }
+
+    for (auto& cluster : this->clusters)
+    {
+        std::sort(cluster.neighbours.begin(), cluster.neighbours.end());
+        cluster.neighbours.erase(
+            std::unique(cluster.neighbours.begin(), cluster.neighbours.end()), cluster.neighbours.end());
+    }
+
+    this->dirty = true;
+}
+
+void HierarchicalPathfinder::update()
+{
+    if (!this->dirty)
+        return;
+
+    std::vector<bool> affected(this->clusters.size(), false);
+
+    for (std::size_t i = 0; i < this->clusters.size(); ++i)
+    {
+        if (!this->clusters[i].dirty)
+            continue;
+
+        const auto a = static_cast<std::int32_t>(i);
+
+        affected[i] = true;
+
+        for (const std::int32_t b : this->clusters[i].neighbours)
+        {
+            // Both dirty: the transitions are updated when visiting the
+            // lower one.
+            if (!this->clusters[b].dirty || a < b)
+                this->updateTransitions(std::min(a, b), std::max(a, b));
+
+            affected[b] = true;
+        }
+    }
+
+    for (std::size_t i = 0; i < this->clusters.size(); ++i)
+    {
+        if (affected[i])
+            this->updatePortals(static_cast<std::int32_t>(i));
+
+        this->clusters[i].dirty = false;
+    }
+
+    this->dirty = false;
+    this->slotsDirty = true;
+}
+
+void HierarchicalPathfinder::updateTransitions(std::int32_t a, std::int32_t b)
+{
+    const auto& nodes = this->pathfinder.nodes;
+
+    std::vector<Transition> edges;
+
+    for (const Index node : this->clusters[a].nodes)
+    {
+        if (this->pathfinder.getNodeCost(node) < 0)
+            continue;
+
+        for (const Index neighbour : nodes[node].neighbours)
+        {
+            if (neighbour != Pathfinder::invalidIndex && this->nodeClusters[neighbour] == b &&
+                this->pathfinder.getNodeCost(neighbour) >= 0)
+                edges.emplace_back(node, neighbour);
+        }
+    }
+
+    std::vector<Transition>& selected = this->transitions[ClusterPair(a, b)];
+    selected.clear();
+
+    if (edges.empty())
+    {
+        this->transitions.erase(ClusterPair(a, b));
+        return;
+    }
+
+    // Group the edges into entrances: two edges are part of the same
+    // entrance if their endpoints on both sides are the same or adjacent.
+    auto isNear = [this](Index x, Index y) { return x == y || this->pathfinder.hexDistance(x, y) == 1; };
+
+    std::vector<std::size_t> roots(edges.size());
+    std::iota(roots.begin(), roots.end(), 0);
+
+    for (std::size_t i = 0; i < edges.size(); ++i)
+    {
+        for (std::size_t j = i + 1; j < edges.size(); ++j)
+        {
+            if (isNear(edges[i].first, edges[j].first) && isNear(edges[i].second, edges[j].second))
+                roots[findRoot(roots, i)] = findRoot(roots, j);
+        }
+    }
+
+    std::map<std::size_t, std::vector<Transition>> entrances;
+    for (std::size_t i = 0; i < edges.size(); ++i)
+        entrances[findRoot(roots, i)].push_back(edges[i]);
+
+    for (auto& entrance : entrances)
+    {
+        std::vector<Transition>& entranceEdges = entrance.second;
+
+        std::sort(entranceEdges.begin(), entranceEdges.end(), [&nodes](const Transition& x, const Transition& y) {
+            const HexCoordinates& x1 = nodes[x.first].position;
+            const HexCoordinates& x2 = nodes[x.second].position;
+            const HexCoordinates& y1 = nodes[y.first].position;
+            const HexCoordinates& y2 = nodes[y.second].position;
+
+            return std::tie(x1.q, x1.r, x2.q, x2.r) < std::tie(y1.q, y1.r, y2.q, y2.r);
+        });
+
+        if (entranceEdges.size() < longEntranceSize)
+        {
+            selected.push_back(entranceEdges[entranceEdges.size() / 2]);
+        }
+        else
+        {
+            selected.push_back(entranceEdges.front());
+            selected.push_back(entranceEdges.back());
+        }
+    }
+}
+
+void HierarchicalPathfinder::updatePortals(std::int32_t cluster)
+{
+    std::vector<Portal>& portals = this->clusters[cluster].portals;
+
+    for (const Portal& portal : portals)
+        this->nodePortals[portal.node] = -1;
+
+    portals.clear();
+
+    for (const std::int32_t neighbour : this->clusters[cluster].neighbours)
+    {
+        const auto it = this->transitions.find(ClusterPair(std::min(cluster, neighbour), std::max(cluster, neighbour)));
+        if (it == this->transitions.end())
+            continue;
+
+        for (const Transition& transition : it->second)
+        {
+            const bool isFirst = this->nodeClusters[transition.first] == cluster;
+            const Index node = isFirst ? transition.first : transition.second;
+            const Index other = isFirst ? transition.second : transition.first;
+
+            const std::int32_t portal = this->addPortal(cluster, node);
+            portals[portal].transitions.push_back(Edge{other, this->pathfinder.getNodeCost(other)});
+        }
+    }
+
+    std::vector<std::vector<int>> portalCosts;
+    portalCosts.reserve(portals.size());
+
+    for (const Portal& portal : portals)
+        portalCosts.push_back(this->findPortalCosts(portal.node));
+
+    for (std::size_t i = 0; i < portals.size(); ++i)
+    {
+        for (std::size_t j = 0; j < portals.size(); ++j)
+        {
+            if (i != j && portalCosts[i][j] >= 0 && !isDetour(portalCosts, i, j))
+                portals[i].edges.push_back(Edge{static_cast<Index>(j), portalCosts[i][j]});
+        }
+    }
+}
+
+void HierarchicalPathfinder::updatePortalSlots()
+{
+    if (!this->slotsDirty)
+        return;
+
+    std::int32_t slot{0};
+
+    this->portalOffsets.resize(this->clusters.size());
+    this->portalNodes.clear();
+    this->portalPositions.clear();
+
+    for (std::size_t i = 0; i < this->clusters.size(); ++i)
+    {
+        this->portalOffsets[i] = slot;
+
+        for (const Portal& portal : this->clusters[i].portals)
+        {
+            this->portalNodes.push_back(portal.node);
+            this->portalPositions.push_back(this->pathfinder.nodes[portal.node].position);
+        }
+
+        slot += static_cast<std::int32_t>(this->clusters[i].portals.size());
+    }
+
+    this->portalEdgeOffsets.clear();
+    this->portalEdges.clear();
+
+    for (std::size_t i = 0; i < this->clusters.size(); ++i)
+    {
+        const std::int32_t offset = this->portalOffsets[i];
+
+        for (const Portal& portal : this->clusters[i].portals)
+        {
+            this->portalEdgeOffsets.push_back(static_cast<std::int32_t>(this->portalEdges.size()));
+
+            for (const Edge& edge : portal.edges)
+                this->portalEdges.push_back(Edge{offset + edge.to, edge.cost});
+
+            for (const Edge& transition : portal.transitions)
+            {
+                const std::int32_t other =
+                    this->portalOffsets[this->nodeClusters[transition.to]] + this->nodePortals[transition.to];
+
+                this->portalEdges.push_back(Edge{other, transition.cost});
+            }
+        }
+    }
+
+    // The slots of the source and the destination, their edges are
+    // specific to the query.
+    this->portalNodes.resize(this->portalNodes.size() + 2, Pathfinder::invalidIndex);
+    this->portalPositions.resize(this->portalNodes.size(), HexCoordinates{0, 0});
+    this->portalEdgeOffsets.resize(this->portalNodes.size() + 1, static_cast<std::int32_t>(this->portalEdges.size()));
+
+    this->slotsDirty = false;
+}
+
+std::int32_t HierarchicalPathfinder::addPortal(std::int32_t cluster, Index node)
+{
+    std::vector<Portal>& portals = this->clusters[cluster].portals;
+
+    if (this->nodePortals[node] == -1)
+    {
+        this->nodePortals[node] = static_cast<std::int32_t>(portals.size());
+        portals.push_back(Portal{node, {}});
+    }
+
+    return this->nodePortals[node];
+}
+
+std::vector<int> HierarchicalPathfinder::findPortalCosts(Index node)
+{
+    const std::int32_t cluster = this->nodeClusters[node];
+
+    this->pathfinder.search(
+        &node, 1, Pathfinder::invalidIndex, std::numeric_limits<int>::max(), &this->nodeClusters, cluster, nullptr);
+
+    const std::vector<Portal>& portals = this->clusters[cluster].portals;
+    std::vector<int> portalCosts(portals.size(), -1);
+
+    for (std::size_t i = 0; i < portals.size(); ++i)
+    {
+        if (this->pathfinder.isClosed(portals[i].node))
+            portalCosts[i] = this->pathfinder.costs[portals[i].node];
+    }
+
+    return portalCosts;
+}
+
+bool HierarchicalPathfinder::findAbstractPath(
+    Index source, Index destination, std::vector<Index>& abstractPath, int& cost)
+{
+    const std::int32_t sourceCluster = this->nodeClusters[source];
+    const std::int32_t destinationCluster = this->nodeClusters[destination];
+    const std::vector<Portal>& sourcePortals = this->clusters[sourceCluster].portals;
+    const std::vector<Portal>& destinationPortals = this->clusters[destinationCluster].portals;
+
+    const std::vector<int> sourceCosts = this->findPortalCosts(source);
+    std::vector<int> destinationCosts = this->findPortalCosts(destination);
+
+    // The portal -> destination costs are derived from the destination ->
+    // portal ones: reversing a path swaps the cost of its first and last
+    // map-node.
+    const int destinationCost = this->pathfinder.getNodeCost(destination);
+    for (std::size_t i = 0; i < destinationPortals.size(); ++i)
+    {
+        if (destinationCosts[i] >= 0)
+            destinationCosts[i] += destinationCost - this->pathfinder.getNodeCost(destinationPortals[i].node);
+    }
+
+    const auto destinationSlot = static_cast<std::int32_t>(this->portalNodes.size() - 1);
+    const std::int32_t sourceSlot = destinationSlot - 1;
+
+    this->portalNodes[sourceSlot] = source;
+    this->portalNodes[destinationSlot] = destination;
+    this->portalPositions[sourceSlot] = this->pathfinder.nodes[source].position;
+    this->portalPositions[destinationSlot] = this->pathfinder.nodes[destination].position;
+
+    const HexCoordinates& destinationPosition = this->portalPositions[destinationSlot];
+
+    if (this->searchNodes.size() < this->portalNodes.size())
+        this->searchNodes.resize(this->portalNodes.size(), SearchNode{0, 0, 0, -1});
+
+    this->searchQueue.clear();
+
+    if (++this->searchGeneration == 0)
+    {
+        // The stamps wrapped around, old stamps could be mistaken for
+        // current ones.
+        std::fill(this->searchNodes.begin(), this->searchNodes.end(), SearchNode{0, 0, 0, -1});
+        this->searchGeneration = 1;
+    }
+
+    const std::uint32_t generation = this->searchGeneration;
+    const int minCost = this->pathfinder.minCost;
+
+    auto relax = [this, generation, minCost, &destinationPosition](
+                     std::int32_t slot, int slotCost, std::int32_t parent) {
+        SearchNode& searchNode = this->searchNodes[slot];
+
+        if (searchNode.closed == generation || (searchNode.visited == generation && slotCost >= searchNode.cost))
+            return;
+
+        searchNode.visited = generation;
+        searchNode.cost = slotCost;
+        searchNode.parent = parent;
+
+        const int priority = slotCost + hexDistance(this->portalPositions[slot], destinationPosition) * minCost;
+
+        this->searchQueue.push_back(Pathfinder::QueueEntry{priority, slot});
+        std::push_heap(this->searchQueue.begin(), this->searchQueue.end(), std::greater<Pathfinder::QueueEntry>());
+    };
+
+    relax(sourceSlot, 0, -1);
+
+    while (!this->searchQueue.empty())
+    {
+        std::pop_heap(this->searchQueue.begin(), this->searchQueue.end(), std::greater<Pathfinder::QueueEntry>());
+
+        const std::int32_t current = this->searchQueue.back().node;
+        this->searchQueue.pop_back();
+
+        SearchNode& currentNode = this->searchNodes[current];
+
+        if (currentNode.closed == generation)
+            continue;
+
+        currentNode.closed = generation;
+
+        if (current == destinationSlot)
+            break;
+
+        const int currentCost = currentNode.cost;
+
+        if (current == sourceSlot)
+        {
+            for (std::size_t i = 0; i < sourcePortals.size(); ++i)
+            {
+                if (sourceCosts[i] >= 0)
+                    relax(this->portalOffsets[sourceCluster] + static_cast<std::int32_t>(i), sourceCosts[i], current);
+            }
+
+            continue;
+        }
+
+        for (std::int32_t i = this->portalEdgeOffsets[current]; i < this->portalEdgeOffsets[current + 1]; ++i)
+            relax(this->portalEdges[i].to, currentCost + this->portalEdges[i].cost, current);
+
+        const std::int32_t portal = current - this->portalOffsets[destinationCluster];
+
+        if (portal >= 0 && portal < static_cast<std::int32_t>(destinationPortals.size()) &&
+            destinationCosts[portal] >= 0)
+            relax(destinationSlot, currentCost + destinationCosts[portal], current);
+    }
+
+    if (this->searchNodes[destinationSlot].closed != generation)
+        return false;
+
+    cost = this->searchNodes[destinationSlot].cost;
+
+    for (std::int32_t slot = destinationSlot; slot != -1; slot = this->searchNodes[slot].parent)
+        abstractPath.push_back(this->portalNodes[slot]);
+
+    std::reverse(abstractPath.begin(), abstractPath.end());
+
+    return true;
+}
+
+void HierarchicalPathfinder::refine(const std::vector<Index>& abstractPath, std::vector<MapNode*>& mapNodes)
+{
+    mapNodes.push_back(this->pathfinder.mapNodes[abstractPath.front()]);
+
+    for (std::size_t i = 1; i < abstractPath.size(); ++i)
+    {
+        const Index from = abstractPath[i - 1];
+        const Index to = abstractPath[i];
+        const std::int32_t cluster = this->nodeClusters[from];
+
+        if (this->nodeClusters[to] != cluster)
+        {
+            mapNodes.push_back(this->pathfinder.mapNodes[to]);
+            continue;
+        }
+
+        this->pathfinder.search(&from, 1, to, std::numeric_limits<int>::max(), &this->nodeClusters, cluster, nullptr);
+
+        // The first map-node of the segment is the last one of the previous
+        // segment.
+        mapNodes.pop_back();
+        this->pathfinder.appendPath(to, mapNodes);
+    }
+}
+
+static int floorDiv(int a, int b)
+{
+    return a / b - (a % b != 0 && (a < 0) != (b < 0));
+}
+
+static std::size_t findRoot(std::vector<std::size_t>& roots, std::size_t i)
+{
+    while (roots[i] != i)
+    {
+        roots[i] = roots[roots[i]];
+        i = roots[i];
+    }
+
+    return i;
+}
+
+/*
+ * An edge is a detour if it is as expensive as going through another
+ * portal, the search gets the same costs without it. The parts have to be
+ * cheaper than the whole, otherwise (with free terrain) two edges could be
+ * each other's detour and both would be dropped.
+ */
+static bool isDetour(const std::vector<std::vector<int>>& costs, std::size_t from, std::size_t to)
+{
+    for (std::size_t via = 0; via < costs.size(); ++via)
+    {
+        const int first = costs[from][via];
+        const int second = costs[via][to];
+
+        if (first > 0 && second > 0 && first + second == costs[from][to])
+            return true;
+    }
+
+    return false;
+}
+
+} // namespace core
+} // namespace warmonger
@@ -0,0 +1,227 @@
+/** \file
+ * HierarchicalPathfinder class.
+ *
+ * \copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef W_CORE_HIERARCHICAL_PATHFINDER_H
+#define W_CORE_HIERARCHICAL_PATHFINDER_H
+
+#include <cstdint>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "core/Pathfinder.h"
+
+namespace warmonger {
+namespace core {
+
+/**
+ * Finds long-distance paths on large maps using a precomputed abstraction.
+ *
+ * The map is partitioned into clusters of clusterSize x clusterSize
+ * map-nodes (in axial hex-coordinates). Where two clusters border each
+ * other a few passable edges are selected as transitions (one for short
+ * entrances, both ends for long ones), their endpoints are the portals.
+ * The abstract graph consists of the portals, connected by the
+ * transitions and, inside each cluster, by the cost of the cheapest path
+ * between the portals that doesn't leave the cluster. Paths that cost the
+ * same as going through a third portal are left out, they don't change
+ * the costs, only make the graph denser.
+ * A path is found by connecting the source and destination to the
+ * portals of their clusters, searching the abstract graph with A* and then
+ * refining each abstract step with an A* confined to the step's cluster.
+ * The found paths are not necessarily the cheapest ones, as they are
+ * forced through the portals, but they are usually within a few percent
+ * of it. Queries between close map-nodes (at most two cluster-sizes
+ * apart) are answered with a plain A* search.
+ */
+class HierarchicalPathfinder
+{
+public:
+    /**
+     * Build the pathfinder and the abstraction for the map.
+     *
+     * The map has to outlive the pathfinder.
+     *
+     * \param map the map
+     * \param clusterSize the size of the clusters, larger clusters make
+     * long-distance queries faster but updateTerrainType() slower
+     *
+     * \throws utils::ValueError if clusterSize is less than 2
+     */
+    explicit HierarchicalPathfinder(const Map& map, int clusterSize = 32);
+
+    /**
+     * Rebuild the graph and the abstraction from the current state of the
+     * map.
+     *
+     * Call this after the map-nodes change, see Pathfinder::rebuild().
+     */
+    void rebuild();
+
+    /**
+     * Update the terrain-type of the map-node from the map.
+     *
+     * This only invalidates the abstraction of the map-node's cluster and
+     * its neighbours, which is recomputed on the next query.
+     *
+     * \param mapNode the map-node whose terrain-type changed
+     *
+     * \throws utils::ValueError if the map-node is not on the map
+     */
+    void updateTerrainType(MapNode* mapNode);
+
+    /**
+     * Set the cost of moving into map-nodes of the terrain-type.
+     *
+     * Invalidates the whole abstraction.
+     *
+     * \param terrainType the terrain-type
+     * \param cost the cost, negative for impassable
+     */
+    void setTerrainCost(const QString& terrainType, int cost);
+
+    /**
+     * Get the cost of moving into map-nodes of the terrain-type.
+     *
+     * \param terrainType the terrain-type
+     *
+     * \returns the cost, negative if impassable
+     */
+    int getTerrainCost(const QString& terrainType) const
+    {
+        return this->pathfinder.getTerrainCost(terrainType);
+    }
+
+    /**
+     * Find a path between the map-nodes.
+     *
+     * \param from the source map-node
+     * \param to the destination map-node
+     *
+     * \returns the path, Path::mapNodes is empty if there is none
+     *
+     * \throws utils::ValueError if any of the map-nodes is not on the map
+     */
+    Path findPath(MapNode* from, MapNode* to);
+
+    int getClusterSize() const
+    {
+        return this->clusterSize;
+    }
+
+    std::size_t getClusterCount() const
+    {
+        return this->clusters.size();
+    }
+
+    /**
+     * Get the number of portals in the abstraction.
+     *
+     * Brings the abstraction up-to-date first.
+     */
+    std::size_t getPortalCount();
+
+private:
+    using Index = Pathfinder::Index;
+
+    struct Edge
+    {
+        Index to;
+        int cost;
+    };
+
+    struct Portal
+    {
+        Index node;
+        // to the other side of the transitions, by node index
+        std::vector<Edge> transitions;
+        // to the other portals of the cluster, by portal index
+        std::vector<Edge> edges;
+    };
+
+    // Like the pathfinder's scratch buffers, but interleaved, relaxing an
+    // edge touches a single cache-line.
+    struct SearchNode
+    {
+        std::uint32_t visited;
+        std::uint32_t closed;
+        int cost;
+        std::int32_t parent;
+    };
+
+    struct Cluster
+    {
+        std::vector<Index> nodes;
+        std::vector<std::int32_t> neighbours;
+        std::vector<Portal> portals;
+        bool dirty;
+    };
+
+    // An edge crossing the border of two clusters, from the cluster with
+    // the lower id to the one with the higher id.
+    using Transition = std::pair<Index, Index>;
+    using ClusterPair = std::pair<std::int32_t, std::int32_t>;
+
+    void buildClusters();
+    void update();
+    void updateTransitions(std::int32_t a, std::int32_t b);
+    void updatePortals(std::int32_t cluster);
+    void updatePortalSlots();
+    std::int32_t addPortal(std::int32_t cluster, Index node);
+    std::vector<int> findPortalCosts(Index node);
+    bool findAbstractPath(Index source, Index destination, std::vector<Index>& abstractPath, int& cost);
+    void refine(const std::vector<Index>& abstractPath, std::vector<MapNode*>& mapNodes);
+
+    Pathfinder pathfinder;
+    const int clusterSize;
+
+    // by node index
+    std::vector<std::int32_t> nodeClusters;
+    // index into the portals of the node's cluster, -1 if not a portal
+    std::vector<std::int32_t> nodePortals;
+    std::vector<Cluster> clusters;
+    std::map<ClusterPair, std::vector<Transition>> transitions;
+    bool dirty;
+
+    // The abstract graph is searched over portal slots: the portals of all
+    // clusters numbered in cluster order, followed by the source and the
+    // destination of the query. This keeps the scratch data of the search
+    // small and dense, unlike the pathfinder's, which is indexed by node.
+    // The slots are renumbered on the first query after an update.
+    bool slotsDirty;
+
+    // by cluster, the slot of its first portal
+    std::vector<std::int32_t> portalOffsets;
+    // by portal slot
+    std::vector<Index> portalNodes;
+    std::vector<HexCoordinates> portalPositions;
+    // by portal slot, where its edges begin in portalEdges, plus the end
+    std::vector<std::int32_t> portalEdgeOffsets;
+    // the edges and the transitions of all portals, to portal slots
+    std::vector<Edge> portalEdges;
+    std::uint32_t searchGeneration;
+    std::vector<SearchNode> searchNodes;
+    std::vector<Pathfinder::QueueEntry> searchQueue;
+};
+
+} // namespace core
+} // namespace warmonger
+
+#endif // W_CORE_HIERARCHICAL_PATHFINDER_H
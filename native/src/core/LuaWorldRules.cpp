@@ -18,10 +18,19 @@
 
 #include "core/LuaWorldRules.h"
 
+#include <utility>
+
+#include <QPointer>
+
 #include "core/Map.h"
+#include "core/Pathfinder.h"
 #include "core/Settlement.h"
+#include "core/Territory.h"
+#include "core/Visibility.h"
+#include "utils/Exception.h"
 #include "utils/Logging.h"
 #include "utils/Lua.h"
+#include "utils/LuaProfiler.h"
 #include "utils/Utils.h"
 
 namespace sol {
@@ -36,7 +45,58 @@ struct is_container<::warmonger::core::MapNodeNeighbours> : std::false_type
 namespace warmonger {
 namespace core {
 
+namespace {
+
+/*
+ * A map analysis object (pathfinder, territory or visibility) created
+ * from Lua. Lua decides when it is collected, so the map might be
+ * destroyed first: the map is tracked through a QPointer and using the
+ * object after that is a Lua error instead of a dangling reference.
+ */
+template <typename T>
+class LuaMapBound
+{
+public:
+    explicit LuaMapBound(const Map& map)
+        : map(&map)
+        , object(map)
+    {
+    }
+
+    T& get()
+    {
+        if (this->map.isNull())
+            throw utils::ValueError("Attempted to use an object whose map was destroyed");
+
+        return this->object;
+    }
+
+private:
+    QPointer<const Map> map;
+    T object;
+};
+
+/*
+ * Binds the member function of a map analysis object, the map is checked
+ * before each call.
+ */
+template <typename T, typename R, typename... Args>
+auto checked(R (T::*method)(Args...))
+{
+    return [method](LuaMapBound<T>& bound, Args... args) { return (bound.get().*method)(std::forward<Args>(args)...); };
+}
+
+template <typename T, typename R, typename... Args>
+auto checked(R (T::*method)(Args...) const)
+{
+    return [method](LuaMapBound<T>& bound, Args... args) { return (bound.get().*method)(std::forward<Args>(args)...); };
+}
+
+} // namespace
+
 static void exposeAPI(sol::state& lua);
+static std::tuple<sol::as_table_t<std::vector<MapNode*>>, sol::as_table_t<std::vector<int>>> splitReachable(
+    const std::vector<ReachableMapNode>& reachable);
 
 std::unique_ptr<WorldRules> LuaWorldRules::make(World* world)
 {
@@ -53,10 +113,16 @@ LuaWorldRules::LuaWorldRules(core::World* world)
     exposeAPI(lua);
 
     lua["W"] = this->world;
+
+    if (utils::LuaProfiler::isRequested())
+        this->profiler = std::make_unique<utils::LuaProfiler>(
+            lua.lua_state(), fmt::format("world-rules of {}", this->world->getName().toStdString()));
 }
 
 LuaWorldRules::~LuaWorldRules()
 {
+    if (this->profiler)
+        this->profiler->logReport();
 }
 
 void LuaWorldRules::loadRules(const QString& basePath, const QString& mainRulesFile)
@@ -213,7 +279,118 @@ static void exposeAPI(sol::state& lua)
         "settlements",
         sol::property(&Map::getSettlements),
         "create_settlement",
-        [](Map* const map) { return map->createSettlement(); });
+        [](Map* const map) { return map->createSettlement(); },
+        "settlement_at",
+        &Map::getSettlementAt,
+        "faction_settlements",
+        [](const Map* const map, const Faction* faction) {
+            return sol::as_table(std::vector<Settlement*>(map->getFactionSettlements(faction)));
+        },
+        "owned_map_node_count",
+        &Map::getOwnedMapNodeCount);
+
+    lua.new_usertype<LuaMapBound<Pathfinder>>("pathfinder",
+        sol::constructors<LuaMapBound<Pathfinder>(const Map&)>(),
+        "rebuild",
+        checked(&Pathfinder::rebuild),
+        "set_terrain_cost",
+        checked(&Pathfinder::setTerrainCost),
+        "get_terrain_cost",
+        checked(&Pathfinder::getTerrainCost),
+        "find_path",
+        [](LuaMapBound<Pathfinder>& pathfinder, MapNode* from, MapNode* to) {
+            auto path = pathfinder.get().findPath(from, to);
+            return std::make_tuple(sol::as_table(std::move(path.mapNodes)), path.cost);
+        },
+        "find_movement_range",
+        sol::overload(
+            [](LuaMapBound<Pathfinder>& pathfinder, MapNode* source, int budget) {
+                return splitReachable(pathfinder.get().findMovementRange(source, budget));
+            },
+            [](LuaMapBound<Pathfinder>& pathfinder, std::vector<MapNode*> sources, int budget) {
+                return splitReachable(pathfinder.get().findMovementRange(sources, budget));
+            }));
+
+    lua.new_usertype<LuaMapBound<Territory>>("territory",
+        sol::constructors<LuaMapBound<Territory>(const Map&)>(),
+        "rebuild",
+        checked(&Territory::rebuild),
+        "update_settlements",
+        checked(&Territory::updateSettlements),
+        "max_distance",
+        sol::property(checked(&Territory::getMaxDistance), checked(&Territory::setMaxDistance)),
+        "owner",
+        checked(&Territory::getOwner),
+        "settlement",
+        checked(&Territory::getSettlement),
+        "distance",
+        checked(&Territory::getDistance),
+        "border_neighbours",
+        [](LuaMapBound<Territory>& territory, MapNode* mapNode) {
+            std::vector<MapNode*> neighbours;
+            for (const Direction direction : directions)
+            {
+                if (territory.get().isBorder(mapNode, direction))
+                    neighbours.push_back(mapNode->getNeighbour(direction));
+            }
+            return sol::as_table(std::move(neighbours));
+        },
+        "map_nodes",
+        [](LuaMapBound<Territory>& territory, const Faction* faction) {
+            return sol::as_table(territory.get().getMapNodes(faction));
+        });
+
+    lua.new_usertype<LuaMapBound<Visibility>>("visibility",
+        sol::constructors<LuaMapBound<Visibility>(const Map&)>(),
+        "rebuild",
+        checked(&Visibility::rebuild),
+        "update_terrain_type",
+        checked(&Visibility::updateTerrainType),
+        "update_settlements",
+        checked(&Visibility::updateSettlements),
+        "set_sight_range",
+        checked(&Visibility::setSightRange),
+        "get_sight_range",
+        checked(&Visibility::getSightRange),
+        "set_sight_blocking",
+        checked(&Visibility::setSightBlocking),
+        "is_sight_blocking",
+        checked(&Visibility::isSightBlocking),
+        "add_source",
+        checked(&Visibility::addSource),
+        "move_source",
+        checked(&Visibility::moveSource),
+        "remove_source",
+        checked(&Visibility::removeSource),
+        "is_visible",
+        checked(&Visibility::isVisible),
+        "visible_map_nodes",
+        [](LuaMapBound<Visibility>& visibility, const Faction* faction) {
+            return sol::as_table(visibility.get().getVisibleMapNodes(faction));
+        },
+        "visible_count",
+        checked(&Visibility::getVisibleCount));
+}
+
+/*
+ * Lua gets the map-nodes and the costs as two parallel arrays, this is
+ * much cheaper than creating a table for each map-node.
+ */
+static std::tuple<sol::as_table_t<std::vector<MapNode*>>, sol::as_table_t<std::vector<int>>> splitReachable(
+    const std::vector<ReachableMapNode>& reachable)
+{
+    std::vector<MapNode*> mapNodes;
+    std::vector<int> costs;
+    mapNodes.reserve(reachable.size());
+    costs.reserve(reachable.size());
+
+    for (const auto& reachableMapNode : reachable)
+    {
+        mapNodes.push_back(reachableMapNode.mapNode);
+        costs.push_back(reachableMapNode.cost);
+    }
+
+    return std::make_tuple(sol::as_table(std::move(mapNodes)), sol::as_table(std::move(costs)));
 }
 
 } // namespace core
@@ -30,6 +30,11 @@ class state;
 }
 
 namespace warmonger {
+
+namespace utils {
+class LuaProfiler;
+}
+
 namespace core {
 
 class Map;
@@ -68,9 +73,23 @@ public:
 
     void mapInit(Map* map) override;
 
+    /**
+     * Get the profiler of the rules.
+     *
+     * The rules are profiled if LuaProfiler::isRequested(), in which
+     * case the report is logged when the rules are destroyed.
+     *
+     * \returns the profiler, nullptr if the rules are not profiled
+     */
+    utils::LuaProfiler* getProfiler()
+    {
+        return this->profiler.get();
+    }
+
 private:
     World* world;
     std::unique_ptr<sol::state> state; // to avoid exposing the massive sol.hpp
+    std::unique_ptr<utils::LuaProfiler> profiler;
     std::function<void(Map*, int, unsigned int)> generateMapHook;
     std::function<void(Map*)> mapInitHook;
 };
@@ -25,6 +25,7 @@
 
 #include "core/Settlement.h"
 #include "utils/Logging.h"
+#include "utils/Profiling.h"
 #include "utils/QVariantUtils.h"
 #include "utils/ToString.h"
 
@@ -34,7 +35,7 @@ namespace core {
 const QString factionNameTemplate{"New Faction %1"};
 
 static std::vector<MapNode*> unserializeMapNodes(std::vector<ir::Value> serializedMapNodes, Map* map);
-static void addMapNodeRing(std::vector<MapNode*>& nodes, Map* map);
+static void addMapNodeRing(std::vector<MapNode*>& nodes, std::size_t ringBegin, Map* map);
 static MapNode* createNeighbour(MapNode* node, const Direction direction, Map* map);
 static void connectWithCommonNeighbour(MapNode* n1, MapNode* n2, const Direction dn1n2, const Direction dn1n3);
 
@@ -49,8 +50,17 @@ Map::Map(QObject* parent)
 Map::Map(ir::Value v, World& world, QObject* parent)
     : QObject(parent)
 {
+    wProfileZone("Map::Map(ir::Value)");
+
     auto obj = std::move(v).asObject();
 
+    const auto versionIt = obj.find("version");
+    const int version = versionIt == obj.end() ? 1 : versionIt->second.asInteger();
+
+    if (version > formatVersion)
+        throw utils::ValueError(
+            fmt::format("Unsupported map format version {}, the latest supported is {}", version, formatVersion));
+
     if (world.getUuid() != obj["world"].asString())
         throw utils::ValueError(
             fmt::format("World mismatch, expected `{}' got `{}'", obj["world"].asString(), world.getUuid()));
@@ -70,12 +80,16 @@ Map::Map(ir::Value v, World& world, QObject* parent)
         settlementList.begin(), settlementList.end(), std::back_inserter(this->settlements), [this](ir::Value& v) {
             return new Settlement(std::move(v), *this, this);
         });
+
+    for (Settlement* settlement : this->settlements)
+        this->indexSettlement(settlement);
 }
 
 ir::Value Map::serialize() const
 {
     std::unordered_map<QString, ir::Value> obj;
 
+    obj["version"] = formatVersion;
     obj["name"] = this->name;
     obj["world"] = this->world->getUuid();
 
@@ -137,6 +151,26 @@ QVariantList Map::readSettlements() const
     return utils::toQVariantList(this->settlements);
 }
 
+Settlement* Map::getSettlementAt(const MapNode* mapNode) const
+{
+    const auto it = this->mapNodeSettlements.find(mapNode);
+    return it == this->mapNodeSettlements.end() ? nullptr : it->second;
+}
+
+const std::vector<Settlement*>& Map::getFactionSettlements(const Faction* faction) const
+{
+    static const std::vector<Settlement*> noSettlements;
+
+    const auto it = this->factionSettlements.find(faction);
+    return it == this->factionSettlements.end() ? noSettlements : it->second;
+}
+
+std::size_t Map::getOwnedMapNodeCount(const Faction* faction) const
+{
+    const auto it = this->factionMapNodeCounts.find(faction);
+    return it == this->factionMapNodeCounts.end() ? 0 : it->second;
+}
+
 MapNode* Map::createMapNode(ObjectId id)
 {
     MapNode* mapNode = new MapNode(this, id);
@@ -244,6 +278,7 @@ Settlement* Map::createSettlement()
     auto* settlement = new Settlement(this);
 
     this->settlements.push_back(settlement);
+    this->indexSettlement(settlement);
 
     wTrace << "Created settlement " << settlement << " in map " << this;
 
@@ -252,6 +287,46 @@ Settlement* Map::createSettlement()
     return settlement;
 }
 
+Settlement* Map::addSettlement(std::unique_ptr<Settlement> settlement)
+{
+    assert(settlement->parent() == this);
+
+    auto s = settlement.get();
+
+    this->settlements.push_back(settlement.release());
+    this->indexSettlement(s);
+
+    wTrace << "Added settlement " << s << " to map " << this;
+
+    emit settlementsChanged();
+
+    return s;
+}
+
+std::unique_ptr<Settlement> Map::removeSettlement(Settlement* settlement)
+{
+    const auto it = std::find(this->settlements.begin(), this->settlements.end(), settlement);
+
+    if (it == this->settlements.end())
+        return std::unique_ptr<Settlement>();
+
+    this->settlements.erase(it);
+
+    const auto entryIt = this->settlementEntries.find(settlement);
+    this->removeFromIndexes(settlement, entryIt->second);
+    this->settlementEntries.erase(entryIt);
+
+    settlement->setParent(nullptr);
+
+    QObject::disconnect(settlement, nullptr, this, nullptr);
+
+    wTrace << "Removed settlement " << settlement;
+
+    emit settlementsChanged();
+
+    return std::unique_ptr<Settlement>(settlement);
+}
+
 void Map::generateMapNodes(unsigned int radius)
 {
     if (radius == 0)
@@ -261,11 +336,15 @@ void Map::generateMapNodes(unsigned int radius)
 
     std::vector<MapNode*> generatedMapNodes;
 
+    generatedMapNodes.reserve(3 * static_cast<std::size_t>(radius) * (radius - 1) + 1);
     generatedMapNodes.emplace_back(new MapNode(this));
 
+    std::size_t ringBegin{0};
     for (unsigned i = 1; i < radius; ++i)
     {
-        addMapNodeRing(generatedMapNodes, this);
+        const std::size_t nextRingBegin = generatedMapNodes.size();
+        addMapNodeRing(generatedMapNodes, ringBegin, this);
+        ringBegin = nextRingBegin;
     }
 
     for (auto mapNode : this->mapNodes)
@@ -278,6 +357,79 @@ void Map::generateMapNodes(unsigned int radius)
     emit mapNodesChanged();
 }
 
+void Map::indexSettlement(Settlement* settlement)
+{
+    const SettlementEntry entry{settlement->getPosition(), settlement->getOwner()};
+
+    this->settlementEntries.emplace(settlement, entry);
+    this->addToIndexes(settlement, entry);
+
+    QObject::connect(
+        settlement, &Settlement::positionChanged, this, [this, settlement]() { this->reindexSettlement(settlement); });
+    QObject::connect(
+        settlement, &Settlement::ownerChanged, this, [this, settlement]() { this->reindexSettlement(settlement); });
+}
+
+void Map::reindexSettlement(Settlement* settlement)
+{
+    SettlementEntry& entry = this->settlementEntries.at(settlement);
+
+    this->removeFromIndexes(settlement, entry);
+
+    entry.position = settlement->getPosition();
+    entry.owner = settlement->getOwner();
+
+    this->addToIndexes(settlement, entry);
+}
+
+/*
+ * A faction owns a map-node as long as at least one of its settlements is
+ * positioned there, so the counts only change when the first settlement of
+ * the faction arrives to or the last one leaves the map-node.
+ */
+void Map::addToIndexes(Settlement* settlement, const SettlementEntry& entry)
+{
+    this->factionSettlements[entry.owner].push_back(settlement);
+
+    if (entry.position == nullptr)
+        return;
+
+    const auto range = this->mapNodeSettlements.equal_range(entry.position);
+    const bool alreadyOwned = std::any_of(range.first, range.second, [this, &entry](const auto& element) {
+        return this->settlementEntries.at(element.second).owner == entry.owner;
+    });
+
+    this->mapNodeSettlements.emplace(entry.position, settlement);
+
+    if (entry.owner != nullptr && !alreadyOwned)
+        ++this->factionMapNodeCounts[entry.owner];
+}
+
+void Map::removeFromIndexes(Settlement* settlement, const SettlementEntry& entry)
+{
+    auto& ownerSettlements = this->factionSettlements[entry.owner];
+    ownerSettlements.erase(std::find(ownerSettlements.begin(), ownerSettlements.end(), settlement));
+
+    if (entry.position == nullptr)
+        return;
+
+    const auto range = this->mapNodeSettlements.equal_range(entry.position);
+    this->mapNodeSettlements.erase(std::find_if(
+        range.first, range.second, [settlement](const auto& element) { return element.second == settlement; }));
+
+    if (entry.owner == nullptr)
+        return;
+
+    // Use the indexed owners, so the counts stay consistent with the index.
+    const auto remaining = this->mapNodeSettlements.equal_range(entry.position);
+    const bool stillOwned = std::any_of(remaining.first, remaining.second, [this, &entry](const auto& element) {
+        return this->settlementEntries.at(element.second).owner == entry.owner;
+    });
+
+    if (!stillOwned)
+        --this->factionMapNodeCounts[entry.owner];
+}
+
 bool operator==(const BannerConfiguration& a, const BannerConfiguration& b)
 {
     return a.banner == b.banner && a.primaryColor == b.primaryColor && a.secondaryColor == b.secondaryColor;
@@ -321,52 +473,83 @@ BannerConfiguration nextAvailableBannerConfiguration(
     return nextConfiguration;
 }
 
+/*
+ * Neighbours are resolved after all map-nodes have been created. The
+ * current format has them as ids, these are resolved via an id index,
+ * the format of version 1 has them as references.
+ */
 static std::vector<MapNode*> unserializeMapNodes(std::vector<ir::Value> serializedMapNodes, Map* map)
 {
     std::vector<MapNode*> mapNodes;
-    std::vector<std::tuple<MapNode*, Direction, ir::Value>> neighbours;
+    mapNodes.reserve(serializedMapNodes.size());
+
+    std::unordered_map<int, MapNode*> mapNodeIndex;
+    mapNodeIndex.reserve(serializedMapNodes.size());
+
+    std::vector<ir::Value> neighbours;
+    neighbours.reserve(serializedMapNodes.size());
 
     for (auto& element : serializedMapNodes)
     {
         auto object = std::move(element).asMap();
-        auto nodeNeighbours = std::move(object["neighbours"]).asMap();
+        neighbours.push_back(std::move(object["neighbours"]));
 
         mapNodes.push_back(new MapNode(std::move(object), map));
+        mapNodeIndex.emplace(mapNodes.back()->getId().get(), mapNodes.back());
+    }
 
-        // for now just store the references to the neighbours
-        // they will be resolved after all mapnodes have been processed
-        for (auto& nodeNeighbour : nodeNeighbours)
+    for (std::size_t i = 0; i < mapNodes.size(); ++i)
+    {
+        MapNode* mn = mapNodes[i];
+
+        if (neighbours[i].getType() == ir::Type::Map)
         {
-            neighbours.emplace_back(
-                mapNodes.back(), str2direction(nodeNeighbour.first), std::move(nodeNeighbour.second));
+            for (const auto& nodeNeighbour : neighbours[i].asMap())
+                mn->setNeighbour(str2direction(nodeNeighbour.first), nodeNeighbour.second.asReference<MapNode>(map));
+
+            continue;
         }
-    }
 
-    MapNode* mn;
-    Direction d;
-    for (const auto& neighbour : neighbours)
-    {
-        std::tie(mn, d, std::ignore) = neighbour;
-        mn->setNeighbour(d, std::get<ir::Value>(std::move(neighbour)).asReference<MapNode>(map));
+        const auto& ids = neighbours[i].asList();
+
+        if (ids.size() != directions.size())
+            throw utils::ValueError(fmt::format(
+                "Expected {} neighbours for map-node {}, got {}", directions.size(), mn->getId().get(), ids.size()));
+
+        for (std::size_t j = 0; j < directions.size(); ++j)
+        {
+            const int id = ids[j].asInteger();
+            if (id < 0)
+                continue;
+
+            const auto it = mapNodeIndex.find(id);
+            if (it == mapNodeIndex.end())
+                throw utils::ValueError(
+                    fmt::format("Neighbour {} of map-node {} doesn't exist", id, mn->getId().get()));
+
+            mn->setNeighbour(directions[j], it->second);
+        }
     }
 
     return mapNodes;
 }
 
-static void addMapNodeRing(std::vector<MapNode*>& nodes, Map* map)
+/*
+ * Only the nodes of the outermost ring, starting at ringBegin, can have
+ * missing neighbours, the inner ones are fully connected already.
+ */
+static void addMapNodeRing(std::vector<MapNode*>& nodes, std::size_t ringBegin, Map* map)
 {
-    std::vector<MapNode*> newNodes;
+    const std::size_t ringEnd = nodes.size();
 
-    for (MapNode* node : nodes)
+    for (std::size_t i = ringBegin; i < ringEnd; ++i)
     {
         for (Direction direction : directions)
         {
-            if (node->getNeighbour(direction) == nullptr)
-                newNodes.push_back(createNeighbour(node, direction, map));
+            if (nodes[i]->getNeighbour(direction) == nullptr)
+                nodes.push_back(createNeighbour(nodes[i], direction, map));
         }
     }
-
-    std::copy(newNodes.begin(), newNodes.end(), std::back_inserter(nodes));
 }
 
 static MapNode* createNeighbour(MapNode* node, const Direction direction, Map* map)
@@ -22,6 +22,7 @@
 #define CORE_MAP_H
 
 #include <memory>
+#include <unordered_map>
 #include <vector>
 
 #include <QObject>
@@ -78,6 +79,16 @@ public:
      */
     Map(ir::Value v, World& world, QObject* parent);
 
+    /**
+     * The version of the serialized format.
+     *
+     * Version 1 (which has no version entry) had the neighbours of the
+     * map-nodes as references keyed by the direction, version 2 has them
+     * as an array of ids in the order of core::directions, with -1 for the
+     * missing ones. Older versions can still be unserialized.
+     */
+    static constexpr int formatVersion{2};
+
     ir::Value serialize() const override;
 
     /**
@@ -176,6 +187,44 @@ public:
      */
     QVariantList readSettlements() const;
 
+    /**
+     * Get the settlement at the map-node.
+     *
+     * Served from an index which is kept up-to-date as settlements are
+     * created and moved, so this is O(1).
+     * If several settlements share the map-node any one of them is
+     * returned.
+     *
+     * \param mapNode the map-node
+     *
+     * \returns the settlement or nullptr if there is none
+     */
+    Settlement* getSettlementAt(const MapNode* mapNode) const;
+
+    /**
+     * Get the settlements owned by the faction.
+     *
+     * Served from an index which is kept up-to-date as settlements are
+     * created and change owners, so this is O(1).
+     *
+     * \param faction the faction, nullptr for the unowned settlements
+     *
+     * \returns the settlements, in the order they were acquired
+     */
+    const std::vector<Settlement*>& getFactionSettlements(const Faction* faction) const;
+
+    /**
+     * Get the number of map-nodes the faction owns.
+     *
+     * A faction owns the map-nodes its settlements are positioned at.
+     * Served from an index, so this is O(1).
+     *
+     * \param faction the faction
+     *
+     * \returns the number of owned map-nodes
+     */
+    std::size_t getOwnedMapNodeCount(const Faction* faction) const;
+
     /**
      * Create a new map-node and add it to the map.
      *
@@ -267,6 +316,32 @@ public:
      */
     Settlement* createSettlement();
 
+    /**
+     * Add a new settlement to the map.
+     *
+     * The map must already own this settlement, i.e. it must have been
+     * created with the map as its parent.
+     * Will emit the signal Map::settlementsChanged().
+     *
+     * \returns the added settlement
+     */
+    Settlement* addSettlement(std::unique_ptr<Settlement> settlement);
+
+    /**
+     * Remove the settlement and renounce ownership.
+     *
+     * The settlement is removed and it's returned as an std::unique_ptr
+     * and will be destroyed if the caller doesn't save it.
+     * If the settlement is not found, nothing happens.
+     * Will emit the signal Map::settlementsChanged().
+     *
+     * \param settlement the settlement to remove
+     *
+     * \returns the removed settlement or an empty pointer if the
+     * settlement was not found
+     */
+    std::unique_ptr<Settlement> removeSettlement(Settlement* settlement);
+
     /**
      * Generate a hexagonal map with the given radius.
      *
@@ -303,6 +378,17 @@ signals:
     void settlementsChanged();
 
 private:
+    struct SettlementEntry
+    {
+        const MapNode* position;
+        const Faction* owner;
+    };
+
+    void indexSettlement(Settlement* settlement);
+    void reindexSettlement(Settlement* settlement);
+    void addToIndexes(Settlement* settlement, const SettlementEntry& entry);
+    void removeFromIndexes(Settlement* settlement, const SettlementEntry& entry);
+
     QString name;
     World* world;
     unsigned int mapNodeIndex;
@@ -310,6 +396,13 @@ private:
     std::vector<Faction*> factions;
     std::vector<MapNode*> mapNodes;
     std::vector<Settlement*> settlements;
+
+    // Secondary indexes of the settlements, maintained through the
+    // settlements' positionChanged() and ownerChanged() signals.
+    std::unordered_map<const Settlement*, SettlementEntry> settlementEntries;
+    std::unordered_multimap<const MapNode*, Settlement*> mapNodeSettlements;
+    std::unordered_map<const Faction*, std::vector<Settlement*>> factionSettlements;
+    std::unordered_map<const Faction*, std::size_t> factionMapNodeCounts;
 };
 
 struct BannerConfiguration
@@ -0,0 +1,509 @@
+/**
+ * Copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "core/MapJournal.h"
+
+#include "core/Map.h"
+#include "core/Settlement.h"
+#include "utils/Exception.h"
+
+namespace warmonger {
+namespace core {
+
+MapJournal::MapJournal(Map& map, std::size_t recordLimit)
+    : map(map)
+    , recordLimit(recordLimit)
+    , recordCount(0)
+    , commandDepth(0)
+{
+}
+
+void MapJournal::beginCommand()
+{
+    ++this->commandDepth;
+}
+
+void MapJournal::endCommand()
+{
+    if (this->commandDepth == 0)
+        throw utils::ValueError("Attempted to end a command without beginning one");
+
+    if (--this->commandDepth == 0)
+        this->commit();
+}
+
+bool MapJournal::undo()
+{
+    if (this->commandDepth != 0)
+        throw utils::ValueError("Attempted to undo while a command is in progress");
+
+    if (this->undoCommands.empty())
+        return false;
+
+    Command command = std::move(this->undoCommands.back());
+    this->undoCommands.pop_back();
+
+    for (auto it = command.rbegin(); it != command.rend(); ++it)
+        this->apply(*it, false);
+
+    this->redoCommands.push_back(std::move(command));
+
+    return true;
+}
+
+bool MapJournal::redo()
+{
+    if (this->commandDepth != 0)
+        throw utils::ValueError("Attempted to redo while a command is in progress");
+
+    if (this->redoCommands.empty())
+        return false;
+
+    Command command = std::move(this->redoCommands.back());
+    this->redoCommands.pop_back();
+
+    for (auto& r : command)
+        this->apply(r, true);
+
+    this->undoCommands.push_back(std::move(command));
+
+    return true;
+}
+
+void MapJournal::clear()
+{
+    if (this->commandDepth != 0)
+        throw utils::ValueError("Attempted to clear the journal while a command is in progress");
+
+    this->undoCommands.clear();
+    this->redoCommands.clear();
+    this->recordCount = 0;
+}
+
+void MapJournal::setRecordLimit(std::size_t recordLimit)
+{
+    this->recordLimit = recordLimit;
+    this->compact();
+}
+
+MapNode* MapJournal::createMapNode()
+{
+    MapNode* mapNode = this->map.createMapNode();
+
+    this->record(Record{RecordType::CreateMapNode, Direction::West, mapNode, nullptr, nullptr, {}, {}, nullptr});
+
+    return mapNode;
+}
+
+void MapJournal::removeMapNode(MapNode* mapNode)
+{
+    this->checkAttached(mapNode);
+
+    this->beginCommand();
+
+    while (Settlement* settlement = this->map.getSettlementAt(mapNode))
+        this->setPosition(settlement, nullptr);
+
+    for (const Direction direction : directions)
+    {
+        MapNode* neighbour = mapNode->getNeighbour(direction);
+        const Direction backDirection = oppositeDirection(direction);
+
+        if (neighbour && neighbour->getNeighbour(backDirection) == mapNode)
+            this->setNeighbour(neighbour, backDirection, nullptr);
+    }
+
+    Record r{RecordType::RemoveMapNode, Direction::West, mapNode, nullptr, nullptr, {}, {}, nullptr};
+    this->detach(r);
+    this->record(std::move(r));
+
+    this->endCommand();
+}
+
+void MapJournal::setNeighbour(MapNode* mapNode, Direction direction, MapNode* neighbour)
+{
+    this->checkAttached(mapNode);
+    this->checkAttached(neighbour);
+
+    MapNode* oldNeighbour = mapNode->getNeighbour(direction);
+
+    if (oldNeighbour == neighbour)
+        return;
+
+    mapNode->setNeighbour(direction, neighbour);
+
+    this->recordChange(Record{RecordType::Neighbour, direction, mapNode, oldNeighbour, neighbour, {}, {}, nullptr});
+}
+
+void MapJournal::setTerrainType(MapNode* mapNode, const QString& terrainType)
+{
+    this->checkAttached(mapNode);
+
+    const QString oldTerrainType = mapNode->getTerrainType();
+
+    mapNode->setTerrainType(terrainType);
+
+    this->recordStringChange(RecordType::TerrainType, mapNode, oldTerrainType, terrainType);
+}
+
+Faction* MapJournal::createFaction()
+{
+    Faction* faction = this->map.createFaction();
+
+    this->record(Record{RecordType::CreateFaction, Direction::West, faction, nullptr, nullptr, {}, {}, nullptr});
+
+    return faction;
+}
+
+void MapJournal::removeFaction(Faction* faction)
+{
+    this->checkAttached(faction);
+
+    this->beginCommand();
+
+    while (!this->map.getFactionSettlements(faction).empty())
+        this->setOwner(this->map.getFactionSettlements(faction).back(), nullptr);
+
+    Record r{RecordType::RemoveFaction, Direction::West, faction, nullptr, nullptr, {}, {}, nullptr};
+    this->detach(r);
+    this->record(std::move(r));
+
+    this->endCommand();
+}
+
+void MapJournal::setName(Faction* faction, const QString& name)
+{
+    this->checkAttached(faction);
+
+    const QString oldName = faction->getName();
+
+    faction->setName(name);
+
+    this->recordStringChange(RecordType::FactionName, faction, oldName, name);
+}
+
+void MapJournal::setPrimaryColor(Faction* faction, Color* color)
+{
+    this->checkAttached(faction);
+
+    Color* oldColor = faction->getPrimaryColor();
+
+    faction->setPrimaryColor(color);
+
+    this->recordObjectChange(RecordType::FactionPrimaryColor, faction, oldColor, color);
+}
+
+void MapJournal::setSecondaryColor(Faction* faction, Color* color)
+{
+    this->checkAttached(faction);
+
+    Color* oldColor = faction->getSecondaryColor();
+
+    faction->setSecondaryColor(color);
+
+    this->recordObjectChange(RecordType::FactionSecondaryColor, faction, oldColor, color);
+}
+
+void MapJournal::setBanner(Faction* faction, Banner* banner)
+{
+    this->checkAttached(faction);
+
+    Banner* oldBanner = faction->getBanner();
+
+    faction->setBanner(banner);
+
+    this->recordObjectChange(RecordType::FactionBanner, faction, oldBanner, banner);
+}
+
+void MapJournal::setCivilization(Faction* faction, Civilization* civilization)
+{
+    this->checkAttached(faction);
+
+    Civilization* oldCivilization = faction->getCivilization();
+
+    faction->setCivilization(civilization);
+
+    this->recordObjectChange(RecordType::FactionCivilization, faction, oldCivilization, civilization);
+}
+
+Settlement* MapJournal::createSettlement()
+{
+    Settlement* settlement = this->map.createSettlement();
+
+    this->record(Record{RecordType::CreateSettlement, Direction::West, settlement, nullptr, nullptr, {}, {}, nullptr});
+
+    return settlement;
+}
+
+void MapJournal::removeSettlement(Settlement* settlement)
+{
+    this->checkAttached(settlement);
+
+    Record r{RecordType::RemoveSettlement, Direction::West, settlement, nullptr, nullptr, {}, {}, nullptr};
+    this->detach(r);
+    this->record(std::move(r));
+}
+
+void MapJournal::setType(Settlement* settlement, const QString& type)
+{
+    this->checkAttached(settlement);
+
+    const QString oldType = settlement->getType();
+
+    settlement->setType(type);
+
+    this->recordStringChange(RecordType::SettlementType, settlement, oldType, type);
+}
+
+void MapJournal::setPosition(Settlement* settlement, MapNode* position)
+{
+    this->checkAttached(settlement);
+    this->checkAttached(position);
+
+    MapNode* oldPosition = settlement->getPosition();
+
+    settlement->setPosition(position);
+
+    this->recordObjectChange(RecordType::SettlementPosition, settlement, oldPosition, position);
+}
+
+void MapJournal::setOwner(Settlement* settlement, Faction* owner)
+{
+    this->checkAttached(settlement);
+    this->checkAttached(owner);
+
+    Faction* oldOwner = settlement->getOwner();
+
+    settlement->setOwner(owner);
+
+    this->recordObjectChange(RecordType::SettlementOwner, settlement, oldOwner, owner);
+}
+
+/*
+ * Objects removed through the journal (or created by an undone command)
+ * are parentless while detached, changing or referencing them would
+ * record changes to objects which aren't part of the map.
+ */
+void MapJournal::checkAttached(const QObject* object) const
+{
+    if (object != nullptr && object->parent() != &this->map)
+        throw utils::ValueError("Attempted to change or reference an object which is not part of the map");
+}
+
+void MapJournal::record(Record r)
+{
+    this->currentCommand.push_back(std::move(r));
+
+    if (this->commandDepth == 0)
+        this->commit();
+}
+
+/*
+ * Only the last value of the property matters for redo and only the
+ * first one for undo, so repeated changes within a command update the
+ * existing record in-place.
+ */
+void MapJournal::recordChange(Record r)
+{
+    auto& indexes = this->currentRecords[r.object];
+
+    for (const std::size_t index : indexes)
+    {
+        Record& existing = this->currentCommand[index];
+
+        if (existing.type == r.type && existing.direction == r.direction)
+        {
+            existing.newObject = r.newObject;
+            existing.newString = std::move(r.newString);
+            return;
+        }
+    }
+
+    indexes.push_back(this->currentCommand.size());
+
+    this->record(std::move(r));
+}
+
+void MapJournal::recordObjectChange(RecordType type, QObject* object, QObject* oldValue, QObject* newValue)
+{
+    if (oldValue != newValue)
+        this->recordChange(Record{type, Direction::West, object, oldValue, newValue, {}, {}, nullptr});
+}
+
+void MapJournal::recordStringChange(
+    RecordType type, QObject* object, const QString& oldValue, const QString& newValue)
+{
+    if (oldValue != newValue)
+        this->recordChange(Record{type, Direction::West, object, nullptr, nullptr, oldValue, newValue, nullptr});
+}
+
+void MapJournal::commit()
+{
+    this->currentRecords.clear();
+
+    if (this->currentCommand.empty())
+        return;
+
+    // A new command invalidates the undone ones.
+    for (const auto& command : this->redoCommands)
+        this->recordCount -= command.size();
+    this->redoCommands.clear();
+
+    this->recordCount += this->currentCommand.size();
+    this->undoCommands.push_back(std::move(this->currentCommand));
+    this->currentCommand.clear();
+
+    this->compact();
+}
+
+/*
+ * Dropping the oldest commands moves the checkpoint forward, the objects
+ * held by their records can no longer be restored and are destroyed.
+ * These are always objects that were removed from the map, newer commands
+ * can't reference them. The redo commands are not touched, they are
+ * dropped anyway by the next command.
+ */
+void MapJournal::compact()
+{
+    while (this->recordCount > this->recordLimit && this->undoCommands.size() > 1)
+    {
+        this->recordCount -= this->undoCommands.front().size();
+        this->undoCommands.pop_front();
+    }
+}
+
+void MapJournal::apply(Record& r, bool forward)
+{
+    QObject* const objectValue = forward ? r.newObject : r.oldObject;
+    const QString& stringValue = forward ? r.newString : r.oldString;
+
+    switch (r.type)
+    {
+        case RecordType::CreateMapNode:
+        case RecordType::CreateFaction:
+        case RecordType::CreateSettlement:
+            if (forward)
+                this->attach(r);
+            else
+                this->detach(r);
+            break;
+
+        case RecordType::RemoveMapNode:
+        case RecordType::RemoveFaction:
+        case RecordType::RemoveSettlement:
+            if (forward)
+                this->detach(r);
+            else
+                this->attach(r);
+            break;
+
+        case RecordType::Neighbour:
+            static_cast<MapNode*>(r.object)->setNeighbour(r.direction, static_cast<MapNode*>(objectValue));
+            break;
+
+        case RecordType::TerrainType:
+            static_cast<MapNode*>(r.object)->setTerrainType(stringValue);
+            break;
+
+        case RecordType::FactionName:
+            static_cast<Faction*>(r.object)->setName(stringValue);
+            break;
+
+        case RecordType::FactionPrimaryColor:
+            static_cast<Faction*>(r.object)->setPrimaryColor(static_cast<Color*>(objectValue));
+            break;
+
+        case RecordType::FactionSecondaryColor:
+            static_cast<Faction*>(r.object)->setSecondaryColor(static_cast<Color*>(objectValue));
+            break;
+
+        case RecordType::FactionBanner:
+            static_cast<Faction*>(r.object)->setBanner(static_cast<Banner*>(objectValue));
+            break;
+
+        case RecordType::FactionCivilization:
+            static_cast<Faction*>(r.object)->setCivilization(static_cast<Civilization*>(objectValue));
+            break;
+
+        case RecordType::SettlementType:
+            static_cast<Settlement*>(r.object)->setType(stringValue);
+            break;
+
+        case RecordType::SettlementPosition:
+            static_cast<Settlement*>(r.object)->setPosition(static_cast<MapNode*>(objectValue));
+            break;
+
+        case RecordType::SettlementOwner:
+            static_cast<Settlement*>(r.object)->setOwner(static_cast<Faction*>(objectValue));
+            break;
+    }
+}
+
+void MapJournal::attach(Record& r)
+{
+    QObject* object = r.detached.release();
+    object->setParent(&this->map);
+
+    switch (r.type)
+    {
+        case RecordType::CreateMapNode:
+        case RecordType::RemoveMapNode:
+            this->map.addMapNode(std::unique_ptr<MapNode>(static_cast<MapNode*>(object)));
+            break;
+
+        case RecordType::CreateFaction:
+        case RecordType::RemoveFaction:
+            this->map.addFaction(std::unique_ptr<Faction>(static_cast<Faction*>(object)));
+            break;
+
+        case RecordType::CreateSettlement:
+        case RecordType::RemoveSettlement:
+            this->map.addSettlement(std::unique_ptr<Settlement>(static_cast<Settlement*>(object)));
+            break;
+
+        default:
+            break;
+    }
+}
+
+void MapJournal::detach(Record& r)
+{
+    switch (r.type)
+    {
+        case RecordType::CreateMapNode:
+        case RecordType::RemoveMapNode:
+            r.detached = this->map.removeMapNode(static_cast<MapNode*>(r.object));
+            break;
+
+        case RecordType::CreateFaction:
+        case RecordType::RemoveFaction:
+            r.detached = this->map.removeFaction(static_cast<Faction*>(r.object));
+            break;
+
+        case RecordType::CreateSettlement:
+        case RecordType::RemoveSettlement:
+            r.detached = this->map.removeSettlement(static_cast<Settlement*>(r.object));
+            break;
+
+        default:
+            break;
+    }
+}
+
+} // namespace core
+} // namespace warmonger
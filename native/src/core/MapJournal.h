@@ -0,0 +1,266 @@
+/** \file
+ * MapJournal class.
+ *
+ * \copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef W_CORE_MAP_JOURNAL_H
+#define W_CORE_MAP_JOURNAL_H
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <QObject>
+#include <QString>
+
+#include "core/Hexagon.h"
+
+namespace warmonger {
+namespace core {
+
+class Banner;
+class Civilization;
+class Color;
+class Faction;
+class Map;
+class MapNode;
+class Settlement;
+
+/**
+ * Undo/redo journal of the changes to a campaign-map.
+ *
+ * The changes are made through the journal, which applies them to the map
+ * and records them. Each record describes a single, fine-grained change
+ * (a created or removed object, a changed neighbour or property) with
+ * both the old and the new value, so undoing or redoing it is O(1) and
+ * undoing or redoing a command is O(number of changes in the command).
+ * Removed objects are kept alive by the records, so they can be restored,
+ * until the record is dropped.
+ *
+ * Related changes can be grouped into a single command with
+ * beginCommand() and endCommand(), these are undone and redone as a unit.
+ * Changes made outside of a command form a command of their own.
+ * Repeated changes of the same property within a command are merged into
+ * a single record.
+ *
+ * To keep the memory use of long editing sessions bounded, the journal
+ * compacts the history when it grows beyond the record limit: the oldest
+ * commands are dropped (their state becomes the new checkpoint which
+ * can't be undone past), along with the removed objects only they keep
+ * alive.
+ *
+ * Only the changes made through the journal are recorded, changing the
+ * map directly while the journal has history makes undo and redo
+ * restore stale values. Changes of, or referencing, objects which are not
+ * part of the map, e.g. the ones removed through the journal, are
+ * rejected with utils::ValueError.
+ */
+class MapJournal
+{
+public:
+    /**
+     * Construct an empty journal for the map.
+     *
+     * The map has to outlive the journal.
+     *
+     * \param map the map
+     * \param recordLimit the maximum number of records kept in the history
+     */
+    explicit MapJournal(Map& map, std::size_t recordLimit = 100000);
+
+    MapJournal(const MapJournal&) = delete;
+    MapJournal& operator=(const MapJournal&) = delete;
+
+    /**
+     * Begin a command.
+     *
+     * The changes made until the matching endCommand() are grouped into a
+     * single command. Commands can be nested, only the outermost one is
+     * recorded.
+     */
+    void beginCommand();
+
+    /**
+     * End the command begun with beginCommand().
+     *
+     * Empty commands are not recorded.
+     */
+    void endCommand();
+
+    /**
+     * Undo the last command.
+     *
+     * \returns whether there was a command to undo
+     *
+     * \throws utils::ValueError if a command is in progress
+     */
+    bool undo();
+
+    /**
+     * Redo the last undone command.
+     *
+     * \returns whether there was a command to redo
+     *
+     * \throws utils::ValueError if a command is in progress
+     */
+    bool redo();
+
+    bool canUndo() const
+    {
+        return !this->undoCommands.empty();
+    }
+
+    bool canRedo() const
+    {
+        return !this->redoCommands.empty();
+    }
+
+    /**
+     * Drop the whole history.
+     */
+    void clear();
+
+    /**
+     * Set the maximum number of records kept in the history.
+     *
+     * The last command is always kept, regardless of its size.
+     * Compacts the history if it's above the new limit.
+     *
+     * \param recordLimit the record limit
+     */
+    void setRecordLimit(std::size_t recordLimit);
+
+    std::size_t getRecordLimit() const
+    {
+        return this->recordLimit;
+    }
+
+    /**
+     * Get the number of records in the history (both undo and redo).
+     */
+    std::size_t getRecordCount() const
+    {
+        return this->recordCount;
+    }
+
+    MapNode* createMapNode();
+
+    /**
+     * Remove the map-node.
+     *
+     * The neighbours of the map-node are unlinked from it and the
+     * settlements on it lose their position. Neighbourship is assumed to
+     * be mutual, as it is on generated maps, only the neighbours the
+     * map-node points to are checked.
+     */
+    void removeMapNode(MapNode* mapNode);
+
+    void setNeighbour(MapNode* mapNode, Direction direction, MapNode* neighbour);
+    void setTerrainType(MapNode* mapNode, const QString& terrainType);
+
+    Faction* createFaction();
+
+    /**
+     * Remove the faction.
+     *
+     * The settlements owned by the faction lose their owner.
+     */
+    void removeFaction(Faction* faction);
+
+    void setName(Faction* faction, const QString& name);
+    void setPrimaryColor(Faction* faction, Color* color);
+    void setSecondaryColor(Faction* faction, Color* color);
+    void setBanner(Faction* faction, Banner* banner);
+    void setCivilization(Faction* faction, Civilization* civilization);
+
+    Settlement* createSettlement();
+    void removeSettlement(Settlement* settlement);
+    void setType(Settlement* settlement, const QString& type);
+    void setPosition(Settlement* settlement, MapNode* position);
+    void setOwner(Settlement* settlement, Faction* owner);
+
+private:
+    enum class RecordType : std::uint8_t
+    {
+        CreateMapNode,
+        RemoveMapNode,
+        Neighbour,
+        TerrainType,
+        CreateFaction,
+        RemoveFaction,
+        FactionName,
+        FactionPrimaryColor,
+        FactionSecondaryColor,
+        FactionBanner,
+        FactionCivilization,
+        CreateSettlement,
+        RemoveSettlement,
+        SettlementType,
+        SettlementPosition,
+        SettlementOwner
+    };
+
+    /*
+     * Object values are stored as QObject* and string values as QString,
+     * the type determines which of them are used and what the object
+     * pointers point to. The detached object holds created or removed
+     * objects while they are not part of the map.
+     */
+    struct Record
+    {
+        RecordType type;
+        Direction direction;
+        QObject* object;
+        QObject* oldObject;
+        QObject* newObject;
+        QString oldString;
+        QString newString;
+        std::unique_ptr<QObject> detached;
+    };
+
+    using Command = std::vector<Record>;
+
+    void checkAttached(const QObject* object) const;
+    void record(Record r);
+    void recordChange(Record r);
+    void recordObjectChange(RecordType type, QObject* object, QObject* oldValue, QObject* newValue);
+    void recordStringChange(RecordType type, QObject* object, const QString& oldValue, const QString& newValue);
+    void commit();
+    void compact();
+    void apply(Record& r, bool forward);
+    void attach(Record& r);
+    void detach(Record& r);
+
+    Map& map;
+    std::size_t recordLimit;
+    std::size_t recordCount;
+    unsigned int commandDepth;
+    Command currentCommand;
+    // the index of the record in the current command for each
+    // (object, record-type, direction), for merging repeated changes
+    std::unordered_map<const QObject*, std::vector<std::size_t>> currentRecords;
+    std::deque<Command> undoCommands;
+    std::vector<Command> redoCommands;
+};
+
+} // namespace core
+} // namespace warmonger
+
+#endif // W_CORE_MAP_JOURNAL_H
@@ -119,12 +119,15 @@ ir::Value MapNode::serialize() const
 
     obj["id"] = this->getId().get();
 
-    std::unordered_map<QString, ir::Value> serializedNeigbours;
-    std::transform(this->neighbours.cbegin(),
-        this->neighbours.cend(),
-        std::inserter(serializedNeigbours, serializedNeigbours.begin()),
-        [](std::pair<Direction, MapNode*> n) { return std::make_pair(direction2str(n.first), ir::Value(n.second)); });
-    obj["neighbours"] = std::move(serializedNeigbours);
+    // see Map::formatVersion
+    std::vector<ir::Value> serializedNeighbours;
+    serializedNeighbours.reserve(directions.size());
+    for (const Direction direction : directions)
+    {
+        const MapNode* neighbour = this->neighbours.at(direction);
+        serializedNeighbours.emplace_back(neighbour == nullptr ? -1 : neighbour->getId().get());
+    }
+    obj["neighbours"] = std::move(serializedNeighbours);
 
     return obj;
 }
@@ -0,0 +1,242 @@
+/**
+ * Copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "core/MapSnapshot.h"
+
+#include <unordered_map>
+
+#include "core/Map.h"
+#include "core/Settlement.h"
+#include "core/Territory.h"
+
+namespace warmonger {
+namespace core {
+
+template <typename T, typename Snapshot>
+static const Snapshot* lookupSnapshot(
+    const T* obj, const std::unordered_map<const T*, std::size_t>& indexes, const std::vector<Snapshot>& snapshots);
+template <typename T, typename Snapshot>
+static ir::Value serializeReference(const Snapshot* snapshot);
+static ir::Value serializeName(const NamedType* obj);
+
+MapSnapshot::MapSnapshot(const Map& map, const Territory* territory)
+    : name(map.getName())
+    , world(map.getWorld())
+{
+    const auto& originalMapNodes = map.getMapNodes();
+    const auto& originalFactions = map.getFactions();
+    const auto& originalSettlements = map.getSettlements();
+
+    // The vectors are sized up-front so that the pointers into them
+    // remain stable for the lifetime of the snapshot.
+    this->mapNodeData.reserve(originalMapNodes.size());
+    this->factionData.reserve(originalFactions.size());
+    this->settlementData.reserve(originalSettlements.size());
+
+    std::unordered_map<const MapNode*, std::size_t> mapNodeIndexes;
+    mapNodeIndexes.reserve(originalMapNodes.size());
+
+    for (MapNode* mapNode : originalMapNodes)
+    {
+        mapNodeIndexes.emplace(mapNode, this->mapNodeData.size());
+        this->mapNodeData.push_back(
+            MapNodeSnapshot{mapNode, mapNode->getId(), mapNode->getTerrainType(), {}, nullptr, {}, nullptr});
+    }
+
+    for (std::size_t i = 0; i < originalMapNodes.size(); ++i)
+    {
+        for (const auto& neighbour : originalMapNodes[i]->getNeighbours())
+        {
+            this->mapNodeData[i].neighbours.set(
+                neighbour.first, lookupSnapshot<MapNode>(neighbour.second, mapNodeIndexes, this->mapNodeData));
+        }
+    }
+
+    std::unordered_map<const Faction*, std::size_t> factionIndexes;
+    factionIndexes.reserve(originalFactions.size());
+
+    for (Faction* faction : originalFactions)
+    {
+        factionIndexes.emplace(faction, this->factionData.size());
+        this->factionData.push_back(FactionSnapshot{faction->getId(),
+            faction->getName(),
+            faction->getPrimaryColor(),
+            faction->getSecondaryColor(),
+            faction->getBanner(),
+            faction->getCivilization(),
+            {},
+            map.getOwnedMapNodeCount(faction)});
+    }
+
+    if (territory)
+    {
+        for (std::size_t i = 0; i < originalMapNodes.size(); ++i)
+        {
+            MapNodeSnapshot& mapNode = this->mapNodeData[i];
+
+            mapNode.owner =
+                lookupSnapshot<Faction>(territory->getOwner(originalMapNodes[i]), factionIndexes, this->factionData);
+
+            for (const Direction direction : directions)
+            {
+                if (territory->isBorder(originalMapNodes[i], direction))
+                    mapNode.borders.set(direction, mapNode.neighbours.at(direction));
+            }
+        }
+    }
+
+    std::unordered_map<const Settlement*, std::size_t> settlementIndexes;
+    settlementIndexes.reserve(originalSettlements.size());
+
+    for (Settlement* settlement : originalSettlements)
+    {
+        const auto position = lookupSnapshot<MapNode>(settlement->getPosition(), mapNodeIndexes, this->mapNodeData);
+
+        settlementIndexes.emplace(settlement, this->settlementData.size());
+        this->settlementData.push_back(SettlementSnapshot{settlement->getId(),
+            settlement->getType(),
+            position,
+            lookupSnapshot<Faction>(settlement->getOwner(), factionIndexes, this->factionData)});
+
+        if (position && map.getSettlementAt(settlement->getPosition()) == settlement)
+            this->mapNodeData[mapNodeIndexes.at(settlement->getPosition())].settlement = &this->settlementData.back();
+    }
+
+    for (std::size_t i = 0; i < originalFactions.size(); ++i)
+    {
+        for (const Settlement* settlement : map.getFactionSettlements(originalFactions[i]))
+        {
+            this->factionData[i].settlements.push_back(
+                lookupSnapshot<Settlement>(settlement, settlementIndexes, this->settlementData));
+        }
+    }
+
+    this->mapNodes.reserve(this->mapNodeData.size());
+    for (const auto& mapNode : this->mapNodeData)
+        this->mapNodes.push_back(&mapNode);
+
+    this->factions.reserve(this->factionData.size());
+    for (const auto& faction : this->factionData)
+        this->factions.push_back(&faction);
+
+    this->settlements.reserve(this->settlementData.size());
+    for (const auto& settlement : this->settlementData)
+        this->settlements.push_back(&settlement);
+}
+
+/*
+ * Mirrors Map::serialize() and the serialize() of the map's objects, the
+ * two have to be kept in sync.
+ */
+ir::Value MapSnapshot::serialize() const
+{
+    std::unordered_map<QString, ir::Value> obj;
+
+    obj["version"] = Map::formatVersion;
+    obj["name"] = this->name;
+    obj["world"] = this->world->getUuid();
+
+    std::vector<ir::Value> serializedMapNodes;
+    serializedMapNodes.reserve(this->mapNodeData.size());
+    for (const auto& mapNode : this->mapNodeData)
+    {
+        std::vector<ir::Value> serializedNeighbours;
+        serializedNeighbours.reserve(directions.size());
+        for (const Direction direction : directions)
+        {
+            const MapNodeSnapshot* neighbour = mapNode.neighbours.at(direction);
+            serializedNeighbours.emplace_back(neighbour == nullptr ? -1 : neighbour->id.get());
+        }
+
+        std::unordered_map<QString, ir::Value> serializedMapNode;
+        serializedMapNode["id"] = mapNode.id.get();
+        serializedMapNode["neighbours"] = std::move(serializedNeighbours);
+
+        serializedMapNodes.emplace_back(std::move(serializedMapNode));
+    }
+    obj["mapNodes"] = std::move(serializedMapNodes);
+
+    std::vector<ir::Value> serializedFactions;
+    serializedFactions.reserve(this->factionData.size());
+    for (const auto& faction : this->factionData)
+    {
+        std::unordered_map<QString, ir::Value> serializedFaction;
+        serializedFaction["id"] = faction.id.get();
+        serializedFaction["name"] = faction.name;
+        serializedFaction["primaryColor"] = serializeName(faction.primaryColor);
+        serializedFaction["secondaryColor"] = serializeName(faction.secondaryColor);
+        serializedFaction["banner"] = serializeName(faction.banner);
+        serializedFaction["civilization"] = serializeName(faction.civilization);
+
+        serializedFactions.emplace_back(std::move(serializedFaction));
+    }
+    obj["factions"] = std::move(serializedFactions);
+
+    std::vector<ir::Value> serializedSettlements;
+    serializedSettlements.reserve(this->settlementData.size());
+    for (const auto& settlement : this->settlementData)
+    {
+        std::unordered_map<QString, ir::Value> serializedSettlement;
+        serializedSettlement["id"] = settlement.id.get();
+        serializedSettlement["type"] = settlement.type;
+        serializedSettlement["position"] = serializeReference<MapNode>(settlement.position);
+        serializedSettlement["owner"] = serializeReference<Faction>(settlement.owner);
+
+        serializedSettlements.emplace_back(std::move(serializedSettlement));
+    }
+    obj["settlements"] = std::move(serializedSettlements);
+
+    return obj;
+}
+
+template <typename T, typename Snapshot>
+static const Snapshot* lookupSnapshot(
+    const T* obj, const std::unordered_map<const T*, std::size_t>& indexes, const std::vector<Snapshot>& snapshots)
+{
+    if (obj == nullptr)
+        return nullptr;
+
+    const auto it = indexes.find(obj);
+
+    return it == indexes.end() ? nullptr : &snapshots[it->second];
+}
+
+/*
+ * The map's objects are all owned by the map, which is the root of their
+ * object-tree, see ir::Value(WObject*).
+ */
+template <typename T, typename Snapshot>
+static ir::Value serializeReference(const Snapshot* snapshot)
+{
+    if (snapshot == nullptr)
+        return ir::Reference{QString(), QString(), ObjectId::Invalid};
+
+    return ir::Reference{
+        QString(Map::staticMetaObject.className()), QString(T::staticMetaObject.className()), snapshot->id};
+}
+
+static ir::Value serializeName(const NamedType* obj)
+{
+    if (obj == nullptr)
+        return ir::Value();
+
+    return obj->getName();
+}
+
+} // namespace core
+} // namespace warmonger
@@ -0,0 +1,207 @@
+/** \file
+ * MapSnapshot class.
+ *
+ * \copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef W_CORE_MAP_SNAPSHOT_H
+#define W_CORE_MAP_SNAPSHOT_H
+
+#include <array>
+#include <vector>
+
+#include <QString>
+
+#include "core/Hexagon.h"
+#include "core/IntermediateRepresentation.h"
+#include "core/WObject.h"
+
+namespace warmonger {
+namespace core {
+
+class Banner;
+class Civilization;
+class Color;
+class Map;
+class MapNode;
+class Territory;
+class World;
+
+struct FactionSnapshot;
+struct MapNodeSnapshot;
+struct SettlementSnapshot;
+
+/**
+ * The neighbours of a map-node snapshot.
+ *
+ * Read-only counterpart of MapNodeNeighbours.
+ */
+class MapNodeSnapshotNeighbours
+{
+public:
+    MapNodeSnapshotNeighbours()
+    {
+        this->neighbours.fill(nullptr);
+    }
+
+    const MapNodeSnapshot* at(Direction direction) const
+    {
+        return this->neighbours[static_cast<std::size_t>(direction)];
+    }
+
+    void set(Direction direction, const MapNodeSnapshot* neighbour)
+    {
+        this->neighbours[static_cast<std::size_t>(direction)] = neighbour;
+    }
+
+private:
+    std::array<const MapNodeSnapshot*, 6> neighbours;
+};
+
+/**
+ * Frozen copy of a map-node.
+ */
+struct MapNodeSnapshot
+{
+    /**
+     * The map-node this snapshot was taken of.
+     *
+     * Only to be used as an identity, it must not be dereferenced
+     * outside of the GUI thread.
+     */
+    MapNode* mapNode;
+    ObjectId id;
+    QString terrainType;
+    MapNodeSnapshotNeighbours neighbours;
+    // the owner of the map-node according to the territory, nullptr if not
+    // owned or if the snapshot was taken without a territory
+    const FactionSnapshot* owner;
+    // the neighbours with a different owner, the others are nullptr
+    MapNodeSnapshotNeighbours borders;
+    // the settlement at the map-node, see Map::getSettlementAt()
+    const SettlementSnapshot* settlement;
+};
+
+/**
+ * Frozen copy of a faction.
+ */
+struct FactionSnapshot
+{
+    ObjectId id;
+    QString name;
+    Color* primaryColor;
+    Color* secondaryColor;
+    Banner* banner;
+    Civilization* civilization;
+    // see Map::getFactionSettlements() and Map::getOwnedMapNodeCount()
+    std::vector<const SettlementSnapshot*> settlements;
+    std::size_t ownedMapNodeCount;
+};
+
+/**
+ * Frozen copy of a settlement.
+ */
+struct SettlementSnapshot
+{
+    ObjectId id;
+    QString type;
+    const MapNodeSnapshot* position;
+    const FactionSnapshot* owner;
+};
+
+/**
+ * Immutable snapshot of a campaign-map.
+ *
+ * The snapshot is a plain-data copy of the map's content, it doesn't
+ * reference any of the map's QObjects (apart from MapNodeSnapshot::mapNode
+ * which is only an identity) so it can be safely read from any thread once
+ * created. The world objects (banners, colors, etc.) are referenced directly,
+ * as they are immutable once the world is loaded.
+ * Taking the snapshot is O(map-size) and has to be done on the thread owning
+ * the map.
+ * If a territory is passed the ownership of the map-nodes is included.
+ * The snapshot can be serialized (on any thread), which allows saving the
+ * map without blocking the thread owning it for longer than taking the
+ * snapshot.
+ */
+class MapSnapshot
+{
+public:
+    /**
+     * Take a snapshot of the map.
+     *
+     * \param map the map
+     * \param territory the territory of the map, can be nullptr
+     */
+    explicit MapSnapshot(const Map& map, const Territory* territory = nullptr);
+
+    MapSnapshot(const MapSnapshot&) = delete;
+    MapSnapshot& operator=(const MapSnapshot&) = delete;
+
+    /**
+     * Serialize the snapshot.
+     *
+     * The result is the same as that of Map::serialize() for the map at
+     * the time the snapshot was taken, so it can be unserialized as a
+     * Map.
+     *
+     * \returns the intermediate-representation
+     */
+    ir::Value serialize() const;
+
+    const QString& getName() const
+    {
+        return this->name;
+    }
+
+    World* getWorld() const
+    {
+        return this->world;
+    }
+
+    const std::vector<const MapNodeSnapshot*>& getMapNodes() const
+    {
+        return this->mapNodes;
+    }
+
+    const std::vector<const FactionSnapshot*>& getFactions() const
+    {
+        return this->factions;
+    }
+
+    const std::vector<const SettlementSnapshot*>& getSettlements() const
+    {
+        return this->settlements;
+    }
+
+private:
+    QString name;
+    World* world;
+
+    std::vector<MapNodeSnapshot> mapNodeData;
+    std::vector<FactionSnapshot> factionData;
+    std::vector<SettlementSnapshot> settlementData;
+
+    std::vector<const MapNodeSnapshot*> mapNodes;
+    std::vector<const FactionSnapshot*> factions;
+    std::vector<const SettlementSnapshot*> settlements;
+};
+
+} // namespace core
+} // namespace warmonger
+
+#endif // W_CORE_MAP_SNAPSHOT_H
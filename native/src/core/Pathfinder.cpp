@@ -0,0 +1,307 @@
+/**
+ * Copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "core/Pathfinder.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+
+#include "core/Map.h"
+#include "utils/Exception.h"
+
+namespace warmonger {
+namespace core {
+
+static const int defaultCost{1};
+
+Pathfinder::Pathfinder(const Map& map)
+    : map(map)
+    , minCost(defaultCost)
+    , generation(0)
+{
+    this->rebuild();
+}
+
+void Pathfinder::rebuild()
+{
+    const auto& mapNodes = this->map.getMapNodes();
+    const std::size_t size = mapNodes.size();
+
+    this->mapNodes = mapNodes;
+    this->indexes = indexMapNodes(mapNodes);
+
+    const auto neighbours = indexNeighbours(mapNodes, this->indexes);
+
+    // The paths never cross components, so it doesn't matter that their
+    // coordinates are inconsistent with each other.
+    std::vector<HexCoordinates> coordinates;
+    placeMapNodes(neighbours, coordinates);
+
+    this->terrainTypes.clear();
+    this->terrainTypeIndexes.clear();
+
+    this->nodes.assign(size, Node{});
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        Node& node = this->nodes[i];
+
+        node.neighbours = neighbours[i];
+        node.position = coordinates[i];
+        node.terrainType = this->internTerrainType(mapNodes[i]->getTerrainType());
+    }
+
+    this->updateTerrainCosts();
+
+    this->generation = 0;
+    this->visited.assign(size, 0);
+    this->closed.assign(size, 0);
+    this->costs.resize(size);
+    this->parents.resize(size);
+}
+
+void Pathfinder::updateTerrainType(MapNode* mapNode)
+{
+    const Index index = this->indexOf(mapNode);
+    const std::size_t terrainTypeCount = this->terrainTypes.size();
+
+    this->nodes[index].terrainType = this->internTerrainType(mapNode->getTerrainType());
+
+    if (this->terrainTypes.size() != terrainTypeCount)
+        this->updateTerrainCosts();
+}
+
+void Pathfinder::setTerrainCost(const QString& terrainType, int cost)
+{
+    this->explicitTerrainCosts[terrainType] = cost;
+    this->updateTerrainCosts();
+}
+
+int Pathfinder::getTerrainCost(const QString& terrainType) const
+{
+    const auto it = this->explicitTerrainCosts.find(terrainType);
+    return it == this->explicitTerrainCosts.end() ? defaultCost : it->second;
+}
+
+Path Pathfinder::findPath(MapNode* from, MapNode* to)
+{
+    const Index source = this->indexOf(from);
+    const Index destination = this->indexOf(to);
+
+    this->search(&source, 1, destination, std::numeric_limits<int>::max(), nullptr, 0, nullptr);
+
+    Path path{{}, -1};
+
+    if (!this->isClosed(destination))
+        return path;
+
+    path.cost = this->costs[destination];
+    this->appendPath(destination, path.mapNodes);
+
+    return path;
+}
+
+std::vector<ReachableMapNode> Pathfinder::findMovementRange(MapNode* source, int budget)
+{
+    return this->findMovementRange(std::vector<MapNode*>{source}, budget);
+}
+
+std::vector<ReachableMapNode> Pathfinder::findMovementRange(const std::vector<MapNode*>& sources, int budget)
+{
+    std::vector<Index> sourceIndexes;
+    sourceIndexes.reserve(sources.size());
+    std::transform(sources.begin(), sources.end(), std::back_inserter(sourceIndexes), [this](MapNode* mapNode) {
+        return this->indexOf(mapNode);
+    });
+
+    std::vector<Index> closedOrder;
+    this->search(sourceIndexes.data(), sourceIndexes.size(), invalidIndex, budget, nullptr, 0, &closedOrder);
+
+    std::vector<ReachableMapNode> reachable;
+    reachable.reserve(closedOrder.size());
+
+    for (const Index node : closedOrder)
+        reachable.push_back(ReachableMapNode{this->mapNodes[node], this->costs[node]});
+
+    return reachable;
+}
+
+Pathfinder::Index Pathfinder::indexOf(MapNode* mapNode) const
+{
+    const auto it = this->indexes.find(mapNode);
+
+    if (it == this->indexes.end())
+        throw utils::ValueError("Map-node is not on the map of the pathfinder");
+
+    return it->second;
+}
+
+std::int32_t Pathfinder::internTerrainType(const QString& terrainType)
+{
+    const auto inserted =
+        this->terrainTypeIndexes.emplace(terrainType, static_cast<std::int32_t>(this->terrainTypes.size()));
+
+    if (inserted.second)
+        this->terrainTypes.push_back(terrainType);
+
+    return inserted.first->second;
+}
+
+void Pathfinder::updateTerrainCosts()
+{
+    this->terrainCosts.resize(this->terrainTypes.size());
+    this->minCost = defaultCost;
+
+    bool first{true};
+    for (std::size_t i = 0; i < this->terrainTypes.size(); ++i)
+    {
+        const int cost = this->getTerrainCost(this->terrainTypes[i]);
+        this->terrainCosts[i] = cost;
+
+        if (cost >= 0 && (first || cost < this->minCost))
+        {
+            this->minCost = cost;
+            first = false;
+        }
+    }
+}
+
+void Pathfinder::search(const Index* sources,
+    std::size_t sourceCount,
+    Index destination,
+    int budget,
+    const std::vector<std::int32_t>* regions,
+    std::int32_t region,
+    std::vector<Index>* closedOrder)
+{
+    this->beginQuery();
+
+    const bool isAStar = destination != invalidIndex;
+
+    for (std::size_t i = 0; i < sourceCount; ++i)
+    {
+        if (this->visited[sources[i]] != this->generation)
+        {
+            const int priority = isAStar ? this->hexDistance(sources[i], destination) * this->minCost : 0;
+            this->push(sources[i], 0, priority, invalidIndex);
+        }
+    }
+
+    while (!this->queue.empty())
+    {
+        const Index current = this->pop().node;
+
+        if (this->closed[current] == this->generation)
+            continue;
+
+        this->closed[current] = this->generation;
+
+        if (closedOrder)
+            closedOrder->push_back(current);
+
+        if (current == destination)
+            break;
+
+        const int currentCost = this->costs[current];
+
+        for (const Index neighbour : this->nodes[current].neighbours)
+        {
+            if (neighbour == invalidIndex || this->closed[neighbour] == this->generation)
+                continue;
+
+            if (regions && (*regions)[neighbour] != region)
+                continue;
+
+            const int stepCost = this->getNodeCost(neighbour);
+            if (stepCost < 0)
+                continue;
+
+            const int cost = currentCost + stepCost;
+
+            if (cost > budget || (this->visited[neighbour] == this->generation && cost >= this->costs[neighbour]))
+                continue;
+
+            this->push(neighbour,
+                cost,
+                isAStar ? cost + this->hexDistance(neighbour, destination) * this->minCost : cost,
+                current);
+        }
+    }
+}
+
+bool Pathfinder::isClosed(Index node) const
+{
+    return this->closed[node] == this->generation;
+}
+
+int Pathfinder::getNodeCost(Index node) const
+{
+    return this->terrainCosts[this->nodes[node].terrainType];
+}
+
+void Pathfinder::appendPath(Index destination, std::vector<MapNode*>& mapNodes) const
+{
+    const std::size_t begin = mapNodes.size();
+
+    for (Index node = destination; node != invalidIndex; node = this->parents[node])
+        mapNodes.push_back(this->mapNodes[node]);
+
+    std::reverse(mapNodes.begin() + begin, mapNodes.end());
+}
+
+void Pathfinder::beginQuery()
+{
+    this->queue.clear();
+
+    if (++this->generation == 0)
+    {
+        // The stamps wrapped around, old stamps could be mistaken for
+        // current ones.
+        std::fill(this->visited.begin(), this->visited.end(), 0);
+        std::fill(this->closed.begin(), this->closed.end(), 0);
+        this->generation = 1;
+    }
+}
+
+void Pathfinder::push(Index node, int cost, int priority, Index parent)
+{
+    this->visited[node] = this->generation;
+    this->costs[node] = cost;
+    this->parents[node] = parent;
+
+    this->queue.push_back(QueueEntry{priority, node});
+    std::push_heap(this->queue.begin(), this->queue.end(), std::greater<QueueEntry>());
+}
+
+Pathfinder::QueueEntry Pathfinder::pop()
+{
+    std::pop_heap(this->queue.begin(), this->queue.end(), std::greater<QueueEntry>());
+
+    const QueueEntry entry = this->queue.back();
+    this->queue.pop_back();
+
+    return entry;
+}
+
+int Pathfinder::hexDistance(Index a, Index b) const
+{
+    return core::hexDistance(this->nodes[a].position, this->nodes[b].position);
+}
+
+} // namespace core
+} // namespace warmonger
@@ -0,0 +1,246 @@
+/** \file
+ * Pathfinder class.
+ *
+ * \copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef W_CORE_PATHFINDER_H
+#define W_CORE_PATHFINDER_H
+
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <QString>
+
+#include "core/HexGrid.h"
+#include "utils/Hash.h"
+
+namespace warmonger {
+namespace core {
+
+class Map;
+class MapNode;
+
+/**
+ * A path between two map-nodes.
+ */
+struct Path
+{
+    // from the source to the destination, both included, empty if there
+    // is no path
+    std::vector<MapNode*> mapNodes;
+    // -1 if there is no path
+    int cost;
+};
+
+/**
+ * A map-node reachable within the movement-budget.
+ */
+struct ReachableMapNode
+{
+    MapNode* mapNode;
+    // the cost of the cheapest path to the map-node
+    int cost;
+};
+
+/**
+ * Finds paths and movement-ranges on a map.
+ *
+ * The cost of moving into a map-node is the cost of its terrain-type.
+ * Terrain-types with a negative cost are impassable. The cost of
+ * terrain-types without an explicit cost is the default cost (1).
+ * Paths are found with A*, using the hex-distance as the heuristic,
+ * movement-ranges with Dijkstra's algorithm, which can be started from
+ * multiple sources at once.
+ *
+ * The map-node graph is flattened into an index-based representation on
+ * construction. The scratch buffers used by the queries are allocated
+ * once and reused, so queries don't allocate (apart from the result).
+ * This also means that the pathfinder can't be used by multiple threads
+ * concurrently.
+ * The pathfinder doesn't track the changes of the map, call rebuild()
+ * after the map-nodes change and updateTerrainType() after the
+ * terrain-type of a map-node changes.
+ * For long-distance queries on large maps see HierarchicalPathfinder.
+ */
+class Pathfinder
+{
+public:
+    /**
+     * Build the pathfinder for the map.
+     *
+     * The map has to outlive the pathfinder.
+     *
+     * \param map the map
+     */
+    explicit Pathfinder(const Map& map);
+
+    /**
+     * Rebuild the graph from the current state of the map.
+     */
+    void rebuild();
+
+    /**
+     * Update the terrain-type of the map-node from the map.
+     *
+     * \param mapNode the map-node whose terrain-type changed
+     *
+     * \throws utils::ValueError if the map-node is not on the map
+     */
+    void updateTerrainType(MapNode* mapNode);
+
+    /**
+     * Set the cost of moving into map-nodes of the terrain-type.
+     *
+     * \param terrainType the terrain-type
+     * \param cost the cost, negative for impassable
+     */
+    void setTerrainCost(const QString& terrainType, int cost);
+
+    /**
+     * Get the cost of moving into map-nodes of the terrain-type.
+     *
+     * \param terrainType the terrain-type
+     *
+     * \returns the cost, negative if impassable
+     */
+    int getTerrainCost(const QString& terrainType) const;
+
+    /**
+     * Find the cheapest path between the map-nodes.
+     *
+     * \param from the source map-node
+     * \param to the destination map-node
+     *
+     * \returns the path, Path::mapNodes is empty if there is none
+     *
+     * \throws utils::ValueError if any of the map-nodes is not on the map
+     */
+    Path findPath(MapNode* from, MapNode* to);
+
+    /**
+     * Find the map-nodes reachable from the source within the budget.
+     *
+     * \param source the source map-node
+     * \param budget the maximum cost of the paths
+     *
+     * \returns the reachable map-nodes (including the source), ordered by
+     * their cost
+     *
+     * \throws utils::ValueError if the map-node is not on the map
+     */
+    std::vector<ReachableMapNode> findMovementRange(MapNode* source, int budget);
+
+    /**
+     * Find the map-nodes reachable from any of the sources within the budget.
+     *
+     * Computed in a single pass, the cost of each map-node is that of the
+     * cheapest path from any of the sources.
+     *
+     * \param sources the source map-nodes
+     * \param budget the maximum cost of the paths
+     *
+     * \returns the reachable map-nodes (including the sources), ordered by
+     * their cost
+     *
+     * \throws utils::ValueError if any of the map-nodes is not on the map
+     */
+    std::vector<ReachableMapNode> findMovementRange(const std::vector<MapNode*>& sources, int budget);
+
+private:
+    friend class HierarchicalPathfinder;
+
+    using Index = MapNodeIndex;
+
+    static constexpr Index invalidIndex{invalidMapNodeIndex};
+
+    struct Node
+    {
+        std::array<Index, 6> neighbours;
+        HexCoordinates position;
+        std::int32_t terrainType;
+    };
+
+    struct QueueEntry
+    {
+        int priority;
+        Index node;
+
+        bool operator>(const QueueEntry& other) const
+        {
+            return this->priority > other.priority;
+        }
+    };
+
+    Index indexOf(MapNode* mapNode) const;
+    std::int32_t internTerrainType(const QString& terrainType);
+    void updateTerrainCosts();
+
+    /*
+     * Run A* towards the destination, or Dijkstra if it is invalidIndex.
+     *
+     * Only paths not more expensive than budget are considered. If
+     * regions is not null, the search is restricted to nodes whose region
+     * is region. The closed nodes have valid costs and parents until the
+     * next search, closedOrder (if not null) receives them in the order
+     * they were closed.
+     */
+    void search(const Index* sources,
+        std::size_t sourceCount,
+        Index destination,
+        int budget,
+        const std::vector<std::int32_t>* regions,
+        std::int32_t region,
+        std::vector<Index>* closedOrder);
+    bool isClosed(Index node) const;
+    int getNodeCost(Index node) const;
+    void appendPath(Index destination, std::vector<MapNode*>& mapNodes) const;
+    void beginQuery();
+    void push(Index node, int cost, int priority, Index parent);
+    QueueEntry pop();
+    int hexDistance(Index a, Index b) const;
+
+    const Map& map;
+
+    std::vector<MapNode*> mapNodes;
+    std::unordered_map<const MapNode*, Index> indexes;
+    std::vector<Node> nodes;
+
+    std::vector<QString> terrainTypes;
+    std::unordered_map<QString, std::int32_t> terrainTypeIndexes;
+    std::unordered_map<QString, int> explicitTerrainCosts;
+    // by terrain-type index
+    std::vector<int> terrainCosts;
+    // the smallest passable cost, scales the heuristic
+    int minCost;
+
+    // Scratch buffers, a node's cost and parent are only valid if its
+    // visited stamp equals the current query's generation.
+    std::uint32_t generation;
+    std::vector<std::uint32_t> visited;
+    std::vector<std::uint32_t> closed;
+    std::vector<int> costs;
+    std::vector<Index> parents;
+    std::vector<QueueEntry> queue;
+};
+
+} // namespace core
+} // namespace warmonger
+
+#endif // W_CORE_PATHFINDER_H
@@ -0,0 +1,463 @@
+/**
+ * Copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "core/Territory.h"
+
+#include <limits>
+#include <unordered_set>
+
+#include "core/Map.h"
+#include "core/Settlement.h"
+#include "utils/Exception.h"
+
+namespace warmonger {
+namespace core {
+
+static const int unclaimedDistance{std::numeric_limits<int>::max()};
+
+Territory::Territory(const Map& map)
+    : map(map)
+    , maxDistance(-1)
+{
+    this->rebuild();
+}
+
+void Territory::rebuild()
+{
+    const auto& mapNodes = this->map.getMapNodes();
+    const std::size_t size = mapNodes.size();
+
+    this->mapNodes = mapNodes;
+    this->indexes = indexMapNodes(mapNodes);
+    this->neighbours = indexNeighbours(mapNodes, this->indexes);
+
+    this->sites.clear();
+    this->freeSites.clear();
+    this->settlementSites.clear();
+    this->factions.clear();
+    this->factionIndexes.clear();
+
+    this->distances.assign(size, unclaimedDistance);
+    this->claimants.assign(size, -1);
+    this->owners.assign(size, -1);
+    this->borders.assign(size, 0);
+
+    // Seed all the settlements at once, so that the map-nodes are visited
+    // only once (give or take a few ties).
+    for (Settlement* settlement : this->map.getSettlements())
+    {
+        // Settlements without a position, or whose map-node was removed
+        // from the map, don't claim anything.
+        MapNode* position = settlement->getPosition();
+        if (position == nullptr || this->indexes.find(position) == this->indexes.end())
+            continue;
+
+        const auto site = static_cast<std::int32_t>(this->sites.size());
+        const Index node = this->indexOf(position);
+
+        Faction* owner = settlement->getOwner();
+
+        this->sites.push_back(Site{settlement, position, owner, node, this->internFaction(owner), true});
+        this->settlementSites.emplace(settlement, site);
+
+        if (this->isCloser(0, site, node))
+        {
+            this->distances[node] = 0;
+            this->claimants[node] = site;
+            this->queue.push_back(node);
+        }
+    }
+
+    this->propagate();
+
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        const std::int32_t claimant = this->claimants[i];
+        this->owners[i] = claimant == -1 ? -1 : this->sites[claimant].ownerIndex;
+    }
+
+    for (std::size_t i = 0; i < size; ++i)
+        this->updateBorders(static_cast<Index>(i));
+
+    this->changed.clear();
+}
+
+void Territory::updateSettlements()
+{
+    std::unordered_set<const Settlement*> current;
+
+    for (Settlement* settlement : this->map.getSettlements())
+    {
+        // Settlements without a position, or whose map-node was removed
+        // from the map, don't claim anything.
+        MapNode* position = settlement->getPosition();
+        if (position == nullptr || this->indexes.find(position) == this->indexes.end())
+            continue;
+
+        current.insert(settlement);
+
+        const auto it = this->settlementSites.find(settlement);
+        if (it == this->settlementSites.end())
+        {
+            this->settlementSites.emplace(settlement, this->addSite(settlement));
+            continue;
+        }
+
+        const std::int32_t id = it->second;
+        Site& site = this->sites[id];
+
+        if (site.position != position)
+        {
+            this->unclaim(id);
+
+            site.position = position;
+            site.node = this->indexOf(position);
+            site.owner = settlement->getOwner();
+            site.ownerIndex = this->internFaction(site.owner);
+
+            this->claim(id);
+        }
+        else if (site.owner != settlement->getOwner())
+        {
+            site.owner = settlement->getOwner();
+            site.ownerIndex = this->internFaction(site.owner);
+
+            this->recolor(id);
+        }
+    }
+
+    for (auto it = this->settlementSites.begin(); it != this->settlementSites.end();)
+    {
+        if (current.find(it->first) == current.end())
+        {
+            this->removeSite(it->second);
+            it = this->settlementSites.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    this->updateOwners(this->changed);
+    this->changed.clear();
+}
+
+void Territory::setMaxDistance(int maxDistance)
+{
+    this->maxDistance = maxDistance < 0 ? -1 : maxDistance;
+    this->rebuild();
+}
+
+Faction* Territory::getOwner(const MapNode* mapNode) const
+{
+    const auto it = this->indexes.find(mapNode);
+    if (it == this->indexes.end())
+        return nullptr;
+
+    const std::int32_t owner = this->owners[it->second];
+    return owner == -1 ? nullptr : this->factions[owner];
+}
+
+Settlement* Territory::getSettlement(const MapNode* mapNode) const
+{
+    const auto it = this->indexes.find(mapNode);
+    if (it == this->indexes.end())
+        return nullptr;
+
+    const std::int32_t claimant = this->claimants[it->second];
+    return claimant == -1 ? nullptr : this->sites[claimant].settlement;
+}
+
+int Territory::getDistance(const MapNode* mapNode) const
+{
+    const auto it = this->indexes.find(mapNode);
+    if (it == this->indexes.end() || this->claimants[it->second] == -1)
+        return -1;
+
+    return this->distances[it->second];
+}
+
+bool Territory::isBorder(const MapNode* mapNode, Direction direction) const
+{
+    const auto it = this->indexes.find(mapNode);
+    if (it == this->indexes.end())
+        return false;
+
+    return this->borders[it->second] & (1 << static_cast<int>(direction));
+}
+
+std::vector<Border> Territory::getBorders() const
+{
+    std::vector<Border> borders;
+
+    for (std::size_t i = 0; i < this->mapNodes.size(); ++i)
+    {
+        if (this->owners[i] == -1 || this->borders[i] == 0)
+            continue;
+
+        for (std::size_t d = 0; d < directions.size(); ++d)
+        {
+            if (this->borders[i] & (1 << d))
+                borders.push_back(Border{this->mapNodes[i], directions[d]});
+        }
+    }
+
+    return borders;
+}
+
+std::vector<MapNode*> Territory::getMapNodes(const Faction* faction) const
+{
+    std::vector<MapNode*> mapNodes;
+
+    const auto it = this->factionIndexes.find(faction);
+    if (faction == nullptr || it == this->factionIndexes.end())
+        return mapNodes;
+
+    for (std::size_t i = 0; i < this->mapNodes.size(); ++i)
+    {
+        if (this->owners[i] == it->second)
+            mapNodes.push_back(this->mapNodes[i]);
+    }
+
+    return mapNodes;
+}
+
+Territory::Index Territory::indexOf(const MapNode* mapNode) const
+{
+    const auto it = this->indexes.find(mapNode);
+
+    if (it == this->indexes.end())
+        throw utils::ValueError("Map-node is not on the map of the territory");
+
+    return it->second;
+}
+
+std::int32_t Territory::internFaction(Faction* faction)
+{
+    if (faction == nullptr)
+        return -1;
+
+    const auto inserted = this->factionIndexes.emplace(faction, static_cast<std::int32_t>(this->factions.size()));
+
+    if (inserted.second)
+        this->factions.push_back(faction);
+
+    return inserted.first->second;
+}
+
+std::int32_t Territory::addSite(Settlement* settlement)
+{
+    const Index node = this->indexOf(settlement->getPosition());
+
+    std::int32_t id;
+    if (this->freeSites.empty())
+    {
+        id = static_cast<std::int32_t>(this->sites.size());
+        this->sites.emplace_back();
+    }
+    else
+    {
+        id = this->freeSites.back();
+        this->freeSites.pop_back();
+    }
+
+    this->sites[id] = Site{settlement,
+        settlement->getPosition(),
+        settlement->getOwner(),
+        node,
+        this->internFaction(settlement->getOwner()),
+        true};
+
+    this->claim(id);
+
+    return id;
+}
+
+void Territory::removeSite(std::int32_t site)
+{
+    this->unclaim(site);
+
+    this->sites[site].active = false;
+    this->freeSites.push_back(site);
+}
+
+void Territory::claim(std::int32_t site)
+{
+    const Index node = this->sites[site].node;
+
+    if (!this->isCloser(0, site, node))
+        return;
+
+    this->distances[node] = 0;
+    this->claimants[node] = site;
+    this->changed.push_back(node);
+    this->queue.push_back(node);
+
+    this->propagate();
+}
+
+/*
+ * The map-nodes claimed by a settlement form a connected region around
+ * it: the map-node one step closer to the settlement is claimed by the
+ * same settlement. The region is cleared and then refilled from the
+ * claimed map-nodes around it. Map-nodes outside of the region are
+ * not affected.
+ */
+void Territory::unclaim(std::int32_t site)
+{
+    const Index node = this->sites[site].node;
+
+    if (this->claimants[node] != site)
+        return;
+
+    const std::size_t regionBegin = this->changed.size();
+
+    this->claimants[node] = -1;
+    this->distances[node] = unclaimedDistance;
+    this->changed.push_back(node);
+
+    for (std::size_t i = regionBegin; i < this->changed.size(); ++i)
+    {
+        for (const Index neighbour : this->neighbours[this->changed[i]])
+        {
+            if (neighbour == invalidIndex)
+                continue;
+
+            if (this->claimants[neighbour] == site)
+            {
+                this->claimants[neighbour] = -1;
+                this->distances[neighbour] = unclaimedDistance;
+                this->changed.push_back(neighbour);
+            }
+            else if (this->claimants[neighbour] != -1)
+            {
+                this->queue.push_back(neighbour);
+            }
+        }
+    }
+
+    this->propagate();
+}
+
+void Territory::recolor(std::int32_t site)
+{
+    const Index node = this->sites[site].node;
+    const std::int32_t ownerIndex = this->sites[site].ownerIndex;
+
+    if (this->claimants[node] != site || this->owners[node] == ownerIndex)
+        return;
+
+    const std::size_t regionBegin = this->changed.size();
+
+    this->owners[node] = ownerIndex;
+    this->changed.push_back(node);
+
+    for (std::size_t i = regionBegin; i < this->changed.size(); ++i)
+    {
+        for (const Index neighbour : this->neighbours[this->changed[i]])
+        {
+            if (neighbour != invalidIndex && this->claimants[neighbour] == site &&
+                this->owners[neighbour] != ownerIndex)
+            {
+                this->owners[neighbour] = ownerIndex;
+                this->changed.push_back(neighbour);
+            }
+        }
+    }
+}
+
+bool Territory::isCloser(int distance, std::int32_t site, Index node) const
+{
+    const std::int32_t claimant = this->claimants[node];
+
+    if (claimant == -1)
+        return true;
+
+    if (distance != this->distances[node])
+        return distance < this->distances[node];
+
+    if (this->sites[site].node != this->sites[claimant].node)
+        return this->sites[site].node < this->sites[claimant].node;
+
+    return site < claimant;
+}
+
+void Territory::propagate()
+{
+    for (std::size_t head = 0; head < this->queue.size(); ++head)
+    {
+        const Index node = this->queue[head];
+        const int distance = this->distances[node] + 1;
+        const std::int32_t claimant = this->claimants[node];
+
+        if (this->maxDistance >= 0 && distance > this->maxDistance)
+            continue;
+
+        for (const Index neighbour : this->neighbours[node])
+        {
+            if (neighbour == invalidIndex || !this->isCloser(distance, claimant, neighbour))
+                continue;
+
+            this->distances[neighbour] = distance;
+            this->claimants[neighbour] = claimant;
+            this->changed.push_back(neighbour);
+            this->queue.push_back(neighbour);
+        }
+    }
+
+    this->queue.clear();
+}
+
+void Territory::updateOwners(const std::vector<Index>& changed)
+{
+    for (const Index node : changed)
+    {
+        const std::int32_t claimant = this->claimants[node];
+        this->owners[node] = claimant == -1 ? -1 : this->sites[claimant].ownerIndex;
+    }
+
+    for (const Index node : changed)
+    {
+        this->updateBorders(node);
+
+        for (const Index neighbour : this->neighbours[node])
+        {
+            if (neighbour != invalidIndex)
+                this->updateBorders(neighbour);
+        }
+    }
+}
+
+void Territory::updateBorders(Index node)
+{
+    std::uint8_t borders{0};
+
+    for (std::size_t d = 0; d < directions.size(); ++d)
+    {
+        const Index neighbour = this->neighbours[node][d];
+
+        if (neighbour != invalidIndex && this->owners[neighbour] != this->owners[node])
+            borders |= 1 << d;
+    }
+
+    this->borders[node] = borders;
+}
+
+} // namespace core
+} // namespace warmonger
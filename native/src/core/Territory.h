@@ -0,0 +1,245 @@
+/** \file
+ * Territory class.
+ *
+ * \copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef W_CORE_TERRITORY_H
+#define W_CORE_TERRITORY_H
+
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "core/HexGrid.h"
+#include "core/Hexagon.h"
+
+namespace warmonger {
+namespace core {
+
+class Faction;
+class Map;
+class MapNode;
+class Settlement;
+
+/**
+ * An edge between map-nodes of different owners.
+ */
+struct Border
+{
+    // the owned side of the border
+    MapNode* mapNode;
+    // the direction of the other side
+    Direction direction;
+};
+
+/**
+ * Computes which faction controls which map-nodes.
+ *
+ * Each map-node is claimed by its closest settlement (in steps), the
+ * map-node is owned by the owner of the claiming settlement. Ties are
+ * broken by the position of the settlements, so the result doesn't
+ * depend on the order of the settlements. Settlements without an owner
+ * still claim map-nodes, those are left without an owner. The
+ * claims can be limited to a maximum distance.
+ *
+ * The territory is computed with a multi-source BFS from all settlements.
+ * Changes of the settlements are applied incrementally, see
+ * updateSettlements(): adding a settlement only visits the map-nodes it
+ * takes over, removing it only refills the map-nodes it claimed from
+ * their neighbours and changing its owner only visits its map-nodes.
+ */
+class Territory
+{
+public:
+    /**
+     * Compute the territory for the map.
+     *
+     * The map has to outlive the territory.
+     *
+     * \param map the map
+     */
+    explicit Territory(const Map& map);
+
+    /**
+     * Recompute the territory from scratch from the current state of the
+     * map.
+     *
+     * The map-nodes of the map are not watched, call this after they
+     * change.
+     */
+    void rebuild();
+
+    /**
+     * Synchronize the territory with the settlements of the map.
+     *
+     * Only the settlements that were added, removed, moved or changed
+     * their owner since the last call are processed. Settlements without a
+     * position, or positioned on a map-node that is not on the map, are
+     * ignored. The settlements of the map are not watched, call this after
+     * they change.
+     */
+    void updateSettlements();
+
+    /**
+     * Set the maximum distance of the claims.
+     *
+     * Recomputes the territory.
+     *
+     * \param maxDistance the maximum distance, negative for unlimited
+     */
+    void setMaxDistance(int maxDistance);
+
+    int getMaxDistance() const
+    {
+        return this->maxDistance;
+    }
+
+    /**
+     * Get the owner of the map-node.
+     *
+     * \param mapNode the map-node
+     *
+     * \returns the owner, nullptr if the map-node is not owned or is not
+     * on the map
+     */
+    Faction* getOwner(const MapNode* mapNode) const;
+
+    /**
+     * Get the settlement claiming the map-node.
+     *
+     * \param mapNode the map-node
+     *
+     * \returns the settlement, nullptr if the map-node is not claimed or
+     * is not on the map
+     */
+    Settlement* getSettlement(const MapNode* mapNode) const;
+
+    /**
+     * Get the distance of the map-node from the settlement claiming it.
+     *
+     * \param mapNode the map-node
+     *
+     * \returns the distance, -1 if the map-node is not claimed or is not
+     * on the map
+     */
+    int getDistance(const MapNode* mapNode) const;
+
+    /**
+     * Get the owner indexes of the map-nodes.
+     *
+     * The owner index of a map-node is the index of its owner in
+     * getFactions(), -1 if it's not owned. The map-nodes are in the
+     * order of Map::getMapNodes() at the time of the last rebuild().
+     */
+    const std::vector<std::int32_t>& getOwnerIndexes() const
+    {
+        return this->owners;
+    }
+
+    /**
+     * Get the factions referred to by the owner indexes.
+     */
+    const std::vector<Faction*>& getFactions() const
+    {
+        return this->factions;
+    }
+
+    /**
+     * Is there a border between the map-node and its neighbour?
+     *
+     * \param mapNode the map-node
+     * \param direction the direction of the neighbour
+     *
+     * \returns whether the neighbour exists and has a different owner
+     */
+    bool isBorder(const MapNode* mapNode, Direction direction) const;
+
+    /**
+     * Get all the borders of the owned map-nodes.
+     *
+     * Borders between two owned map-nodes are included from both sides.
+     */
+    std::vector<Border> getBorders() const;
+
+    /**
+     * Get the map-nodes owned by the faction.
+     *
+     * \param faction the faction
+     *
+     * \returns the map-nodes
+     */
+    std::vector<MapNode*> getMapNodes(const Faction* faction) const;
+
+private:
+    using Index = MapNodeIndex;
+
+    static constexpr Index invalidIndex{invalidMapNodeIndex};
+
+    struct Site
+    {
+        Settlement* settlement;
+        MapNode* position;
+        Faction* owner;
+        Index node;
+        std::int32_t ownerIndex;
+        bool active;
+    };
+
+    Index indexOf(const MapNode* mapNode) const;
+    std::int32_t internFaction(Faction* faction);
+    std::int32_t addSite(Settlement* settlement);
+    void removeSite(std::int32_t site);
+    void claim(std::int32_t site);
+    void unclaim(std::int32_t site);
+    void recolor(std::int32_t site);
+    bool isCloser(int distance, std::int32_t site, Index node) const;
+    void propagate();
+    void updateOwners(const std::vector<Index>& changed);
+    void updateBorders(Index node);
+
+    const Map& map;
+    int maxDistance;
+
+    std::vector<MapNode*> mapNodes;
+    std::unordered_map<const MapNode*, Index> indexes;
+    std::vector<std::array<Index, 6>> neighbours;
+
+    std::vector<Site> sites;
+    std::vector<std::int32_t> freeSites;
+    std::unordered_map<const Settlement*, std::int32_t> settlementSites;
+
+    std::vector<Faction*> factions;
+    std::unordered_map<const Faction*, std::int32_t> factionIndexes;
+
+    // by map-node index
+    std::vector<int> distances;
+    std::vector<std::int32_t> claimants;
+    std::vector<std::int32_t> owners;
+    // bit d is set if there is a border towards directions[d]
+    std::vector<std::uint8_t> borders;
+
+    // scratch buffers
+    std::vector<Index> queue;
+    std::vector<Index> changed;
+};
+
+} // namespace core
+} // namespace warmonger
+
+#endif // W_CORE_TERRITORY_H
@@ -0,0 +1,560 @@
+/**
+ * Copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "core/Visibility.h"
+
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <limits>
+
+#include <fmt/format.h>
+
+#include "core/Hexagon.h"
+#include "core/Map.h"
+#include "core/Settlement.h"
+#include "utils/Exception.h"
+
+namespace warmonger {
+namespace core {
+
+static const int defaultSightRange{2};
+
+// Used for comparing the (inexact) shadow boundaries.
+static const double epsilon{1e-9};
+
+// Walking these directions from the south-west corner of a hex-ring goes
+// around the ring, counter-clockwise.
+static const std::array<Direction, 6> ringDirections{Direction::East,
+    Direction::NorthEast,
+    Direction::NorthWest,
+    Direction::West,
+    Direction::SouthWest,
+    Direction::SouthEast};
+
+static bool isInShadow(const std::vector<std::pair<double, double>>& shadows, std::size_t count, double angle);
+static bool mergeShadows(std::vector<std::pair<double, double>>& shadows);
+
+Visibility::Visibility(const Map& map)
+    : map(map)
+    , minQ(0)
+    , minR(0)
+    , gridWidth(0)
+    , gridHeight(0)
+{
+    this->rebuild();
+}
+
+void Visibility::rebuild()
+{
+    const auto& mapNodes = this->map.getMapNodes();
+    const std::size_t size = mapNodes.size();
+
+    this->mapNodes = mapNodes;
+    this->indexes = indexMapNodes(mapNodes);
+
+    std::vector<HexCoordinates> coordinates;
+    const auto components = placeMapNodes(indexNeighbours(mapNodes, this->indexes), coordinates);
+
+    // Place each component to the east of the previous one, so that they
+    // can share the grid.
+    const std::size_t componentCount =
+        size == 0 ? 0 : static_cast<std::size_t>(*std::max_element(components.begin(), components.end())) + 1;
+    std::vector<std::pair<int, int>> componentBounds(
+        componentCount, {std::numeric_limits<int>::max(), std::numeric_limits<int>::min()});
+
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        auto& bounds = componentBounds[components[i]];
+        bounds.first = std::min(bounds.first, coordinates[i].q);
+        bounds.second = std::max(bounds.second, coordinates[i].q);
+    }
+
+    std::vector<int> componentShifts(componentCount);
+    int nextQ{0};
+
+    for (std::size_t component = 0; component < componentCount; ++component)
+    {
+        componentShifts[component] = nextQ - componentBounds[component].first;
+        nextQ += componentBounds[component].second - componentBounds[component].first + 2;
+    }
+
+    this->nodes.resize(size);
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        const HexCoordinates position{coordinates[i].q + componentShifts[components[i]], coordinates[i].r};
+        this->nodes[i] = Node{position, components[i], false};
+    }
+
+    int maxQ{0};
+    int maxR{0};
+    this->minQ = 0;
+    this->minR = 0;
+    for (const Node& node : this->nodes)
+    {
+        this->minQ = std::min(this->minQ, node.position.q);
+        this->minR = std::min(this->minR, node.position.r);
+        maxQ = std::max(maxQ, node.position.q);
+        maxR = std::max(maxR, node.position.r);
+    }
+
+    this->gridWidth = maxQ - this->minQ + 1;
+    this->gridHeight = maxR - this->minR + 1;
+    this->grid.assign(static_cast<std::size_t>(this->gridWidth) * this->gridHeight, invalidIndex);
+
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        const Node& node = this->nodes[i];
+        const std::size_t y = static_cast<std::size_t>(node.position.r - this->minR);
+        this->grid[y * this->gridWidth + (node.position.q - this->minQ)] = static_cast<Index>(i);
+    }
+
+    this->updateBlocking();
+
+    // The indexes changed, the visibility has to be recomputed from
+    // scratch.
+    this->factions.clear();
+
+    for (std::size_t i = 0; i < this->sources.size(); ++i)
+    {
+        Source& source = this->sources[i];
+
+        if (!source.active)
+            continue;
+
+        source.visible.clear();
+
+        if (this->indexes.find(source.position) == this->indexes.end())
+        {
+            if (source.settlement)
+                this->settlementStates.erase(source.settlement);
+
+            source.active = false;
+            this->freeSources.push_back(i);
+        }
+    }
+
+    this->recomputeSources();
+    this->updateSettlements();
+}
+
+void Visibility::updateTerrainType(MapNode* mapNode)
+{
+    const Index index = this->indexOf(mapNode);
+    const bool blocking = this->isSightBlocking(mapNode->getTerrainType());
+
+    if (this->nodes[index].blocking == blocking)
+        return;
+
+    this->nodes[index].blocking = blocking;
+
+    for (Source& source : this->sources)
+    {
+        if (!source.active)
+            continue;
+
+        const Index position = this->indexOf(source.position);
+
+        if (this->nodes[position].component == this->nodes[index].component &&
+            this->hexDistance(position, index) <= source.range)
+        {
+            this->hide(source);
+            this->show(source);
+        }
+    }
+}
+
+void Visibility::updateSettlements()
+{
+    std::unordered_set<const Settlement*> current;
+
+    for (Settlement* settlement : this->map.getSettlements())
+    {
+        MapNode* position = settlement->getPosition();
+        Faction* owner = settlement->getOwner();
+
+        // Settlements whose map-node was removed from the map are treated
+        // like the ones without a position.
+        if (position == nullptr || owner == nullptr || this->indexes.find(position) == this->indexes.end())
+            continue;
+
+        current.insert(settlement);
+
+        const auto it = this->settlementStates.find(settlement);
+
+        if (it == this->settlementStates.end())
+        {
+            const SourceId source = this->addSource(owner, position, this->getSightRange(settlement->getType()));
+            this->sources[source].settlement = settlement;
+            this->settlementStates.emplace(settlement, SettlementState{source, position, owner, settlement->getType()});
+            continue;
+        }
+
+        SettlementState& state = it->second;
+
+        if (state.owner != owner || state.type != settlement->getType())
+        {
+            this->removeSource(state.source);
+            state.source = this->addSource(owner, position, this->getSightRange(settlement->getType()));
+            this->sources[state.source].settlement = settlement;
+            state.position = position;
+            state.owner = owner;
+            state.type = settlement->getType();
+        }
+        else if (state.position != position)
+        {
+            this->moveSource(state.source, position);
+            state.position = position;
+        }
+    }
+
+    for (auto it = this->settlementStates.begin(); it != this->settlementStates.end();)
+    {
+        if (current.find(it->first) == current.end())
+        {
+            this->removeSource(it->second.source);
+            it = this->settlementStates.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+void Visibility::setSightRange(const QString& settlementType, int range)
+{
+    if (range < 0)
+        throw utils::ValueError(fmt::format("Invalid sight-range {}, it must not be negative", range));
+
+    this->sightRanges[settlementType] = range;
+
+    for (const auto& element : this->settlementStates)
+    {
+        if (element.second.type != settlementType)
+            continue;
+
+        Source& source = this->sources[element.second.source];
+
+        this->hide(source);
+        source.range = range;
+        this->show(source);
+    }
+}
+
+int Visibility::getSightRange(const QString& settlementType) const
+{
+    const auto it = this->sightRanges.find(settlementType);
+    return it == this->sightRanges.end() ? defaultSightRange : it->second;
+}
+
+void Visibility::setSightBlocking(const QString& terrainType, bool blocking)
+{
+    if (blocking)
+        this->blockingTerrainTypes.insert(terrainType);
+    else
+        this->blockingTerrainTypes.erase(terrainType);
+
+    this->updateBlocking();
+    this->recomputeSources();
+}
+
+bool Visibility::isSightBlocking(const QString& terrainType) const
+{
+    return this->blockingTerrainTypes.find(terrainType) != this->blockingTerrainTypes.end();
+}
+
+Visibility::SourceId Visibility::addSource(Faction* faction, MapNode* position, int range)
+{
+    if (range < 0)
+        throw utils::ValueError(fmt::format("Invalid sight-range {}, it must not be negative", range));
+
+    this->indexOf(position);
+
+    SourceId id;
+    if (this->freeSources.empty())
+    {
+        id = this->sources.size();
+        this->sources.emplace_back();
+    }
+    else
+    {
+        id = this->freeSources.back();
+        this->freeSources.pop_back();
+    }
+
+    Source& source = this->sources[id];
+    source.faction = faction;
+    source.position = position;
+    source.range = range;
+    source.settlement = nullptr;
+    source.visible.clear();
+    source.active = true;
+
+    this->show(source);
+
+    return id;
+}
+
+void Visibility::moveSource(SourceId id, MapNode* position)
+{
+    Source& source = this->getSource(id);
+
+    this->indexOf(position);
+
+    this->hide(source);
+    source.position = position;
+    this->show(source);
+}
+
+void Visibility::removeSource(SourceId id)
+{
+    Source& source = this->getSource(id);
+
+    this->hide(source);
+    source.active = false;
+    this->freeSources.push_back(id);
+}
+
+bool Visibility::isVisible(const Faction* faction, const MapNode* mapNode) const
+{
+    const auto factionIt = this->factions.find(faction);
+    if (factionIt == this->factions.end())
+        return false;
+
+    const auto it = this->indexes.find(mapNode);
+    if (it == this->indexes.end())
+        return false;
+
+    return factionIt->second.bits[it->second / 64] & (std::uint64_t{1} << (it->second % 64));
+}
+
+std::vector<MapNode*> Visibility::getVisibleMapNodes(const Faction* faction) const
+{
+    std::vector<MapNode*> visibleMapNodes;
+
+    const auto it = this->factions.find(faction);
+    if (it == this->factions.end())
+        return visibleMapNodes;
+
+    const std::vector<std::uint64_t>& bits = it->second.bits;
+
+    for (std::size_t word = 0; word < bits.size(); ++word)
+    {
+        if (bits[word] == 0)
+            continue;
+
+        for (std::size_t bit = 0; bit < 64; ++bit)
+        {
+            if (bits[word] & (std::uint64_t{1} << bit))
+                visibleMapNodes.push_back(this->mapNodes[word * 64 + bit]);
+        }
+    }
+
+    return visibleMapNodes;
+}
+
+std::size_t Visibility::getVisibleCount(const Faction* faction) const
+{
+    const auto it = this->factions.find(faction);
+    if (it == this->factions.end())
+        return 0;
+
+    std::size_t count{0};
+    for (const std::uint64_t word : it->second.bits)
+        count += std::bitset<64>(word).count();
+
+    return count;
+}
+
+Visibility::Index Visibility::indexOf(const MapNode* mapNode) const
+{
+    const auto it = this->indexes.find(mapNode);
+
+    if (it == this->indexes.end())
+        throw utils::ValueError("Map-node is not on the map of the visibility");
+
+    return it->second;
+}
+
+Visibility::Index Visibility::lookup(int q, int r) const
+{
+    const int x = q - this->minQ;
+    const int y = r - this->minR;
+
+    if (x < 0 || x >= this->gridWidth || y < 0 || y >= this->gridHeight)
+        return invalidIndex;
+
+    return this->grid[static_cast<std::size_t>(y) * this->gridWidth + x];
+}
+
+Visibility::Source& Visibility::getSource(SourceId id)
+{
+    if (id >= this->sources.size() || !this->sources[id].active)
+        throw utils::ValueError(fmt::format("Sight source {} doesn't exist", id));
+
+    return this->sources[id];
+}
+
+void Visibility::updateBlocking()
+{
+    for (std::size_t i = 0; i < this->nodes.size(); ++i)
+        this->nodes[i].blocking = this->isSightBlocking(this->mapNodes[i]->getTerrainType());
+}
+
+void Visibility::recomputeSources()
+{
+    for (Source& source : this->sources)
+    {
+        if (!source.active)
+            continue;
+
+        this->hide(source);
+        this->show(source);
+    }
+}
+
+void Visibility::show(Source& source)
+{
+    FactionVisibility& faction = this->factions[source.faction];
+
+    if (faction.counts.empty())
+    {
+        faction.counts.assign(this->nodes.size(), 0);
+        faction.bits.assign((this->nodes.size() + 63) / 64, 0);
+    }
+
+    this->computeFieldOfView(this->indexOf(source.position), source.range, source.visible);
+
+    for (const Index node : source.visible)
+    {
+        if (faction.counts[node]++ == 0)
+            faction.bits[node / 64] |= std::uint64_t{1} << (node % 64);
+    }
+}
+
+void Visibility::hide(Source& source)
+{
+    if (source.visible.empty())
+        return;
+
+    FactionVisibility& faction = this->factions[source.faction];
+
+    for (const Index node : source.visible)
+    {
+        if (--faction.counts[node] == 0)
+            faction.bits[node / 64] &= ~(std::uint64_t{1} << (node % 64));
+    }
+
+    source.visible.clear();
+}
+
+void Visibility::computeFieldOfView(Index center, int range, std::vector<Index>& visible)
+{
+    const Node& centerNode = this->nodes[center];
+
+    visible.push_back(center);
+    this->shadows.clear();
+
+    // The angles are measured along the perimeter of the ring, as a
+    // fraction of the full turn, starting from the south-west corner.
+    // This is the same for all the rings so shadows cast by inner rings
+    // can be applied to outer rings directly.
+    for (int k = 1; k <= range; ++k)
+    {
+        const double cellWidth = 1.0 / (6 * k);
+        const std::size_t settledShadows = this->shadows.size();
+
+        int q = centerNode.position.q + hexOffset(Direction::SouthWest).q * k;
+        int r = centerNode.position.r + hexOffset(Direction::SouthWest).r * k;
+
+        for (int side = 0; side < 6; ++side)
+        {
+            const HexCoordinates& offset = hexOffset(ringDirections[side]);
+
+            for (int i = 0; i < k; ++i, q += offset.q, r += offset.r)
+            {
+                const Index node = this->lookup(q, r);
+                if (node == invalidIndex || this->nodes[node].component != centerNode.component)
+                    continue;
+
+                const double angle = (side * k + i) * cellWidth;
+                if (isInShadow(this->shadows, settledShadows, angle))
+                    continue;
+
+                visible.push_back(node);
+
+                if (this->nodes[node].blocking)
+                    this->shadows.emplace_back(angle - cellWidth / 2, angle + cellWidth / 2);
+            }
+        }
+
+        // Everything is in the shadow, no need to look further.
+        if (this->shadows.size() != settledShadows && mergeShadows(this->shadows))
+            break;
+    }
+}
+
+int Visibility::hexDistance(Index a, Index b) const
+{
+    return core::hexDistance(this->nodes[a].position, this->nodes[b].position);
+}
+
+/*
+ * The shadows can extend below 0 and above 1, so the angle is checked
+ * in its wrapped-around forms too.
+ */
+static bool isInShadow(const std::vector<std::pair<double, double>>& shadows, std::size_t count, double angle)
+{
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        for (const double a : {angle - 1, angle, angle + 1})
+        {
+            if (shadows[i].first + epsilon < a && a < shadows[i].second - epsilon)
+                return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+ * Returns whether the shadows cover the full turn.
+ */
+static bool mergeShadows(std::vector<std::pair<double, double>>& shadows)
+{
+    std::sort(shadows.begin(), shadows.end());
+
+    std::size_t last{0};
+    for (std::size_t i = 1; i < shadows.size(); ++i)
+    {
+        if (shadows[i].first <= shadows[last].second + epsilon)
+            shadows[last].second = std::max(shadows[last].second, shadows[i].second);
+        else
+            shadows[++last] = shadows[i];
+    }
+
+    shadows.resize(last + 1);
+
+    return std::any_of(shadows.begin(), shadows.end(), [](const std::pair<double, double>& shadow) {
+        return shadow.second - shadow.first >= 1 - epsilon;
+    });
+}
+
+} // namespace core
+} // namespace warmonger
@@ -0,0 +1,289 @@
+/** \file
+ * Visibility class.
+ *
+ * \copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef W_CORE_VISIBILITY_H
+#define W_CORE_VISIBILITY_H
+
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <QString>
+
+#include "core/HexGrid.h"
+#include "utils/Hash.h"
+
+namespace warmonger {
+namespace core {
+
+class Faction;
+class Map;
+class MapNode;
+class Settlement;
+
+/**
+ * Computes what the factions can see on a map.
+ *
+ * Each faction sees the map-nodes in the field-of-view of its sight
+ * sources. The settlements of the map are sight sources of their owner
+ * (see updateSettlements()), additional sources (e.g. armies) can be
+ * added with addSource(). The sight-range of a settlement depends on its
+ * type, it is the default sight-range (2) for types without an explicit
+ * one.
+ *
+ * The field-of-view is computed with shadowcasting on the hex-rings
+ * around the source: a map-node is visible if its center is not in the
+ * shadow of a sight-blocking map-node closer to the source. Sight-blocking
+ * map-nodes are visible themselves.
+ *
+ * The visible map-nodes of each faction are kept in a bitset over the
+ * map-node indexes, next to a per map-node count of the faction's sources
+ * seeing it. Moving, adding or removing a source only recomputes that
+ * source's field-of-view, so the cost of an update is proportional to the
+ * size of the field-of-view, not to that of the map.
+ */
+class Visibility
+{
+public:
+    using SourceId = std::size_t;
+
+    /**
+     * Build the visibility for the map.
+     *
+     * The settlements of the map are added as sight sources.
+     * The map has to outlive the visibility.
+     *
+     * \param map the map
+     */
+    explicit Visibility(const Map& map);
+
+    /**
+     * Rebuild the graph from the current state of the map.
+     *
+     * The fields-of-view of all sources are recomputed. Sources whose
+     * map-node is no longer on the map are removed. The map-nodes of the
+     * map are not watched, call this after they change.
+     */
+    void rebuild();
+
+    /**
+     * Update the terrain-type of the map-node from the map.
+     *
+     * Only the sources in whose sight-range the map-node is are
+     * recomputed. The terrain-types are not watched, call this after one
+     * changes.
+     *
+     * \param mapNode the map-node whose terrain-type changed
+     *
+     * \throws utils::ValueError if the map-node is not on the map
+     */
+    void updateTerrainType(MapNode* mapNode);
+
+    /**
+     * Synchronize the settlement sources with the settlements of the map.
+     *
+     * Only the sources of the settlements that were added, removed, moved
+     * or changed their owner or type since the last call are recomputed.
+     * Settlements without a position or an owner, or positioned on a
+     * map-node that is not on the map, are not sight sources. The
+     * settlements of the map are not watched, call this after they change.
+     */
+    void updateSettlements();
+
+    /**
+     * Set the sight-range of settlements of the settlement-type.
+     *
+     * \param settlementType the settlement-type
+     * \param range the sight-range, 0 means only the settlement's map-node
+     *
+     * \throws utils::ValueError if range is negative
+     */
+    void setSightRange(const QString& settlementType, int range);
+
+    /**
+     * Get the sight-range of settlements of the settlement-type.
+     *
+     * \param settlementType the settlement-type
+     *
+     * \returns the sight-range
+     */
+    int getSightRange(const QString& settlementType) const;
+
+    /**
+     * Set whether map-nodes of the terrain-type block the sight.
+     *
+     * \param terrainType the terrain-type
+     * \param blocking does it block the sight?
+     */
+    void setSightBlocking(const QString& terrainType, bool blocking);
+
+    /**
+     * Does the terrain-type block the sight?
+     *
+     * \param terrainType the terrain-type
+     *
+     * \returns does it block the sight?
+     */
+    bool isSightBlocking(const QString& terrainType) const;
+
+    /**
+     * Add a sight source.
+     *
+     * \param faction the faction the source belongs to
+     * \param position the map-node of the source
+     * \param range the sight-range of the source
+     *
+     * \returns the id of the source
+     *
+     * \throws utils::ValueError if the map-node is not on the map or if
+     * range is negative
+     */
+    SourceId addSource(Faction* faction, MapNode* position, int range);
+
+    /**
+     * Move the sight source to the map-node.
+     *
+     * \param source the id of the source
+     * \param position the new map-node of the source
+     *
+     * \throws utils::ValueError if the source doesn't exist or if the
+     * map-node is not on the map
+     */
+    void moveSource(SourceId source, MapNode* position);
+
+    /**
+     * Remove the sight source.
+     *
+     * \param source the id of the source
+     *
+     * \throws utils::ValueError if the source doesn't exist
+     */
+    void removeSource(SourceId source);
+
+    /**
+     * Can the faction see the map-node?
+     *
+     * \param faction the faction
+     * \param mapNode the map-node
+     *
+     * \returns false if the faction has no sources or the map-node is not
+     * on the map
+     */
+    bool isVisible(const Faction* faction, const MapNode* mapNode) const;
+
+    /**
+     * Get the map-nodes the faction can see.
+     *
+     * \param faction the faction
+     *
+     * \returns the map-nodes, in the order of the map's map-nodes
+     */
+    std::vector<MapNode*> getVisibleMapNodes(const Faction* faction) const;
+
+    /**
+     * Get the number of map-nodes the faction can see.
+     *
+     * \param faction the faction
+     *
+     * \returns the number of map-nodes
+     */
+    std::size_t getVisibleCount(const Faction* faction) const;
+
+private:
+    using Index = MapNodeIndex;
+
+    static constexpr Index invalidIndex{invalidMapNodeIndex};
+
+    struct Node
+    {
+        // the components of the map are laid out side-by-side so that
+        // they don't overlap
+        HexCoordinates position;
+        std::int32_t component;
+        bool blocking;
+    };
+
+    struct Source
+    {
+        Faction* faction;
+        MapNode* position;
+        int range;
+        // the settlement, if it is a settlement source
+        const Settlement* settlement;
+        std::vector<Index> visible;
+        bool active;
+    };
+
+    struct SettlementState
+    {
+        SourceId source;
+        MapNode* position;
+        Faction* owner;
+        QString type;
+    };
+
+    struct FactionVisibility
+    {
+        // the number of sources seeing each map-node
+        std::vector<std::uint16_t> counts;
+        std::vector<std::uint64_t> bits;
+    };
+
+    Index indexOf(const MapNode* mapNode) const;
+    Index lookup(int q, int r) const;
+    Source& getSource(SourceId source);
+    void updateBlocking();
+    void recomputeSources();
+    void show(Source& source);
+    void hide(Source& source);
+    void computeFieldOfView(Index center, int range, std::vector<Index>& visible);
+    int hexDistance(Index a, Index b) const;
+
+    const Map& map;
+
+    std::vector<MapNode*> mapNodes;
+    std::unordered_map<const MapNode*, Index> indexes;
+    std::vector<Node> nodes;
+
+    // dense (q, r) -> index lookup
+    int minQ;
+    int minR;
+    int gridWidth;
+    int gridHeight;
+    std::vector<Index> grid;
+
+    std::unordered_map<QString, int> sightRanges;
+    std::unordered_set<QString> blockingTerrainTypes;
+
+    std::vector<Source> sources;
+    std::vector<SourceId> freeSources;
+    std::unordered_map<const Settlement*, SettlementState> settlementStates;
+    std::unordered_map<const Faction*, FactionVisibility> factions;
+
+    // scratch buffer of the field-of-view computation
+    std::vector<std::pair<double, double>> shadows;
+};
+
+} // namespace core
+} // namespace warmonger
+
+#endif // W_CORE_VISIBILITY_H
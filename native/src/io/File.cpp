@@ -16,22 +16,55 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <thread>
+#include <vector>
+
+#include <QDataStream>
 #include <QFile>
 #include <QFileInfo>
+#include <QSaveFile>
 
 #include "core/Map.h"
+#include "core/MapSnapshot.h"
 #include "core/World.h"
 #include "io/File.h"
+#include "io/IncrementalMapWriter.h"
 #include "io/JsonSerializer.h"
 #include "utils/Constants.h"
 #include "utils/Exception.h"
 #include "utils/PathBuilder.h"
+#include "utils/Profiling.h"
 #include "utils/Settings.h"
 
 namespace warmonger {
 namespace io {
 
-void writeWorld(const core::World* const world, const QString& path)
+namespace {
+
+const char compressedMagic[8] = {'W', 'C', 'O', 'M', 'P', 'R', 'S', 'D'};
+const quint32 compressedVersion{1};
+
+// Large enough to compress well, small enough to spread the work of
+// compressing big maps across threads.
+const int compressedChunkSize{1 << 20};
+
+// Deflate can't do better than about 1032:1, a header claiming more is
+// corrupt or malicious.
+const quint64 maxCompressionRatio{1032};
+
+// The decompressed data has to fit into a single QByteArray, with its
+// header and terminating null.
+const quint64 maxDecompressedSize{static_cast<quint64>(std::numeric_limits<int>::max()) - sizeof(QByteArrayData) - 1};
+
+} // namespace
+
+static QByteArray compress(const QByteArray& data, Compression compression);
+static QByteArray decompress(const QByteArray& data, const QString& path);
+
+void writeWorld(const core::World* const world, const QString& path, Compression compression)
 {
     QFile file(path);
     if (!file.open(QIODevice::WriteOnly))
@@ -41,7 +74,7 @@ void writeWorld(const core::World* const world, const QString& path)
 
     io::JsonSerializer serializer;
 
-    file.write(serializer.serialize(world->serialize()));
+    file.write(compress(serializer.serialize(world->serialize()), compression));
 }
 
 std::unique_ptr<core::World> readWorld(const QString& path)
@@ -69,7 +102,7 @@ std::unique_ptr<core::World> readWorld(const QString& path)
 
     io::JsonSerializer serializer;
 
-    auto world = std::make_unique<core::World>(serializer.unserialize(file->readAll()));
+    auto world = std::make_unique<core::World>(serializer.unserialize(decompress(file->readAll(), path)));
 
     QFileInfo fileInfo(*file);
 
@@ -89,21 +122,28 @@ std::unique_ptr<core::World> readWorld(const QString& path)
     return world;
 }
 
-void writeMap(const core::Map* const map, const QString& path)
+void writeMap(const core::Map* const map, const QString& path, Compression compression)
 {
-    QFile file(path);
-    if (!file.open(QIODevice::WriteOnly))
-    {
-        throw utils::IOError(QString("Failed to open %1 for writing").arg(path));
-    }
+    wProfileZone("io::writeMap");
 
     io::JsonSerializer serializer;
 
-    file.write(serializer.serialize(map->serialize()));
+    writeFile(path, compress(serializer.serialize(map->serialize()), compression));
+}
+
+void writeMap(const core::MapSnapshot& snapshot, const QString& path, Compression compression)
+{
+    wProfileZone("io::writeMap(snapshot)");
+
+    io::JsonSerializer serializer;
+
+    writeFile(path, compress(serializer.serialize(snapshot.serialize()), compression));
 }
 
 std::unique_ptr<core::Map> readMap(const QString& path, core::World* world)
 {
+    wProfileZone("io::readMap");
+
     QFile file(path);
     if (!file.open(QIODevice::ReadOnly))
     {
@@ -112,7 +152,131 @@ std::unique_ptr<core::Map> readMap(const QString& path, core::World* world)
 
     io::JsonSerializer serializer;
 
-    return std::make_unique<core::Map>(serializer.unserialize(file.readAll()), *world, nullptr);
+    auto serializedMap =
+        replayMapDeltas(serializer.unserialize(decompress(file.readAll(), path)), mapDeltaLogPath(path));
+
+    return std::make_unique<core::Map>(std::move(serializedMap), *world, nullptr);
+}
+
+void writeFile(const QString& path, const QByteArray& data)
+{
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        throw utils::IOError(QString("Failed to open %1 for writing").arg(path));
+    }
+
+    if (file.write(data) != data.size() || !file.commit())
+    {
+        throw utils::IOError(QString("Failed to write %1: %2").arg(path).arg(file.errorString()));
+    }
+}
+
+/*
+ * The chunks are compressed independently, so they are spread across
+ * threads. Each is written as a QByteArray (size-prefixed), after a
+ * header with the magic, the version and the uncompressed size.
+ */
+static QByteArray compress(const QByteArray& data, Compression compression)
+{
+    if (compression == Compression::None)
+        return data;
+
+    wProfileZone("io::compress");
+
+    const int chunkCount = (data.size() + compressedChunkSize - 1) / compressedChunkSize;
+    const int threadCount = std::max(1, std::min(static_cast<int>(std::thread::hardware_concurrency()), chunkCount));
+
+    std::vector<QByteArray> chunks(chunkCount);
+    std::atomic<int> nextChunk{0};
+
+    const auto compressChunks = [&]() {
+        for (int i = nextChunk++; i < chunkCount; i = nextChunk++)
+        {
+            const int offset = i * compressedChunkSize;
+            chunks[i] = qCompress(reinterpret_cast<const uchar*>(data.constData()) + offset,
+                std::min(compressedChunkSize, data.size() - offset));
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < threadCount; ++i)
+        threads.emplace_back(compressChunks);
+
+    compressChunks();
+
+    for (auto& thread : threads)
+        thread.join();
+
+    QByteArray compressed;
+    QDataStream stream(&compressed, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_0);
+
+    stream.writeRawData(compressedMagic, sizeof(compressedMagic));
+    stream << compressedVersion << static_cast<quint64>(data.size());
+
+    for (const auto& chunk : chunks)
+        stream << chunk;
+
+    return compressed;
+}
+
+/*
+ * Uncompressed data is passed through, see compress() for the format.
+ * The chunks are decompressed one at a time, straight into the result.
+ * Both the compressed and the decompressed data are held in memory as a
+ * whole, only the zlib work is done chunk by chunk.
+ */
+static QByteArray decompress(const QByteArray& data, const QString& path)
+{
+    if (!data.startsWith(QByteArray::fromRawData(compressedMagic, sizeof(compressedMagic))))
+        return data;
+
+    wProfileZone("io::decompress");
+
+    QDataStream stream(data);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream.skipRawData(sizeof(compressedMagic));
+
+    quint32 version{0};
+    quint64 size{0};
+    stream >> version >> size;
+
+    if (stream.status() != QDataStream::Ok || version != compressedVersion)
+    {
+        throw utils::IOError(fmt::format("Failed to read `{}': unsupported compressed format", path));
+    }
+
+    // The size is only trusted for reserving the buffer once it's known
+    // to be achievable with the amount of compressed data at hand.
+    if (size > maxDecompressedSize || size > static_cast<quint64>(data.size()) * maxCompressionRatio)
+    {
+        throw utils::IOError(
+            fmt::format("Failed to read `{}': invalid decompressed size {} in compressed header", path, size));
+    }
+
+    QByteArray decompressed;
+    decompressed.reserve(static_cast<int>(size));
+
+    while (!stream.atEnd() && static_cast<quint64>(decompressed.size()) < size)
+    {
+        QByteArray chunk;
+        stream >> chunk;
+
+        const QByteArray decompressedChunk = qUncompress(chunk);
+
+        if (stream.status() != QDataStream::Ok || decompressedChunk.isEmpty())
+            break;
+
+        decompressed.append(decompressedChunk);
+    }
+
+    if (static_cast<quint64>(decompressed.size()) != size)
+    {
+        throw utils::IOError(fmt::format("Failed to read `{}': compressed data is truncated or corrupt", path));
+    }
+
+    return decompressed;
 }
 
 } // namespace io
@@ -23,17 +23,37 @@
 
 #include <memory>
 
+#include <QByteArray>
 #include <QString>
 
 namespace warmonger {
 
 namespace core {
 class Map;
+class MapSnapshot;
 class World;
 } // namespace core
 
 namespace io {
 
+/**
+ * The compression of the written files.
+ *
+ * Compressed files are split into chunks which are compressed
+ * independently (and in parallel) and are written as a sequence of
+ * frames, after a header with a magic. Reading detects the magic, so
+ * compressed and uncompressed files can be read the same way.
+ * This is not streaming: the serialized data is built in memory as a
+ * whole before compressing and the whole file is read before
+ * decompressing, so peak memory use is the size of both.
+ */
+enum class Compression
+{
+    None,
+    // zlib, see qCompress()
+    Zlib
+};
+
 /**
  * Write the world to path.
  *
@@ -41,15 +61,17 @@ namespace io {
  *
  * \param world the world
  * \param path the path where the world will be saved
+ * \param compression the compression to use
  *
  * \throw utils::IOError if the file at path is not writeable
  */
-void writeWorld(const core::World* const world, const QString& path);
+void writeWorld(const core::World* const world, const QString& path, Compression compression = Compression::None);
 
 /**
  * Read the world from path.
  *
- * Read and unserialize the world from the file at path.
+ * Read and unserialize the world from the file at path, which can be
+ * compressed, see Compression.
  * The path can be a relative or absolute path to a world description
  * file or just a name. In the latter case the world will be looked up
  * in the worlds dir as set in the settings.
@@ -67,18 +89,38 @@ std::unique_ptr<core::World> readWorld(const QString& path);
  * Write the map to path.
  *
  * Serialize and write the map to the file at path.
+ * The file is written atomically, it's first written to a temporary file
+ * which is then renamed to path, so path either has the old or the new
+ * content, even if writing fails half-way.
  *
  * \param map the map
  * \param path the path where the map will be saved
+ * \param compression the compression to use
+ *
+ * \throw utils::IOError if the file at path is not writeable
+ */
+void writeMap(const core::Map* const map, const QString& path, Compression compression = Compression::None);
+
+/**
+ * Write the map snapshot to path.
+ *
+ * Same as writeMap(const core::Map* const, const QString&) but it works
+ * on a snapshot, so it can be called from any thread.
+ *
+ * \param snapshot the snapshot of the map
+ * \param path the path where the map will be saved
+ * \param compression the compression to use
  *
  * \throw utils::IOError if the file at path is not writeable
  */
-void writeMap(const core::Map* const map, const QString& path);
+void writeMap(const core::MapSnapshot& snapshot, const QString& path, Compression compression = Compression::None);
 
 /**
  * Read the map from path.
  *
- * Read and unserialize the map from the file at path.
+ * Read and unserialize the map from the file at path, which can be
+ * compressed, see Compression. If the map was saved with an
+ * IncrementalMapWriter its delta-log is replayed on it.
  *
  * \param path the path to the map file
  * \param world the world this map belongs to
@@ -90,6 +132,19 @@ void writeMap(const core::Map* const map, const QString& path);
  */
 std::unique_ptr<core::Map> readMap(const QString& path, core::World* world);
 
+/**
+ * Write data to path atomically.
+ *
+ * The data is first written to a temporary file which is then renamed to
+ * path, so path either has the old or the new content.
+ *
+ * \param path the path of the file
+ * \param data the data to write
+ *
+ * \throw utils::IOError if the file at path is not writeable
+ */
+void writeFile(const QString& path, const QByteArray& data);
+
 } // namespace io
 } // namespace warmonger
 
@@ -0,0 +1,443 @@
+/**
+ * Copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "io/IncrementalMapWriter.h"
+
+#include <algorithm>
+
+#include <QDataStream>
+#include <QFile>
+#include <QUuid>
+
+#include "core/Map.h"
+#include "core/Settlement.h"
+#include "io/File.h"
+#include "io/JsonSerializer.h"
+#include "utils/Exception.h"
+#include "utils/Logging.h"
+#include "utils/Profiling.h"
+
+namespace warmonger {
+namespace io {
+
+namespace {
+
+// The records of the log are QByteArrays, each prefixed with its size.
+const QDataStream::Version logStreamVersion{QDataStream::Qt_5_0};
+
+/*
+ * A serialized object-list with an id index, for replaying the log.
+ *
+ * Removed objects are only cleared in-place and are dropped from the list
+ * in one go at the end, added objects are appended, so the order of the
+ * list matches that of a freshly saved map.
+ */
+class SerializedObjects
+{
+public:
+    explicit SerializedObjects(std::vector<core::ir::Value> objects)
+        : objects(std::move(objects))
+    {
+        for (std::size_t i = 0; i < this->objects.size(); ++i)
+            this->indexes.emplace(this->objects[i].getObjectId().get(), i);
+    }
+
+    void apply(std::vector<core::ir::Value> upserted, const std::vector<core::ir::Value>& removed)
+    {
+        for (const auto& id : removed)
+        {
+            const auto it = this->indexes.find(id.asInteger());
+            if (it == this->indexes.end())
+                continue;
+
+            this->objects[it->second] = core::ir::Value();
+            this->indexes.erase(it);
+        }
+
+        for (auto& obj : upserted)
+        {
+            const int id = obj.getObjectId().get();
+            const auto it = this->indexes.find(id);
+
+            if (it == this->indexes.end())
+            {
+                this->indexes.emplace(id, this->objects.size());
+                this->objects.push_back(std::move(obj));
+            }
+            else
+            {
+                this->objects[it->second] = std::move(obj);
+            }
+        }
+    }
+
+    std::vector<core::ir::Value> take()
+    {
+        this->objects.erase(std::remove_if(this->objects.begin(),
+                                this->objects.end(),
+                                [](const core::ir::Value& obj) { return obj.getType() == core::ir::Type::Null; }),
+            this->objects.end());
+        this->indexes.clear();
+
+        return std::move(this->objects);
+    }
+
+private:
+    std::vector<core::ir::Value> objects;
+    std::unordered_map<int, std::size_t> indexes;
+};
+
+} // namespace
+
+template <typename T>
+static void serializeChanges(const std::vector<T*>& added,
+    const std::unordered_set<T*>& dirty,
+    const std::vector<core::ObjectId>& removed,
+    std::unordered_map<QString, core::ir::Value>& batch,
+    const QString& key,
+    const QString& removedKey);
+
+QString mapDeltaLogPath(const QString& path)
+{
+    return path + ".delta";
+}
+
+core::ir::Value replayMapDeltas(core::ir::Value map, const QString& logPath)
+{
+    wProfileZone("io::replayMapDeltas");
+
+    QFile log(logPath);
+    if (!log.exists())
+        return map;
+
+    if (!log.open(QIODevice::ReadOnly))
+    {
+        throw utils::IOError(QString("Failed to open %1 for reading").arg(logPath));
+    }
+
+    auto obj = std::move(map).asMap();
+
+    const auto generationIt = obj.find("generation");
+    if (generationIt == obj.end())
+    {
+        wWarning << "Ignoring delta-log " << logPath << ", the map was not written incrementally";
+        return obj;
+    }
+
+    const QString generation = generationIt->second.asString();
+
+    SerializedObjects mapNodes(std::move(obj["mapNodes"]).asList());
+    SerializedObjects factions(std::move(obj["factions"]).asList());
+    SerializedObjects settlements(std::move(obj["settlements"]).asList());
+
+    QDataStream stream(&log);
+    stream.setVersion(logStreamVersion);
+
+    io::JsonSerializer serializer;
+
+    while (!stream.atEnd())
+    {
+        QByteArray record;
+        stream >> record;
+
+        if (stream.status() != QDataStream::Ok)
+        {
+            wWarning << "Ignoring truncated last record of delta-log " << logPath;
+            break;
+        }
+
+        auto batch = serializer.unserialize(record).asMap();
+
+        if (batch["generation"].asString() != generation)
+            continue;
+
+        obj["name"] = std::move(batch["name"]);
+        mapNodes.apply(std::move(batch["mapNodes"]).asList(), batch["removedMapNodes"].asList());
+        factions.apply(std::move(batch["factions"]).asList(), batch["removedFactions"].asList());
+        settlements.apply(std::move(batch["settlements"]).asList(), batch["removedSettlements"].asList());
+    }
+
+    obj["mapNodes"] = mapNodes.take();
+    obj["factions"] = factions.take();
+    obj["settlements"] = settlements.take();
+
+    return obj;
+}
+
+IncrementalMapWriter::IncrementalMapWriter(core::Map& map, const QString& path, QObject* parent)
+    : QObject(parent)
+    , map(map)
+    , path(path)
+    , compactionRatio(1.0)
+    , baseSize(0)
+    , logSize(0)
+    , nameDirty(false)
+{
+    QObject::connect(&this->map, &core::Map::nameChanged, this, [this]() { this->nameDirty = true; });
+    QObject::connect(&this->map, &core::Map::mapNodesChanged, this, [this]() { this->mapNodes.listChanged = true; });
+    QObject::connect(&this->map, &core::Map::factionsChanged, this, [this]() { this->factions.listChanged = true; });
+    QObject::connect(
+        &this->map, &core::Map::settlementsChanged, this, [this]() { this->settlements.listChanged = true; });
+}
+
+void IncrementalMapWriter::save()
+{
+    wProfileZone("IncrementalMapWriter::save");
+
+    if (this->generation.isEmpty() || this->logSize > this->compactionRatio * this->baseSize)
+    {
+        this->compact();
+        return;
+    }
+
+    this->syncObjects(this->mapNodes, this->map.getMapNodes());
+    this->syncObjects(this->factions, this->map.getFactions());
+    this->syncObjects(this->settlements, this->map.getSettlements());
+
+    if (!this->hasChanges())
+        return;
+
+    std::unordered_map<QString, core::ir::Value> batch;
+    batch["generation"] = this->generation;
+    batch["name"] = this->map.getName();
+    serializeChanges(this->mapNodes.added,
+        this->mapNodes.dirty,
+        this->mapNodes.removed,
+        batch,
+        "mapNodes",
+        "removedMapNodes");
+    serializeChanges(this->factions.added,
+        this->factions.dirty,
+        this->factions.removed,
+        batch,
+        "factions",
+        "removedFactions");
+    serializeChanges(this->settlements.added,
+        this->settlements.dirty,
+        this->settlements.removed,
+        batch,
+        "settlements",
+        "removedSettlements");
+
+    io::JsonSerializer serializer;
+    const QByteArray record = serializer.serialize(std::move(batch));
+
+    const QString logPath = mapDeltaLogPath(this->path);
+
+    QFile log(logPath);
+    if (!log.open(QIODevice::WriteOnly | QIODevice::Append))
+    {
+        throw utils::IOError(QString("Failed to open %1 for writing").arg(logPath));
+    }
+
+    const qint64 previousSize = log.size();
+
+    QDataStream stream(&log);
+    stream.setVersion(logStreamVersion);
+    stream << record;
+
+    if (stream.status() != QDataStream::Ok || !log.flush())
+    {
+        // Don't leave a torn record behind, the next record would be
+        // appended after it, making the rest of the log unreadable.
+        const QString error = log.errorString();
+        log.resize(previousSize);
+
+        throw utils::IOError(QString("Failed to write %1: %2").arg(logPath).arg(error));
+    }
+
+    this->logSize = log.size();
+    this->resetChanges();
+
+    wDebug << "Saved " << record.size() << " bytes of changes of map " << this->map.getName() << " to " << logPath;
+}
+
+void IncrementalMapWriter::compact()
+{
+    wProfileZone("IncrementalMapWriter::compact");
+
+    this->syncObjects(this->mapNodes, this->map.getMapNodes());
+    this->syncObjects(this->factions, this->map.getFactions());
+    this->syncObjects(this->settlements, this->map.getSettlements());
+
+    const QString generation = QUuid::createUuid().toString();
+
+    auto serializedMap = this->map.serialize().asMap();
+    serializedMap["generation"] = generation;
+
+    io::JsonSerializer serializer;
+    const QByteArray data = serializer.serialize(std::move(serializedMap));
+
+    writeFile(this->path, data);
+
+    this->generation = generation;
+    this->baseSize = data.size();
+    this->logSize = 0;
+    this->resetChanges();
+
+    // The records of a stale log are skipped anyway as they belong to the
+    // previous generation.
+    const QString logPath = mapDeltaLogPath(this->path);
+    if (QFile::exists(logPath) && !QFile::remove(logPath))
+        wWarning << "Failed to remove stale delta-log " << logPath;
+
+    wDebug << "Compacted map " << this->map.getName() << " to " << this->path;
+}
+
+void IncrementalMapWriter::setCompactionRatio(double compactionRatio)
+{
+    this->compactionRatio = compactionRatio;
+}
+
+template <typename T>
+void IncrementalMapWriter::syncObjects(TrackedObjects<T>& objects, const std::vector<T*>& current)
+{
+    if (!objects.listChanged)
+        return;
+
+    const std::unordered_set<T*> currentObjects(current.begin(), current.end());
+
+    for (auto it = objects.known.begin(); it != objects.known.end();)
+    {
+        if (currentObjects.find(it->first) != currentObjects.end())
+        {
+            ++it;
+            continue;
+        }
+
+        // Removed from the map but not destroyed (yet), e.g. kept for undo.
+        QObject::disconnect(it->first, nullptr, this, nullptr);
+        objects.added.erase(std::remove(objects.added.begin(), objects.added.end(), it->first), objects.added.end());
+        objects.dirty.erase(it->first);
+        objects.removed.push_back(it->second);
+        it = objects.known.erase(it);
+    }
+
+    for (T* obj : current)
+    {
+        if (objects.known.find(obj) == objects.known.end())
+        {
+            this->track(objects, obj);
+            objects.added.push_back(obj);
+        }
+    }
+
+    objects.listChanged = false;
+}
+
+template <typename T>
+void IncrementalMapWriter::track(TrackedObjects<T>& objects, T* obj)
+{
+    objects.known.emplace(obj, obj->getId());
+
+    this->connectSignals(obj);
+
+    QObject::connect(obj, &QObject::destroyed, this, [obj, id = obj->getId(), &objects]() {
+        objects.added.erase(std::remove(objects.added.begin(), objects.added.end(), obj), objects.added.end());
+        objects.dirty.erase(obj);
+        if (objects.known.erase(obj))
+            objects.removed.push_back(id);
+    });
+}
+
+void IncrementalMapWriter::connectSignals(core::MapNode* mapNode)
+{
+    const auto markDirty = [this, mapNode]() { this->mapNodes.dirty.insert(mapNode); };
+
+    QObject::connect(mapNode, &core::MapNode::neighboursChanged, this, markDirty);
+}
+
+void IncrementalMapWriter::connectSignals(core::Faction* faction)
+{
+    const auto markDirty = [this, faction]() { this->factions.dirty.insert(faction); };
+
+    QObject::connect(faction, &core::Faction::nameChanged, this, markDirty);
+    QObject::connect(faction, &core::Faction::primaryColorChanged, this, markDirty);
+    QObject::connect(faction, &core::Faction::secondaryColorChanged, this, markDirty);
+    QObject::connect(faction, &core::Faction::bannerChanged, this, markDirty);
+    QObject::connect(faction, &core::Faction::civilizationChanged, this, markDirty);
+}
+
+void IncrementalMapWriter::connectSignals(core::Settlement* settlement)
+{
+    const auto markDirty = [this, settlement]() { this->settlements.dirty.insert(settlement); };
+
+    QObject::connect(settlement, &core::Settlement::typeChanged, this, markDirty);
+    QObject::connect(settlement, &core::Settlement::positionChanged, this, markDirty);
+    QObject::connect(settlement, &core::Settlement::ownerChanged, this, markDirty);
+}
+
+bool IncrementalMapWriter::hasChanges() const
+{
+    return this->nameDirty || !this->mapNodes.added.empty() || !this->mapNodes.dirty.empty() ||
+        !this->mapNodes.removed.empty() || !this->factions.added.empty() || !this->factions.dirty.empty() ||
+        !this->factions.removed.empty() || !this->settlements.added.empty() || !this->settlements.dirty.empty() ||
+        !this->settlements.removed.empty();
+}
+
+void IncrementalMapWriter::resetChanges()
+{
+    this->nameDirty = false;
+
+    this->mapNodes.added.clear();
+    this->mapNodes.dirty.clear();
+    this->mapNodes.removed.clear();
+    this->factions.added.clear();
+    this->factions.dirty.clear();
+    this->factions.removed.clear();
+    this->settlements.added.clear();
+    this->settlements.dirty.clear();
+    this->settlements.removed.clear();
+}
+
+/*
+ * Changed objects are saved whole, they are small and this way replaying
+ * them is a simple replace. Added objects are saved first, in order, as
+ * they are appended to the lists on replay.
+ */
+template <typename T>
+static void serializeChanges(const std::vector<T*>& added,
+    const std::unordered_set<T*>& dirty,
+    const std::vector<core::ObjectId>& removed,
+    std::unordered_map<QString, core::ir::Value>& batch,
+    const QString& key,
+    const QString& removedKey)
+{
+    std::vector<core::ir::Value> serializedObjects;
+    serializedObjects.reserve(added.size() + dirty.size());
+    for (const T* obj : added)
+        serializedObjects.push_back(obj->serialize());
+
+    const std::unordered_set<T*> addedObjects(added.begin(), added.end());
+    for (T* obj : dirty)
+    {
+        if (addedObjects.find(obj) == addedObjects.end())
+            serializedObjects.push_back(obj->serialize());
+    }
+
+    std::vector<core::ir::Value> serializedIds;
+    serializedIds.reserve(removed.size());
+    for (const core::ObjectId& id : removed)
+        serializedIds.emplace_back(id.get());
+
+    batch[key] = std::move(serializedObjects);
+    batch[removedKey] = std::move(serializedIds);
+}
+
+} // namespace io
+} // namespace warmonger
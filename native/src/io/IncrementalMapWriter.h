@@ -0,0 +1,190 @@
+/** \file
+ * IncrementalMapWriter class.
+ *
+ * \copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef W_IO_INCREMENTAL_MAP_WRITER_H
+#define W_IO_INCREMENTAL_MAP_WRITER_H
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <QObject>
+#include <QString>
+
+#include "core/IntermediateRepresentation.h"
+#include "core/WObject.h"
+
+namespace warmonger {
+
+namespace core {
+class Faction;
+class Map;
+class MapNode;
+class Settlement;
+} // namespace core
+
+namespace io {
+
+/**
+ * Get the path of the delta-log belonging to the map file at path.
+ *
+ * \param path the path to the map file
+ *
+ * \returns the path to the delta-log
+ */
+QString mapDeltaLogPath(const QString& path);
+
+/**
+ * Replay the delta-log at logPath on the serialized map.
+ *
+ * Records that don't belong to the map (their generation doesn't match
+ * that of the map) are skipped, as is a truncated last record, which is
+ * the result of an interrupted save. If there is no log at logPath the
+ * map is returned unchanged.
+ *
+ * \param map the serialized base map, as written by IncrementalMapWriter
+ * \param logPath the path to the delta-log
+ *
+ * \returns the serialized map with the changes applied
+ *
+ * \throw utils::IOError if the log is not readable
+ * \throw utils::ValueError if a record is not valid
+ */
+core::ir::Value replayMapDeltas(core::ir::Value map, const QString& logPath);
+
+/**
+ * Saves the map incrementally.
+ *
+ * The map is saved as a base file and a delta-log (see mapDeltaLogPath())
+ * next to it. The changes made to the map are tracked via the change
+ * signals of the map and its objects, and each save appends a record to
+ * the log with the objects that were changed, added or removed since the
+ * previous save. Thus the cost of a save is proportional to the changes
+ * made since the previous one, not to the size of the map. The only
+ * exception is adding or removing objects, which requires a pass over
+ * the respective object list of the map.
+ * When the log grows larger than the base file times the compaction
+ * ratio, the next save compacts it, that is writes a new base (atomically)
+ * and removes the log.
+ * The base file has a generation, which each log record is tagged with,
+ * so a log left behind by an interrupted compaction is never replayed on
+ * the new base. io::readMap() reads the base and replays the log on it.
+ * Only the state visible to Map::serialize() is tracked, e.g. changes to
+ * the terrain-type of map-nodes are not saved. Objects that are removed
+ * and added back between two saves (e.g. by undo) keep their original
+ * place in the saved object-lists.
+ */
+class IncrementalMapWriter : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * Construct the writer and start tracking the changes of the map.
+     *
+     * Nothing is written until the first save, which always writes the
+     * base. The map has to outlive the writer.
+     *
+     * \param map the map to save
+     * \param path the path of the base file
+     * \param parent the parent QObject
+     */
+    IncrementalMapWriter(core::Map& map, const QString& path, QObject* parent = nullptr);
+
+    /**
+     * Save the changes made since the previous save.
+     *
+     * Does nothing if there were no changes.
+     *
+     * \throw utils::IOError if the base or the log is not writeable
+     */
+    void save();
+
+    /**
+     * Write a new base and remove the log.
+     *
+     * \throw utils::IOError if the base is not writeable
+     */
+    void compact();
+
+    double getCompactionRatio() const
+    {
+        return this->compactionRatio;
+    }
+
+    /**
+     * Set the log-size to base-size ratio above which the log is compacted.
+     *
+     * Defaults to 1.
+     *
+     * \param compactionRatio the ratio
+     */
+    void setCompactionRatio(double compactionRatio);
+
+    /**
+     * Get the size of the log written since the last compaction.
+     *
+     * \returns the size in bytes
+     */
+    qint64 getLogSize() const
+    {
+        return this->logSize;
+    }
+
+private:
+    template <typename T>
+    struct TrackedObjects
+    {
+        std::unordered_map<T*, core::ObjectId> known;
+        // in the order of the map's list, so that the saved lists have the
+        // same order as the map's
+        std::vector<T*> added;
+        std::unordered_set<T*> dirty;
+        std::vector<core::ObjectId> removed;
+        bool listChanged = true;
+    };
+
+    template <typename T>
+    void syncObjects(TrackedObjects<T>& objects, const std::vector<T*>& current);
+    template <typename T>
+    void track(TrackedObjects<T>& objects, T* obj);
+    void connectSignals(core::MapNode* mapNode);
+    void connectSignals(core::Faction* faction);
+    void connectSignals(core::Settlement* settlement);
+    bool hasChanges() const;
+    void resetChanges();
+
+    core::Map& map;
+    QString path;
+    QString generation;
+    double compactionRatio;
+    qint64 baseSize;
+    qint64 logSize;
+    bool nameDirty;
+
+    TrackedObjects<core::MapNode> mapNodes;
+    TrackedObjects<core::Faction> factions;
+    TrackedObjects<core::Settlement> settlements;
+};
+
+} // namespace io
+} // namespace warmonger
+
+#endif // W_IO_INCREMENTAL_MAP_WRITER_H
@@ -25,6 +25,8 @@
 #include <experimental/optional>
 #include <fmt/format.h>
 
+#include "utils/Profiling.h"
+
 namespace warmonger {
 namespace io {
 
@@ -66,6 +68,8 @@ QByteArray JsonSerializer::serialize(core::ir::Value v) const
 
 core::ir::Value JsonSerializer::unserialize(const QByteArray& data) const
 {
+    wProfileZone("JsonSerializer::unserialize");
+
     auto jdoc = parseJson(data);
 
     if (jdoc.isObject())
@@ -0,0 +1,152 @@
+/**
+ * Copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "io/MapSaver.h"
+
+#include <algorithm>
+#include <exception>
+
+#include <QTimer>
+
+#include "core/Map.h"
+#include "core/MapSnapshot.h"
+#include "io/File.h"
+#include "utils/Logging.h"
+#include "utils/Profiling.h"
+
+namespace warmonger {
+namespace io {
+
+MapSaver::MapSaver(QObject* parent)
+    : QObject(parent)
+    , stopping(false)
+    , saving(false)
+    , autosaveTimer(new QTimer(this))
+    , autosaveMap(nullptr)
+    , worker(&MapSaver::run, this)
+{
+    QObject::connect(this->autosaveTimer, &QTimer::timeout, this, [this]() {
+        this->save(*this->autosaveMap, this->autosavePath);
+    });
+}
+
+MapSaver::~MapSaver()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+
+    this->jobAvailable.notify_one();
+    this->worker.join();
+}
+
+void MapSaver::save(const core::Map& map, const QString& path)
+{
+    wProfileZone("MapSaver::save");
+
+    auto snapshot = std::make_unique<const core::MapSnapshot>(map);
+
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+
+        auto it = std::find_if(
+            this->pendingJobs.begin(), this->pendingJobs.end(), [&path](const Job& job) { return job.path == path; });
+
+        if (it == this->pendingJobs.end())
+        {
+            this->pendingJobs.push_back(Job{path, std::move(snapshot)});
+        }
+        else
+        {
+            wDebug << "Skipping superseded save of map to " << path;
+            it->snapshot = std::move(snapshot);
+        }
+    }
+
+    this->jobAvailable.notify_one();
+}
+
+void MapSaver::waitForSaves()
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->jobsDone.wait(lock, [this] { return this->pendingJobs.empty() && !this->saving; });
+}
+
+void MapSaver::startAutosave(const core::Map& map, const QString& path, std::chrono::milliseconds interval)
+{
+    wInfo << "Autosaving map " << map.getName() << " to " << path << " every " << interval.count() << "ms";
+
+    this->autosaveMap = &map;
+    this->autosavePath = path;
+    this->autosaveTimer->start(static_cast<int>(interval.count()));
+}
+
+void MapSaver::stopAutosave()
+{
+    this->autosaveTimer->stop();
+    this->autosaveMap = nullptr;
+    this->autosavePath.clear();
+}
+
+void MapSaver::run()
+{
+    while (true)
+    {
+        Job job;
+
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->jobAvailable.wait(lock, [this] { return this->stopping || !this->pendingJobs.empty(); });
+
+            // Pending saves are finished before stopping, they might be
+            // the last chance to save the map.
+            if (this->pendingJobs.empty())
+                return;
+
+            job = std::move(this->pendingJobs.front());
+            this->pendingJobs.erase(this->pendingJobs.begin());
+            this->saving = true;
+        }
+
+        try
+        {
+            writeMap(*job.snapshot, job.path);
+
+            wDebug << "Saved map " << job.snapshot->getName() << " to " << job.path;
+
+            emit saved(job.path);
+        }
+        catch (std::exception& e)
+        {
+            wError.format("Failed to save map `{}' to `{}': {}", job.snapshot->getName(), job.path, e.what());
+
+            emit saveFailed(job.path, QString(e.what()));
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->saving = false;
+        }
+
+        this->jobsDone.notify_all();
+    }
+}
+
+} // namespace io
+} // namespace warmonger
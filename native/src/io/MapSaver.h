@@ -0,0 +1,151 @@
+/** \file
+ * MapSaver class.
+ *
+ * \copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef W_IO_MAP_SAVER_H
+#define W_IO_MAP_SAVER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <QObject>
+#include <QString>
+
+class QTimer;
+
+namespace warmonger {
+
+namespace core {
+class Map;
+class MapSnapshot;
+} // namespace core
+
+namespace io {
+
+/**
+ * Saves maps in the background.
+ *
+ * Only the snapshot of the map is taken on the calling thread, the
+ * serialization and the writing is done on a dedicated worker thread,
+ * see writeMap(const core::MapSnapshot&, const QString&). Files are
+ * written atomically so an interrupted save never leaves a corrupt file
+ * behind.
+ * Saves to the same path are coalesced, if a save is requested while a
+ * previous one to the same path is still waiting for the worker, the
+ * previous one is skipped.
+ * The map can also be saved periodically, see MapSaver::startAutosave().
+ */
+class MapSaver : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * Construct the saver and start the worker thread.
+     *
+     * \param parent the parent QObject
+     */
+    explicit MapSaver(QObject* parent = nullptr);
+
+    /**
+     * Stop and join the worker thread.
+     *
+     * Waits for all requested saves to finish.
+     */
+    ~MapSaver();
+
+    /**
+     * Request saving the map to path.
+     *
+     * Takes a snapshot of the map and passes it to the worker. Must be
+     * called on the thread owning the map.
+     *
+     * \param map the map to save
+     * \param path the path where the map will be saved
+     */
+    void save(const core::Map& map, const QString& path);
+
+    /**
+     * Wait for all requested saves to finish.
+     */
+    void waitForSaves();
+
+    /**
+     * Save the map to path periodically.
+     *
+     * Replaces the previous autosave, if any. The map has to outlive the
+     * autosave, see MapSaver::stopAutosave().
+     *
+     * \param map the map to save
+     * \param path the path where the map will be saved
+     * \param interval the time between saves
+     */
+    void startAutosave(const core::Map& map, const QString& path, std::chrono::milliseconds interval);
+
+    /**
+     * Stop the periodic saving.
+     */
+    void stopAutosave();
+
+signals:
+    /**
+     * Emitted when the map was saved to path.
+     *
+     * Emitted from the worker thread.
+     */
+    void saved(const QString& path);
+
+    /**
+     * Emitted when saving the map to path failed.
+     *
+     * Emitted from the worker thread.
+     */
+    void saveFailed(const QString& path, const QString& error);
+
+private:
+    struct Job
+    {
+        QString path;
+        std::unique_ptr<const core::MapSnapshot> snapshot;
+    };
+
+    void run();
+
+    std::mutex mutex;
+    std::condition_variable jobAvailable;
+    std::condition_variable jobsDone;
+    bool stopping;
+    bool saving;
+    std::vector<Job> pendingJobs;
+
+    QTimer* autosaveTimer;
+    const core::Map* autosaveMap;
+    QString autosavePath;
+
+    std::thread worker;
+};
+
+} // namespace io
+} // namespace warmonger
+
+#endif // W_IO_MAP_SAVER_H
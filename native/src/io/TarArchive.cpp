@@ -0,0 +1,226 @@
+/**
+ * Copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "io/TarArchive.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <fmt/ostream.h>
+
+#include "utils/Exception.h"
+#include "utils/ToString.h"
+
+namespace warmonger {
+namespace io {
+
+namespace {
+
+const qint64 blockSize{512};
+
+// ustar header field offsets and sizes
+const int nameOffset{0};
+const int nameSize{100};
+const int sizeOffset{124};
+const int sizeSize{12};
+const int typeOffset{156};
+const int magicOffset{257};
+const int prefixOffset{345};
+const int prefixSize{155};
+
+} // namespace
+
+static QString readString(const char* field, std::size_t maxSize);
+static qint64 readNumber(const char* field, std::size_t fieldSize, const QString& path);
+static QString readPaxPath(const char* records, qint64 size);
+static bool isZeroBlock(const char* block);
+
+TarArchive::TarArchive(const QString& path)
+    : path(path)
+    , file(path)
+    , data(nullptr)
+    , size(0)
+{
+    if (!this->file.open(QIODevice::ReadOnly))
+    {
+        throw utils::IOError(fmt::format("Failed to open archive `{}': {}", path, this->file.errorString()));
+    }
+
+    this->size = this->file.size();
+
+    // Mapping is not possible for empty files, these are not valid
+    // archives anyway.
+    if (this->size < blockSize)
+    {
+        throw utils::IOError(fmt::format("Failed to read archive `{}': file is too small", path));
+    }
+
+    this->data = this->file.map(0, this->size);
+    if (this->data == nullptr)
+    {
+        throw utils::IOError(fmt::format("Failed to map archive `{}': {}", path, this->file.errorString()));
+    }
+
+    this->index();
+}
+
+const TarArchive::Entry* TarArchive::findEntry(const QString& name) const
+{
+    const auto it = this->entries.find(name);
+    return it == this->entries.end() ? nullptr : &it->second;
+}
+
+void TarArchive::index()
+{
+    const char* const begin = reinterpret_cast<const char*>(this->data);
+    QString longName;
+
+    for (qint64 offset = 0; offset + blockSize <= this->size;)
+    {
+        const char* header = begin + offset;
+
+        if (isZeroBlock(header))
+            break;
+
+        if (std::memcmp(header + magicOffset, "ustar", 5) != 0)
+        {
+            throw utils::IOError(fmt::format(
+                "Failed to read archive `{}': invalid header at offset {}, is it compressed?", this->path, offset));
+        }
+
+        const qint64 entrySize = readNumber(header + sizeOffset, sizeSize, this->path);
+        const qint64 dataOffset = offset + blockSize;
+
+        if (entrySize < 0 || dataOffset + entrySize > this->size)
+        {
+            throw utils::IOError(
+                fmt::format("Failed to read archive `{}': entry at offset {} is truncated", this->path, offset));
+        }
+
+        const char* entryData = begin + dataOffset;
+
+        switch (header[typeOffset])
+        {
+            case 'L': // GNU long name, applies to the next entry
+                longName = readString(entryData, static_cast<std::size_t>(entrySize));
+                break;
+            case 'x': // pax extended header, applies to the next entry
+                longName = readPaxPath(entryData, entrySize);
+                break;
+            case '0':
+            case '\0':
+            {
+                QString name = longName;
+                if (name.isEmpty())
+                {
+                    name = readString(header + nameOffset, nameSize);
+
+                    const QString prefix = readString(header + prefixOffset, prefixSize);
+                    if (!prefix.isEmpty())
+                        name = prefix + "/" + name;
+                }
+
+                if (name.startsWith("./"))
+                    name.remove(0, 2);
+
+                this->entries[name] = Entry{reinterpret_cast<const uchar*>(entryData), entrySize};
+                longName.clear();
+                break;
+            }
+            default: // directories, links, etc.
+                longName.clear();
+                break;
+        }
+
+        offset = dataOffset + (entrySize + blockSize - 1) / blockSize * blockSize;
+    }
+}
+
+static QString readString(const char* field, std::size_t maxSize)
+{
+    const auto end = std::find(field, field + maxSize, '\0');
+    return QString::fromUtf8(field, static_cast<int>(end - field));
+}
+
+/*
+ * Numbers are octal ASCII, except for large values in the GNU format
+ * which are big-endian binary, marked by the high bit of the first byte.
+ */
+static qint64 readNumber(const char* field, std::size_t fieldSize, const QString& path)
+{
+    const auto* bytes = reinterpret_cast<const unsigned char*>(field);
+    qint64 n{0};
+
+    if (bytes[0] & 0x80)
+    {
+        for (std::size_t i = 1; i < fieldSize; ++i)
+            n = (n << 8) | bytes[i];
+
+        return n;
+    }
+
+    for (std::size_t i = 0; i < fieldSize && bytes[i] != '\0'; ++i)
+    {
+        if (bytes[i] == ' ')
+            continue;
+
+        if (bytes[i] < '0' || bytes[i] > '7')
+            throw utils::IOError(fmt::format("Failed to read archive `{}': invalid number in header", path));
+
+        n = n * 8 + (bytes[i] - '0');
+    }
+
+    return n;
+}
+
+/*
+ * The records have the format: "<length> <key>=<value>\n".
+ */
+static QString readPaxPath(const char* records, qint64 size)
+{
+    qint64 offset{0};
+
+    while (offset < size)
+    {
+        const char* record = records + offset;
+        const char* space = static_cast<const char*>(std::memchr(record, ' ', static_cast<std::size_t>(size - offset)));
+        if (space == nullptr)
+            break;
+
+        const qint64 length = QByteArray(record, static_cast<int>(space - record)).toLongLong();
+        if (length <= 0 || offset + length > size)
+            break;
+
+        // without the trailing newline
+        const QByteArray keyValue(space + 1, static_cast<int>(record + length - 1 - (space + 1)));
+        if (keyValue.startsWith("path="))
+            return QString::fromUtf8(keyValue.mid(5));
+
+        offset += length;
+    }
+
+    return QString();
+}
+
+static bool isZeroBlock(const char* block)
+{
+    return std::all_of(block, block + blockSize, [](char c) { return c == '\0'; });
+}
+
+} // namespace io
+} // namespace warmonger
@@ -0,0 +1,104 @@
+/** \file
+ * TarArchive class.
+ *
+ * \copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef W_IO_TAR_ARCHIVE_H
+#define W_IO_TAR_ARCHIVE_H
+
+#include <unordered_map>
+
+#include <QFile>
+#include <QString>
+
+#include "utils/Hash.h"
+
+namespace warmonger {
+namespace io {
+
+/**
+ * Read-only, memory-mapped tar archive.
+ *
+ * The archive is mapped into memory as a whole and its entries are
+ * indexed in a single scan of the headers. The entries' data is not
+ * copied, it points directly into the mapped region, which stays valid
+ * for the lifetime of the archive object.
+ * Only uncompressed archives are supported, with the ustar, GNU and pax
+ * formats' long names. Only regular files are indexed.
+ */
+class TarArchive
+{
+public:
+    struct Entry
+    {
+        const uchar* data;
+        qint64 size;
+    };
+
+    /**
+     * Open, map and index the archive.
+     *
+     * \param path the path to the archive
+     *
+     * \throws utils::IOError if the archive can't be opened, mapped or
+     * it's not a valid (uncompressed) tar archive
+     */
+    explicit TarArchive(const QString& path);
+
+    TarArchive(const TarArchive&) = delete;
+    TarArchive& operator=(const TarArchive&) = delete;
+
+    const QString& getPath() const
+    {
+        return this->path;
+    }
+
+    /**
+     * Get the entries.
+     *
+     * \returns the entries, by their path in the archive, without the
+     * leading "./" if any
+     */
+    const std::unordered_map<QString, Entry>& getEntries() const
+    {
+        return this->entries;
+    }
+
+    /**
+     * Find an entry.
+     *
+     * \param name the path of the entry in the archive
+     *
+     * \returns the entry or nullptr if there is no such entry
+     */
+    const Entry* findEntry(const QString& name) const;
+
+private:
+    void index();
+
+    QString path;
+    QFile file;
+    const uchar* data;
+    qint64 size;
+    std::unordered_map<QString, Entry> entries;
+};
+
+} // namespace io
+} // namespace warmonger
+
+#endif // W_IO_TAR_ARCHIVE_H
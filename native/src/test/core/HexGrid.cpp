@@ -0,0 +1,106 @@
+/**
+ * Copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <algorithm>
+
+#include "core/HexGrid.h"
+#include "core/Map.h"
+#include <catch.hpp>
+
+using namespace warmonger;
+
+TEST_CASE("HexGrid", "[HexGrid]")
+{
+    core::Map map;
+    map.generateMapNodes(3);
+
+    const auto& mapNodes = map.getMapNodes();
+    core::MapNode* center = mapNodes[0];
+
+    const auto indexes = core::indexMapNodes(mapNodes);
+    const auto neighbours = core::indexNeighbours(mapNodes, indexes);
+
+    SECTION("Indexing")
+    {
+        REQUIRE(indexes.size() == mapNodes.size());
+
+        for (std::size_t i = 0; i < mapNodes.size(); ++i)
+        {
+            REQUIRE(indexes.at(mapNodes[i]) == static_cast<core::MapNodeIndex>(i));
+
+            for (std::size_t d = 0; d < core::directions.size(); ++d)
+            {
+                core::MapNode* neighbour = mapNodes[i]->getNeighbour(core::directions[d]);
+
+                if (neighbour == nullptr)
+                    REQUIRE(neighbours[i][d] == core::invalidMapNodeIndex);
+                else
+                    REQUIRE(neighbours[i][d] == indexes.at(neighbour));
+            }
+        }
+    }
+
+    SECTION("Placing")
+    {
+        std::vector<core::HexCoordinates> coordinates;
+        const auto components = core::placeMapNodes(neighbours, coordinates);
+
+        REQUIRE(coordinates.size() == mapNodes.size());
+        REQUIRE(coordinates[0].q == 0);
+        REQUIRE(coordinates[0].r == 0);
+        REQUIRE(std::all_of(components.begin(), components.end(), [](std::int32_t c) { return c == 0; }));
+
+        for (std::size_t i = 0; i < mapNodes.size(); ++i)
+        {
+            REQUIRE(core::hexDistance(coordinates[0], coordinates[i]) <= 2);
+
+            for (std::size_t d = 0; d < core::directions.size(); ++d)
+            {
+                const core::MapNodeIndex neighbour = neighbours[i][d];
+                if (neighbour == core::invalidMapNodeIndex)
+                    continue;
+
+                const core::HexCoordinates& offset = core::hexOffset(core::directions[d]);
+
+                REQUIRE(coordinates[neighbour].q == coordinates[i].q + offset.q);
+                REQUIRE(coordinates[neighbour].r == coordinates[i].r + offset.r);
+            }
+        }
+    }
+
+    SECTION("Placing disconnected components")
+    {
+        std::vector<std::array<core::MapNodeIndex, 6>> disconnected(2);
+        disconnected[0].fill(core::invalidMapNodeIndex);
+        disconnected[1].fill(core::invalidMapNodeIndex);
+
+        std::vector<core::HexCoordinates> coordinates;
+        const auto components = core::placeMapNodes(disconnected, coordinates);
+
+        REQUIRE(components == std::vector<std::int32_t>({0, 1}));
+        REQUIRE(coordinates[1].q == 0);
+        REQUIRE(coordinates[1].r == 0);
+    }
+
+    SECTION("Walking")
+    {
+        REQUIRE(core::walk(center, core::Direction::East, 0) == center);
+        REQUIRE(core::walk(center, core::Direction::East, 1) == center->getNeighbour(core::Direction::East));
+        REQUIRE(core::walk(core::walk(center, core::Direction::East, 2), core::Direction::West, 2) == center);
+        REQUIRE(core::walk(center, core::Direction::East, 3) == nullptr);
+    }
+}
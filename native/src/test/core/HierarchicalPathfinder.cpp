@@ -0,0 +1,147 @@
+/**
+ * Copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <algorithm>
+
+#include "core/HexGrid.h"
+#include "core/HierarchicalPathfinder.h"
+#include "core/Map.h"
+#include "utils/Exception.h"
+#include <catch.hpp>
+
+using namespace warmonger;
+
+static bool isConnected(const core::Path& path);
+
+TEST_CASE("HierarchicalPathfinder", "[HierarchicalPathfinder]")
+{
+    core::Map map;
+    map.generateMapNodes(20);
+
+    core::MapNode* center = map.getMapNodes()[0];
+    core::MapNode* east = core::walk(center, core::Direction::East, 19);
+    core::MapNode* west = core::walk(center, core::Direction::West, 19);
+
+    core::HierarchicalPathfinder pathfinder(map, 4);
+    core::Pathfinder referencePathfinder(map);
+
+    REQUIRE(pathfinder.getClusterCount() == 80);
+    REQUIRE(pathfinder.getPortalCount() > 0);
+
+    SECTION("Long path")
+    {
+        const auto path = pathfinder.findPath(west, east);
+
+        REQUIRE(path.cost == 38);
+        REQUIRE(path.mapNodes.size() == 39);
+        REQUIRE(path.mapNodes.front() == west);
+        REQUIRE(path.mapNodes.back() == east);
+        REQUIRE(isConnected(path));
+
+        core::MapNode* southWest = core::walk(center, core::Direction::SouthWest, 19);
+        core::MapNode* northEast = core::walk(center, core::Direction::NorthEast, 19);
+
+        const auto diagonalPath = pathfinder.findPath(southWest, northEast);
+        const int cheapestCost = referencePathfinder.findPath(southWest, northEast).cost;
+
+        REQUIRE(isConnected(diagonalPath));
+        REQUIRE(diagonalPath.cost >= cheapestCost);
+        REQUIRE(diagonalPath.cost <= cheapestCost * 5 / 4);
+    }
+
+    SECTION("Short path")
+    {
+        const auto path = pathfinder.findPath(center, core::walk(center, core::Direction::East, 3));
+
+        REQUIRE(path.cost == 3);
+        REQUIRE(path.mapNodes.size() == 4);
+    }
+
+    SECTION("Terrain changes")
+    {
+        // Wall off the west from the east.
+        std::vector<core::MapNode*> wall{center};
+        for (int i = 1; i < 20; ++i)
+        {
+            wall.push_back(core::walk(center, core::Direction::NorthWest, i));
+            wall.push_back(core::walk(center, core::Direction::SouthEast, i));
+        }
+
+        for (core::MapNode* mapNode : wall)
+            mapNode->setTerrainType("water");
+
+        pathfinder.rebuild();
+        pathfinder.setTerrainCost("water", -1);
+        REQUIRE(pathfinder.getTerrainCost("water") == -1);
+
+        const auto noPath = pathfinder.findPath(west, east);
+        REQUIRE(noPath.cost == -1);
+        REQUIRE(noPath.mapNodes.empty());
+
+        core::MapNode* gap = core::walk(center, core::Direction::SouthEast, 10);
+        gap->setTerrainType("grass");
+        pathfinder.updateTerrainType(gap);
+
+        referencePathfinder.rebuild();
+        referencePathfinder.setTerrainCost("water", -1);
+        const int cheapestCost = referencePathfinder.findPath(west, east).cost;
+
+        const auto path = pathfinder.findPath(west, east);
+        REQUIRE(isConnected(path));
+        REQUIRE(std::find(path.mapNodes.begin(), path.mapNodes.end(), gap) != path.mapNodes.end());
+        REQUIRE(path.cost >= cheapestCost);
+        REQUIRE(path.cost <= cheapestCost * 5 / 4);
+
+        gap->setTerrainType("water");
+        pathfinder.updateTerrainType(gap);
+        REQUIRE(pathfinder.findPath(west, east).cost == -1);
+    }
+
+    SECTION("Free terrain")
+    {
+        for (core::MapNode* mapNode : map.getMapNodes())
+            mapNode->setTerrainType("road");
+
+        pathfinder.rebuild();
+        pathfinder.setTerrainCost("road", 0);
+
+        const auto path = pathfinder.findPath(west, east);
+        REQUIRE(path.cost == 0);
+        REQUIRE(isConnected(path));
+    }
+
+    SECTION("Invalid cluster-size")
+    {
+        REQUIRE_THROWS_AS(core::HierarchicalPathfinder(map, 1), utils::ValueError);
+    }
+}
+
+static bool isConnected(const core::Path& path)
+{
+    for (std::size_t i = 1; i < path.mapNodes.size(); ++i)
+    {
+        const auto& neighbours = path.mapNodes[i - 1]->getNeighbours();
+        const bool isNeighbour = std::any_of(neighbours.begin(), neighbours.end(), [&](const auto& neighbour) {
+            return neighbour.second == path.mapNodes[i];
+        });
+
+        if (!isNeighbour)
+            return false;
+    }
+
+    return !path.mapNodes.empty();
+}
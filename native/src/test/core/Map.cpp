@@ -17,11 +17,15 @@
  */
 
 #include "core/Map.h"
+#include "core/Settlement.h"
+#include "utils/Exception.h"
 #include <catch.hpp>
 
 using namespace warmonger;
 
 static unsigned int numberOfConnections(const std::vector<core::MapNode*>& nodes);
+static core::ir::Value toVersion1(core::ir::Value serializedMap);
+static void requireSameNeighbours(const core::Map& map1, const core::Map& map2);
 
 TEST_CASE("Map::generateMapNodes()", "[Map]")
 {
@@ -71,6 +75,137 @@ TEST_CASE("Map::generateMapNodes()", "[Map]")
     }
 }
 
+TEST_CASE("Map settlement indexes", "[Map]")
+{
+    core::Map map;
+    map.generateMapNodes(3);
+
+    const auto& mapNodes = map.getMapNodes();
+    core::Faction* faction0 = map.createFaction();
+    core::Faction* faction1 = map.createFaction();
+
+    core::Settlement* settlement0 = map.createSettlement();
+    settlement0->setPosition(mapNodes[0]);
+    settlement0->setOwner(faction0);
+
+    core::Settlement* settlement1 = map.createSettlement();
+    settlement1->setPosition(mapNodes[1]);
+    settlement1->setOwner(faction0);
+
+    SECTION("Created settlements")
+    {
+        REQUIRE(map.getSettlementAt(mapNodes[0]) == settlement0);
+        REQUIRE(map.getSettlementAt(mapNodes[1]) == settlement1);
+        REQUIRE(map.getSettlementAt(mapNodes[2]) == nullptr);
+
+        REQUIRE(map.getFactionSettlements(faction0) == std::vector<core::Settlement*>({settlement0, settlement1}));
+        REQUIRE(map.getFactionSettlements(faction1).empty());
+
+        REQUIRE(map.getOwnedMapNodeCount(faction0) == 2);
+        REQUIRE(map.getOwnedMapNodeCount(faction1) == 0);
+    }
+
+    SECTION("Moved settlement")
+    {
+        settlement1->setPosition(mapNodes[2]);
+
+        REQUIRE(map.getSettlementAt(mapNodes[1]) == nullptr);
+        REQUIRE(map.getSettlementAt(mapNodes[2]) == settlement1);
+        REQUIRE(map.getOwnedMapNodeCount(faction0) == 2);
+
+        settlement1->setPosition(mapNodes[0]);
+
+        REQUIRE(map.getSettlementAt(mapNodes[2]) == nullptr);
+        REQUIRE(map.getOwnedMapNodeCount(faction0) == 1);
+
+        settlement1->setPosition(mapNodes[3]);
+
+        REQUIRE(map.getSettlementAt(mapNodes[0]) == settlement0);
+        REQUIRE(map.getSettlementAt(mapNodes[3]) == settlement1);
+        REQUIRE(map.getOwnedMapNodeCount(faction0) == 2);
+    }
+
+    SECTION("Changed owner")
+    {
+        settlement0->setOwner(faction1);
+
+        REQUIRE(map.getFactionSettlements(faction0) == std::vector<core::Settlement*>({settlement1}));
+        REQUIRE(map.getFactionSettlements(faction1) == std::vector<core::Settlement*>({settlement0}));
+        REQUIRE(map.getOwnedMapNodeCount(faction0) == 1);
+        REQUIRE(map.getOwnedMapNodeCount(faction1) == 1);
+
+        settlement1->setOwner(nullptr);
+
+        REQUIRE(map.getFactionSettlements(faction0).empty());
+        REQUIRE(map.getFactionSettlements(nullptr) == std::vector<core::Settlement*>({settlement1}));
+        REQUIRE(map.getOwnedMapNodeCount(faction0) == 0);
+        REQUIRE(map.getSettlementAt(mapNodes[1]) == settlement1);
+    }
+}
+
+TEST_CASE("Map serialization formats", "[Map]")
+{
+    core::World world("uuid", core::WorldRules::Type::Lua);
+
+    core::Map map;
+    map.setWorld(&world);
+    map.generateMapNodes(3);
+
+    SECTION("Neighbours are serialized as ids")
+    {
+        const core::ir::Value serializedMap = map.serialize();
+        const auto& serializedMapNodes = serializedMap.asMap().at("mapNodes").asList();
+
+        REQUIRE(serializedMap.asMap().at("version").asInteger() == core::Map::formatVersion);
+        REQUIRE(serializedMapNodes.size() == map.getMapNodes().size());
+
+        for (std::size_t i = 0; i < serializedMapNodes.size(); ++i)
+        {
+            const auto& neighbours = serializedMapNodes[i].asMap().at("neighbours").asList();
+
+            REQUIRE(neighbours.size() == core::directions.size());
+
+            for (std::size_t j = 0; j < core::directions.size(); ++j)
+            {
+                const core::MapNode* neighbour = map.getMapNodes()[i]->getNeighbour(core::directions[j]);
+                REQUIRE(neighbours[j].asInteger() == (neighbour == nullptr ? -1 : neighbour->getId().get()));
+            }
+        }
+    }
+
+    SECTION("Current version")
+    {
+        const core::Map newMap(map.serialize(), world, nullptr);
+
+        requireSameNeighbours(map, newMap);
+    }
+
+    SECTION("Version 1")
+    {
+        const core::Map newMap(toVersion1(map.serialize()), world, nullptr);
+
+        requireSameNeighbours(map, newMap);
+    }
+
+    SECTION("Unsupported version")
+    {
+        auto serializedMap = map.serialize().asMap();
+        serializedMap["version"] = core::Map::formatVersion + 1;
+
+        REQUIRE_THROWS_AS(core::Map(std::move(serializedMap), world, nullptr), utils::ValueError);
+    }
+
+    SECTION("Unknown neighbour")
+    {
+        auto serializedMap = map.serialize().asMap();
+        auto serializedMapNodes = std::move(serializedMap["mapNodes"]).asList();
+        serializedMapNodes.pop_back();
+        serializedMap["mapNodes"] = std::move(serializedMapNodes);
+
+        REQUIRE_THROWS_AS(core::Map(std::move(serializedMap), world, nullptr), utils::ValueError);
+    }
+}
+
 static unsigned int numberOfConnections(const std::vector<core::MapNode*>& nodes)
 {
     unsigned int n{0};
@@ -86,3 +221,64 @@ static unsigned int numberOfConnections(const std::vector<core::MapNode*>& nodes
 
     return n;
 }
+
+/*
+ * Version 1 had no version entry and had the neighbours as references
+ * keyed by the direction.
+ */
+static core::ir::Value toVersion1(core::ir::Value serializedMap)
+{
+    auto obj = std::move(serializedMap).asMap();
+    obj.erase("version");
+
+    auto serializedMapNodes = std::move(obj["mapNodes"]).asList();
+    for (auto& serializedMapNode : serializedMapNodes)
+    {
+        auto mapNodeObj = std::move(serializedMapNode).asMap();
+        const auto& ids = mapNodeObj["neighbours"].asList();
+
+        std::unordered_map<QString, core::ir::Value> neighbours;
+        for (std::size_t i = 0; i < core::directions.size(); ++i)
+        {
+            const int id = ids[i].asInteger();
+
+            if (id < 0)
+                neighbours.emplace(core::direction2str(core::directions[i]),
+                    core::ir::Reference{QString(), QString(), core::ObjectId::Invalid});
+            else
+                neighbours.emplace(core::direction2str(core::directions[i]),
+                    core::ir::Reference{QString(core::Map::staticMetaObject.className()),
+                        QString(core::MapNode::staticMetaObject.className()),
+                        core::ObjectId(id)});
+        }
+
+        mapNodeObj["neighbours"] = std::move(neighbours);
+        serializedMapNode = std::move(mapNodeObj);
+    }
+    obj["mapNodes"] = std::move(serializedMapNodes);
+
+    return obj;
+}
+
+static void requireSameNeighbours(const core::Map& map1, const core::Map& map2)
+{
+    REQUIRE(map1.getMapNodes().size() == map2.getMapNodes().size());
+
+    for (std::size_t i = 0; i < map1.getMapNodes().size(); ++i)
+    {
+        const core::MapNode* mapNode1 = map1.getMapNodes()[i];
+        const core::MapNode* mapNode2 = map2.getMapNodes()[i];
+
+        REQUIRE(mapNode1->getId() == mapNode2->getId());
+
+        for (const core::Direction direction : core::directions)
+        {
+            const core::MapNode* neighbour1 = mapNode1->getNeighbour(direction);
+            const core::MapNode* neighbour2 = mapNode2->getNeighbour(direction);
+
+            REQUIRE((neighbour1 == nullptr) == (neighbour2 == nullptr));
+            if (neighbour1 != nullptr)
+                REQUIRE(neighbour1->getId() == neighbour2->getId());
+        }
+    }
+}
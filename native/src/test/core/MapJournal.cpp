@@ -0,0 +1,186 @@
+/**
+ * Copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include "core/Map.h"
+#include "core/MapJournal.h"
+#include "core/Settlement.h"
+#include "utils/Exception.h"
+#include <catch.hpp>
+
+using namespace warmonger;
+
+TEST_CASE("MapJournal", "[MapJournal]")
+{
+    core::Map map;
+    map.generateMapNodes(3);
+
+    core::MapJournal journal(map);
+
+    core::MapNode* center = map.getMapNodes()[0];
+    core::MapNode* east = center->getNeighbour(core::Direction::East);
+
+    REQUIRE(!journal.canUndo());
+    REQUIRE(!journal.canRedo());
+
+    SECTION("Changing a property")
+    {
+        journal.setTerrainType(center, "hills");
+
+        REQUIRE(center->getTerrainType() == "hills");
+        REQUIRE(journal.canUndo());
+
+        REQUIRE(journal.undo());
+        REQUIRE(center->getTerrainType() == "");
+        REQUIRE(!journal.canUndo());
+        REQUIRE(journal.canRedo());
+
+        REQUIRE(journal.redo());
+        REQUIRE(center->getTerrainType() == "hills");
+        REQUIRE(!journal.redo());
+    }
+
+    SECTION("Commands")
+    {
+        journal.beginCommand();
+        journal.setTerrainType(center, "hills");
+        journal.setTerrainType(center, "mountains");
+        journal.setTerrainType(east, "hills");
+        journal.endCommand();
+
+        REQUIRE(journal.getRecordCount() == 2);
+
+        REQUIRE(journal.undo());
+        REQUIRE(center->getTerrainType() == "");
+        REQUIRE(east->getTerrainType() == "");
+        REQUIRE(!journal.canUndo());
+
+        REQUIRE(journal.redo());
+        REQUIRE(center->getTerrainType() == "mountains");
+        REQUIRE(east->getTerrainType() == "hills");
+
+        journal.beginCommand();
+        REQUIRE_THROWS_AS(journal.undo(), utils::ValueError);
+        journal.endCommand();
+
+        REQUIRE_THROWS_AS(journal.endCommand(), utils::ValueError);
+    }
+
+    SECTION("A new command drops the undone ones")
+    {
+        journal.setTerrainType(center, "hills");
+        journal.undo();
+        journal.setTerrainType(east, "hills");
+
+        REQUIRE(!journal.canRedo());
+        REQUIRE(journal.getRecordCount() == 1);
+    }
+
+    SECTION("Removing a map-node")
+    {
+        core::Settlement* settlement = map.createSettlement();
+        settlement->setPosition(east);
+
+        const std::size_t mapNodeCount = map.getMapNodes().size();
+
+        journal.removeMapNode(east);
+
+        REQUIRE(map.getMapNodes().size() == mapNodeCount - 1);
+        REQUIRE(center->getNeighbour(core::Direction::East) == nullptr);
+        REQUIRE(settlement->getPosition() == nullptr);
+
+        REQUIRE(journal.undo());
+
+        REQUIRE(map.getMapNodes().size() == mapNodeCount);
+        REQUIRE(center->getNeighbour(core::Direction::East) == east);
+        REQUIRE(east->getNeighbour(core::Direction::West) == center);
+        REQUIRE(settlement->getPosition() == east);
+        REQUIRE(map.getSettlementAt(east) == settlement);
+        REQUIRE(!journal.canUndo());
+    }
+
+    SECTION("Creating and removing factions and settlements")
+    {
+        journal.beginCommand();
+        core::Faction* faction = journal.createFaction();
+        core::Settlement* settlement = journal.createSettlement();
+        journal.setPosition(settlement, center);
+        journal.setOwner(settlement, faction);
+        journal.endCommand();
+
+        journal.removeFaction(faction);
+
+        REQUIRE(map.getFactions().empty());
+        REQUIRE(settlement->getOwner() == nullptr);
+
+        REQUIRE(journal.undo());
+        REQUIRE(map.getFactions().size() == 1);
+        REQUIRE(settlement->getOwner() == faction);
+        REQUIRE(map.getFactionSettlements(faction).size() == 1);
+
+        REQUIRE(journal.undo());
+        REQUIRE(map.getFactions().empty());
+        REQUIRE(map.getSettlements().empty());
+        REQUIRE(map.getSettlementAt(center) == nullptr);
+
+        REQUIRE(journal.redo());
+        REQUIRE(map.getFactions().size() == 1);
+        REQUIRE(map.getSettlementAt(center) == settlement);
+        REQUIRE(settlement->getOwner() == faction);
+    }
+
+    SECTION("Detached objects are rejected")
+    {
+        core::Faction* faction = journal.createFaction();
+        core::Settlement* settlement = journal.createSettlement();
+        journal.setPosition(settlement, center);
+
+        journal.removeFaction(faction);
+
+        REQUIRE_THROWS_AS(journal.setOwner(settlement, faction), utils::ValueError);
+        REQUIRE_THROWS_AS(journal.setName(faction, "Removed"), utils::ValueError);
+        REQUIRE_THROWS_AS(journal.removeFaction(faction), utils::ValueError);
+        REQUIRE(settlement->getOwner() == nullptr);
+
+        // Undoing the creation detaches the settlement.
+        REQUIRE(journal.undo());
+        REQUIRE(journal.undo());
+        REQUIRE(journal.undo());
+
+        REQUIRE_THROWS_AS(journal.setPosition(settlement, east), utils::ValueError);
+        REQUIRE(journal.canRedo());
+
+        REQUIRE(journal.redo());
+        journal.setPosition(settlement, east);
+        REQUIRE(settlement->getPosition() == east);
+    }
+
+    SECTION("Record limit")
+    {
+        journal.setRecordLimit(3);
+
+        for (const auto& terrainType : {"a", "b", "c", "d", "e"})
+            journal.setTerrainType(center, terrainType);
+
+        REQUIRE(journal.getRecordCount() == 3);
+
+        REQUIRE(journal.undo());
+        REQUIRE(journal.undo());
+        REQUIRE(journal.undo());
+        REQUIRE(!journal.undo());
+        REQUIRE(center->getTerrainType() == "b");
+    }
+}
@@ -0,0 +1,120 @@
+/**
+ * Copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include <algorithm>
+
+#include "core/HexGrid.h"
+#include "core/Map.h"
+#include "core/Pathfinder.h"
+#include "utils/Exception.h"
+#include <catch.hpp>
+
+using namespace warmonger;
+
+TEST_CASE("Pathfinder", "[Pathfinder]")
+{
+    core::Map map;
+    map.generateMapNodes(5);
+
+    core::MapNode* center = map.getMapNodes()[0];
+    core::MapNode* east = core::walk(center, core::Direction::East, 4);
+    core::MapNode* west = core::walk(center, core::Direction::West, 4);
+
+    core::Pathfinder pathfinder(map);
+
+    SECTION("Shortest path")
+    {
+        const auto path = pathfinder.findPath(west, east);
+
+        REQUIRE(path.cost == 8);
+        REQUIRE(path.mapNodes.size() == 9);
+        REQUIRE(path.mapNodes.front() == west);
+        REQUIRE(path.mapNodes.back() == east);
+
+        for (std::size_t i = 1; i < path.mapNodes.size(); ++i)
+        {
+            const auto& neighbours = path.mapNodes[i - 1]->getNeighbours();
+            REQUIRE(std::any_of(neighbours.begin(), neighbours.end(), [&](const auto& neighbour) {
+                return neighbour.second == path.mapNodes[i];
+            }));
+        }
+    }
+
+    SECTION("Path to self")
+    {
+        const auto path = pathfinder.findPath(center, center);
+
+        REQUIRE(path.cost == 0);
+        REQUIRE(path.mapNodes.size() == 1);
+    }
+
+    SECTION("Terrain costs")
+    {
+        for (const auto& neighbour : center->getNeighbours())
+            neighbour.second->setTerrainType("water");
+        pathfinder.rebuild();
+
+        pathfinder.setTerrainCost("water", 3);
+        REQUIRE(pathfinder.getTerrainCost("water") == 3);
+        REQUIRE(pathfinder.findPath(center, east).cost == 6);
+
+        // Going around is cheaper.
+        pathfinder.setTerrainCost("water", 10);
+        REQUIRE(pathfinder.findPath(west, east).cost == 10);
+
+        pathfinder.setTerrainCost("water", -1);
+        const auto path = pathfinder.findPath(center, east);
+        REQUIRE(path.cost == -1);
+        REQUIRE(path.mapNodes.empty());
+        REQUIRE(pathfinder.findMovementRange(center, 10).size() == 1);
+    }
+
+    SECTION("Movement range")
+    {
+        REQUIRE(pathfinder.findMovementRange(center, 0).size() == 1);
+        REQUIRE(pathfinder.findMovementRange(center, 1).size() == 7);
+
+        const auto reachable = pathfinder.findMovementRange(center, 2);
+        REQUIRE(reachable.size() == 19);
+        REQUIRE(reachable.front().mapNode == center);
+        REQUIRE(reachable.front().cost == 0);
+        REQUIRE(reachable.back().cost == 2);
+    }
+
+    SECTION("Multi-source movement range")
+    {
+        REQUIRE(pathfinder.findMovementRange(std::vector<core::MapNode*>{west, east}, 0).size() == 2);
+
+        const auto reachable = pathfinder.findMovementRange(std::vector<core::MapNode*>{west, east}, 3);
+        REQUIRE(reachable.size() == 32);
+        for (const auto& reachableMapNode : reachable)
+        {
+            REQUIRE(reachableMapNode.mapNode != center);
+            REQUIRE(reachableMapNode.cost <= 3);
+        }
+    }
+
+    SECTION("Map-node not on the map")
+    {
+        core::Map otherMap;
+        otherMap.generateMapNodes(1);
+
+        REQUIRE_THROWS_AS(pathfinder.findPath(center, otherMap.getMapNodes()[0]), utils::ValueError);
+    }
+}
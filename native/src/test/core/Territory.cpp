@@ -0,0 +1,144 @@
+/**
+ * Copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include "core/HexGrid.h"
+#include "core/Map.h"
+#include "core/Settlement.h"
+#include "core/Territory.h"
+#include <catch.hpp>
+
+using namespace warmonger;
+
+TEST_CASE("Territory", "[Territory]")
+{
+    core::Map map;
+    map.generateMapNodes(10);
+
+    core::MapNode* center = map.getMapNodes()[0];
+    core::MapNode* west = core::walk(center, core::Direction::West, 4);
+    core::MapNode* east = core::walk(center, core::Direction::East, 4);
+
+    core::Faction* westFaction = map.createFaction();
+    core::Faction* eastFaction = map.createFaction();
+
+    core::Settlement* westSettlement = map.createSettlement();
+    westSettlement->setPosition(west);
+    westSettlement->setOwner(westFaction);
+
+    core::Settlement* eastSettlement = map.createSettlement();
+    eastSettlement->setPosition(east);
+    eastSettlement->setOwner(eastFaction);
+
+    core::Territory territory(map);
+
+    SECTION("Closest settlement")
+    {
+        const std::size_t mapNodeCount = map.getMapNodes().size();
+
+        REQUIRE(territory.getMapNodes(westFaction).size() + territory.getMapNodes(eastFaction).size() == mapNodeCount);
+        REQUIRE(territory.getOwnerIndexes().size() == mapNodeCount);
+        REQUIRE(territory.getFactions().size() == 2);
+
+        REQUIRE(territory.getOwner(west) == westFaction);
+        REQUIRE(territory.getSettlement(west) == westSettlement);
+        REQUIRE(territory.getDistance(west) == 0);
+
+        core::MapNode* westOfCenter = center->getNeighbour(core::Direction::West);
+        core::MapNode* eastOfCenter = center->getNeighbour(core::Direction::East);
+
+        REQUIRE(territory.getOwner(westOfCenter) == westFaction);
+        REQUIRE(territory.getDistance(westOfCenter) == 3);
+        REQUIRE(territory.getOwner(eastOfCenter) == eastFaction);
+        REQUIRE(territory.getDistance(center) == 4);
+
+        // The center is claimed by one of them, there is a border between
+        // it and the other side.
+        const core::Direction otherSide =
+            territory.getOwner(center) == westFaction ? core::Direction::East : core::Direction::West;
+        REQUIRE(territory.isBorder(center, otherSide));
+        REQUIRE(!territory.isBorder(westOfCenter, core::Direction::West));
+
+        const auto borders = territory.getBorders();
+        REQUIRE(!borders.empty());
+        for (const auto& border : borders)
+        {
+            REQUIRE(territory.getOwner(border.mapNode) != nullptr);
+            REQUIRE(territory.getOwner(border.mapNode) !=
+                territory.getOwner(border.mapNode->getNeighbour(border.direction)));
+        }
+    }
+
+    SECTION("Maximum distance")
+    {
+        territory.setMaxDistance(2);
+        REQUIRE(territory.getMaxDistance() == 2);
+
+        REQUIRE(territory.getMapNodes(westFaction).size() == 19);
+        REQUIRE(territory.getMapNodes(eastFaction).size() == 19);
+        REQUIRE(territory.getOwner(center) == nullptr);
+        REQUIRE(territory.getSettlement(center) == nullptr);
+        REQUIRE(territory.getDistance(center) == -1);
+
+        core::MapNode* edge = core::walk(west, core::Direction::East, 2);
+        REQUIRE(territory.getOwner(edge) == westFaction);
+        REQUIRE(territory.isBorder(edge, core::Direction::East));
+    }
+
+    SECTION("Settlement changes")
+    {
+        eastSettlement->setOwner(westFaction);
+        territory.updateSettlements();
+        REQUIRE(territory.getMapNodes(westFaction).size() == map.getMapNodes().size());
+        REQUIRE(territory.getMapNodes(eastFaction).empty());
+        REQUIRE(territory.getBorders().empty());
+
+        eastSettlement->setOwner(eastFaction);
+        eastSettlement->setPosition(core::walk(center, core::Direction::East, 8));
+        territory.updateSettlements();
+        REQUIRE(territory.getOwner(center) == westFaction);
+        REQUIRE(territory.getOwner(east) == eastFaction);
+        REQUIRE(territory.getDistance(east) == 4);
+
+        eastSettlement->setOwner(nullptr);
+        territory.updateSettlements();
+        REQUIRE(territory.getOwner(east) == nullptr);
+        REQUIRE(territory.getSettlement(east) == eastSettlement);
+
+        eastSettlement->setPosition(nullptr);
+        territory.updateSettlements();
+        REQUIRE(territory.getMapNodes(westFaction).size() == map.getMapNodes().size());
+    }
+
+    SECTION("Removed map-node")
+    {
+        std::unique_ptr<core::MapNode> removed = map.removeMapNode(east);
+        REQUIRE(eastSettlement->getPosition() == east);
+
+        REQUIRE_NOTHROW(territory.rebuild());
+        REQUIRE(territory.getMapNodes(westFaction).size() == map.getMapNodes().size());
+        REQUIRE(territory.getMapNodes(eastFaction).empty());
+        REQUIRE(territory.getSettlement(east) == nullptr);
+
+        eastSettlement->setPosition(center);
+        territory.updateSettlements();
+        REQUIRE(territory.getOwner(center) == eastFaction);
+
+        eastSettlement->setPosition(east);
+        REQUIRE_NOTHROW(territory.updateSettlements());
+        REQUIRE(territory.getMapNodes(westFaction).size() == map.getMapNodes().size());
+    }
+}
@@ -0,0 +1,159 @@
+/**
+ * Copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include "core/HexGrid.h"
+#include "core/Map.h"
+#include "core/Settlement.h"
+#include "core/Visibility.h"
+#include "utils/Exception.h"
+#include <catch.hpp>
+
+using namespace warmonger;
+
+TEST_CASE("Visibility", "[Visibility]")
+{
+    core::Map map;
+    map.generateMapNodes(10);
+
+    core::MapNode* center = map.getMapNodes()[0];
+    core::MapNode* east = center->getNeighbour(core::Direction::East);
+
+    core::Faction* faction = map.createFaction();
+    core::Faction* otherFaction = map.createFaction();
+
+    core::Settlement* settlement = map.createSettlement();
+    settlement->setType("town");
+    settlement->setPosition(center);
+    settlement->setOwner(faction);
+
+    core::Visibility visibility(map);
+
+    SECTION("Sight range")
+    {
+        REQUIRE(visibility.getSightRange("town") == 2);
+        REQUIRE(visibility.getVisibleCount(faction) == 19);
+        REQUIRE(visibility.getVisibleMapNodes(faction).size() == 19);
+        REQUIRE(visibility.isVisible(faction, center));
+        REQUIRE(!visibility.isVisible(faction, core::walk(center, core::Direction::East, 3)));
+        REQUIRE(visibility.getVisibleCount(otherFaction) == 0);
+        REQUIRE(!visibility.isVisible(otherFaction, center));
+
+        visibility.setSightRange("town", 3);
+        REQUIRE(visibility.getVisibleCount(faction) == 37);
+        REQUIRE(visibility.isVisible(faction, core::walk(center, core::Direction::East, 3)));
+
+        REQUIRE_THROWS_AS(visibility.setSightRange("town", -1), utils::ValueError);
+    }
+
+    SECTION("Sight blocking")
+    {
+        visibility.setSightRange("town", 3);
+
+        east->setTerrainType("mountains");
+        visibility.setSightBlocking("mountains", true);
+        REQUIRE(visibility.isSightBlocking("mountains"));
+
+        REQUIRE(visibility.getVisibleCount(faction) == 33);
+        REQUIRE(visibility.isVisible(faction, east));
+        REQUIRE(!visibility.isVisible(faction, core::walk(center, core::Direction::East, 2)));
+        REQUIRE(!visibility.isVisible(faction, core::walk(center, core::Direction::East, 3)));
+
+        for (const auto& neighbour : center->getNeighbours())
+        {
+            neighbour.second->setTerrainType("mountains");
+            visibility.updateTerrainType(neighbour.second);
+        }
+        REQUIRE(visibility.getVisibleCount(faction) == 7);
+
+        for (const auto& neighbour : center->getNeighbours())
+        {
+            neighbour.second->setTerrainType("grassland");
+            visibility.updateTerrainType(neighbour.second);
+        }
+        REQUIRE(visibility.getVisibleCount(faction) == 37);
+    }
+
+    SECTION("Settlement changes")
+    {
+        visibility.setSightRange("town", 3);
+
+        settlement->setPosition(core::walk(center, core::Direction::East, 5));
+        visibility.updateSettlements();
+        REQUIRE(visibility.getVisibleCount(faction) == 37);
+        REQUIRE(!visibility.isVisible(faction, center));
+        REQUIRE(visibility.isVisible(faction, core::walk(center, core::Direction::East, 8)));
+
+        settlement->setOwner(otherFaction);
+        visibility.updateSettlements();
+        REQUIRE(visibility.getVisibleCount(faction) == 0);
+        REQUIRE(visibility.getVisibleCount(otherFaction) == 37);
+
+        settlement->setOwner(nullptr);
+        visibility.updateSettlements();
+        REQUIRE(visibility.getVisibleCount(otherFaction) == 0);
+    }
+
+    SECTION("Sources")
+    {
+        visibility.setSightRange("town", 3);
+        settlement->setPosition(core::walk(center, core::Direction::East, 5));
+        visibility.updateSettlements();
+
+        const auto source = visibility.addSource(faction, core::walk(center, core::Direction::West, 5), 1);
+        REQUIRE(visibility.getVisibleCount(faction) == 44);
+
+        // Fully overlaps with the settlement's field-of-view.
+        visibility.moveSource(source, core::walk(center, core::Direction::East, 4));
+        REQUIRE(visibility.getVisibleCount(faction) == 37);
+
+        visibility.removeSource(source);
+        REQUIRE(visibility.getVisibleCount(faction) == 37);
+
+        REQUIRE_THROWS_AS(visibility.removeSource(source), utils::ValueError);
+        REQUIRE_THROWS_AS(visibility.addSource(faction, center, -1), utils::ValueError);
+    }
+
+    SECTION("Map-node not on the map")
+    {
+        core::Map otherMap;
+        otherMap.generateMapNodes(1);
+
+        REQUIRE(!visibility.isVisible(faction, otherMap.getMapNodes()[0]));
+        REQUIRE_THROWS_AS(visibility.addSource(faction, otherMap.getMapNodes()[0], 1), utils::ValueError);
+    }
+
+    SECTION("Removed map-node")
+    {
+        core::MapNode* position = core::walk(center, core::Direction::East, 5);
+        settlement->setPosition(position);
+        visibility.updateSettlements();
+
+        std::unique_ptr<core::MapNode> removed = map.removeMapNode(position);
+        REQUIRE(settlement->getPosition() == position);
+
+        REQUIRE_NOTHROW(visibility.rebuild());
+        REQUIRE(visibility.getVisibleCount(faction) == 0);
+
+        settlement->setPosition(center);
+        visibility.updateSettlements();
+        REQUIRE(visibility.getVisibleCount(faction) == 19);
+
+        settlement->setPosition(position);
+        REQUIRE_NOTHROW(visibility.updateSettlements());
+        REQUIRE(visibility.getVisibleCount(faction) == 0);
+    }
+}
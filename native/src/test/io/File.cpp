@@ -0,0 +1,116 @@
+/**
+ * Copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <QFile>
+#include <QTemporaryDir>
+#include <catch.hpp>
+
+#include "core/Map.h"
+#include "io/File.h"
+#include "io/JsonSerializer.h"
+#include "utils/Exception.h"
+
+using namespace warmonger;
+
+static QByteArray readAll(const QString& path);
+static void writeAll(const QString& path, const QByteArray& data);
+
+TEST_CASE("Compressed map files", "[File]")
+{
+    core::World world("uuid", core::WorldRules::Type::Lua);
+
+    core::Map map;
+    map.setName("The undiscovered map");
+    map.setWorld(&world);
+    // large enough to span several compressed chunks
+    map.generateMapNodes(64);
+
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+
+    const QString path = dir.filePath("map.wmd");
+    const QString compressedPath = dir.filePath("map-compressed.wmd");
+
+    io::writeMap(&map, path);
+    io::writeMap(&map, compressedPath, io::Compression::Zlib);
+
+    const io::JsonSerializer serializer;
+    const QByteArray json = serializer.serialize(map.serialize());
+
+    SECTION("Compressed file is smaller")
+    {
+        REQUIRE(readAll(path) == json);
+        REQUIRE(readAll(compressedPath).size() * 4 < json.size());
+    }
+
+    SECTION("Compression is detected on read")
+    {
+        REQUIRE(serializer.serialize(io::readMap(path, &world)->serialize()) == json);
+        REQUIRE(serializer.serialize(io::readMap(compressedPath, &world)->serialize()) == json);
+    }
+
+    SECTION("Truncated compressed file")
+    {
+        const QByteArray compressed = readAll(compressedPath);
+        writeAll(compressedPath, compressed.left(compressed.size() - 16));
+
+        REQUIRE_THROWS_AS(io::readMap(compressedPath, &world), utils::IOError);
+    }
+
+    SECTION("Corrupt compressed file")
+    {
+        QByteArray compressed = readAll(compressedPath);
+        compressed[compressed.size() / 2] = ~compressed[compressed.size() / 2];
+        writeAll(compressedPath, compressed);
+
+        REQUIRE_THROWS_AS(io::readMap(compressedPath, &world), utils::IOError);
+    }
+
+    SECTION("Implausible decompressed size")
+    {
+        QByteArray compressed = readAll(compressedPath);
+
+        // Beyond what a QByteArray can hold, and beyond what deflate can
+        // achieve with the compressed data at hand.
+        for (const quint64 size : {quint64(1) << 40, static_cast<quint64>(compressed.size()) * 2000})
+        {
+            // The size follows the magic and the version, big-endian.
+            for (int i = 0; i < 8; ++i)
+                compressed[12 + i] = static_cast<char>((size >> (56 - 8 * i)) & 0xff);
+
+            writeAll(compressedPath, compressed);
+
+            REQUIRE_THROWS_AS(io::readMap(compressedPath, &world), utils::IOError);
+        }
+    }
+}
+
+static QByteArray readAll(const QString& path)
+{
+    QFile file(path);
+    REQUIRE(file.open(QIODevice::ReadOnly));
+
+    return file.readAll();
+}
+
+static void writeAll(const QString& path, const QByteArray& data)
+{
+    QFile file(path);
+    REQUIRE(file.open(QIODevice::WriteOnly));
+    REQUIRE(file.write(data) == data.size());
+}
@@ -0,0 +1,180 @@
+/**
+ * Copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <QFile>
+#include <QTemporaryDir>
+#include <catch.hpp>
+
+#include "core/Map.h"
+#include "core/Settlement.h"
+#include "io/File.h"
+#include "io/IncrementalMapWriter.h"
+#include "io/JsonSerializer.h"
+
+using namespace warmonger;
+
+static QByteArray serializeMap(const core::Map& map);
+
+TEST_CASE("Map saved incrementally", "[IncrementalMapWriter]")
+{
+    core::World world("uuid", core::WorldRules::Type::Lua);
+    auto* civilization = world.createCivilization("Persians");
+    auto* banner = world.createBanner("Striped");
+    auto* color = world.createColor("Red");
+
+    core::Map map;
+    map.setName("The undiscovered map");
+    map.setWorld(&world);
+    map.generateMapNodes(4);
+
+    auto* faction = map.createFaction();
+    faction->setName("The Achmeid Empire");
+    faction->setCivilization(civilization);
+    faction->setBanner(banner);
+    faction->setPrimaryColor(color);
+
+    auto* settlement = map.createSettlement();
+    settlement->setType("city");
+    settlement->setPosition(map.getMapNodes()[3]);
+    settlement->setOwner(faction);
+
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+
+    const QString path = dir.filePath("map.wmd");
+    const QString logPath = io::mapDeltaLogPath(path);
+
+    io::IncrementalMapWriter writer(map, path);
+    writer.save();
+
+    SECTION("The first save writes the base")
+    {
+        REQUIRE(QFile::exists(path));
+        REQUIRE(!QFile::exists(logPath));
+        REQUIRE(serializeMap(*io::readMap(path, &world)) == serializeMap(map));
+    }
+
+    SECTION("Changes are appended to the log")
+    {
+        map.setName("The discovered map");
+        faction->setName("The Persian Empire");
+
+        auto* newSettlement = map.createSettlement();
+        newSettlement->setType("village");
+        newSettlement->setPosition(map.getMapNodes()[5]);
+        newSettlement->setOwner(faction);
+
+        map.removeSettlement(settlement);
+
+        auto* mapNode = map.getMapNodes()[7];
+        for (core::MapNode* neighbour : map.getMapNodes())
+        {
+            for (const core::Direction direction : core::directions)
+            {
+                if (neighbour->getNeighbour(direction) == mapNode)
+                    neighbour->setNeighbour(direction, nullptr);
+            }
+        }
+        map.removeMapNode(mapNode);
+
+        const QByteArray base = [&path] {
+            QFile file(path);
+            file.open(QIODevice::ReadOnly);
+            return file.readAll();
+        }();
+
+        writer.save();
+
+        REQUIRE(QFile::exists(logPath));
+        REQUIRE(writer.getLogSize() > 0);
+        REQUIRE(writer.getLogSize() < base.size());
+
+        // the base is left untouched
+        QFile file(path);
+        REQUIRE(file.open(QIODevice::ReadOnly));
+        REQUIRE(file.readAll() == base);
+
+        REQUIRE(serializeMap(*io::readMap(path, &world)) == serializeMap(map));
+    }
+
+    SECTION("Saving without changes")
+    {
+        writer.save();
+
+        REQUIRE(!QFile::exists(logPath));
+    }
+
+    SECTION("Objects are saved in order")
+    {
+        for (int i = 0; i < 8; ++i)
+            map.createFaction()->setName(QString("Faction %1").arg(i));
+
+        writer.save();
+
+        REQUIRE(serializeMap(*io::readMap(path, &world)) == serializeMap(map));
+    }
+
+    SECTION("Compaction")
+    {
+        writer.setCompactionRatio(0.0);
+
+        faction->setName("The Persian Empire");
+        writer.save();
+
+        REQUIRE(writer.getLogSize() > 0);
+
+        settlement->setType("village");
+        writer.save();
+
+        REQUIRE(writer.getLogSize() == 0);
+        REQUIRE(!QFile::exists(logPath));
+        REQUIRE(serializeMap(*io::readMap(path, &world)) == serializeMap(map));
+    }
+
+    SECTION("Truncated last record is ignored")
+    {
+        map.setName("The discovered map");
+        writer.save();
+
+        QFile log(logPath);
+        REQUIRE(log.open(QIODevice::WriteOnly | QIODevice::Append));
+        REQUIRE(log.write(QByteArray("\x00\x00\x10\x00{\"gen", 9)) == 9);
+        log.close();
+
+        REQUIRE(io::readMap(path, &world)->getName() == "The discovered map");
+    }
+
+    SECTION("Log of another generation is ignored")
+    {
+        map.setName("The discovered map");
+        writer.save();
+
+        map.setName("The forgotten map");
+        io::writeMap(&map, path);
+
+        REQUIRE(QFile::exists(logPath));
+        REQUIRE(io::readMap(path, &world)->getName() == "The forgotten map");
+    }
+}
+
+static QByteArray serializeMap(const core::Map& map)
+{
+    const io::JsonSerializer serializer;
+
+    return serializer.serialize(map.serialize());
+}
@@ -0,0 +1,102 @@
+/**
+ * Copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <QTemporaryDir>
+#include <catch.hpp>
+
+#include "core/Map.h"
+#include "core/MapSnapshot.h"
+#include "core/Settlement.h"
+#include "io/File.h"
+#include "io/JsonSerializer.h"
+#include "io/MapSaver.h"
+
+using namespace warmonger;
+
+TEST_CASE("Map saved in the background", "[MapSaver]")
+{
+    core::World world("uuid", core::WorldRules::Type::Lua);
+    auto* civilization = world.createCivilization("Persians");
+    auto* banner = world.createBanner("Striped");
+    auto* color = world.createColor("Red");
+
+    core::Map map;
+    map.setName("The undiscovered map");
+    map.setWorld(&world);
+    map.generateMapNodes(8);
+
+    auto* faction = map.createFaction();
+    faction->setName("The Achmeid Empire");
+    faction->setCivilization(civilization);
+    faction->setBanner(banner);
+    faction->setPrimaryColor(color);
+
+    auto* settlement = map.createSettlement();
+    settlement->setType("city");
+    settlement->setPosition(map.getMapNodes()[3]);
+    settlement->setOwner(faction);
+
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+
+    SECTION("Snapshot serialized as the map")
+    {
+        const io::JsonSerializer serializer;
+
+        REQUIRE(serializer.serialize(core::MapSnapshot(map).serialize()) == serializer.serialize(map.serialize()));
+    }
+
+    SECTION("Saving")
+    {
+        const QString path = dir.filePath("map.wmd");
+
+        io::MapSaver saver;
+        saver.save(map, path);
+
+        // Changes after the save request are not part of the save.
+        map.setName("The discovered map");
+
+        saver.waitForSaves();
+
+        auto savedMap = io::readMap(path, &world);
+
+        REQUIRE(savedMap->getName() == "The undiscovered map");
+        REQUIRE(savedMap->getMapNodes().size() == map.getMapNodes().size());
+        REQUIRE(savedMap->getFactions().size() == 1);
+        REQUIRE(savedMap->getSettlements().size() == 1);
+        REQUIRE(savedMap->getSettlements()[0]->getPosition()->getId() == map.getMapNodes()[3]->getId());
+        REQUIRE(savedMap->getSettlements()[0]->getOwner()->getId() == faction->getId());
+    }
+
+    SECTION("Saving fails")
+    {
+        const QString path = dir.filePath("nonexistent/map.wmd");
+
+        bool failed = false;
+
+        io::MapSaver saver;
+        QObject::connect(&saver, &io::MapSaver::saveFailed, [&failed](const QString&, const QString&) {
+            failed = true;
+        });
+
+        saver.save(map, path);
+        saver.waitForSaves();
+
+        REQUIRE(failed);
+    }
+}
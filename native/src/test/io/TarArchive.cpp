@@ -0,0 +1,144 @@
+/**
+ * Copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include <QTemporaryFile>
+#include <catch.hpp>
+
+#include "io/TarArchive.h"
+#include "utils/Exception.h"
+
+using namespace warmonger;
+
+static void appendEntry(QByteArray& archive, const QByteArray& name, const QByteArray& data, char type = '0')
+{
+    QByteArray header(512, '\0');
+
+    std::memcpy(header.data(), name.constData(), std::min(name.size(), 100));
+    std::memcpy(header.data() + 100, "0000644", 7);
+    std::memcpy(header.data() + 124, QByteArray::number(data.size(), 8).rightJustified(11, '0').constData(), 11);
+    header[156] = type;
+    std::memcpy(header.data() + 257, "ustar", 6);
+    std::memcpy(header.data() + 263, "00", 2);
+
+    // checksum, computed with the checksum field filled with spaces
+    std::memset(header.data() + 148, ' ', 8);
+    unsigned checksum{0};
+    for (char c : header)
+        checksum += static_cast<unsigned char>(c);
+    std::memcpy(header.data() + 148, QByteArray::number(checksum, 8).rightJustified(6, '0').constData(), 6);
+
+    archive.append(header);
+    archive.append(data);
+    archive.append(QByteArray((512 - data.size() % 512) % 512, '\0'));
+}
+
+static void writeArchive(QTemporaryFile& file, QByteArray archive)
+{
+    archive.append(QByteArray(1024, '\0'));
+
+    REQUIRE(file.open());
+    REQUIRE(file.write(archive) == archive.size());
+    file.close();
+}
+
+TEST_CASE("Reading tar archive", "[TarArchive]")
+{
+    QTemporaryFile file;
+
+    SECTION("Regular entries")
+    {
+        QByteArray archive;
+        appendEntry(archive, "surface.wsm", "{\"name\": \"surface\"}");
+        appendEntry(archive, "./surface.rcc", QByteArray(1000, 'x'));
+        appendEntry(archive, "dir/", QByteArray(), '5');
+        appendEntry(archive, "dir/nested", "nested");
+        writeArchive(file, archive);
+
+        const io::TarArchive tar(file.fileName());
+
+        REQUIRE(tar.getEntries().size() == 3);
+
+        const auto* wsm = tar.findEntry("surface.wsm");
+        REQUIRE(wsm != nullptr);
+        REQUIRE(QByteArray(reinterpret_cast<const char*>(wsm->data), wsm->size) == "{\"name\": \"surface\"}");
+
+        const auto* rcc = tar.findEntry("surface.rcc");
+        REQUIRE(rcc != nullptr);
+        REQUIRE(rcc->size == 1000);
+        REQUIRE(QByteArray(reinterpret_cast<const char*>(rcc->data), rcc->size) == QByteArray(1000, 'x'));
+
+        REQUIRE(tar.findEntry("dir/nested") != nullptr);
+        REQUIRE(tar.findEntry("dir/") == nullptr);
+        REQUIRE(tar.findEntry("nonexistent") == nullptr);
+    }
+
+    SECTION("GNU long name")
+    {
+        const QByteArray longName = QByteArray(150, 'n') + ".rcc";
+
+        QByteArray archive;
+        appendEntry(archive, "././@LongLink", longName + '\0', 'L');
+        appendEntry(archive, longName.left(100), "data");
+        writeArchive(file, archive);
+
+        const io::TarArchive tar(file.fileName());
+
+        REQUIRE(tar.getEntries().size() == 1);
+        REQUIRE(tar.findEntry(QString::fromUtf8(longName)) != nullptr);
+    }
+
+    SECTION("pax path")
+    {
+        const QByteArray longName = QByteArray(150, 'p') + ".rcc";
+        const QByteArray record = "path=" + longName + "\n";
+        // the length includes itself and the separating space
+        const QByteArray paxRecord = QByteArray::number(record.size() + 4) + " " + record;
+
+        QByteArray archive;
+        appendEntry(archive, "PaxHeader", paxRecord, 'x');
+        appendEntry(archive, longName.left(100), "data");
+        writeArchive(file, archive);
+
+        const io::TarArchive tar(file.fileName());
+
+        REQUIRE(tar.findEntry(QString::fromUtf8(longName)) != nullptr);
+    }
+
+    SECTION("Not a tar archive")
+    {
+        writeArchive(file, QByteArray(2048, 'z'));
+
+        REQUIRE_THROWS_AS(io::TarArchive(file.fileName()), utils::IOError);
+    }
+
+    SECTION("Truncated")
+    {
+        QByteArray archive;
+        appendEntry(archive, "surface.rcc", QByteArray(1000, 'x'));
+        archive.truncate(700);
+
+        REQUIRE(file.open());
+        file.write(archive);
+        file.close();
+
+        REQUIRE_THROWS_AS(io::TarArchive(file.fileName()), utils::IOError);
+    }
+}
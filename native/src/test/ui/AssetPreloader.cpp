@@ -0,0 +1,95 @@
+/**
+ * Copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <vector>
+
+#include "ui/AssetPreloader.h"
+#include "utils/Exception.h"
+#include <catch.hpp>
+
+using namespace warmonger;
+
+static std::vector<QString> makePaths(int n)
+{
+    std::vector<QString> paths;
+    for (int i = 0; i < n; ++i)
+        paths.push_back(QString("asset%1.png").arg(i));
+    return paths;
+}
+
+TEST_CASE("AssetPreloader loads all assets", "[AssetPreloader]")
+{
+    const auto paths = makePaths(100);
+
+    std::mutex mutex;
+    std::set<QString> loaded;
+    std::atomic<int> lastProgress(0);
+    std::atomic<bool> totalMatches(true);
+
+    ui::AssetPreloader preloader(paths,
+        [&](const QString& path) {
+            std::lock_guard<std::mutex> lock(mutex);
+            loaded.insert(path);
+        },
+        [&](int n, int total) {
+            if (total != 100)
+                totalMatches = false;
+            if (n == total)
+                lastProgress = n;
+        },
+        4);
+
+    preloader.wait();
+
+    REQUIRE(preloader.getTotalCount() == 100);
+    REQUIRE(preloader.isDone());
+    REQUIRE(totalMatches);
+    REQUIRE(loaded.size() == paths.size());
+    REQUIRE(lastProgress == 100);
+}
+
+TEST_CASE("AssetPreloader tolerates failing assets", "[AssetPreloader]")
+{
+    std::atomic<int> progress(0);
+
+    ui::AssetPreloader preloader(makePaths(10),
+        [](const QString& path) {
+            if (path == "asset3.png")
+                throw utils::ValueError("Failed to load image");
+            if (path == "asset5.png")
+                throw std::runtime_error("Out of memory");
+        },
+        [&](int, int) { ++progress; },
+        2);
+
+    preloader.wait();
+
+    REQUIRE(progress == 10);
+}
+
+TEST_CASE("AssetPreloader with no assets", "[AssetPreloader]")
+{
+    ui::AssetPreloader preloader({}, [](const QString&) {}, [](int, int) {});
+
+    REQUIRE(preloader.getTotalCount() == 0);
+    REQUIRE(preloader.isDone());
+}
@@ -0,0 +1,150 @@
+/**
+ * Copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <QColor>
+#include <QImage>
+#include <QObject>
+
+#include "ui/Banner.h"
+#include <catch.hpp>
+
+using namespace warmonger;
+
+static QImage createImage(int width, int height, QRgb color);
+
+TEST_CASE("Recolor", "[Banner]")
+{
+    const QRgb foregroundPlaceholder{QColor("black").rgba()};
+    const QRgb backgroundPlaceholder{QColor("white").rgba()};
+    const QRgb foreground{QColor("red").rgba()};
+    const QRgb background{QColor("blue").rgba()};
+    const QRgb other{QColor("green").rgba()};
+
+    QImage image(3, 2, QImage::Format_ARGB32);
+    image.setPixel(0, 0, foregroundPlaceholder);
+    image.setPixel(1, 0, backgroundPlaceholder);
+    image.setPixel(2, 0, other);
+    image.setPixel(0, 1, qRgba(0, 0, 0, 128));
+    image.setPixel(1, 1, backgroundPlaceholder);
+    image.setPixel(2, 1, foregroundPlaceholder);
+
+    ui::recolor(image, foregroundPlaceholder, foreground, backgroundPlaceholder, background);
+
+    REQUIRE(image.pixel(0, 0) == foreground);
+    REQUIRE(image.pixel(1, 0) == background);
+    REQUIRE(image.pixel(2, 0) == other);
+    REQUIRE(image.pixel(0, 1) == qRgba(0, 0, 0, 128));
+    REQUIRE(image.pixel(1, 1) == background);
+    REQUIRE(image.pixel(2, 1) == foreground);
+}
+
+TEST_CASE("BannerImageCache", "[Banner]")
+{
+    ui::BannerImageCache cache(1024 * 1024);
+    QObject worldSurface;
+
+    int created{0};
+    const auto create = [&created]() {
+        ++created;
+        return createImage(8, 8, QColor("red").rgba());
+    };
+
+    const ui::BannerImageCache::Key key{&worldSurface, "banner", "red", "blue", QSize(16, 16)};
+
+    SECTION("Hit")
+    {
+        const QImage image = cache.get(key, create);
+
+        REQUIRE(created == 1);
+        REQUIRE(image.size() == QSize(16, 16));
+
+        REQUIRE(cache.get(key, create) == image);
+        REQUIRE(created == 1);
+
+        const auto stats = cache.getStats();
+        REQUIRE(stats.hits == 1);
+        REQUIRE(stats.misses == 1);
+        REQUIRE(stats.entries == 1);
+    }
+
+    SECTION("Keyed on names and size")
+    {
+        cache.get(key, create);
+        cache.get({&worldSurface, "banner", "red", "blue", QSize(32, 32)}, create);
+        cache.get({&worldSurface, "banner", "blue", "red", QSize(16, 16)}, create);
+        cache.get({&worldSurface, "other", "red", "blue", QSize(16, 16)}, create);
+
+        REQUIRE(created == 4);
+
+        // Equal names hit, regardless of which objects they came from.
+        cache.get({&worldSurface, QString("ban") + "ner", "red", "blue", QSize(16, 16)}, create);
+        REQUIRE(created == 4);
+        REQUIRE(cache.getStats().entries == 4);
+    }
+
+    SECTION("Forget world-surface")
+    {
+        QObject otherWorldSurface;
+
+        cache.get(key, create);
+        cache.get({&otherWorldSurface, "banner", "red", "blue", QSize(16, 16)}, create);
+        REQUIRE(cache.getStats().entries == 2);
+
+        {
+            QObject destroyedWorldSurface;
+            cache.get({&destroyedWorldSurface, "banner", "red", "blue", QSize(16, 16)}, create);
+            REQUIRE(cache.getStats().entries == 3);
+        }
+
+        REQUIRE(cache.getStats().entries == 2);
+
+        cache.forget(&otherWorldSurface);
+        REQUIRE(cache.getStats().entries == 1);
+
+        cache.get(key, create);
+        REQUIRE(created == 3);
+    }
+
+    SECTION("Budget")
+    {
+        // Each 16x16 ARGB32 image takes 1 KiB.
+        ui::BannerImageCache smallCache(2 * 1024);
+
+        smallCache.get({&worldSurface, "a", "red", "blue", QSize(16, 16)}, create);
+        smallCache.get({&worldSurface, "b", "red", "blue", QSize(16, 16)}, create);
+        smallCache.get({&worldSurface, "a", "red", "blue", QSize(16, 16)}, create);
+        smallCache.get({&worldSurface, "c", "red", "blue", QSize(16, 16)}, create);
+
+        const auto stats = smallCache.getStats();
+        REQUIRE(created == 3);
+        REQUIRE(stats.entries == 2);
+        REQUIRE(stats.evictions == 1);
+
+        // "b" was the least recently used.
+        smallCache.get({&worldSurface, "a", "red", "blue", QSize(16, 16)}, create);
+        REQUIRE(created == 3);
+        smallCache.get({&worldSurface, "b", "red", "blue", QSize(16, 16)}, create);
+        REQUIRE(created == 4);
+    }
+}
+
+static QImage createImage(int width, int height, QRgb color)
+{
+    QImage image(width, height, QImage::Format_ARGB32);
+    image.fill(color);
+    return image;
+}
@@ -0,0 +1,87 @@
+/**
+ * Copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "ui/WorldSurfaceRules.h"
+#include "utils/Exception.h"
+#include <catch.hpp>
+
+using namespace warmonger;
+
+TEST_CASE("Building the graphic-map", "[graphics::Map]")
+{
+    ui::graphics::Map map;
+
+    auto mapNode0 = reinterpret_cast<core::MapNode*>(0x10);
+    auto mapNode1 = reinterpret_cast<core::MapNode*>(0x20);
+
+    SECTION("Empty")
+    {
+        REQUIRE(map.mapNodes.empty());
+        REQUIRE(map.layers.empty());
+        REQUIRE(map.gridTiles.empty());
+    }
+
+    SECTION("Adding layer without map-node")
+    {
+        REQUIRE_THROWS_AS(map.beginLayer(), utils::ValueError);
+    }
+
+    SECTION("Adding grid-tile without layer")
+    {
+        REQUIRE_THROWS_AS(map.addGridTile(ui::graphics::GridTile{0, 0, 1, 1, 0}), utils::ValueError);
+
+        map.beginMapNode(mapNode0);
+
+        REQUIRE_THROWS_AS(map.addGridTile(ui::graphics::GridTile{0, 0, 1, 1, 0}), utils::ValueError);
+    }
+
+    SECTION("Ranges")
+    {
+        const ui::graphics::GridTile gridTiles[] = {{0, 0, 1, 1, 3}, {1, 0, 1, 1, 4}, {0, 1, 2, 1, 5}};
+
+        map.beginMapNode(mapNode0);
+        map.beginLayer();
+        map.addGridTile(gridTiles[0]);
+        map.beginLayer();
+        map.addGridTiles(&gridTiles[1], 2);
+
+        map.beginMapNode(mapNode1);
+        map.beginLayer();
+
+        REQUIRE(map.mapNodes.size() == 2);
+        REQUIRE(map.layers.size() == 3);
+        REQUIRE(map.gridTiles.size() == 3);
+
+        REQUIRE(map.mapNodes[0].mapNode == mapNode0);
+        REQUIRE(map.mapNodes[0].layers.begin == 0);
+        REQUIRE(map.mapNodes[0].layers.end == 2);
+
+        REQUIRE(map.layers[0].begin == 0);
+        REQUIRE(map.layers[0].end == 1);
+        REQUIRE(map.layers[1].begin == 1);
+        REQUIRE(map.layers[1].end == 3);
+
+        REQUIRE(map.gridTiles[2].width == 2);
+        REQUIRE(map.gridTiles[2].assetId == 5);
+
+        REQUIRE(map.mapNodes[1].mapNode == mapNode1);
+        REQUIRE(map.mapNodes[1].layers.begin == 2);
+        REQUIRE(map.mapNodes[1].layers.end == 3);
+        REQUIRE(map.layers[2].size() == 0);
+    }
+}
@@ -0,0 +1,115 @@
+/**
+ * Copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#include <QImage>
+
+#include "ui/HexMask.h"
+#include <catch.hpp>
+
+using namespace warmonger;
+
+static QImage makeMaskImage(int size)
+{
+    QImage image(size, size, QImage::Format_ARGB32);
+    image.fill(0);
+
+    // A crude diamond, good enough to have an irregular shape.
+    const int half = size / 2;
+    for (int y = 0; y < size; ++y)
+    {
+        for (int x = 0; x < size; ++x)
+        {
+            if (std::abs(x - half) + std::abs(y - half) < half)
+                image.setPixel(x, y, 0xffffffff);
+        }
+    }
+
+    return image;
+}
+
+TEST_CASE("Empty HexMask", "[HexMask]")
+{
+    const ui::HexMask mask;
+
+    REQUIRE(mask.getWidth() == 0);
+    REQUIRE(mask.getHeight() == 0);
+    REQUIRE(!mask.contains(0, 0));
+    REQUIRE(!mask.contains(QPointF(0.0, 0.0)));
+}
+
+TEST_CASE("HexMask matches the image", "[HexMask]")
+{
+    // 70 is deliberately not a multiple of 64
+    const int size = 70;
+    const QImage image = makeMaskImage(size);
+    const ui::HexMask mask(image);
+
+    REQUIRE(mask.getWidth() == size);
+    REQUIRE(mask.getHeight() == size);
+
+    SECTION("Pixels")
+    {
+        for (int y = 0; y < size; ++y)
+        {
+            for (int x = 0; x < size; ++x)
+            {
+                REQUIRE(mask.contains(x, y) == (image.pixel(x, y) == 0xffffffff));
+            }
+        }
+    }
+
+    SECTION("Out of bounds")
+    {
+        REQUIRE(!mask.contains(-1, size / 2));
+        REQUIRE(!mask.contains(size / 2, -1));
+        REQUIRE(!mask.contains(size, size / 2));
+        REQUIRE(!mask.contains(size / 2, size));
+        REQUIRE(!mask.contains(QPointF(-0.5, size / 2)));
+        REQUIRE(!mask.contains(QPointF(size / 2, size + 0.5)));
+    }
+
+    SECTION("Fractional points")
+    {
+        REQUIRE(mask.contains(QPointF(size / 2 + 0.5, size / 2 + 0.5)));
+        REQUIRE(!mask.contains(QPointF(0.5, 0.5)));
+    }
+
+    SECTION("Batch")
+    {
+        std::vector<QPoint> points;
+        for (int y = -2; y < size + 2; ++y)
+        {
+            for (int x = -2; x < size + 2; ++x)
+            {
+                points.emplace_back(x, y);
+            }
+        }
+
+        std::unique_ptr<bool[]> results(new bool[points.size()]);
+        mask.contains(points.data(), points.size(), results.get());
+
+        for (std::size_t i = 0; i < points.size(); ++i)
+        {
+            REQUIRE(results[i] == mask.contains(points[i]));
+        }
+    }
+}
@@ -0,0 +1,85 @@
+/**
+ * Copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <QFile>
+#include <QTemporaryDir>
+
+#include "ui/ImageCacheFile.h"
+#include "utils/Exception.h"
+#include <catch.hpp>
+
+using namespace warmonger;
+
+static QImage makeImage(int width, int height, QImage::Format format)
+{
+    QImage image(width, height, format);
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+            image.setPixel(x, y, qRgba(x * 7, y * 13, x + y, 128));
+    }
+    return image;
+}
+
+TEST_CASE("ImageCacheFile round-trip", "[ImageCacheFile]")
+{
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+
+    const QString path = dir.path() + "/images.wic";
+
+    ui::ImageCacheFile::Images images{{"a.png", makeImage(13, 7, QImage::Format_ARGB32_Premultiplied)},
+        {"dir/b.png", makeImage(64, 64, QImage::Format_ARGB32)}};
+
+    ui::ImageCacheFile::write(path, images);
+
+    const ui::ImageCacheFile file(path);
+    const auto& loaded = file.getImages();
+
+    REQUIRE(loaded.size() == images.size());
+
+    for (std::size_t i = 0; i < images.size(); ++i)
+    {
+        REQUIRE(loaded[i].first == images[i].first);
+        REQUIRE(loaded[i].second.format() == images[i].second.format());
+        REQUIRE(loaded[i].second == images[i].second);
+    }
+}
+
+TEST_CASE("ImageCacheFile rejects invalid files", "[ImageCacheFile]")
+{
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+
+    SECTION("Missing file")
+    {
+        REQUIRE_THROWS_AS(ui::ImageCacheFile{dir.path() + "/missing.wic"}, utils::IOError);
+    }
+
+    SECTION("Not an image-cache")
+    {
+        const QString path = dir.path() + "/garbage.wic";
+
+        QFile file(path);
+        REQUIRE(file.open(QIODevice::WriteOnly));
+        file.write(QByteArray(256, 'x'));
+        file.close();
+
+        REQUIRE_THROWS_AS(ui::ImageCacheFile{path}, utils::IOError);
+    }
+}
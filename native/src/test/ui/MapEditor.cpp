@@ -47,4 +47,62 @@ TEST_CASE("Invokable map-editing members", "[MapEditor]")
 
         REQUIRE(map.getFactions().size() == 1);
     }
+
+    SECTION("undo and redo")
+    {
+        REQUIRE(!mapEditor.canUndo());
+
+        mapEditor.setNumberOfFactions(2);
+        mapEditor.setNumberOfFactions(1);
+
+        REQUIRE(mapEditor.canUndo());
+
+        mapEditor.undo();
+
+        REQUIRE(map.getFactions().size() == 2);
+        REQUIRE(mapEditor.canRedo());
+
+        mapEditor.undo();
+
+        REQUIRE(map.getFactions().empty());
+        REQUIRE(!mapEditor.canUndo());
+
+        mapEditor.redo();
+
+        REQUIRE(map.getFactions().size() == 2);
+    }
+
+    SECTION("Current faction is reset when it's removed")
+    {
+        mapEditor.setNumberOfFactions(2);
+
+        core::Faction* faction = map.getFactions().back();
+        mapEditor.setCurrentFaction(faction);
+
+        mapEditor.setNumberOfFactions(1);
+
+        REQUIRE(mapEditor.getCurrentFaction() == nullptr);
+
+        mapEditor.undo();
+        mapEditor.setCurrentFaction(map.getFactions().front());
+
+        mapEditor.undo();
+
+        REQUIRE(map.getFactions().empty());
+        REQUIRE(mapEditor.getCurrentFaction() == nullptr);
+    }
+
+    SECTION("Current faction is reset when the map changes")
+    {
+        mapEditor.setNumberOfFactions(1);
+        mapEditor.setCurrentFaction(map.getFactions().front());
+
+        core::Map otherMap;
+        otherMap.setWorld(&world);
+        mapEditor.setMap(&otherMap);
+
+        REQUIRE(mapEditor.getCurrentFaction() == nullptr);
+
+        mapEditor.setMap(&map);
+    }
 }
@@ -0,0 +1,205 @@
+/**
+ * Copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include "core/Map.h"
+#include "core/Settlement.h"
+#include "ui/MapUtil.h"
+#include "ui/MiniMapImage.h"
+#include <catch.hpp>
+
+using namespace warmonger;
+
+static const int tileSize{64};
+
+static QColor imageColor(const ui::MiniMapImage& image, core::MapNode* mapNode);
+
+TEST_CASE("MiniMapImage", "[MiniMapImage]")
+{
+    core::Map map;
+    map.generateMapNodes(3);
+
+    core::MapNode* center = map.getMapNodes()[0];
+    core::MapNode* west = center->getNeighbour(core::Direction::West);
+    core::MapNode* east = center->getNeighbour(core::Direction::East);
+
+    core::Faction* red = map.createFaction();
+    core::Faction* blue = map.createFaction();
+
+    std::unordered_map<const core::MapNode*, QColor> terrainColors;
+    int terrainColorCalls{0};
+
+    ui::MiniMapImage image(
+        [&](const core::MapNode& mapNode) {
+            ++terrainColorCalls;
+            const auto it = terrainColors.find(&mapNode);
+            return it == terrainColors.end() ? QColor(Qt::green) : it->second;
+        },
+        [&](const core::Faction& faction) { return &faction == red ? QColor(Qt::red) : QColor(Qt::blue); });
+
+    image.setMapNodes(ui::positionMapNodes(center, tileSize), tileSize);
+
+    SECTION("Full image")
+    {
+        REQUIRE(image.update());
+        REQUIRE(!image.getImage().isNull());
+        REQUIRE(image.getImageMapRect() == ui::calculateBoundingRect(image.getMapNodesPos(), tileSize));
+        REQUIRE(terrainColorCalls == static_cast<int>(map.getMapNodes().size()));
+
+        for (core::MapNode* mapNode : map.getMapNodes())
+        {
+            REQUIRE(!image.mapNodeImageRect(mapNode).isEmpty());
+            REQUIRE(imageColor(image, mapNode) == QColor(Qt::green));
+        }
+
+        REQUIRE(!image.update());
+    }
+
+    SECTION("Owned settlement")
+    {
+        core::Settlement* settlement = map.createSettlement();
+        settlement->setPosition(west);
+        settlement->setOwner(red);
+
+        core::Settlement* unowned = map.createSettlement();
+        unowned->setPosition(east);
+
+        image.setSettlements(map.getSettlements());
+        REQUIRE(image.update());
+
+        REQUIRE(imageColor(image, west) == QColor(Qt::red));
+        REQUIRE(imageColor(image, east) == QColor(Qt::green));
+        REQUIRE(imageColor(image, center) == QColor(Qt::green));
+    }
+
+    SECTION("Several settlements on the same map-node")
+    {
+        core::Settlement* unowned = map.createSettlement();
+        unowned->setPosition(center);
+
+        core::Settlement* first = map.createSettlement();
+        first->setPosition(center);
+        first->setOwner(blue);
+
+        core::Settlement* second = map.createSettlement();
+        second->setPosition(center);
+        second->setOwner(red);
+
+        image.setSettlements({unowned, first, second});
+        REQUIRE(image.update());
+        REQUIRE(imageColor(image, center) == QColor(Qt::blue));
+
+        image.setSettlements({second, first, unowned});
+        REQUIRE(image.update());
+        REQUIRE(imageColor(image, center) == QColor(Qt::blue));
+
+        first->setPosition(west);
+        image.updateSettlementPosition(first);
+        REQUIRE(image.update());
+        REQUIRE(imageColor(image, center) == QColor(Qt::red));
+        REQUIRE(imageColor(image, west) == QColor(Qt::blue));
+    }
+
+    SECTION("Per map-node invalidation")
+    {
+        REQUIRE(image.update());
+
+        const QImage before = image.getImage();
+        terrainColorCalls = 0;
+
+        terrainColors[center] = Qt::yellow;
+        image.invalidateMapNode(center);
+
+        REQUIRE(image.update());
+        REQUIRE(terrainColorCalls == 1);
+        REQUIRE(imageColor(image, center) == QColor(Qt::yellow));
+
+        // Only the pixels of the invalidated map-node changed.
+        const QRect rect = image.mapNodeImageRect(center);
+        const QImage& after = image.getImage();
+        REQUIRE(after.size() == before.size());
+        for (int y = 0; y < after.height(); ++y)
+        {
+            for (int x = 0; x < after.width(); ++x)
+            {
+                if (!rect.contains(x, y))
+                    REQUIRE(after.pixel(x, y) == before.pixel(x, y));
+            }
+        }
+
+        REQUIRE(!image.update());
+    }
+
+    SECTION("Moving a settlement")
+    {
+        core::Settlement* settlement = map.createSettlement();
+        settlement->setPosition(west);
+        settlement->setOwner(red);
+
+        image.setSettlements(map.getSettlements());
+        REQUIRE(image.update());
+        terrainColorCalls = 0;
+
+        settlement->setPosition(east);
+        image.updateSettlementPosition(settlement);
+
+        REQUIRE(image.update());
+        REQUIRE(terrainColorCalls == 1);
+        REQUIRE(imageColor(image, west) == QColor(Qt::green));
+        REQUIRE(imageColor(image, east) == QColor(Qt::red));
+    }
+
+    SECTION("Maximum size")
+    {
+        core::Settlement* settlement = map.createSettlement();
+        settlement->setPosition(center);
+        settlement->setOwner(red);
+
+        image.setSettlements(map.getSettlements());
+        image.setMaxSize(QSize(8, 6));
+        REQUIRE(image.update());
+
+        const QImage& result = image.getImage();
+        REQUIRE(result.width() <= 8);
+        REQUIRE(result.height() <= 6);
+        REQUIRE(image.getImageMapRect() == ui::calculateBoundingRect(image.getMapNodesPos(), tileSize));
+
+        for (core::MapNode* mapNode : map.getMapNodes())
+        {
+            const QRect rect = image.mapNodeImageRect(mapNode);
+            REQUIRE(!rect.isEmpty());
+            REQUIRE(result.rect().contains(rect));
+        }
+
+        REQUIRE(imageColor(image, center) == QColor(Qt::red));
+
+        // The neighbours share pixels with the settlement, redrawing them
+        // doesn't paint over it.
+        image.invalidateMapNode(west);
+        image.invalidateMapNode(east);
+        REQUIRE(image.update());
+        REQUIRE(imageColor(image, center) == QColor(Qt::red));
+
+        image.setMaxSize(QSize(8, 6));
+        REQUIRE(!image.update());
+    }
+}
+
+static QColor imageColor(const ui::MiniMapImage& image, core::MapNode* mapNode)
+{
+    const QRect rect = image.mapNodeImageRect(mapNode);
+    return QColor(image.getImage().pixel(rect.center()));
+}
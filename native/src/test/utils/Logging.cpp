@@ -0,0 +1,137 @@
+/**
+ * Copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "utils/Logging.h"
+#include <catch.hpp>
+
+using namespace warmonger;
+
+static std::size_t countLines(const std::string& str, const std::string& needle)
+{
+    std::size_t n = 0;
+    std::istringstream s(str);
+    for (std::string line; std::getline(s, line);)
+    {
+        if (line.find(needle) != std::string::npos)
+            ++n;
+    }
+    return n;
+}
+
+TEST_CASE("Asynchronous logging", "[Logging]")
+{
+    std::stringstream stream;
+
+    SECTION("All messages are written")
+    {
+        utils::initLogging(utils::LogConfig::Stream(stream).setAsync(utils::LogOverflowPolicy::Block, 16));
+
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t)
+        {
+            threads.emplace_back([t]() {
+                for (int i = 0; i < 500; ++i)
+                    wInfo << "async message " << t << "/" << i;
+            });
+        }
+
+        for (auto& thread : threads)
+            thread.join();
+
+        wInfo << "long message " << std::string(2000, 'x');
+
+        utils::flushLogging();
+
+        REQUIRE(countLines(stream.str(), "async message") == 2000);
+        REQUIRE(countLines(stream.str(), std::string(2000, 'x')) == 1);
+    }
+
+    SECTION("Messages are dropped on overflow")
+    {
+        utils::initLogging(utils::LogConfig::Stream(stream).setAsync(utils::LogOverflowPolicy::Drop, 2));
+
+        for (int i = 0; i < 1000; ++i)
+            wInfo << "async message " << i;
+
+        utils::flushLogging();
+
+        const std::size_t logged = countLines(stream.str(), "async message");
+        REQUIRE(logged > 0);
+        REQUIRE(logged <= 1000);
+
+        if (logged < 1000)
+            REQUIRE(countLines(stream.str(), "Dropped") >= 1);
+    }
+
+    SECTION("Nested messages")
+    {
+        utils::initLogging(utils::LogConfig::Stream(stream).setAsync());
+
+        wInfo << "outer " << [] {
+            wInfo << "inner";
+            return 1;
+        }();
+
+        utils::flushLogging();
+
+        REQUIRE(countLines(stream.str(), "outer 1") == 1);
+        REQUIRE(countLines(stream.str(), "inner") == 1);
+    }
+
+    utils::initLogging(utils::LogConfig::File("test_warmonger.log"));
+}
+
+TEST_CASE("Disabled log levels", "[Logging]")
+{
+    std::stringstream stream;
+    utils::initLogging(utils::LogConfig::Stream(stream).setLevel(utils::LogLevel::Info));
+
+    REQUIRE(utils::getLogLevel() == utils::LogLevel::Info);
+    REQUIRE(!utils::isLogLevelEnabled(utils::LogLevel::Debug));
+    REQUIRE(utils::isLogLevelEnabled(utils::LogLevel::Warning));
+
+    int evaluated = 0;
+    const auto argument = [&evaluated]() {
+        ++evaluated;
+        return "argument";
+    };
+
+    wDebug << "disabled " << argument();
+    wTrace.format("disabled {}", argument());
+    wInfo << "enabled " << argument();
+
+    REQUIRE(evaluated == 1);
+    REQUIRE(stream.str().find("disabled") == std::string::npos);
+    REQUIRE(stream.str().find("enabled argument") != std::string::npos);
+
+    // The macro is a single expression, it is safe in an unbraced if-else.
+    bool elseTaken = false;
+    if (evaluated == 0)
+        wInfo << "not taken";
+    else
+        elseTaken = true;
+
+    REQUIRE(elseTaken);
+
+    utils::initLogging(utils::LogConfig::File("test_warmonger.log"));
+}
@@ -0,0 +1,137 @@
+/**
+ * Copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <memory>
+#include <string>
+
+#include "utils/LruCache.h"
+#include <catch.hpp>
+
+using namespace warmonger;
+
+TEST_CASE("LruCache hits and misses", "[LruCache]")
+{
+    utils::LruCache<std::string, int> cache;
+
+    cache.insert("a", 1, 10);
+
+    REQUIRE(cache.find("a") != nullptr);
+    REQUIRE(*cache.find("a") == 1);
+    REQUIRE(cache.find("b") == nullptr);
+
+    const auto stats = cache.getStats();
+    REQUIRE(stats.hits == 2);
+    REQUIRE(stats.misses == 1);
+    REQUIRE(stats.entries == 1);
+    REQUIRE(stats.residentBytes == 10);
+}
+
+TEST_CASE("LruCache evicts least recently used first", "[LruCache]")
+{
+    utils::LruCache<std::string, int> cache(30);
+
+    cache.insert("a", 1, 10);
+    cache.insert("b", 2, 10);
+    cache.insert("c", 3, 10);
+
+    SECTION("Within budget")
+    {
+        cache.trim();
+
+        REQUIRE(cache.getStats().evictions == 0);
+        REQUIRE(cache.getStats().entries == 3);
+    }
+
+    SECTION("Over budget")
+    {
+        // Make "a" the most recently used one.
+        cache.find("a");
+        cache.insert("d", 4, 15);
+        cache.trim();
+
+        REQUIRE(cache.contains("a"));
+        REQUIRE(!cache.contains("b"));
+        REQUIRE(!cache.contains("c"));
+        REQUIRE(cache.contains("d"));
+        REQUIRE(cache.getStats().evictions == 2);
+        REQUIRE(cache.getStats().residentBytes == 25);
+    }
+
+    SECTION("Predicate")
+    {
+        cache.insert("d", 4, 10);
+        cache.trim([](const std::string& key, const int&) { return key != "a"; });
+
+        REQUIRE(cache.contains("a"));
+        REQUIRE(!cache.contains("b"));
+        REQUIRE(cache.contains("c"));
+        REQUIRE(cache.contains("d"));
+    }
+
+    SECTION("Shrinking the budget")
+    {
+        cache.setBudget(10);
+        cache.trim();
+
+        REQUIRE(cache.contains("c"));
+        REQUIRE(cache.getStats().entries == 1);
+        REQUIRE(cache.getStats().budgetBytes == 10);
+    }
+}
+
+TEST_CASE("LruCache replace and erase", "[LruCache]")
+{
+    utils::LruCache<std::string, std::unique_ptr<int>> cache;
+
+    cache.insert("a", std::make_unique<int>(1), 10);
+    cache.insert("a", std::make_unique<int>(2), 20);
+
+    REQUIRE(**cache.find("a") == 2);
+    REQUIRE(cache.getStats().residentBytes == 20);
+
+    cache.erase("a");
+
+    REQUIRE(!cache.contains("a"));
+    REQUIRE(cache.getStats().residentBytes == 0);
+
+    REQUIRE(cache.fits(100));
+    cache.setBudget(50);
+    cache.insert("b", std::make_unique<int>(3), 40);
+    REQUIRE(cache.fits(10));
+    REQUIRE(!cache.fits(11));
+}
+
+TEST_CASE("LruCache erase by predicate", "[LruCache]")
+{
+    utils::LruCache<std::string, int> cache;
+
+    cache.insert("a", 1, 10);
+    cache.insert("b", 2, 20);
+    cache.insert("c", 3, 30);
+
+    cache.eraseIf([](const std::string&, int value) { return value % 2 == 1; });
+
+    REQUIRE(!cache.contains("a"));
+    REQUIRE(cache.contains("b"));
+    REQUIRE(!cache.contains("c"));
+
+    const auto stats = cache.getStats();
+    REQUIRE(stats.entries == 1);
+    REQUIRE(stats.residentBytes == 20);
+    REQUIRE(stats.evictions == 0);
+}
@@ -0,0 +1,136 @@
+/**
+ * Copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include <chrono>
+#include <thread>
+
+#include "utils/Lua.h"
+#include "utils/LuaProfiler.h"
+#include <catch.hpp>
+
+using namespace warmonger;
+
+static const utils::LuaFunctionStats* findStats(
+    const std::vector<utils::LuaFunctionStats>& stats, const std::string& name)
+{
+    for (const auto& function : stats)
+    {
+        if (function.name.compare(0, name.size(), name) == 0)
+            return &function;
+    }
+    return nullptr;
+}
+
+TEST_CASE("LuaProfiler", "[LuaProfiler]")
+{
+    sol::state lua;
+
+    lua.set_function(
+        "native_sleep", [](int ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); });
+
+    lua.script(R"(
+        function leaf()
+            native_sleep(5)
+        end
+
+        function recursive(n)
+            if n > 0 then
+                recursive(n - 1)
+            else
+                leaf()
+            end
+        end
+
+        function failing()
+            leaf()
+            error("failed")
+        end
+    )");
+
+    utils::LuaProfiler profiler(lua.lua_state(), "test");
+
+    SECTION("Calls and times")
+    {
+        lua["recursive"](3);
+        lua["leaf"]();
+
+        const auto stats = profiler.getStats();
+
+        const auto leaf = findStats(stats, "leaf");
+        REQUIRE(leaf != nullptr);
+        REQUIRE(!leaf->native);
+        REQUIRE(leaf->calls == 2);
+        REQUIRE(leaf->totalTime >= std::chrono::milliseconds(10));
+        REQUIRE(leaf->selfTime < leaf->totalTime);
+
+        const auto recursive = findStats(stats, "recursive");
+        REQUIRE(recursive != nullptr);
+        REQUIRE(recursive->calls == 4);
+        REQUIRE(recursive->totalTime >= std::chrono::milliseconds(5));
+        // The recursive calls are accounted for only once.
+        REQUIRE(recursive->totalTime < leaf->totalTime);
+
+        const auto nativeSleep = findStats(stats, "native_sleep");
+        REQUIRE(nativeSleep != nullptr);
+        REQUIRE(nativeSleep->native);
+        REQUIRE(nativeSleep->calls == 2);
+        REQUIRE(nativeSleep->selfTime >= std::chrono::milliseconds(10));
+
+        // Sorted by self time.
+        REQUIRE(stats.front().name == nativeSleep->name);
+    }
+
+    SECTION("Errors")
+    {
+        sol::protected_function failing = lua["failing"];
+        REQUIRE(!failing().valid());
+
+        lua["leaf"]();
+
+        const auto stats = profiler.getStats();
+
+        const auto leaf = findStats(stats, "leaf");
+        REQUIRE(leaf != nullptr);
+        REQUIRE(leaf->calls == 2);
+
+        const auto failingStats = findStats(stats, "failing");
+        REQUIRE(failingStats != nullptr);
+        REQUIRE(failingStats->calls == 1);
+    }
+
+    SECTION("Reset")
+    {
+        lua["leaf"]();
+        REQUIRE(!profiler.getStats().empty());
+
+        profiler.reset();
+        REQUIRE(profiler.getStats().empty());
+    }
+
+    SECTION("Report")
+    {
+        lua["leaf"]();
+
+        std::stringstream report;
+        profiler.writeReport(report);
+
+        REQUIRE(report.str().find("Lua profile of test") != std::string::npos);
+        REQUIRE(report.str().find("[C] native_sleep") != std::string::npos);
+    }
+}
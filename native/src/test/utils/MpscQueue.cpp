@@ -0,0 +1,96 @@
+/**
+ * Copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <thread>
+#include <vector>
+
+#include "utils/MpscQueue.h"
+#include <catch.hpp>
+
+using namespace warmonger;
+
+TEST_CASE("MpscQueue single-threaded", "[MpscQueue]")
+{
+    utils::MpscQueue<int> queue(3);
+
+    REQUIRE(queue.getCapacity() == 4);
+
+    int value = 0;
+    REQUIRE(!queue.tryPop([&](int& v) { value = v; }));
+
+    for (int i = 0; i < 4; ++i)
+        REQUIRE(queue.tryPush([i](int& v) { v = i; }));
+
+    REQUIRE(!queue.tryPush([](int& v) { v = 100; }));
+
+    for (int i = 0; i < 4; ++i)
+    {
+        REQUIRE(queue.tryPop([&](int& v) { value = v; }));
+        REQUIRE(value == i);
+    }
+
+    REQUIRE(!queue.tryPop([&](int& v) { value = v; }));
+
+    // Wrap around.
+    REQUIRE(queue.tryPush([](int& v) { v = 42; }));
+    REQUIRE(queue.tryPop([&](int& v) { value = v; }));
+    REQUIRE(value == 42);
+}
+
+TEST_CASE("MpscQueue multi-threaded", "[MpscQueue]")
+{
+    const int producerCount = 4;
+    const int itemsPerProducer = 10000;
+
+    utils::MpscQueue<std::pair<int, int>> queue(64);
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < producerCount; ++p)
+    {
+        producers.emplace_back([&queue, p]() {
+            for (int i = 0; i < itemsPerProducer; ++i)
+            {
+                while (!queue.tryPush([p, i](std::pair<int, int>& v) { v = {p, i}; }))
+                    std::this_thread::yield();
+            }
+        });
+    }
+
+    std::vector<int> next(producerCount, 0);
+    bool inOrder = true;
+
+    for (int received = 0; received < producerCount * itemsPerProducer;)
+    {
+        const bool popped = queue.tryPop([&](std::pair<int, int>& v) {
+            inOrder = inOrder && v.second == next[v.first];
+            ++next[v.first];
+        });
+
+        if (popped)
+            ++received;
+        else
+            std::this_thread::yield();
+    }
+
+    for (auto& producer : producers)
+        producer.join();
+
+    REQUIRE(inOrder);
+    for (int p = 0; p < producerCount; ++p)
+        REQUIRE(next[p] == itemsPerProducer);
+}
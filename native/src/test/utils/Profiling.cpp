@@ -0,0 +1,92 @@
+/**
+ * Copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "utils/Profiling.h"
+#include <catch.hpp>
+
+using namespace warmonger;
+
+static std::size_t countOccurrences(const std::string& str, const std::string& needle)
+{
+    std::size_t n = 0;
+    for (auto pos = str.find(needle); pos != std::string::npos; pos = str.find(needle, pos + 1))
+        ++n;
+    return n;
+}
+
+TEST_CASE("Profiling zones", "[Profiling]")
+{
+    SECTION("Disabled")
+    {
+        utils::startProfiling();
+        utils::stopProfiling();
+
+        {
+            wProfileZone("disabled zone");
+        }
+
+        std::stringstream trace;
+        utils::writeChromeTrace(trace);
+
+        REQUIRE(countOccurrences(trace.str(), "disabled zone") == 0);
+    }
+
+    SECTION("Enabled")
+    {
+        utils::startProfiling();
+
+        {
+            wProfileZone("outer zone");
+            wProfileZone("inner \"zone\"");
+        }
+
+        std::thread thread([]() { wProfileZone("thread zone"); });
+        thread.join();
+
+        utils::stopProfiling();
+
+        std::stringstream trace;
+        utils::writeChromeTrace(trace);
+        const std::string json = trace.str();
+
+        REQUIRE(json.find("\"traceEvents\"") != std::string::npos);
+        REQUIRE(countOccurrences(json, "\"name\":\"outer zone\"") == 1);
+        REQUIRE(countOccurrences(json, "\"name\":\"inner \\\"zone\\\"\"") == 1);
+        REQUIRE(countOccurrences(json, "\"name\":\"thread zone\"") == 1);
+        REQUIRE(countOccurrences(json, "\"ph\":\"X\"") == 3);
+    }
+
+    SECTION("Restarting clears the zones")
+    {
+        utils::startProfiling();
+        {
+            wProfileZone("old zone");
+        }
+        utils::startProfiling();
+        utils::stopProfiling();
+
+        std::stringstream trace;
+        utils::writeChromeTrace(trace);
+
+        REQUIRE(countOccurrences(trace.str(), "old zone") == 0);
+    }
+}
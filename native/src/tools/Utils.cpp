@@ -18,6 +18,9 @@
 
 #include "tools/Utils.h"
 
+#include <fstream>
+#include <string>
+
 namespace warmonger {
 namespace tools {
 
@@ -30,5 +33,19 @@ std::shared_ptr<std::stringstream> setupLogging()
     return stream;
 }
 
+long peakResidentSetSize()
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+
+    while (std::getline(status, line))
+    {
+        if (line.compare(0, 6, "VmHWM:") == 0)
+            return std::stol(line.substr(6));
+    }
+
+    return -1;
+}
+
 } // namespace tools
 } // namespace warmonger
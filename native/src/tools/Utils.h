@@ -12,6 +12,13 @@ namespace tools {
 
 std::shared_ptr<std::stringstream> setupLogging();
 
+/**
+ * Get the peak resident set size of the process in kB.
+ *
+ * \returns the peak RSS, -1 if it is not available
+ */
+long peakResidentSetSize();
+
 template <typename... Args>
 void die(std::shared_ptr<std::stringstream> logStream, const char* const msg = nullptr, Args&&... args)
 {
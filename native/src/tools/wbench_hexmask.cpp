@@ -0,0 +1,141 @@
+/**
+ * Copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <QImage>
+#include <backward.hpp>
+
+#include "ui/HexMask.h"
+
+namespace backward {
+
+backward::SignalHandling sh;
+
+} // namespace backward
+
+using namespace warmonger;
+
+static QImage makeMaskImage(int size);
+
+template <typename Func>
+static void bench(const char* name, std::size_t pointCount, int rounds, Func&& func)
+{
+    std::size_t hits{0};
+
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; ++i)
+        hits += func();
+    const auto end = std::chrono::steady_clock::now();
+
+    const double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    const double ops = static_cast<double>(pointCount) * rounds;
+
+    // name ops ns/op hits - the hits keep the optimizer honest
+    std::cout << name << " " << static_cast<std::size_t>(ops) << " " << ns / ops << " " << hits << std::endl;
+}
+
+/**
+ * Microbenchmark of the hexagon-mask lookups.
+ *
+ * Compares QImage::pixel() (what hexContains() used to do), HexMask's
+ * scalar lookup and HexMask's batch lookup. Outputs a line per variant:
+ * `name ops ns/op hits'.
+ */
+int main(int argc, char* const argv[])
+{
+    const int size = argc > 1 ? std::atoi(argv[1]) : 128;
+    const std::size_t pointCount = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 1 << 16;
+    const int rounds = argc > 3 ? std::atoi(argv[3]) : 100;
+
+    if (size <= 0 || pointCount == 0 || rounds <= 0)
+    {
+        std::cout << "Usage: wbench_hexmask [tile-size] [point-count] [rounds]" << std::endl;
+        return 1;
+    }
+
+    const QImage image = makeMaskImage(size);
+    const ui::HexMask mask(image);
+
+    // Include some out-of-bounds points, like mapNodeAtPos() would.
+    std::mt19937 gen(0);
+    std::uniform_int_distribution<int> dist(-size / 8, size + size / 8);
+    std::vector<QPoint> points(pointCount);
+    for (auto& point : points)
+        point = QPoint(dist(gen), dist(gen));
+
+    std::unique_ptr<bool[]> results(new bool[pointCount]);
+
+    bench("qimage_pixel", pointCount, rounds, [&]() {
+        std::size_t hits{0};
+        for (const auto& p : points)
+        {
+            if (p.x() >= 0 && p.x() < size && p.y() >= 0 && p.y() < size)
+                hits += image.pixel(p) == 0xffffffff;
+        }
+        return hits;
+    });
+
+    bench("hexmask_scalar", pointCount, rounds, [&]() {
+        std::size_t hits{0};
+        for (const auto& p : points)
+            hits += mask.contains(p);
+        return hits;
+    });
+
+    bench("hexmask_batch", pointCount, rounds, [&]() {
+        std::size_t hits{0};
+        mask.contains(points.data(), pointCount, results.get());
+        for (std::size_t i = 0; i < pointCount; ++i)
+            hits += results[i];
+        return hits;
+    });
+
+    return 0;
+}
+
+/*
+ * Same shape whexagon.py generates: pointy-top hexagon filling the tile.
+ */
+static QImage makeMaskImage(int size)
+{
+    QImage image(size, size, QImage::Format_ARGB32);
+    image.fill(0);
+
+    const double half = size / 2.0;
+
+    for (int y = 0; y < size; ++y)
+    {
+        for (int x = 0; x < size; ++x)
+        {
+            const double dx = std::abs(x + 0.5 - half);
+            const double dy = std::abs(y + 0.5 - half);
+
+            if (dy <= half - dx / 2.0)
+                image.setPixel(x, y, 0xffffffff);
+        }
+    }
+
+    return image;
+}
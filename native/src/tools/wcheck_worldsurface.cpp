@@ -17,9 +17,12 @@
  */
 
 #include <backward.hpp>
+#include <chrono>
 #include <iostream>
 #include <memory>
 
+#include <QTemporaryDir>
+
 #include "io/File.h"
 #include "tools/Utils.h"
 #include "ui/WorldSurface.h"
@@ -38,12 +41,23 @@ using namespace warmonger;
  * Sanity-check a world-surface.
  *
  * A "sane" world-surface can be loaded and activated without exceptions.
+ * On success the time it took to load and activate the surface and the
+ * peak RSS of the process is printed, in the format:
+ * `load+activate: <ms> ms, peak RSS: <before> kB -> <after> kB'.
+ *
+ * If an image-cache directory is passed, the startup with a cold and a warm
+ * image-cache is also measured, including the decoding of all images.
+ * The cache is written to a temporary sub-directory of the passed directory,
+ * which is removed again on exit, the passed directory itself is left
+ * untouched. The result is printed in the format:
+ * `cold: <ms> ms, warm: <ms> ms'.
  */
 int main(int argc, char* const argv[])
 {
     if (argc < 3)
     {
-        std::cout << "Usage: wcheck_worldsurface /path/to/world.wwd /path/to/worldsurface.wsp" << std::endl;
+        std::cout << "Usage: wcheck_worldsurface /path/to/world.wwd /path/to/worldsurface.wsp [/path/to/cache/dir]"
+                  << std::endl;
         return 1;
     }
 
@@ -68,8 +82,48 @@ int main(int argc, char* const argv[])
             e.what());
     }
 
+    const long rssBefore = tools::peakResidentSetSize();
+    const auto start = std::chrono::steady_clock::now();
+
     if (!ui::isWorldSurfaceSane(worldSurfacePath, world.get()))
         tools::die(logStream);
 
+    const auto end = std::chrono::steady_clock::now();
+    const long rssAfter = tools::peakResidentSetSize();
+
+    std::cout << "load+activate: " << std::chrono::duration<double, std::milli>(end - start).count()
+              << " ms, peak RSS: " << rssBefore << " kB -> " << rssAfter << " kB" << std::endl;
+
+    if (argc < 4)
+        return 0;
+
+    const QTemporaryDir cacheDir{QString{argv[3]} + "/wcheck_worldsurface-XXXXXX"};
+
+    if (!cacheDir.isValid())
+        tools::die(logStream, "Failed to create a temporary image-cache directory under {}", argv[3]);
+
+    const auto measureStartup = [&]() {
+        const auto start = std::chrono::steady_clock::now();
+
+        ui::WorldSurface worldSurface(worldSurfacePath, world.get());
+        worldSurface.setImageCacheDir(cacheDir.path());
+        worldSurface.activate();
+        worldSurface.waitForAssets();
+
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    try
+    {
+        const double cold = measureStartup();
+        const double warm = measureStartup();
+
+        std::cout << "cold: " << cold << " ms, warm: " << warm << " ms" << std::endl;
+    }
+    catch (std::exception& e)
+    {
+        tools::die(logStream, "Unexpected exception while measuring startup: {}", e.what());
+    }
+
     return 0;
 }
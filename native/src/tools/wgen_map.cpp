@@ -0,0 +1,268 @@
+/**
+ * Copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <backward.hpp>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+
+#include <QFileInfo>
+
+#include "core/Map.h"
+#include "core/Settlement.h"
+#include "io/File.h"
+#include "tools/Utils.h"
+#include "utils/Logging.h"
+
+namespace backward {
+
+backward::SignalHandling sh;
+
+} // namespace backward
+
+using namespace warmonger;
+
+namespace {
+
+/*
+ * Weighted set of names, e.g. terrain-types.
+ */
+struct Distribution
+{
+    std::vector<QString> names;
+    std::vector<double> weights;
+};
+
+struct Options
+{
+    unsigned int radius{32};
+    unsigned int factionCount{4};
+    // ratio of map-nodes with a settlement
+    double settlementDensity{0.05};
+    Distribution terrainTypes;
+    Distribution settlementTypes;
+    unsigned int seed{0};
+    io::Compression compression{io::Compression::None};
+};
+
+} // namespace
+
+static bool parseOptions(int argc, char* const argv[], Options& options);
+static bool parseDistribution(const QString& str, Distribution& distribution);
+static std::unique_ptr<core::Map> generateMap(core::World* world, const Options& options);
+
+/**
+ * Generate a synthetic campaign-map.
+ *
+ * Builds the map directly from the parameters, without running the world's
+ * map-generation rules, so that maps of arbitrary scale can be produced
+ * quickly for load and scale testing. The world is only used for the
+ * banners, colors and civilizations of the factions. The same parameters
+ * always generate the same map.
+ * The map is written in all supported formats, that is the JSON format of
+ * io::writeMap(), optionally compressed. On success the time it took to
+ * generate and write the map is printed, in the format:
+ * `<n> map-nodes, <n> factions, <n> settlements, generate: <ms> ms, write: <ms> ms, <size> bytes'.
+ */
+int main(int argc, char* const argv[])
+{
+    Options options;
+
+    if (argc < 3 || !parseOptions(argc, argv, options))
+    {
+        std::cout << "Usage: wgen_map /path/to/world.wwd /path/to/map.wmd [--radius=n] [--factions=n]"
+                     " [--settlement-density=ratio] [--terrain-types=name:weight,...]"
+                     " [--settlement-types=name:weight,...] [--seed=n] [--compression=none|zlib]"
+                  << std::endl;
+        return 1;
+    }
+
+    std::shared_ptr<std::stringstream> logStream = tools::setupLogging();
+
+    QString worldPath{argv[1]};
+    QString mapPath{argv[2]};
+
+    wInfo << "world path: " << worldPath;
+    wInfo << "campaign-map path: " << mapPath;
+
+    std::unique_ptr<core::World> world;
+
+    try
+    {
+        world = io::readWorld(worldPath);
+    }
+    catch (const std::exception& e)
+    {
+        tools::die(logStream, "Unexpected exception while trying to load world: {}", e.what());
+    }
+
+    if (options.factionCount > 0 &&
+        (world->getBanners().empty() || world->getColors().empty() || world->getCivilizations().empty()))
+    {
+        tools::die(logStream, "World has no banners, colors or civilizations, cannot create factions");
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+
+    const auto map = generateMap(world.get(), options);
+
+    const auto generated = std::chrono::steady_clock::now();
+
+    try
+    {
+        io::writeMap(map.get(), mapPath, options.compression);
+    }
+    catch (const std::exception& e)
+    {
+        tools::die(logStream, "Unexpected exception while trying to write map: {}", e.what());
+    }
+
+    const auto written = std::chrono::steady_clock::now();
+
+    std::cout << map->getMapNodes().size() << " map-nodes, " << map->getFactions().size() << " factions, "
+              << map->getSettlements().size() << " settlements, generate: "
+              << std::chrono::duration<double, std::milli>(generated - start).count()
+              << " ms, write: " << std::chrono::duration<double, std::milli>(written - generated).count() << " ms, "
+              << QFileInfo(mapPath).size() << " bytes" << std::endl;
+
+    return 0;
+}
+
+static bool parseOptions(int argc, char* const argv[], Options& options)
+{
+    bool ok{true};
+
+    parseDistribution("grassland:4,forest:2,hills:1,mountains:1,water:2", options.terrainTypes);
+    parseDistribution("village:3,town:1", options.settlementTypes);
+
+    for (int i = 3; i < argc && ok; ++i)
+    {
+        const QString arg{argv[i]};
+        const int separator = arg.indexOf('=');
+
+        if (separator == -1)
+            return false;
+
+        const QString name = arg.left(separator);
+        const QString value = arg.mid(separator + 1);
+
+        if (name == "--radius")
+            options.radius = value.toUInt(&ok);
+        else if (name == "--factions")
+            options.factionCount = value.toUInt(&ok);
+        else if (name == "--settlement-density")
+            options.settlementDensity = value.toDouble(&ok);
+        else if (name == "--terrain-types")
+            ok = parseDistribution(value, options.terrainTypes);
+        else if (name == "--settlement-types")
+            ok = parseDistribution(value, options.settlementTypes);
+        else if (name == "--seed")
+            options.seed = value.toUInt(&ok);
+        else if (name == "--compression" && value == "none")
+            options.compression = io::Compression::None;
+        else if (name == "--compression" && value == "zlib")
+            options.compression = io::Compression::Zlib;
+        else
+            return false;
+    }
+
+    return ok && options.radius > 0 && options.settlementDensity >= 0.0 && options.settlementDensity <= 1.0;
+}
+
+static bool parseDistribution(const QString& str, Distribution& distribution)
+{
+    Distribution parsed;
+
+    for (const QString& entry : str.split(',', QString::SkipEmptyParts))
+    {
+        const QStringList parts = entry.split(':');
+        bool ok{true};
+        const double weight = parts.size() == 2 ? parts[1].toDouble(&ok) : 1.0;
+
+        if (parts.size() > 2 || !ok || weight <= 0.0 || parts[0].isEmpty())
+            return false;
+
+        parsed.names.push_back(parts[0]);
+        parsed.weights.push_back(weight);
+    }
+
+    if (parsed.names.empty())
+        return false;
+
+    distribution = std::move(parsed);
+
+    return true;
+}
+
+static std::unique_ptr<core::Map> generateMap(core::World* world, const Options& options)
+{
+    std::mt19937 gen(options.seed);
+
+    auto map = std::make_unique<core::Map>();
+
+    map->setName(QString("Synthetic map (radius %1, seed %2)").arg(options.radius).arg(options.seed));
+    map->setWorld(world);
+    map->generateMapNodes(options.radius);
+
+    std::discrete_distribution<std::size_t> terrainTypeDist(
+        options.terrainTypes.weights.begin(), options.terrainTypes.weights.end());
+
+    for (core::MapNode* mapNode : map->getMapNodes())
+        mapNode->setTerrainType(options.terrainTypes.names[terrainTypeDist(gen)]);
+
+    const auto& banners = world->getBanners();
+    const auto& colors = world->getColors();
+    const auto& civilizations = world->getCivilizations();
+
+    std::vector<core::Faction*> factions;
+    factions.reserve(options.factionCount);
+
+    for (unsigned int i = 0; i < options.factionCount; ++i)
+    {
+        auto* faction = map->createFaction();
+        faction->setName(QString("Faction %1").arg(i));
+        faction->setCivilization(civilizations[i % civilizations.size()]);
+        faction->setBanner(banners[i % banners.size()]);
+        faction->setPrimaryColor(colors[i % colors.size()]);
+        faction->setSecondaryColor(colors[(i + 1) % colors.size()]);
+        factions.push_back(faction);
+    }
+
+    std::bernoulli_distribution hasSettlementDist(options.settlementDensity);
+    std::discrete_distribution<std::size_t> settlementTypeDist(
+        options.settlementTypes.weights.begin(), options.settlementTypes.weights.end());
+    // The last "faction" stands for unowned settlements.
+    std::uniform_int_distribution<std::size_t> ownerDist(0, factions.size());
+
+    for (core::MapNode* mapNode : map->getMapNodes())
+    {
+        if (!hasSettlementDist(gen))
+            continue;
+
+        auto* settlement = map->createSettlement();
+        settlement->setType(options.settlementTypes.names[settlementTypeDist(gen)]);
+        settlement->setPosition(mapNode);
+
+        const std::size_t owner = ownerDist(gen);
+        if (owner < factions.size())
+            settlement->setOwner(factions[owner]);
+    }
+
+    return map;
+}
@@ -0,0 +1,87 @@
+/**
+ * Copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "ui/AssetPreloader.h"
+
+#include <algorithm>
+#include <exception>
+
+#include "utils/Logging.h"
+
+namespace warmonger {
+namespace ui {
+
+AssetPreloader::AssetPreloader(std::vector<QString> paths, LoadFunc load, ProgressFunc progress, unsigned threadCount)
+    : paths(std::move(paths))
+    , load(std::move(load))
+    , progress(std::move(progress))
+    , cancelled(false)
+    , next(0)
+    , loaded(0)
+{
+    if (threadCount == 0)
+        threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+    threadCount = std::min<unsigned>(threadCount, this->paths.size());
+
+    wDebug << "Preloading " << this->paths.size() << " assets on " << threadCount << " threads";
+
+    for (unsigned i = 0; i < threadCount; ++i)
+        this->threads.emplace_back(&AssetPreloader::run, this);
+}
+
+AssetPreloader::~AssetPreloader()
+{
+    this->cancelled = true;
+    this->wait();
+}
+
+void AssetPreloader::wait()
+{
+    for (auto& thread : this->threads)
+    {
+        if (thread.joinable())
+            thread.join();
+    }
+}
+
+void AssetPreloader::run()
+{
+    const int total = this->getTotalCount();
+
+    while (!this->cancelled)
+    {
+        const std::size_t i = this->next++;
+        if (i >= this->paths.size())
+            break;
+
+        try
+        {
+            this->load(this->paths[i]);
+        }
+        catch (std::exception& e)
+        {
+            wWarning.format("Failed to preload asset `{}': {}", this->paths[i], e.what());
+        }
+
+        this->progress(++this->loaded, total);
+    }
+}
+
+} // namespace ui
+} // namespace warmonger
@@ -0,0 +1,107 @@
+/** \file
+ * AssetPreloader class.
+ *
+ * \copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef W_UI_ASSET_PRELOADER_H
+#define W_UI_ASSET_PRELOADER_H
+
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include <QString>
+
+namespace warmonger {
+namespace ui {
+
+/**
+ * Loads a set of assets in the background, on a pool of threads.
+ *
+ * The actual loading is done by the supplied load function, which is
+ * called once for each asset, concurrently from several threads.
+ * Loading starts immediately on construction and can be cancelled by
+ * destroying the preloader.
+ */
+class AssetPreloader
+{
+public:
+    using LoadFunc = std::function<void(const QString& path)>;
+    using ProgressFunc = std::function<void(int loaded, int total)>;
+
+    /**
+     * Start loading the assets.
+     *
+     * \param paths the paths of the assets to load
+     * \param load the function loading a single asset, exceptions
+     * derived from std::exception are logged and ignored
+     * \param progress called after each asset is loaded, from the
+     * thread that loaded it
+     * \param threadCount the number of threads to use, 0 means as many as
+     * there are hardware threads
+     */
+    AssetPreloader(std::vector<QString> paths, LoadFunc load, ProgressFunc progress, unsigned threadCount = 0);
+
+    /**
+     * Cancel loading and join the threads.
+     *
+     * The assets currently being loaded are finished first.
+     */
+    ~AssetPreloader();
+
+    /**
+     * Wait for all the assets to be loaded.
+     */
+    void wait();
+
+    AssetPreloader(const AssetPreloader&) = delete;
+    AssetPreloader& operator=(const AssetPreloader&) = delete;
+
+    int getLoadedCount() const
+    {
+        return this->loaded;
+    }
+
+    int getTotalCount() const
+    {
+        return static_cast<int>(this->paths.size());
+    }
+
+    bool isDone() const
+    {
+        return this->getLoadedCount() == this->getTotalCount();
+    }
+
+private:
+    void run();
+
+    const std::vector<QString> paths;
+    const LoadFunc load;
+    const ProgressFunc progress;
+
+    std::atomic<bool> cancelled;
+    std::atomic<std::size_t> next;
+    std::atomic<int> loaded;
+    std::vector<std::thread> threads;
+};
+
+} // namespace ui
+} // namespace warmonger
+
+#endif // W_UI_ASSET_PRELOADER_H
@@ -16,6 +16,7 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include <QHash>
 #include <QPainter>
 
 #include "ui/Banner.h"
@@ -24,6 +25,11 @@
 namespace warmonger {
 namespace ui {
 
+// Banners are usually shown at a handful of sizes, the budget leaves
+// plenty of room for those, a lot more than this means something is
+// animating their size.
+static const std::size_t bannerImageCacheBudget{16 * 1024 * 1024};
+
 static QImage createBannerImage(
     WorldSurface* worldSurface, core::Banner* banner, core::Color* primaryColor, core::Color* secondaryColor);
 
@@ -82,17 +88,35 @@ void Banner::setWorldSurface(WorldSurface* worldSurface)
 
 void Banner::paint(QPainter* painter)
 {
-    if (this->bannerImage.isNull())
+    const QRect window = painter->window();
+
+    if (!this->worldSurface || !this->banner || !this->primaryColor || !this->secondaryColor || window.isEmpty())
+        return;
+
+    const BannerImageCache::Key key{this->worldSurface,
+        this->banner->getName(),
+        this->primaryColor->getName(),
+        this->secondaryColor->getName(),
+        window.size()};
+
+    const QImage bannerImage = BannerImageCache::instance().get(key, [this]() {
+        return createBannerImage(this->worldSurface, this->banner, this->primaryColor, this->secondaryColor);
+    });
+
+    if (bannerImage.isNull())
         return;
 
-    const QRect source(QPoint(0, 0), this->bannerImage.size());
-    painter->drawImage(painter->window(), this->bannerImage, source);
+    painter->drawImage(window.topLeft(), bannerImage);
 }
 
+/*
+ * The recoloring itself is deferred to paint(), so that changing several
+ * properties in a row only results in a single recoloring, at most once
+ * per frame.
+ */
 void Banner::updateContent()
 {
-    this->bannerImage = createBannerImage(this->worldSurface, this->banner, this->primaryColor, this->secondaryColor);
-    if (this->bannerImage.isNull())
+    if (!this->worldSurface || !this->banner || !this->primaryColor || !this->secondaryColor)
         this->setFlags(0);
     else
         this->setFlags(QQuickItem::ItemHasContents);
@@ -100,36 +124,133 @@ void Banner::updateContent()
     this->update();
 }
 
+std::size_t BannerImageCache::KeyHash::operator()(const Key& key) const
+{
+    std::size_t h = std::hash<const void*>()(key.worldSurface);
+    h = h * 31 + qHash(key.banner);
+    h = h * 31 + qHash(key.primaryColor);
+    h = h * 31 + qHash(key.secondaryColor);
+    h = h * 31 + static_cast<std::size_t>(key.size.width());
+    h = h * 31 + static_cast<std::size_t>(key.size.height());
+    return h;
+}
+
+BannerImageCache::BannerImageCache(std::size_t budget)
+    : images(budget)
+{
+}
+
+BannerImageCache::~BannerImageCache()
+{
+    for (const auto& element : this->watchedWorldSurfaces)
+        QObject::disconnect(element.second);
+}
+
+QImage BannerImageCache::get(const Key& key, const std::function<QImage()>& create)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+
+        if (const QImage* image = this->images.find(key))
+            return *image;
+    }
+
+    QImage image = create();
+
+    if (!image.isNull() && image.size() != key.size)
+        image = image.scaled(key.size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    this->images.insert(key, image, static_cast<std::size_t>(image.bytesPerLine()) * image.height());
+    this->images.trim();
+
+    const QObject* obj = key.worldSurface;
+    if (obj != nullptr && this->watchedWorldSurfaces.find(obj) == this->watchedWorldSurfaces.end())
+    {
+        this->watchedWorldSurfaces.emplace(
+            obj, QObject::connect(obj, &QObject::destroyed, [this, obj]() { this->forget(obj); }));
+    }
+
+    return image;
+}
+
+void BannerImageCache::forget(const QObject* worldSurface)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    this->images.eraseIf([worldSurface](const Key& key, const QImage&) { return key.worldSurface == worldSurface; });
+
+    const auto it = this->watchedWorldSurfaces.find(worldSurface);
+    if (it != this->watchedWorldSurfaces.end())
+    {
+        QObject::disconnect(it->second);
+        this->watchedWorldSurfaces.erase(it);
+    }
+}
+
+utils::CacheStats BannerImageCache::getStats() const
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->images.getStats();
+}
+
+/*
+ * Deliberately leaked: world-surfaces destroyed during static
+ * destruction would otherwise call into a destroyed cache.
+ */
+BannerImageCache& BannerImageCache::instance()
+{
+    static auto cache = new BannerImageCache(bannerImageCacheBudget);
+    return *cache;
+}
+
 static QImage createBannerImage(
     WorldSurface* worldSurface, core::Banner* banner, core::Color* primaryColor, core::Color* secondaryColor)
 {
-    if (!worldSurface || !banner || !primaryColor || !secondaryColor)
-        return QImage();
-
     QImage image = worldSurface->getBannerImage(*banner);
+    if (image.isNull())
+        return image;
+
+    // Work on straight (non-premultiplied) ARGB so that the placeholders
+    // can be compared directly with the raw pixel values.
+    if (image.format() != QImage::Format_ARGB32)
+        image = image.convertToFormat(QImage::Format_ARGB32);
+
+    static const QRgb foregroundPlaceholder{QColor("black").rgba()};
+    static const QRgb backgroundPlaceholder{QColor("white").rgba()};
+
+    recolor(image,
+        foregroundPlaceholder,
+        worldSurface->colorFor(*primaryColor).rgba(),
+        backgroundPlaceholder,
+        worldSurface->colorFor(*secondaryColor).rgba());
+
+    return image;
+}
 
-    static const QColor foregroundPlaceholderColor("black");
-    static const QColor backgroundPlaceholderColor("white");
-    const QColor foregroundColor = worldSurface->colorFor(*primaryColor);
-    const QColor backgroundColor = worldSurface->colorFor(*secondaryColor);
+/*
+ * Replaces the placeholder colors, one scanline at a time.
+ *
+ * The inner loop is a branch-free compare-and-select over 32 bit pixels,
+ * written so that the compiler can vectorize it.
+ */
+void recolor(QImage& image, QRgb foregroundPlaceholder, QRgb foreground, QRgb backgroundPlaceholder, QRgb background)
+{
+    const int width = image.width();
+    const int height = image.height();
 
-    const QSize size = image.size();
-    for (int y = 0; y < size.height(); ++y)
+    for (int y = 0; y < height; ++y)
     {
-        for (int x = 0; x < size.width(); ++x)
+        QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+
+        for (int x = 0; x < width; ++x)
         {
-            if (image.pixelColor(x, y) == foregroundPlaceholderColor)
-            {
-                image.setPixelColor(x, y, foregroundColor);
-            }
-            else if (image.pixelColor(x, y) == backgroundPlaceholderColor)
-            {
-                image.setPixelColor(x, y, backgroundColor);
-            }
+            const QRgb pixel = line[x];
+            const QRgb selected = pixel == backgroundPlaceholder ? background : pixel;
+            line[x] = pixel == foregroundPlaceholder ? foreground : selected;
         }
     }
-
-    return image;
 }
 
 } // namespace ui
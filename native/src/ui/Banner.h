@@ -21,9 +21,14 @@
 #ifndef UI_BANNER_H
 #define UI_BANNER_H
 
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+
 #include <QQuickPaintedItem>
 
 #include "ui/WorldSurface.h"
+#include "utils/LruCache.h"
 
 class QPainter;
 
@@ -37,6 +42,7 @@ namespace ui {
  * secondaryColor as the background. The QQuickPaintedItem's fillColor property
  * is used as the secondary-color. The secondaryColor promerty is merely an alias
  * to the fillColor. It needs the surface to get the actual banner image.
+ * The recolored banner images are cached and shared between all banners.
  */
 class Banner : public QQuickPaintedItem
 {
@@ -168,9 +174,102 @@ private:
     core::Color* primaryColor = nullptr;
     core::Color* secondaryColor = nullptr;
     WorldSurface* worldSurface = nullptr;
-    QImage bannerImage;
 };
 
+/**
+ * Recolored banner images, shared by all Banner items.
+ *
+ * Images are identified by the names of the banner and of the colors, so
+ * entries don't refer to the core objects and stay valid after those are
+ * destroyed. Entries of a world-surface are dropped when it is destroyed.
+ * The least recently used images are evicted when the cache exceeds its
+ * budget. Thread-safe, as banners are painted on the render thread(s).
+ */
+class BannerImageCache
+{
+public:
+    struct Key
+    {
+        // The world-surface, or any other object owning the image.
+        const QObject* worldSurface;
+        QString banner;
+        QString primaryColor;
+        QString secondaryColor;
+        QSize size;
+
+        bool operator==(const Key& other) const
+        {
+            return this->worldSurface == other.worldSurface && this->banner == other.banner &&
+                this->primaryColor == other.primaryColor && this->secondaryColor == other.secondaryColor &&
+                this->size == other.size;
+        }
+    };
+
+    struct KeyHash
+    {
+        std::size_t operator()(const Key& key) const;
+    };
+
+    /**
+     * Constructs an empty cache.
+     *
+     * \param budget the budget in bytes
+     */
+    explicit BannerImageCache(std::size_t budget);
+
+    ~BannerImageCache();
+
+    BannerImageCache(const BannerImageCache&) = delete;
+    BannerImageCache& operator=(const BannerImageCache&) = delete;
+
+    /**
+     * Get the image, creating it on a miss.
+     *
+     * The created image is scaled to the size of the key. Creating is
+     * done without holding the lock so concurrent misses for the same key
+     * may create the image more than once.
+     *
+     * \param key the key
+     * \param create creates the unscaled image
+     *
+     * 
+eturns the image, null if `create' returned a null image
+     */
+    QImage get(const Key& key, const std::function<QImage()>& create);
+
+    /**
+     * Drop all the images of the world-surface.
+     *
+     * \param worldSurface the world-surface
+     */
+    void forget(const QObject* worldSurface);
+
+    utils::CacheStats getStats() const;
+
+    /**
+     * The cache used by the Banner items.
+     */
+    static BannerImageCache& instance();
+
+private:
+    mutable std::mutex mutex;
+    utils::LruCache<Key, QImage, KeyHash> images;
+    std::unordered_map<const QObject*, QMetaObject::Connection> watchedWorldSurfaces;
+};
+
+/**
+ * Replace the placeholder colors of the banner image.
+ *
+ * The image has to be in QImage::Format_ARGB32.
+ *
+ * \param image the banner image
+ * \param foregroundPlaceholder the color to be replaced by foreground
+ * \param foreground the foreground (primary) color
+ * \param backgroundPlaceholder the color to be replaced by background
+ * \param background the background (secondary) color
+ */
+void recolor(QImage& image, QRgb foregroundPlaceholder, QRgb foreground, QRgb backgroundPlaceholder, QRgb background);
+
 } // namespace ui
 } // namespace warmonger
 
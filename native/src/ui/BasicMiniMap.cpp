@@ -48,7 +48,7 @@ QPoint BasicMiniMap::getWindowPos() const
 
 QRect BasicMiniMap::getMapRect() const
 {
-    return this->mapWindow.getWindowRect();
+    return this->mapWindow.getMapRect();
 }
 
 const QMatrix4x4& BasicMiniMap::getTransformMatrix() const
@@ -0,0 +1,97 @@
+/**
+ * Copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "ui/HexMask.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <QImage>
+
+namespace warmonger {
+namespace ui {
+
+HexMask::HexMask()
+    : width(0)
+    , height(0)
+    , rowWords(0)
+    , bits(1, 0)
+{
+}
+
+HexMask::HexMask(const QImage& image)
+    : width(image.width())
+    , height(image.height())
+    , rowWords((static_cast<std::size_t>(image.width()) + 63) / 64)
+    , bits(std::max<std::size_t>(this->rowWords * image.height(), 1), 0)
+{
+    // Convert once, so the scanlines can be read directly.
+    const QImage argbImage = image.convertToFormat(QImage::Format_ARGB32);
+
+    for (int y = 0; y < this->height; ++y)
+    {
+        const QRgb* line = reinterpret_cast<const QRgb*>(argbImage.constScanLine(y));
+        std::uint64_t* row = &this->bits[y * this->rowWords];
+
+        for (int x = 0; x < this->width; ++x)
+        {
+            if (line[x] == 0xffffffff)
+                row[x / 64] |= std::uint64_t(1) << (x % 64);
+        }
+    }
+}
+
+bool HexMask::contains(const QPointF& p) const
+{
+    const qreal x = p.x();
+    const qreal y = p.y();
+
+    if (x < 0.0 || x >= this->width || y < 0.0 || y >= this->height)
+        return false;
+
+    const int xc = static_cast<int>(std::ceil(x));
+    const int yc = static_cast<int>(std::ceil(y));
+    const int xf = static_cast<int>(std::floor(x));
+    const int yf = static_cast<int>(std::floor(y));
+
+    return this->contains(xc, yc) || this->contains(xf, yf);
+}
+
+void HexMask::contains(const QPoint* points, std::size_t count, bool* results) const
+{
+    const auto width = static_cast<unsigned>(this->width);
+    const auto height = static_cast<unsigned>(this->height);
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        const auto x = static_cast<unsigned>(points[i].x());
+        const auto y = static_cast<unsigned>(points[i].y());
+
+        const bool inside = (x < width) & (y < height);
+
+        // Out-of-bounds points are redirected to the first bit and then
+        // masked out, instead of branching on them.
+        const std::size_t rowOffset = inside ? y * this->rowWords : 0;
+        const std::size_t column = inside ? x : 0;
+
+        results[i] = inside & this->bit(rowOffset, column);
+    }
+}
+
+} // namespace ui
+} // namespace warmonger
@@ -0,0 +1,141 @@
+/** \file
+ * HexMask class.
+ *
+ * \copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef W_UI_HEX_MASK_H
+#define W_UI_HEX_MASK_H
+
+#include <cstdint>
+#include <vector>
+
+#include <QPoint>
+#include <QPointF>
+
+class QImage;
+
+namespace warmonger {
+namespace ui {
+
+/**
+ * Pixel-perfect shape of the hexagon.
+ *
+ * The hexagon-mask image converted into a packed bitset, one bit per
+ * pixel, rows padded to 64 bits. Lookups are a bounds-check, a shift and
+ * a mask, without any of the per-call format conversions of QImage::pixel().
+ */
+class HexMask
+{
+public:
+    /**
+     * Construct an empty mask.
+     *
+     * An empty mask doesn't contain any point.
+     */
+    HexMask();
+
+    /**
+     * Construct the mask from the hexagon-mask image.
+     *
+     * The pixels that belong to the hexagon are white (0xffffffff), all
+     * other pixels are considered to be outside of it.
+     *
+     * \param image the hexagon-mask image
+     */
+    explicit HexMask(const QImage& image);
+
+    int getWidth() const
+    {
+        return this->width;
+    }
+
+    int getHeight() const
+    {
+        return this->height;
+    }
+
+    /**
+     * Does the hexagon contain the pixel?
+     *
+     * \param x the x coordinate
+     * \param y the y coordinate
+     *
+     * \returns wether the pixel is in the hexagon or not, pixels outside
+     * of the mask are never in the hexagon
+     */
+    bool contains(int x, int y) const
+    {
+        // negative coordinates wrap around and fail the bounds-check too
+        if (static_cast<unsigned>(x) >= static_cast<unsigned>(this->width) ||
+            static_cast<unsigned>(y) >= static_cast<unsigned>(this->height))
+            return false;
+
+        return this->bit(static_cast<std::size_t>(y) * this->rowWords, static_cast<std::size_t>(x));
+    }
+
+    /**
+     * Does the hexagon contain the point?
+     *
+     * QPoint overload.
+     */
+    bool contains(const QPoint& p) const
+    {
+        return this->contains(p.x(), p.y());
+    }
+
+    /**
+     * Does the hexagon contain the point?
+     *
+     * The point is in the hexagon if any of the pixels it falls
+     * between is.
+     *
+     * \param p the point
+     *
+     * \returns wether the point is in the hexagon or not
+     */
+    bool contains(const QPointF& p) const;
+
+    /**
+     * Does the hexagon contain the points?
+     *
+     * Batch variant of contains(const QPoint&) const. The loop is
+     * branch-free so that tight loops over many points don't stall on
+     * mispredicted bounds-checks.
+     *
+     * \param points the points to test
+     * \param count the number of points
+     * \param results the results, must have room for `count' elements
+     */
+    void contains(const QPoint* points, std::size_t count, bool* results) const;
+
+private:
+    bool bit(std::size_t rowOffset, std::size_t x) const
+    {
+        return (this->bits[rowOffset + x / 64] >> (x % 64)) & 1u;
+    }
+
+    int width;
+    int height;
+    std::size_t rowWords;
+    std::vector<std::uint64_t> bits;
+};
+
+} // namespace ui
+} // namespace warmonger
+
+#endif // W_UI_HEX_MASK_H
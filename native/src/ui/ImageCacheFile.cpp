@@ -0,0 +1,215 @@
+/**
+ * Copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "ui/ImageCacheFile.h"
+
+#include <cstring>
+
+#include <QSaveFile>
+#include <fmt/ostream.h>
+
+#include "utils/Exception.h"
+#include "utils/ToString.h"
+
+namespace warmonger {
+namespace ui {
+
+namespace {
+
+const char magic[8] = {'W', 'I', 'M', 'G', 'C', 'A', 'C', 'H'};
+const quint32 version{1};
+
+// Pixel data is aligned so that it can be used directly.
+const quint64 dataAlignment{64};
+
+struct FileHeader
+{
+    char magic[8];
+    quint32 version;
+    quint32 count;
+};
+
+struct EntryHeader
+{
+    quint64 nameOffset;
+    quint64 dataOffset;
+    quint64 dataSize;
+    quint32 nameSize;
+    quint32 width;
+    quint32 height;
+    quint32 bytesPerLine;
+    quint32 format;
+    quint32 padding;
+};
+
+} // namespace
+
+static quint64 align(quint64 offset);
+static void writeData(QSaveFile& file, const void* data, qint64 size);
+
+ImageCacheFile::ImageCacheFile(const QString& path)
+    : file(path)
+{
+    if (!this->file.open(QIODevice::ReadOnly))
+    {
+        throw utils::IOError(fmt::format("Failed to open image-cache `{}': {}", path, this->file.errorString()));
+    }
+
+    const qint64 size = this->file.size();
+    if (size < static_cast<qint64>(sizeof(FileHeader)))
+    {
+        throw utils::IOError(fmt::format("Failed to read image-cache `{}': file is too small", path));
+    }
+
+    const uchar* data = this->file.map(0, size);
+    if (data == nullptr)
+    {
+        throw utils::IOError(fmt::format("Failed to map image-cache `{}': {}", path, this->file.errorString()));
+    }
+
+    this->index(data, size);
+}
+
+void ImageCacheFile::write(const QString& path, const Images& images)
+{
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        throw utils::IOError(fmt::format("Failed to open image-cache `{}': {}", path, file.errorString()));
+    }
+
+    std::vector<QByteArray> names;
+    names.reserve(images.size());
+    for (const auto& image : images)
+        names.push_back(image.first.toUtf8());
+
+    std::vector<EntryHeader> entries(images.size());
+
+    quint64 offset = sizeof(FileHeader) + sizeof(EntryHeader) * entries.size();
+    for (std::size_t i = 0; i < images.size(); ++i)
+    {
+        entries[i].nameOffset = offset;
+        entries[i].nameSize = static_cast<quint32>(names[i].size());
+        offset += entries[i].nameSize;
+    }
+
+    for (std::size_t i = 0; i < images.size(); ++i)
+    {
+        const QImage& image = images[i].second;
+
+        offset = align(offset);
+
+        entries[i].dataOffset = offset;
+        entries[i].dataSize = static_cast<quint64>(image.bytesPerLine()) * image.height();
+        entries[i].width = image.width();
+        entries[i].height = image.height();
+        entries[i].bytesPerLine = image.bytesPerLine();
+        entries[i].format = image.format();
+        entries[i].padding = 0;
+
+        offset += entries[i].dataSize;
+    }
+
+    FileHeader header;
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.count = static_cast<quint32>(entries.size());
+
+    writeData(file, &header, sizeof(header));
+    writeData(file, entries.data(), sizeof(EntryHeader) * entries.size());
+
+    for (const auto& name : names)
+        writeData(file, name.constData(), name.size());
+
+    const QByteArray padding(dataAlignment, '\0');
+    for (std::size_t i = 0; i < images.size(); ++i)
+    {
+        writeData(file, padding.constData(), entries[i].dataOffset - file.pos());
+        writeData(file, images[i].second.constBits(), entries[i].dataSize);
+    }
+
+    if (!file.commit())
+    {
+        throw utils::IOError(fmt::format("Failed to write image-cache `{}': {}", path, file.errorString()));
+    }
+}
+
+void ImageCacheFile::index(const uchar* data, qint64 size)
+{
+    const QString path = this->file.fileName();
+
+    FileHeader header;
+    std::memcpy(&header, data, sizeof(header));
+
+    if (std::memcmp(header.magic, magic, sizeof(magic)) != 0 || header.version != version)
+    {
+        throw utils::IOError(fmt::format("Failed to read image-cache `{}': not an image-cache or wrong version", path));
+    }
+
+    const quint64 fileSize = static_cast<quint64>(size);
+
+    if (sizeof(FileHeader) + sizeof(EntryHeader) * static_cast<quint64>(header.count) > fileSize)
+    {
+        throw utils::IOError(fmt::format("Failed to read image-cache `{}': entry table is truncated", path));
+    }
+
+    this->images.reserve(header.count);
+
+    for (quint32 i = 0; i < header.count; ++i)
+    {
+        EntryHeader entry;
+        std::memcpy(&entry, data + sizeof(FileHeader) + sizeof(EntryHeader) * i, sizeof(entry));
+
+        if (entry.nameOffset + entry.nameSize > fileSize || entry.dataOffset + entry.dataSize > fileSize ||
+            entry.dataSize != static_cast<quint64>(entry.bytesPerLine) * entry.height || entry.format == 0 ||
+            entry.format >= QImage::NImageFormats)
+        {
+            throw utils::IOError(fmt::format("Failed to read image-cache `{}': entry #{} is corrupt", path, i));
+        }
+
+        const QString name =
+            QString::fromUtf8(reinterpret_cast<const char*>(data + entry.nameOffset), static_cast<int>(entry.nameSize));
+
+        // The image refers to the mapped data, it is read-only so any
+        // attempt to modify it will detach.
+        QImage image(data + entry.dataOffset,
+            static_cast<int>(entry.width),
+            static_cast<int>(entry.height),
+            static_cast<int>(entry.bytesPerLine),
+            static_cast<QImage::Format>(entry.format));
+
+        this->images.emplace_back(name, std::move(image));
+    }
+}
+
+static quint64 align(quint64 offset)
+{
+    return (offset + dataAlignment - 1) / dataAlignment * dataAlignment;
+}
+
+static void writeData(QSaveFile& file, const void* data, qint64 size)
+{
+    if (size > 0 && file.write(reinterpret_cast<const char*>(data), size) != size)
+    {
+        file.cancelWriting();
+        throw utils::IOError(fmt::format("Failed to write image-cache `{}': {}", file.fileName(), file.errorString()));
+    }
+}
+
+} // namespace ui
+} // namespace warmonger
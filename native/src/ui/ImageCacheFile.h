@@ -0,0 +1,98 @@
+/** \file
+ * ImageCacheFile class.
+ *
+ * \copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef W_UI_IMAGE_CACHE_FILE_H
+#define W_UI_IMAGE_CACHE_FILE_H
+
+#include <utility>
+#include <vector>
+
+#include <QFile>
+#include <QImage>
+#include <QString>
+
+namespace warmonger {
+namespace ui {
+
+/**
+ * Read-only, memory-mapped file of decoded images.
+ *
+ * Used to persist the decoded images of a world-surface across runs, so
+ * that they can be used without decoding them again. The images are stored
+ * with their raw pixel data, in whatever format they were passed in, and
+ * the loaded images point directly into the mapped region, which stays
+ * valid for the lifetime of the object.
+ * The file is in the native byte-order, it is not meant to be portable.
+ */
+class ImageCacheFile
+{
+public:
+    using Images = std::vector<std::pair<QString, QImage>>;
+
+    /**
+     * Open, map and index the file.
+     *
+     * \param path the path to the file
+     *
+     * \throws utils::IOError if the file can't be opened, mapped or
+     * it's not a valid image-cache file
+     */
+    explicit ImageCacheFile(const QString& path);
+
+    ImageCacheFile(const ImageCacheFile&) = delete;
+    ImageCacheFile& operator=(const ImageCacheFile&) = delete;
+
+    /**
+     * Get the images.
+     *
+     * The images reference the mapped data, they must not be used after
+     * this object is destroyed.
+     *
+     * \returns the images, with their paths
+     */
+    const Images& getImages() const
+    {
+        return this->images;
+    }
+
+    /**
+     * Write the images to a new image-cache file.
+     *
+     * The file is written atomically, i.e. it is either fully written
+     * or not at all.
+     *
+     * \param path the path to the file
+     * \param images the images, with their paths
+     *
+     * \throws utils::IOError if writing the file fails
+     */
+    static void write(const QString& path, const Images& images);
+
+private:
+    void index(const uchar* data, qint64 size);
+
+    QFile file;
+    Images images;
+};
+
+} // namespace ui
+} // namespace warmonger
+
+#endif // W_UI_IMAGE_CACHE_FILE_H
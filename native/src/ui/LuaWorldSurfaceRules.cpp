@@ -18,15 +18,18 @@
 
 #include "ui/LuaWorldSurfaceRules.h"
 
-#include "core/Map.h"
-#include "core/Settlement.h"
+#include "core/MapSnapshot.h"
+#include "core/World.h"
 #include "ui/WorldSurface.h"
+#include "utils/Exception.h"
 #include "utils/Lua.h"
+#include "utils/LuaProfiler.h"
+#include "utils/Profiling.h"
 
 namespace sol {
 
 template <>
-struct is_container<::warmonger::core::MapNodeNeighbours> : std::false_type
+struct is_container<::warmonger::core::MapNodeSnapshotNeighbours> : std::false_type
 {
 };
 
@@ -35,23 +38,63 @@ struct is_container<::warmonger::core::MapNodeNeighbours> : std::false_type
 namespace warmonger {
 namespace ui {
 
-static int getObjectId(const core::WObject& obj);
+namespace {
+
+/*
+ * The properties of the world-surface exposed to the rules as `WS'.
+ *
+ * The rules can run on a worker thread (see MapRenderer), so they get a
+ * copy instead of the world-surface QObject. The copied properties are set
+ * when the world-surface is constructed and don't change afterwards.
+ */
+struct WorldSurfaceProperties
+{
+    QString name;
+    int tileSize;
+    int gridSize;
+    std::unordered_map<QString, WorldSurface::AssetId> assetIds;
+
+    WorldSurface::AssetId getAssetIdFor(const QString& assetName) const
+    {
+        const auto it = this->assetIds.find(assetName);
+        if (it == this->assetIds.end())
+            throw utils::ValueError(fmt::format("Unknown asset `{}'", assetName.toStdString()));
+
+        return it->second;
+    }
+};
+
+} // namespace
+
+template <typename T>
+static int getObjectId(const T& obj);
+static void addGridTiles(graphics::Map& graphicMap, const sol::table& gridTiles);
 static void exposeAPI(sol::state& lua);
 
 LuaWorldSurfaceRules::LuaWorldSurfaceRules(WorldSurface& worldSurface)
     : WorldSurfaceRules(worldSurface)
     , state(std::make_unique<sol::state>())
+    , lastLayerCount(0)
+    , lastGridTileCount(0)
 {
     sol::state& lua = *this->state;
 
     utils::initLuaAPI(lua);
     exposeAPI(lua);
 
-    lua["WS"] = &this->getWorldSurface();
+    const WorldSurface& worldSurface = this->getWorldSurface();
+    lua["WS"] = WorldSurfaceProperties{
+        worldSurface.getName(), worldSurface.getTileSize(), worldSurface.getGridSize(), worldSurface.getAssetIds()};
+
+    if (utils::LuaProfiler::isRequested())
+        this->profiler = std::make_unique<utils::LuaProfiler>(lua.lua_state(),
+            fmt::format("world-surface-rules of {}", this->getWorldSurface().getName().toStdString()));
 }
 
 LuaWorldSurfaceRules::~LuaWorldSurfaceRules()
 {
+    if (this->profiler)
+        this->profiler->logReport();
 }
 
 void LuaWorldSurfaceRules::loadRules(const QString& basePath, const QString& mainRulesFile)
@@ -72,21 +115,57 @@ void LuaWorldSurfaceRules::loadRules(const QString& basePath, const QString& mai
     }
 }
 
-graphics::Map LuaWorldSurfaceRules::renderMap(core::Map& map)
+graphics::Map LuaWorldSurfaceRules::renderMap(const core::MapSnapshot& map)
 {
+    wProfileZone("LuaWorldSurfaceRules::renderMap");
+
+    graphics::Map graphicMap;
+
+    // The map is likely to have a similar content to the last time it was
+    // rendered, so reserving the same amount avoids most reallocations.
+    graphicMap.reserve(map.getMapNodes().size(), this->lastLayerCount, this->lastGridTileCount);
+
     try
     {
-        return this->renderMapFunc(map);
+        this->renderMapFunc(map, &graphicMap);
     }
     catch (sol::error& e)
     {
         throw utils::ScriptError(fmt::format("LuaWorldSurfaceRules: render_map() failed: {}", e.what()));
     }
+
+    this->lastLayerCount = graphicMap.layers.size();
+    this->lastGridTileCount = graphicMap.gridTiles.size();
+
+    return graphicMap;
 }
 
-static int getObjectId(const core::WObject& obj)
+template <typename T>
+static int getObjectId(const T& obj)
 {
-    return obj.getId().get();
+    return obj.id.get();
+}
+
+/*
+ * Bulk append: the grid-tiles are passed as a flat array of
+ * {x, y, width, height, asset_id, x, y, ...}, this avoids creating a
+ * userdata for each grid-tile.
+ */
+static void addGridTiles(graphics::Map& graphicMap, const sol::table& gridTiles)
+{
+    const std::size_t size = gridTiles.size();
+
+    if (size % 5 != 0)
+        throw utils::ValueError(
+            fmt::format("Cannot add grid-tiles: expected 5 values per grid-tile, got {} values in total", size));
+
+    for (std::size_t i = 1; i <= size; i += 5)
+    {
+        const auto [x, y, width, height, assetId] =
+            gridTiles.raw_get<int, int, int, int, int>(i, i + 1, i + 2, i + 3, i + 4);
+
+        graphicMap.addGridTile(graphics::GridTile{x, y, width, height, assetId});
+    }
 }
 
 static void exposeAPI(sol::state& lua)
@@ -117,109 +196,131 @@ static void exposeAPI(sol::state& lua)
         "colors",
         sol::property(&core::World::getColors));
 
-    lua.new_usertype<core::MapNodeNeighbours>("map_node_neighbours",
+    lua.new_usertype<core::MapNodeSnapshotNeighbours>("map_node_neighbours",
         sol::meta_function::construct,
         sol::no_constructor,
         "west",
-        sol::property([](const core::MapNodeNeighbours& neighbours) { return neighbours.at(core::Direction::West); }),
+        sol::property([](const core::MapNodeSnapshotNeighbours& neighbours) {
+            return neighbours.at(core::Direction::West);
+        }),
         "north_west",
-        sol::property(
-            [](const core::MapNodeNeighbours& neighbours) { return neighbours.at(core::Direction::NorthWest); }),
+        sol::property([](const core::MapNodeSnapshotNeighbours& neighbours) {
+            return neighbours.at(core::Direction::NorthWest);
+        }),
         "north_east",
-        sol::property(
-            [](const core::MapNodeNeighbours& neighbours) { return neighbours.at(core::Direction::NorthEast); }),
+        sol::property([](const core::MapNodeSnapshotNeighbours& neighbours) {
+            return neighbours.at(core::Direction::NorthEast);
+        }),
         "east",
-        sol::property([](const core::MapNodeNeighbours& neighbours) { return neighbours.at(core::Direction::East); }),
+        sol::property([](const core::MapNodeSnapshotNeighbours& neighbours) {
+            return neighbours.at(core::Direction::East);
+        }),
         "south_east",
-        sol::property(
-            [](const core::MapNodeNeighbours& neighbours) { return neighbours.at(core::Direction::SouthEast); }),
+        sol::property([](const core::MapNodeSnapshotNeighbours& neighbours) {
+            return neighbours.at(core::Direction::SouthEast);
+        }),
         "south_west",
-        sol::property(
-            [](const core::MapNodeNeighbours& neighbours) { return neighbours.at(core::Direction::SouthWest); }));
+        sol::property([](const core::MapNodeSnapshotNeighbours& neighbours) {
+            return neighbours.at(core::Direction::SouthWest);
+        }));
 
-    lua.new_usertype<core::MapNode>("map_node",
+    lua.new_usertype<core::MapNodeSnapshot>("map_node",
         sol::meta_function::construct,
         sol::no_constructor,
         "id",
-        sol::property(getObjectId),
+        sol::property(getObjectId<core::MapNodeSnapshot>),
         "neighbours",
-        sol::property(&core::MapNode::getNeighbours),
+        sol::property([](const core::MapNodeSnapshot& mapNode) { return &mapNode.neighbours; }),
         "terrain_type",
-        sol::property(&core::MapNode::getTerrainType));
+        sol::readonly(&core::MapNodeSnapshot::terrainType),
+        "owner",
+        sol::readonly(&core::MapNodeSnapshot::owner),
+        "borders",
+        sol::property([](const core::MapNodeSnapshot& mapNode) { return &mapNode.borders; }),
+        "settlement",
+        sol::readonly(&core::MapNodeSnapshot::settlement));
 
-    lua.new_usertype<core::Faction>("faction",
+    lua.new_usertype<core::FactionSnapshot>("faction",
         sol::meta_function::construct,
         sol::no_constructor,
         "id",
-        sol::property(getObjectId),
+        sol::property(getObjectId<core::FactionSnapshot>),
         "name",
-        sol::property(&core::Faction::getName),
+        sol::readonly(&core::FactionSnapshot::name),
         "primary_color",
-        sol::property(&core::Faction::getPrimaryColor),
+        sol::readonly(&core::FactionSnapshot::primaryColor),
         "secondary_color",
-        sol::property(&core::Faction::getSecondaryColor),
+        sol::readonly(&core::FactionSnapshot::secondaryColor),
         "banner",
-        sol::property(&core::Faction::getBanner),
+        sol::readonly(&core::FactionSnapshot::banner),
         "civilization",
-        sol::property(&core::Faction::getCivilization));
+        sol::readonly(&core::FactionSnapshot::civilization),
+        "settlements",
+        sol::property([](const core::FactionSnapshot& faction) {
+            return sol::as_table(std::vector<const core::SettlementSnapshot*>(faction.settlements));
+        }),
+        "owned_map_node_count",
+        sol::readonly(&core::FactionSnapshot::ownedMapNodeCount));
 
-    lua.new_usertype<core::Settlement>("settlement",
+    lua.new_usertype<core::SettlementSnapshot>("settlement",
         sol::meta_function::construct,
         sol::no_constructor,
         "id",
-        sol::property(getObjectId),
+        sol::property(getObjectId<core::SettlementSnapshot>),
         "type",
-        sol::property(&core::Settlement::getType),
+        sol::readonly(&core::SettlementSnapshot::type),
         "position",
-        sol::property(&core::Settlement::getPosition),
+        sol::readonly(&core::SettlementSnapshot::position),
         "owner",
-        sol::property(&core::Settlement::getOwner));
+        sol::readonly(&core::SettlementSnapshot::owner));
 
-    lua.new_usertype<core::Map>("map",
+    lua.new_usertype<core::MapSnapshot>("map",
         sol::meta_function::construct,
         sol::no_constructor,
         "name",
-        sol::property(&core::Map::getName),
+        sol::property(&core::MapSnapshot::getName),
         "world",
-        sol::property(&core::Map::getWorld),
+        sol::property(&core::MapSnapshot::getWorld),
         "map_nodes",
-        sol::property(&core::Map::getMapNodes),
+        sol::property(&core::MapSnapshot::getMapNodes),
         "factions",
-        sol::property(&core::Map::getFactions),
+        sol::property(&core::MapSnapshot::getFactions),
         "settlements",
-        sol::property(&core::Map::getSettlements));
-
-    lua.new_usertype<graphics::GridTile>("graphic_grid_tile",
-        "x",
-        &graphics::GridTile::x,
-        "y",
-        &graphics::GridTile::y,
-        "width",
-        &graphics::GridTile::width,
-        "height",
-        &graphics::GridTile::height,
-        "asset_id",
-        &graphics::GridTile::assetId);
-
-    lua.new_usertype<graphics::MapNodeLayer>(
-        "graphic_map_node_layer", "grid_tiles", &graphics::MapNodeLayer::gridTiles);
+        sol::property(&core::MapSnapshot::getSettlements));
 
-    lua.new_usertype<graphics::MapNode>(
-        "graphic_map_node", "map_node", &graphics::MapNode::mapNode, "layers", &graphics::MapNode::layers);
-
-    lua.new_usertype<graphics::Map>("graphic_map", "map_nodes", &graphics::Map::mapNodes);
-
-    lua.new_usertype<WorldSurface>("world_surface",
+    // The graphic-map is passed to render_map() to be filled in, it can only
+    // be appended to. The map-node snapshot is only used to identify the
+    // map-node, the graphic-map stores the original map-node.
+    lua.new_usertype<graphics::Map>("graphic_map",
+        sol::meta_function::construct,
+        sol::no_constructor,
+        "begin_map_node",
+        [](graphics::Map& graphicMap, const core::MapNodeSnapshot* mapNode) {
+            if (mapNode == nullptr)
+                throw utils::ValueError("begin_map_node(): map-node is nil");
+
+            graphicMap.beginMapNode(mapNode->mapNode);
+        },
+        "begin_layer",
+        &graphics::Map::beginLayer,
+        "add_grid_tile",
+        [](graphics::Map& graphicMap, int x, int y, int width, int height, int assetId) {
+            graphicMap.addGridTile(graphics::GridTile{x, y, width, height, assetId});
+        },
+        "add_grid_tiles",
+        addGridTiles);
+
+    lua.new_usertype<WorldSurfaceProperties>("world_surface",
         sol::meta_function::construct,
         sol::no_constructor,
         "name",
-        sol::property(&WorldSurface::getName),
+        sol::readonly(&WorldSurfaceProperties::name),
         "tile_size",
-        sol::property(&WorldSurface::getTileSize),
+        sol::readonly(&WorldSurfaceProperties::tileSize),
         "grid_size",
-        sol::property(&WorldSurface::getGridSize),
+        sol::readonly(&WorldSurfaceProperties::gridSize),
         "get_asset_id_for",
-        &WorldSurface::getAssetIdFor);
+        &WorldSurfaceProperties::getAssetIdFor);
 }
 
 } // namespace ui
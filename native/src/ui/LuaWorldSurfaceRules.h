@@ -30,6 +30,11 @@ class state;
 }
 
 namespace warmonger {
+
+namespace utils {
+class LuaProfiler;
+}
+
 namespace ui {
 
 /**
@@ -43,11 +48,28 @@ public:
 
     void loadRules(const QString& basePath, const QString& mainRulesFile) override;
 
-    graphics::Map renderMap(core::Map& map) override;
+    graphics::Map renderMap(const core::MapSnapshot& map) override;
+
+    /**
+     * Get the profiler of the rules.
+     *
+     * The rules are profiled if LuaProfiler::isRequested(), in which
+     * case the report is logged when the rules are destroyed.
+     *
+     * \returns the profiler, nullptr if the rules are not profiled
+     */
+    utils::LuaProfiler* getProfiler()
+    {
+        return this->profiler.get();
+    }
 
 private:
     std::unique_ptr<sol::state> state; // to avoid exposing the massive sol.hpp
-    std::function<graphics::Map(core::Map& map)> renderMapFunc;
+    std::unique_ptr<utils::LuaProfiler> profiler;
+    std::function<void(const core::MapSnapshot& map, graphics::Map* graphicMap)> renderMapFunc;
+    // sizes of the previous result, used for reserving capacity
+    std::size_t lastLayerCount;
+    std::size_t lastGridTileCount;
 };
 
 } // namespace ui
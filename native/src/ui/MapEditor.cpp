@@ -16,6 +16,7 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include <algorithm>
 #include <random>
 
 #include <QCursor>
@@ -23,6 +24,7 @@
 #include <QMetaEnum>
 #include <QSGSimpleTextureNode>
 
+#include "core/Settlement.h"
 #include "ui/MapEditor.h"
 #include "ui/MapUtil.h"
 #include "ui/MapWatcher.h"
@@ -55,6 +57,7 @@ void MapEditor::setMap(core::Map* map)
         {
             QObject::disconnect(this->map, nullptr, this, nullptr);
             delete this->watcher;
+            this->journal.reset();
         }
 
         this->map = map;
@@ -62,12 +65,17 @@ void MapEditor::setMap(core::Map* map)
 
         if (this->map)
         {
+            this->journal = std::make_unique<core::MapJournal>(*this->map);
             this->watcher = new MapWatcher(this->map, this);
             QObject::connect(this->watcher, &MapWatcher::changed, this, &MapEditor::update);
             QObject::connect(this->map, &core::Map::mapNodesChanged, this, &MapEditor::onMapNodesChanged);
+            QObject::connect(this->map, &core::Map::factionsChanged, this, &MapEditor::onFactionsChanged);
         }
 
+        this->onFactionsChanged();
+
         emit mapChanged();
+        emit historyChanged();
     }
 }
 
@@ -144,6 +152,11 @@ void MapEditor::setNumberOfFactions(int n)
     std::size_t newSize = static_cast<std::size_t>(n);
     std::size_t currentSize = this->map->getFactions().size();
 
+    if (newSize == currentSize)
+        return;
+
+    this->journal->beginCommand();
+
     if (newSize > currentSize)
     {
         const std::vector<core::Civilization*>& civilizations = this->map->getWorld()->getCivilizations();
@@ -154,18 +167,22 @@ void MapEditor::setNumberOfFactions(int n)
 
         for (std::size_t i = currentSize; i < newSize; ++i)
         {
-            auto faction = this->map->createFaction();
-            faction->setCivilization(civilizations.at(dist(mtd)));
+            auto faction = this->journal->createFaction();
+            this->journal->setCivilization(faction, civilizations.at(dist(mtd)));
         }
     }
     else if (newSize < currentSize)
     {
         const std::vector<core::Faction*>& factions = this->map->getFactions();
-        for (std::size_t i = newSize; i < currentSize; ++i)
+        while (factions.size() > newSize)
         {
-            this->map->removeFaction(factions.at(i));
+            this->journal->removeFaction(factions.back());
         }
     }
+
+    this->journal->endCommand();
+
+    emit historyChanged();
 }
 
 void MapEditor::setCurrentFaction(core::Faction* currentFaction)
@@ -180,6 +197,18 @@ void MapEditor::setCurrentFaction(core::Faction* currentFaction)
     }
 }
 
+void MapEditor::undo()
+{
+    if (this->journal && this->journal->undo())
+        emit historyChanged();
+}
+
+void MapEditor::redo()
+{
+    if (this->journal && this->journal->redo())
+        emit historyChanged();
+}
+
 void MapEditor::hoverMoveEvent(QHoverEvent* event)
 {
     const QPoint mapPos = this->windowPosToMapPos(event->pos());
@@ -280,6 +309,26 @@ void MapEditor::onMapNodesChanged()
     this->updateMapRect();
 }
 
+/*
+ * The current faction might have been removed from the map, e.g. by
+ * undoing its creation, keeping it would grant settlements to a faction
+ * that is not part of the map.
+ */
+void MapEditor::onFactionsChanged()
+{
+    if (this->currentFaction == nullptr)
+        return;
+
+    if (this->map != nullptr)
+    {
+        const auto& factions = this->map->getFactions();
+        if (std::find(factions.cbegin(), factions.cend(), this->currentFaction) != factions.cend())
+            return;
+    }
+
+    this->setCurrentFaction(nullptr);
+}
+
 void MapEditor::doEditingAction(const QPoint&)
 {
     switch (this->editingMode)
@@ -303,6 +352,17 @@ void MapEditor::doEditingAction(const QPoint&)
 
 void MapEditor::doGrantToCurrentFactionEditingAction()
 {
+    if (this->map == nullptr || this->hoverMapNode == nullptr)
+        return;
+
+    core::Settlement* settlement = this->map->getSettlementAt(this->hoverMapNode);
+
+    if (settlement == nullptr || settlement->getOwner() == this->currentFaction)
+        return;
+
+    this->journal->setOwner(settlement, this->currentFaction);
+
+    emit historyChanged();
 }
 
 bool MapEditor::isCurrentEditingActionPossible() const
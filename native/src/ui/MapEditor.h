@@ -22,9 +22,11 @@
 #define W_UI_MAP_EDITOR_H
 
 #include <experimental/optional>
+#include <memory>
 #include <unordered_map>
 
 #include "core/Map.h"
+#include "core/MapJournal.h"
 #include "ui/BasicMap.h"
 #include "ui/WorldSurface.h"
 
@@ -55,6 +57,8 @@ class MapEditor : public BasicMap
             editingModeChanged)
     Q_PROPERTY(warmonger::core::Faction* currentFaction READ getCurrentFaction WRITE setCurrentFaction NOTIFY
             currentFactionChanged)
+    Q_PROPERTY(bool canUndo READ canUndo NOTIFY historyChanged)
+    Q_PROPERTY(bool canRedo READ canRedo NOTIFY historyChanged)
 
 public:
     /**
@@ -187,6 +191,7 @@ public:
      * EditingMode::GrantToCurrentFaction.
      * The current faction can be nullptr (unassigned), in this case the
      * settlements and armies will have no owner.
+     * It is reset to nullptr when the faction is removed from the map.
      * Will emit the signal MapEditor::currentFactionChanged() if the
      * newly set value is different than the current one.
      *
@@ -194,6 +199,45 @@ public:
      */
     void setCurrentFaction(core::Faction* currentFaction);
 
+    /**
+     * Get the journal of the edits.
+     *
+     * All edits made by the map-editor are recorded in the journal. The
+     * journal is reset when a new campaign-map is set.
+     *
+     * \return the journal, nullptr if there is no campaign-map set
+     */
+    core::MapJournal* getJournal() const
+    {
+        return this->journal.get();
+    }
+
+    bool canUndo() const
+    {
+        return this->journal && this->journal->canUndo();
+    }
+
+    bool canRedo() const
+    {
+        return this->journal && this->journal->canRedo();
+    }
+
+    /**
+     * Undo the last edit.
+     *
+     * Will emit the signal MapEditor::historyChanged() if there was an
+     * edit to undo.
+     */
+    Q_INVOKABLE void undo();
+
+    /**
+     * Redo the last undone edit.
+     *
+     * Will emit the signal MapEditor::historyChanged() if there was an
+     * edit to redo.
+     */
+    Q_INVOKABLE void redo();
+
 signals:
     /**
      * Emitted when the map-node changes.
@@ -215,6 +259,11 @@ signals:
      */
     void currentFactionChanged();
 
+    /**
+     * Emitted when an edit is made, undone or redone.
+     */
+    void historyChanged();
+
 protected:
     void hoverMoveEvent(QHoverEvent* event) override;
     void hoverEnterEvent(QHoverEvent* event) override;
@@ -225,6 +274,7 @@ private:
     void updateContent();
     void updateMapRect();
     void onMapNodesChanged();
+    void onFactionsChanged();
     void doEditingAction(const QPoint& pos);
     void doGrantToCurrentFactionEditingAction();
     bool isCurrentEditingActionPossible() const;
@@ -240,6 +290,7 @@ private:
     core::Faction* currentFaction;
 
     MapWatcher* watcher;
+    std::unique_ptr<core::MapJournal> journal;
 };
 
 } // namespace ui
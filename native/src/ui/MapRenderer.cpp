@@ -0,0 +1,132 @@
+/**
+ * Copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "ui/MapRenderer.h"
+
+#include <exception>
+
+#include "core/Map.h"
+#include "core/MapSnapshot.h"
+#include "ui/WorldSurface.h"
+#include "utils/Logging.h"
+
+namespace warmonger {
+namespace ui {
+
+MapRenderer::MapRenderer(WorldSurface& worldSurface, QObject* parent)
+    : QObject(parent)
+    , worldSurface(worldSurface)
+    , stopping(false)
+    , generation(0)
+    , worker(&MapRenderer::run, this)
+{
+}
+
+MapRenderer::~MapRenderer()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+
+    this->jobAvailable.notify_one();
+    this->worker.join();
+}
+
+void MapRenderer::render(const core::Map& map, const core::Territory* territory)
+{
+    auto snapshot = std::make_unique<const core::MapSnapshot>(map, territory);
+
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+
+        if (this->pendingJob.snapshot)
+            wDebug << "Skipping superseded render request #" << this->pendingJob.generation;
+
+        this->pendingJob.generation = ++this->generation;
+        this->pendingJob.snapshot = std::move(snapshot);
+    }
+
+    this->jobAvailable.notify_one();
+}
+
+std::shared_ptr<const graphics::Map> MapRenderer::takeFrame()
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    if (this->backFrame)
+        this->frontFrame = std::move(this->backFrame);
+
+    return this->frontFrame;
+}
+
+void MapRenderer::run()
+{
+    // Created lazily, on the worker thread, so that the script-state
+    // is only ever touched by this thread.
+    std::unique_ptr<WorldSurfaceRules> rules;
+
+    while (true)
+    {
+        Job job;
+
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->jobAvailable.wait(lock, [this] { return this->stopping || this->pendingJob.snapshot; });
+
+            if (this->stopping)
+                return;
+
+            job = std::move(this->pendingJob);
+        }
+
+        std::shared_ptr<const graphics::Map> frame;
+
+        try
+        {
+            if (!rules)
+                rules = this->worldSurface.createRules();
+
+            frame = std::make_shared<const graphics::Map>(rules->renderMap(*job.snapshot));
+        }
+        catch (std::exception& e)
+        {
+            // Anything escaping the worker would terminate the process.
+            // FIXME: we need a way to communicate this to the user.
+            wError.format("Failed to render map `{}': {}", job.snapshot->getName(), e.what());
+            continue;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+
+            if (job.generation != this->generation)
+            {
+                wDebug << "Discarding superseded frame #" << job.generation;
+                continue;
+            }
+
+            this->backFrame = std::move(frame);
+        }
+
+        emit frameReady();
+    }
+}
+
+} // namespace ui
+} // namespace warmonger
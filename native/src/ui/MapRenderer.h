@@ -0,0 +1,136 @@
+/** \file
+ * MapRenderer class.
+ *
+ * \copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef W_UI_MAP_RENDERER_H
+#define W_UI_MAP_RENDERER_H
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <QObject>
+
+#include "ui/WorldSurfaceRules.h"
+
+namespace warmonger {
+
+namespace core {
+class Map;
+class MapSnapshot;
+class Territory;
+} // namespace core
+
+namespace ui {
+
+class WorldSurface;
+
+/**
+ * Evaluates the render rules of the world-surface in the background.
+ *
+ * The rules are run on a dedicated worker thread, with its own rules
+ * instance (and thus its own script-state), on a snapshot of the map.
+ * The results are published into a double-buffer: the front frame is the
+ * one being displayed, the back frame is the latest one finished by the
+ * worker. MapRenderer::takeFrame() swaps the two, so the previous frame
+ * stays on the screen until the new one is ready.
+ * Only the latest request is of interest, requests that are superseded
+ * before the worker gets to them are skipped and results that are
+ * superseded while being rendered are discarded.
+ */
+class MapRenderer : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * Construct the renderer and start the worker thread.
+     *
+     * The world-surface has to outlive the renderer.
+     *
+     * \param worldSurface the world-surface whose rules are used
+     * \param parent the parent QObject
+     */
+    MapRenderer(WorldSurface& worldSurface, QObject* parent = nullptr);
+
+    /**
+     * Stop and join the worker thread.
+     *
+     * Waits for the current rendering (if any) to finish.
+     */
+    ~MapRenderer();
+
+    /**
+     * Request the rendering of the map.
+     *
+     * Takes a snapshot of the map and passes it to the worker. Only the
+     * snapshot is taken on the calling thread, which must be the thread
+     * owning the map.
+     *
+     * \param map the map to render
+     * \param territory the territory of the map, can be nullptr
+     */
+    void render(const core::Map& map, const core::Territory* territory = nullptr);
+
+    /**
+     * Get the frame to display.
+     *
+     * If a new frame was published since the last call it is swapped in.
+     * Can be called from any thread, it is meant to be called from
+     * QQuickItem::updatePaintNode().
+     *
+     * \returns the frame, nullptr if no frame was rendered yet
+     */
+    std::shared_ptr<const graphics::Map> takeFrame();
+
+signals:
+    /**
+     * Emitted when a new frame is published.
+     *
+     * Emitted from the worker thread.
+     */
+    void frameReady();
+
+private:
+    struct Job
+    {
+        unsigned int generation = 0;
+        std::unique_ptr<const core::MapSnapshot> snapshot;
+    };
+
+    void run();
+
+    WorldSurface& worldSurface;
+
+    std::mutex mutex;
+    std::condition_variable jobAvailable;
+    bool stopping;
+    unsigned int generation;
+    Job pendingJob;
+    std::shared_ptr<const graphics::Map> frontFrame;
+    std::shared_ptr<const graphics::Map> backFrame;
+
+    std::thread worker;
+};
+
+} // namespace ui
+} // namespace warmonger
+
+#endif // W_UI_MAP_RENDERER_H
@@ -29,6 +29,7 @@
 #include "ui/MapUtil.h"
 #include "ui/WorldSurface.h"
 #include "utils/Logging.h"
+#include "utils/Profiling.h"
 #include "utils/Settings.h"
 
 namespace warmonger {
@@ -87,6 +88,8 @@ core::MapNodeNeighbours neighboursByPos(
 
 std::unordered_map<core::MapNode*, QPoint> positionMapNodes(core::MapNode* startNode, int tileSize)
 {
+    wProfileZone("positionMapNodes");
+
     std::unordered_map<core::MapNode*, QPoint> nodesPos;
 
     nodesPos.insert(std::make_pair(startNode, QPoint(0, 0)));
@@ -21,6 +21,8 @@
 #include <QGuiApplication>
 #include <QSGSimpleTextureNode>
 
+#include "core/MapSnapshot.h"
+#include "ui/MapRenderer.h"
 #include "ui/MapUtil.h"
 #include "ui/MapWatcher.h"
 #include "ui/Render.h"
@@ -35,7 +37,10 @@ MapView::MapView(QQuickItem* parent)
     : QQuickItem(parent)
     , map(nullptr)
     , worldSurface(nullptr)
+    , faction(nullptr)
+    , renderer(nullptr)
     , watcher(nullptr)
+    , terrainWatcher(nullptr)
 {
     QObject::connect(this, &MapView::widthChanged, this, &MapView::updateTransform);
     QObject::connect(this, &MapView::heightChanged, this, &MapView::updateTransform);
@@ -53,16 +58,25 @@ void MapView::setMap(core::Map* map)
         {
             QObject::disconnect(this->map, nullptr, this, nullptr);
             delete this->watcher;
+            delete this->terrainWatcher;
+            this->terrainWatcher = nullptr;
         }
 
         this->map = map;
+        this->territory.reset();
+        if (this->map)
+            this->territory = std::make_unique<core::Territory>(*this->map);
+        this->visibility.reset();
+        this->updateVisibility();
         this->updateContent();
 
         if (this->map)
         {
             this->watcher = new MapWatcher(this->map, this);
-            QObject::connect(this->watcher, &MapWatcher::changed, this, &MapView::update);
+            QObject::connect(this->watcher, &MapWatcher::changed, this, &MapView::requestRender);
             QObject::connect(this->map, &core::Map::mapNodesChanged, this, &MapView::onMapNodesChanged);
+            QObject::connect(this->map, &core::Map::settlementsChanged, this, &MapView::requestRender);
+            this->connectTerrainSignals();
         }
 
         emit mapChanged();
@@ -75,13 +89,46 @@ void MapView::setWorldSurface(WorldSurface* worldSurface)
     {
         wInfo << "worldSurface `" << this->worldSurface << "' -> `" << worldSurface << "'";
 
+        QObject::disconnect(this->loadingProgressConnection);
+
         this->worldSurface = worldSurface;
+
+        // The renderer has to go before the world-surface it references.
+        delete this->renderer;
+        this->renderer = nullptr;
+        this->graphicMap.reset();
+
+        if (this->worldSurface != nullptr)
+        {
+            this->renderer = new MapRenderer(*this->worldSurface, this);
+            QObject::connect(this->renderer, &MapRenderer::frameReady, this, &MapView::update);
+
+            // Schedule a frame for newly decoded images, so that their
+            // textures get created before they are needed.
+            this->loadingProgressConnection = QObject::connect(
+                this->worldSurface, &WorldSurface::loadingProgressChanged, this, &MapView::update);
+        }
+
         this->updateContent();
 
         emit worldSurfaceChanged();
     }
 }
 
+void MapView::setFaction(core::Faction* faction)
+{
+    if (this->faction != faction)
+    {
+        wInfo << "faction `" << this->faction << "' -> `" << faction << "'";
+
+        this->faction = faction;
+        this->updateVisibility();
+        this->update();
+
+        emit factionChanged();
+    }
+}
+
 QSGNode* MapView::updatePaintNode(QSGNode* oldRootNode, UpdatePaintNodeData*)
 {
     QSGClipNode* rootNode;
@@ -114,8 +161,24 @@ QSGNode* MapView::updatePaintNode(QSGNode* oldRootNode, UpdatePaintNodeData*)
 
     rootNode->setClipRect(QRectF(0, 0, this->width(), this->height()));
 
-    RenderContext ctx{this->worldSurface, this->window(), this->mapNodesPos, this->mapRect};
-    mapRootNode = renderMap(this->graphicMap, mapRootNode, ctx);
+    if (this->worldSurface != nullptr)
+        this->worldSurface->prepareTextures(this->window());
+
+    if (this->renderer != nullptr)
+        this->graphicMap = this->renderer->takeFrame();
+
+    if (this->graphicMap)
+    {
+        // The GUI thread is blocked while the paint-node is updated, so
+        // the visibility can be read here.
+        RenderContext ctx{this->worldSurface,
+            this->window(),
+            this->mapNodesPos,
+            this->mapRect,
+            this->visibility.get(),
+            this->faction};
+        mapRootNode = renderMap(*this->graphicMap, mapRootNode, ctx);
+    }
 
     return rootNode;
 }
@@ -133,18 +196,26 @@ void MapView::updateContent()
         this->mapNodesPos = positionMapNodes(this->map->getMapNodes()[0], this->worldSurface->getTileSize());
         this->updateMapRect();
         this->updateTransform();
-        try
-        {
-            this->graphicMap = this->worldSurface->getRules().renderMap(*this->map);
-        }
-        catch (utils::Exception& e)
-        {
-            // FIXME: we need a way to communicate this to the user.
-            wError.format("Failed to render map `{}': {}", *this->map, e.what());
-        }
+        this->requestRender();
     }
 }
 
+void MapView::requestRender()
+{
+    if (this->territory)
+        this->territory->updateSettlements();
+
+    if (this->visibility)
+        this->visibility->updateSettlements();
+
+    if (this->renderer == nullptr || !(this->flags() & QQuickItem::ItemHasContents))
+        return;
+
+    // The actual rendering happens on the renderer's worker thread, the
+    // new frame will be picked up by updatePaintNode() once it is ready.
+    this->renderer->render(*this->map, this->territory.get());
+}
+
 void MapView::updateMapRect()
 {
     if (this->worldSurface == nullptr || this->map == nullptr || this->map->getMapNodes().empty() ||
@@ -161,15 +232,51 @@ void MapView::updateMapRect()
 
 void MapView::onMapNodesChanged()
 {
+    if (this->territory)
+        this->territory->rebuild();
+
+    if (this->visibility)
+        this->visibility->rebuild();
+
+    this->connectTerrainSignals();
+
     this->mapNodesPos = positionMapNodes(this->map->getMapNodes()[0], this->worldSurface->getTileSize());
     this->updateMapRect();
     this->updateTransform();
 }
 
+/*
+ * The sight-blocking terrain of the map-nodes is cached by the
+ * visibility, it has to be told about the changes.
+ */
+void MapView::connectTerrainSignals()
+{
+    delete this->terrainWatcher;
+    this->terrainWatcher = new Watcher(this);
+
+    for (core::MapNode* mapNode : this->map->getMapNodes())
+    {
+        QObject::connect(mapNode, &core::MapNode::terrainTypeChanged, this->terrainWatcher, [this, mapNode]() {
+            if (this->visibility)
+                this->visibility->updateTerrainType(mapNode);
+        });
+    }
+}
+
 void MapView::updateTransform()
 {
     this->transform = ui::centerIn(this->mapRect, QRect(0, 0, this->width(), this->height()));
 }
 
+void MapView::updateVisibility()
+{
+    if (this->faction == nullptr || this->map == nullptr)
+        this->visibility.reset();
+    else if (!this->visibility)
+        this->visibility = std::make_unique<core::Visibility>(*this->map);
+    else
+        this->visibility->updateSettlements();
+}
+
 } // namespace ui
 } // namespace warmonger
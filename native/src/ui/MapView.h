@@ -21,17 +21,23 @@
 #ifndef W_UI_MAP_PREVIEW_H
 #define W_UI_MAP_PREVIEW_H
 
+#include <memory>
+
 #include <QMatrix4x4>
 #include <QtQuick/QQuickItem>
 
 #include "core/Map.h"
+#include "core/Territory.h"
+#include "core/Visibility.h"
 #include "ui/BasicMap.h"
 #include "ui/WorldSurface.h"
 
 namespace warmonger {
 namespace ui {
 
+class MapRenderer;
 class MapWatcher;
+struct Watcher;
 
 /**
  * Presents a non-interactive preview of the campaign-map.
@@ -51,6 +57,7 @@ class MapView : public QQuickItem
     Q_OBJECT
     Q_PROPERTY(warmonger::core::Map* map READ getMap WRITE setMap NOTIFY mapChanged)
     Q_PROPERTY(WorldSurface* worldSurface READ getWorldSurface WRITE setWorldSurface NOTIFY worldSurfaceChanged)
+    Q_PROPERTY(warmonger::core::Faction* faction READ getFaction WRITE setFaction NOTIFY factionChanged)
 
 public:
     /**
@@ -108,6 +115,19 @@ public:
      */
     void setWorldSurface(WorldSurface* worldSurface);
 
+    core::Faction* getFaction() const
+    {
+        return this->faction;
+    }
+
+    /**
+     * Set the faction whose point of view the map is shown from.
+     *
+     * Only the map-nodes visible to the faction are shown. If the faction
+     * is nullptr the whole map is shown.
+     */
+    void setFaction(core::Faction* faction);
+
     /**
      * Update the scene-graph.
      *
@@ -126,22 +146,33 @@ signals:
      */
     void worldSurfaceChanged();
 
+    void factionChanged();
+
 private:
     void updateContent();
+    void requestRender();
     void updateMapRect();
     void onMapNodesChanged();
+    void connectTerrainSignals();
     void updateTransform();
+    void updateVisibility();
 
     QRect mapRect;
     QMatrix4x4 transform;
 
     core::Map* map;
     WorldSurface* worldSurface;
+    core::Faction* faction;
+    std::unique_ptr<core::Territory> territory;
+    std::unique_ptr<core::Visibility> visibility;
     std::unordered_map<core::MapNode*, QPoint> mapNodesPos;
 
-    graphics::Map graphicMap;
+    std::shared_ptr<const graphics::Map> graphicMap;
 
+    MapRenderer* renderer;
     MapWatcher* watcher;
+    Watcher* terrainWatcher;
+    QMetaObject::Connection loadingProgressConnection;
 };
 
 } // namespace ui
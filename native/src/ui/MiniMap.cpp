@@ -16,10 +16,12 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
-#include <QColor>
+#include <QQuickWindow>
+#include <QSGSimpleTextureNode>
 #include <QSGTransformNode>
 
 #include "core/Faction.h"
+#include "core/Settlement.h"
 #include "ui/MapUtil.h"
 #include "ui/MapWatcher.h"
 #include "ui/MiniMap.h"
@@ -32,7 +34,14 @@ MiniMap::MiniMap(QQuickItem* parent)
     : BasicMiniMap(parent)
     , worldSurface(nullptr)
     , map(nullptr)
+    , image(
+          [this](const core::MapNode& mapNode) {
+              return this->worldSurface->colorForTerrain(mapNode.getTerrainType());
+          },
+          [this](const core::Faction& faction) { return this->worldSurface->colorFor(*faction.getPrimaryColor()); })
+    , textureInvalid(true)
     , watcher(nullptr)
+    , contentWatcher(nullptr)
 {
 }
 
@@ -50,6 +59,8 @@ void MiniMap::setMap(core::Map* map)
         if (this->map != nullptr)
         {
             delete this->watcher;
+            delete this->contentWatcher;
+            this->contentWatcher = nullptr;
             QObject::disconnect(this->map, nullptr, this, nullptr);
         }
 
@@ -60,8 +71,9 @@ void MiniMap::setMap(core::Map* map)
         if (this->map != nullptr)
         {
             this->watcher = new MapWatcher(this->map, this);
-            QObject::connect(this->watcher, &MapWatcher::changed, this, &MiniMap::update);
+            QObject::connect(this->watcher, &MapWatcher::changed, this, &MiniMap::invalidateImage);
             QObject::connect(this->map, &core::Map::mapNodesChanged, this, &MiniMap::onMapNodesChanged);
+            QObject::connect(this->map, &core::Map::settlementsChanged, this, &MiniMap::onSettlementsChanged);
         }
 
         emit mapChanged();
@@ -113,7 +125,47 @@ QSGNode* MiniMap::updatePaintNode(QSGNode* oldRootNode, UpdatePaintNodeData*)
         rootNode->setMatrix(transform);
     }
 
-    // TODO: invoke GraphicsSystem
+    if (this->flags() & QQuickItem::ItemHasContents)
+    {
+        // The map is scaled to fit the item, a larger image wouldn't show
+        // more detail.
+        this->image.setMaxSize(QSizeF(this->width(), this->height()).toSize());
+        this->textureInvalid = this->image.update() || this->textureInvalid;
+    }
+
+    auto imageNode = static_cast<QSGSimpleTextureNode*>(mapRootNode->firstChild());
+
+    if (this->image.getImage().isNull())
+    {
+        if (imageNode != nullptr)
+        {
+            mapRootNode->removeChildNode(imageNode);
+            delete imageNode;
+        }
+    }
+    else
+    {
+        if (imageNode == nullptr)
+        {
+            imageNode = new QSGSimpleTextureNode();
+            imageNode->setOwnsTexture(true);
+            imageNode->setFiltering(QSGTexture::Nearest);
+            mapRootNode->appendChildNode(imageNode);
+
+            this->textureInvalid = true;
+        }
+
+        if (this->textureInvalid)
+        {
+            imageNode->setTexture(this->window()->createTextureFromImage(this->image.getImage()));
+            this->textureInvalid = false;
+        }
+
+        if (imageNode->rect() != this->image.getImageMapRect())
+        {
+            imageNode->setRect(this->image.getImageMapRect());
+        }
+    }
 
     return rootNode;
 }
@@ -129,11 +181,11 @@ void MiniMap::updateContent()
     {
         this->setFlags(QQuickItem::ItemHasContents);
 
-        this->mapNodesPos = positionMapNodes(this->map->getMapNodes()[0], this->worldSurface->getTileSize());
+        const int tileSize = this->worldSurface->getTileSize();
+        this->image.setMapNodes(positionMapNodes(this->map->getMapNodes()[0], tileSize), tileSize);
 
         this->updateMapRect();
-
-        this->update();
+        this->onSettlementsChanged();
     }
 }
 
@@ -146,15 +198,61 @@ void MiniMap::updateMapRect()
     }
     else
     {
-        this->setMapRect(calculateBoundingRect(this->mapNodesPos, this->worldSurface->getTileSize()));
+        this->setMapRect(calculateBoundingRect(this->image.getMapNodesPos(), this->worldSurface->getTileSize()));
         this->update();
     }
 }
 
 void MiniMap::onMapNodesChanged()
 {
-    this->mapNodesPos = positionMapNodes(this->map->getMapNodes()[0], this->worldSurface->getTileSize());
+    const int tileSize = this->worldSurface->getTileSize();
+    this->image.setMapNodes(positionMapNodes(this->map->getMapNodes()[0], tileSize), tileSize);
     this->updateMapRect();
+    this->connectContentSignals();
+    this->invalidateImage();
+}
+
+void MiniMap::onSettlementsChanged()
+{
+    this->image.setSettlements(this->map->getSettlements());
+    this->connectContentSignals();
+    this->invalidateImage();
+}
+
+void MiniMap::connectContentSignals()
+{
+    delete this->contentWatcher;
+    this->contentWatcher = new Watcher(this);
+
+    for (core::MapNode* mapNode : this->map->getMapNodes())
+    {
+        QObject::connect(mapNode, &core::MapNode::terrainTypeChanged, this->contentWatcher, [this, mapNode]() {
+            this->invalidateMapNode(mapNode);
+        });
+    }
+
+    for (core::Settlement* settlement : this->map->getSettlements())
+    {
+        QObject::connect(settlement, &core::Settlement::ownerChanged, this->contentWatcher, [this, settlement]() {
+            this->invalidateMapNode(settlement->getPosition());
+        });
+        QObject::connect(settlement, &core::Settlement::positionChanged, this->contentWatcher, [this, settlement]() {
+            this->image.updateSettlementPosition(settlement);
+            this->update();
+        });
+    }
+}
+
+void MiniMap::invalidateImage()
+{
+    this->image.invalidate();
+    this->update();
+}
+
+void MiniMap::invalidateMapNode(core::MapNode* mapNode)
+{
+    this->image.invalidateMapNode(mapNode);
+    this->update();
 }
 
 } // namespace ui
@@ -21,10 +21,9 @@
 #ifndef W_UI_CAMPAIGN_MINI_MAP_H
 #define W_UI_CAMPAIGN_MINI_MAP_H
 
-#include <unordered_map>
-
 #include "core/Map.h"
 #include "ui/BasicMiniMap.h"
+#include "ui/MiniMapImage.h"
 #include "ui/WorldSurface.h"
 
 namespace warmonger {
@@ -37,6 +36,7 @@ class World;
 namespace ui {
 
 class MapWatcher;
+struct Watcher;
 
 class MiniMap : public BasicMiniMap
 {
@@ -65,12 +65,24 @@ private:
     void updateContent();
     void updateMapRect();
     void onMapNodesChanged();
+    void onSettlementsChanged();
+    void connectContentSignals();
+    void invalidateImage();
+    void invalidateMapNode(core::MapNode* mapNode);
 
     WorldSurface* worldSurface;
     core::Map* map;
-    std::unordered_map<core::MapNode*, QPoint> mapNodesPos;
+
+    /*
+     * The image is no larger than the item and the texture is only
+     * re-uploaded when the image changed, so neither the memory nor the
+     * cost of a frame depends on the size of the map.
+     */
+    MiniMapImage image;
+    bool textureInvalid;
 
     MapWatcher* watcher;
+    Watcher* contentWatcher;
 };
 
 } // namespace ui
@@ -0,0 +1,272 @@
+/**
+ * Copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include "core/Faction.h"
+#include "core/MapNode.h"
+#include "core/Settlement.h"
+#include "ui/MapUtil.h"
+#include "ui/MiniMapImage.h"
+
+namespace warmonger {
+namespace ui {
+
+// The size of a map-node on the minimap image, in pixels, when the image
+// is not limited by its maximum size.
+static const int mapNodeImageSize{4};
+
+// The maximum size of the image until setMaxSize() is called.
+static const QSize defaultMaxSize{512, 512};
+
+static QSize imageSize(const QSize& mapSize, int tileSize, const QSize& maxSize);
+static int mapToImage(int coord, int origin, double scale);
+
+MiniMapImage::MiniMapImage(TerrainColorFunc terrainColor, FactionColorFunc factionColor)
+    : terrainColor(std::move(terrainColor))
+    , factionColor(std::move(factionColor))
+    , tileSize(1)
+    , maxSize(defaultMaxSize)
+    , scaleX(1.0)
+    , scaleY(1.0)
+    , imageInvalid(true)
+{
+}
+
+void MiniMapImage::setMapNodes(std::unordered_map<core::MapNode*, QPoint> mapNodesPos, int tileSize)
+{
+    this->mapNodesPos = std::move(mapNodesPos);
+    this->tileSize = tileSize;
+    this->invalidate();
+}
+
+void MiniMapImage::setMaxSize(const QSize& maxSize)
+{
+    const QSize size = maxSize.expandedTo(QSize(1, 1));
+    if (size == this->maxSize)
+        return;
+
+    this->maxSize = size;
+    this->invalidate();
+}
+
+void MiniMapImage::setSettlements(const std::vector<core::Settlement*>& settlements)
+{
+    this->settlementsByPosition.clear();
+    this->settlementPositions.clear();
+
+    for (core::Settlement* settlement : settlements)
+    {
+        this->settlementsByPosition.emplace(settlement->getPosition(), settlement);
+        this->settlementPositions.emplace(settlement, settlement->getPosition());
+    }
+
+    this->invalidate();
+}
+
+void MiniMapImage::updateSettlementPosition(core::Settlement* settlement)
+{
+    const auto it = this->settlementPositions.find(settlement);
+    if (it == this->settlementPositions.end())
+        return;
+
+    core::MapNode* oldPosition = it->second;
+    core::MapNode* newPosition = settlement->getPosition();
+
+    const auto range = this->settlementsByPosition.equal_range(oldPosition);
+    const auto entry = std::find_if(
+        range.first, range.second, [settlement](const auto& element) { return element.second == settlement; });
+    if (entry != range.second)
+        this->settlementsByPosition.erase(entry);
+
+    this->settlementsByPosition.emplace(newPosition, settlement);
+    it->second = newPosition;
+
+    this->invalidateMapNode(oldPosition);
+    this->invalidateMapNode(newPosition);
+}
+
+void MiniMapImage::invalidate()
+{
+    this->imageInvalid = true;
+}
+
+void MiniMapImage::invalidateMapNode(core::MapNode* mapNode)
+{
+    this->invalidMapNodes.insert(mapNode);
+}
+
+bool MiniMapImage::update()
+{
+    if (this->imageInvalid)
+    {
+        if (this->mapNodesPos.empty())
+        {
+            this->imageMapRect = QRect();
+            this->image = QImage();
+        }
+        else
+        {
+            this->imageMapRect = calculateBoundingRect(this->mapNodesPos, this->tileSize);
+
+            const QSize size = imageSize(this->imageMapRect.size(), this->tileSize, this->maxSize);
+            this->scaleX = static_cast<double>(size.width()) / this->imageMapRect.width();
+            this->scaleY = static_cast<double>(size.height()) / this->imageMapRect.height();
+
+            this->image = QImage(size, QImage::Format_ARGB32_Premultiplied);
+            this->image.fill(Qt::transparent);
+
+            for (const auto& element : this->mapNodesPos)
+                this->drawMapNode(element.first);
+
+            this->drawSettlements(this->image.rect());
+        }
+
+        this->imageInvalid = false;
+        this->invalidMapNodes.clear();
+
+        return true;
+    }
+
+    if (this->invalidMapNodes.empty())
+        return false;
+
+    QRect dirtyRect;
+    for (core::MapNode* mapNode : this->invalidMapNodes)
+        dirtyRect |= this->drawMapNode(mapNode);
+
+    this->drawSettlements(dirtyRect);
+
+    this->invalidMapNodes.clear();
+
+    return true;
+}
+
+/*
+ * Hexagons are drawn as rectangles: the rows of hexagons are 3/4 tiles
+ * apart so the middle 3/4 of the tile is used. This way the rectangles
+ * of the map-nodes don't overlap and each can be redrawn independently.
+ * When the image is scaled down so far that a map-node would be smaller
+ * than a pixel it still gets one, shared with its neighbours.
+ */
+QRect MiniMapImage::mapNodeImageRect(core::MapNode* mapNode) const
+{
+    const auto it = this->mapNodesPos.find(mapNode);
+    if (it == this->mapNodesPos.end() || this->image.isNull())
+        return QRect();
+
+    const QPoint& pos = it->second;
+    const QRect& mapRect = this->imageMapRect;
+
+    const int x0 = std::max(mapToImage(pos.x(), mapRect.left(), this->scaleX), 0);
+    const int x1 = std::min(
+        std::max(mapToImage(pos.x() + this->tileSize, mapRect.left(), this->scaleX), x0 + 1), this->image.width());
+    const int y0 = std::max(mapToImage(pos.y() + this->tileSize / 8, mapRect.top(), this->scaleY), 0);
+    const int y1 = std::min(
+        std::max(mapToImage(pos.y() + this->tileSize * 7 / 8, mapRect.top(), this->scaleY), y0 + 1),
+        this->image.height());
+
+    return QRect(QPoint(x0, y0), QPoint(x1 - 1, y1 - 1));
+}
+
+QRect MiniMapImage::drawMapNode(core::MapNode* mapNode)
+{
+    const QRect rect = this->mapNodeImageRect(mapNode);
+    if (rect.isEmpty())
+        return rect;
+
+    const QRgb color = qPremultiply(this->mapNodeColor(mapNode).rgba());
+
+    for (int y = rect.top(); y <= rect.bottom(); ++y)
+    {
+        QRgb* line = reinterpret_cast<QRgb*>(this->image.scanLine(y));
+        std::fill(line + rect.left(), line + rect.right() + 1, color);
+    }
+
+    return rect;
+}
+
+/*
+ * On large maps several map-nodes share a pixel and the one drawn last
+ * wins. Redrawing the map-nodes with an owned settlement after the others
+ * keeps the settlements visible, regardless of what was redrawn around
+ * them.
+ */
+void MiniMapImage::drawSettlements(const QRect& rect)
+{
+    if (rect.isEmpty())
+        return;
+
+    for (const auto& element : this->settlementsByPosition)
+    {
+        if (element.second->getOwner() != nullptr && this->mapNodeImageRect(element.first).intersects(rect))
+            this->drawMapNode(element.first);
+    }
+}
+
+/*
+ * Map-nodes with an owned settlement take the color of the owning
+ * faction, all others the color of their terrain. Of several owned
+ * settlements on the same map-node the one with the lowest id is chosen.
+ */
+QColor MiniMapImage::mapNodeColor(core::MapNode* mapNode) const
+{
+    const core::Settlement* chosen{nullptr};
+
+    const auto range = this->settlementsByPosition.equal_range(mapNode);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        const core::Settlement* settlement = it->second;
+        if (settlement->getOwner() == nullptr)
+            continue;
+
+        if (chosen == nullptr || settlement->getId().get() < chosen->getId().get())
+            chosen = settlement;
+    }
+
+    if (chosen != nullptr)
+        return this->factionColor(*chosen->getOwner());
+
+    return this->terrainColor(*mapNode);
+}
+
+/*
+ * The map-nodes are mapNodeImageSize pixels wide unless that would exceed
+ * the maximum size, then the map is scaled down to fit. The size is
+ * rounded down to whole pixels, the caller derives the exact scale of
+ * each axis from it, so the image covers the whole map.
+ */
+static QSize imageSize(const QSize& mapSize, int tileSize, const QSize& maxSize)
+{
+    const double scale = std::min({static_cast<double>(mapNodeImageSize) / tileSize,
+        static_cast<double>(maxSize.width()) / mapSize.width(),
+        static_cast<double>(maxSize.height()) / mapSize.height()});
+
+    return QSize(std::max(static_cast<int>(mapSize.width() * scale), 1),
+        std::max(static_cast<int>(mapSize.height() * scale), 1));
+}
+
+static int mapToImage(int coord, int origin, double scale)
+{
+    return static_cast<int>(std::floor((coord - origin) * scale));
+}
+
+} // namespace ui
+} // namespace warmonger
@@ -0,0 +1,192 @@
+/** \file
+ * MiniMapImage class.
+ *
+ * \copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef W_UI_MINI_MAP_IMAGE_H
+#define W_UI_MINI_MAP_IMAGE_H
+
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <QColor>
+#include <QImage>
+#include <QPoint>
+#include <QRect>
+#include <QSize>
+
+namespace warmonger {
+
+namespace core {
+class Faction;
+class MapNode;
+class Settlement;
+} // namespace core
+
+namespace ui {
+
+/**
+ * Level-of-detail image of the map, as drawn by the MiniMap.
+ *
+ * Each map-node is drawn as a block of pixels with its representative
+ * color: map-nodes with a settlement owned by a faction take the color of
+ * that faction, all others the color of their terrain. When several
+ * owned settlements share a map-node the one with the lowest id wins, so
+ * the image doesn't depend on the order the settlements were added in.
+ *
+ * The size of the image is limited (see setMaxSize()), so it doesn't grow
+ * with the map. On large maps several map-nodes share a pixel, each
+ * map-node still covers at least one. Map-nodes with an owned settlement
+ * are drawn on top of the others, so they don't disappear.
+ *
+ * Only the invalidated map-nodes are redrawn by update(), so its cost is
+ * proportional to the number of changes, not to the size of the map.
+ * The image doesn't track the map, its owner has to notify it of the
+ * changes.
+ */
+class MiniMapImage
+{
+public:
+    using TerrainColorFunc = std::function<QColor(const core::MapNode& mapNode)>;
+    using FactionColorFunc = std::function<QColor(const core::Faction& faction)>;
+
+    /**
+     * Constructs an empty image.
+     *
+     * \param terrainColor the color of a map-node without an owned settlement
+     * \param factionColor the color of a map-node with an owned settlement
+     */
+    MiniMapImage(TerrainColorFunc terrainColor, FactionColorFunc factionColor);
+
+    /**
+     * Set the map-nodes and their positions.
+     *
+     * Invalidates the whole image.
+     *
+     * \param mapNodesPos the positions, as returned by positionMapNodes()
+     * \param tileSize the tile-size the positions were calculated with
+     */
+    void setMapNodes(std::unordered_map<core::MapNode*, QPoint> mapNodesPos, int tileSize);
+
+    const std::unordered_map<core::MapNode*, QPoint>& getMapNodesPos() const
+    {
+        return this->mapNodesPos;
+    }
+
+    /**
+     * Set the maximum size of the image, in pixels.
+     *
+     * The map-nodes are scaled down to fit, keeping the aspect ratio of
+     * the map. Typically this is the size the image is displayed at.
+     * Invalidates the whole image if the size changed.
+     *
+     * \param maxSize the maximum size, at least 1x1 is used
+     */
+    void setMaxSize(const QSize& maxSize);
+
+    const QSize& getMaxSize() const
+    {
+        return this->maxSize;
+    }
+
+    /**
+     * Set the settlements.
+     *
+     * Invalidates the whole image.
+     *
+     * \param settlements the settlements
+     */
+    void setSettlements(const std::vector<core::Settlement*>& settlements);
+
+    /**
+     * Update the position of the settlement.
+     *
+     * Invalidates both the old and the new position of the settlement.
+     *
+     * \param settlement the settlement, previously passed to setSettlements()
+     */
+    void updateSettlementPosition(core::Settlement* settlement);
+
+    /**
+     * Invalidate the whole image.
+     */
+    void invalidate();
+
+    /**
+     * Invalidate the map-node, it will be redrawn by the next update().
+     *
+     * \param mapNode the map-node
+     */
+    void invalidateMapNode(core::MapNode* mapNode);
+
+    /**
+     * Redraw the invalidated parts of the image.
+     *
+     * \returns whether the image changed
+     */
+    bool update();
+
+    const QImage& getImage() const
+    {
+        return this->image;
+    }
+
+    /**
+     * The rectangle the image covers, in map coordinates.
+     */
+    const QRect& getImageMapRect() const
+    {
+        return this->imageMapRect;
+    }
+
+    /**
+     * The rectangle the map-node is drawn to, in image coordinates.
+     *
+     * \param mapNode the map-node
+     *
+     * \returns the rectangle, empty if the map-node is unknown
+     */
+    QRect mapNodeImageRect(core::MapNode* mapNode) const;
+
+private:
+    QRect drawMapNode(core::MapNode* mapNode);
+    void drawSettlements(const QRect& rect);
+    QColor mapNodeColor(core::MapNode* mapNode) const;
+
+    TerrainColorFunc terrainColor;
+    FactionColorFunc factionColor;
+    int tileSize;
+    QSize maxSize;
+    std::unordered_map<core::MapNode*, QPoint> mapNodesPos;
+    std::unordered_multimap<core::MapNode*, core::Settlement*> settlementsByPosition;
+    std::unordered_map<core::Settlement*, core::MapNode*> settlementPositions;
+
+    QImage image;
+    QRect imageMapRect;
+    double scaleX;
+    double scaleY;
+    bool imageInvalid;
+    std::unordered_set<core::MapNode*> invalidMapNodes;
+};
+
+} // namespace ui
+} // namespace warmonger
+
+#endif // W_UI_MINI_MAP_IMAGE_H
@@ -20,6 +20,8 @@
 
 #include <algorithm>
 #include <iterator>
+#include <memory>
+#include <utility>
 
 #include <QSGNode>
 #include <QSGSimpleTextureNode>
@@ -27,7 +29,9 @@
 #include <QString>
 
 #include "core/MapNode.h"
+#include "core/Visibility.h"
 #include "ui/WorldSurface.h"
+#include "utils/Profiling.h"
 
 namespace warmonger {
 namespace ui {
@@ -44,11 +48,63 @@ struct MapNodeContents
     }
 };
 
+/*
+ * A view of a range of elements in one of graphics::Map's arrays.
+ */
+template <typename T>
+struct Slice
+{
+    const T* first;
+    std::size_t count;
+
+    std::size_t size() const
+    {
+        return this->count;
+    }
+
+    const T& operator[](std::size_t i) const
+    {
+        return this->first[i];
+    }
+};
+
+/*
+ * Texture-node holding a reference to the surface's texture it displays,
+ * so that the texture isn't evicted while the node is alive.
+ */
+class SurfaceTextureNode : public QSGSimpleTextureNode
+{
+public:
+    SurfaceTextureNode()
+    {
+        this->setOwnsTexture(false);
+    }
+
+    void setSurfaceTexture(std::shared_ptr<QSGTexture> texture)
+    {
+        if (texture == this->surfaceTexture)
+            return;
+
+        this->setTexture(texture.get());
+        this->surfaceTexture = std::move(texture);
+    }
+
+private:
+    std::shared_ptr<QSGTexture> surfaceTexture;
+};
+
+template <typename T>
+static Slice<T> slice(const std::vector<T>& elements, const graphics::Range& range)
+{
+    return Slice<T>{elements.data() + range.begin, range.size()};
+}
+
 static bool isVisible(const QPoint& position, const RenderContext& ctx);
 static std::vector<MapNodeContents> depthSorted(std::vector<MapNodeContents> mapNodeContents);
 static std::vector<MapNodeContents> visibleMapNodes(const graphics::Map& map, const RenderContext& ctx);
-static QSGNode* drawMapNodeContent(const MapNodeContents& mapNodeContents, QSGNode* oldNode, const RenderContext& ctx);
-static QSGNode* drawMapNodeLayer(const graphics::MapNodeLayer& layer, QSGNode* oldNode, const RenderContext& ctx);
+static QSGNode* drawMapNodeContent(
+    const graphics::Map& map, const MapNodeContents& mapNodeContents, QSGNode* oldNode, const RenderContext& ctx);
+static QSGNode* drawMapNodeLayer(const Slice<graphics::GridTile>& layer, QSGNode* oldNode, const RenderContext& ctx);
 static QSGNode* drawGridTile(const graphics::GridTile& gridTile, QSGNode* oldNode, const RenderContext& ctx);
 
 template <typename Source, typename Func>
@@ -66,8 +122,12 @@ static void syncChildNodesWithSource(QSGNode* rootNode, Source&& source, const R
 
     if (sourceCount < nodesCount)
     {
-        for (int i = sourceCount; i < sourceCount; ++i)
-            rootNode->removeChildNode(rootNode->lastChild());
+        for (int i = sourceCount; i < nodesCount; ++i)
+        {
+            QSGNode* node = rootNode->lastChild();
+            rootNode->removeChildNode(node);
+            delete node;
+        }
     }
     else if (sourceCount > nodesCount)
     {
@@ -83,6 +143,8 @@ static void syncChildNodesWithSource(QSGNode* rootNode, Source&& source, const R
 
 QSGNode* renderMap(const graphics::Map& map, QSGNode* oldNode, const RenderContext& ctx)
 {
+    wProfileZone("renderMap");
+
     const std::vector<MapNodeContents> mapNodeContents = depthSorted(visibleMapNodes(map, ctx));
 
     QSGNode* rootNode;
@@ -95,7 +157,12 @@ QSGNode* renderMap(const graphics::Map& map, QSGNode* oldNode, const RenderConte
         rootNode = new QSGNode();
     }
 
-    syncChildNodesWithSource(rootNode, mapNodeContents, ctx, drawMapNodeContent);
+    syncChildNodesWithSource(rootNode,
+        mapNodeContents,
+        ctx,
+        [&map](const MapNodeContents& contents, QSGNode* oldNode, const RenderContext& ctx) {
+            return drawMapNodeContent(map, contents, oldNode, ctx);
+        });
 
     return rootNode;
 }
@@ -113,7 +180,16 @@ static std::vector<MapNodeContents> visibleMapNodes(const graphics::Map& map, co
 
     for (auto& mapNode : map.mapNodes)
     {
-        auto pos = ctx.mapNodesPos.at(mapNode.mapNode);
+        // The graphic-map might have been rendered from an older state of
+        // the map, so it can reference map-nodes that no longer exist.
+        const auto it = ctx.mapNodesPos.find(mapNode.mapNode);
+        if (it == ctx.mapNodesPos.end())
+            continue;
+
+        if (ctx.visibility != nullptr && !ctx.visibility->isVisible(ctx.faction, mapNode.mapNode))
+            continue;
+
+        const auto& pos = it->second;
         if (isVisible(pos, ctx))
         {
             mapNodeContents.emplace_back(mapNode, pos);
@@ -135,7 +211,8 @@ static std::vector<MapNodeContents> depthSorted(std::vector<MapNodeContents> map
     return mapNodeContents;
 }
 
-static QSGNode* drawMapNodeContent(const MapNodeContents& mapNodeContents, QSGNode* oldNode, const RenderContext& ctx)
+static QSGNode* drawMapNodeContent(
+    const graphics::Map& map, const MapNodeContents& mapNodeContents, QSGNode* oldNode, const RenderContext& ctx)
 {
     QSGTransformNode* node;
     if (oldNode == nullptr)
@@ -155,12 +232,17 @@ static QSGNode* drawMapNodeContent(const MapNodeContents& mapNodeContents, QSGNo
         node->setMatrix(matrix);
     }
 
-    syncChildNodesWithSource(node, mapNodeContents.mapNode->layers, ctx, drawMapNodeLayer);
+    syncChildNodesWithSource(node,
+        slice(map.layers, mapNodeContents.mapNode->layers),
+        ctx,
+        [&map](const graphics::Range& layer, QSGNode* oldNode, const RenderContext& ctx) {
+            return drawMapNodeLayer(slice(map.gridTiles, layer), oldNode, ctx);
+        });
 
     return node;
 }
 
-static QSGNode* drawMapNodeLayer(const graphics::MapNodeLayer& layer, QSGNode* oldNode, const RenderContext& ctx)
+static QSGNode* drawMapNodeLayer(const Slice<graphics::GridTile>& layer, QSGNode* oldNode, const RenderContext& ctx)
 {
     QSGNode* rootNode;
     if (oldNode)
@@ -172,32 +254,25 @@ static QSGNode* drawMapNodeLayer(const graphics::MapNodeLayer& layer, QSGNode* o
         rootNode = new QSGNode();
     }
 
-    syncChildNodesWithSource(rootNode, layer.gridTiles, ctx, drawGridTile);
+    syncChildNodesWithSource(rootNode, layer, ctx, drawGridTile);
 
     return rootNode;
 }
 
 static QSGNode* drawGridTile(const graphics::GridTile& gridTile, QSGNode* oldNode, const RenderContext& ctx)
 {
-    QSGSimpleTextureNode* node;
+    SurfaceTextureNode* node;
     if (oldNode == nullptr)
     {
-        node = new QSGSimpleTextureNode();
-        node->setOwnsTexture(false);
+        node = new SurfaceTextureNode();
     }
     else
     {
         // if not nullptr, it can only be a texture node
-        node = static_cast<QSGSimpleTextureNode*>(oldNode);
+        node = static_cast<SurfaceTextureNode*>(oldNode);
     }
 
-    QSGTexture* texture = ctx.surface->getTexture(gridTile.assetId, ctx.window);
-    QSGTexture* currentTexture = node->texture();
-
-    if (currentTexture == nullptr || currentTexture->textureId() != texture->textureId())
-    {
-        node->setTexture(texture);
-    }
+    node->setSurfaceTexture(ctx.surface->getTexture(gridTile.assetId, ctx.window));
 
     const QRect nodeRect(QPoint(gridTile.x, gridTile.y), QSize(gridTile.width, gridTile.height));
     if (node->rect() != nodeRect)
@@ -32,7 +32,9 @@ class QQuickWindow;
 namespace warmonger {
 
 namespace core {
+class Faction;
 class MapNode;
+class Visibility;
 } // namespace core
 
 namespace ui {
@@ -49,6 +51,9 @@ struct RenderContext
     QQuickWindow* window;
     const std::unordered_map<core::MapNode*, QPoint>& mapNodesPos;
     QRect renderWindow;
+    // If set, only the map-nodes visible to the faction are drawn.
+    const core::Visibility* visibility = nullptr;
+    const core::Faction* faction = nullptr;
 };
 
 QSGNode* renderMap(const graphics::Map& map, QSGNode* oldNode, const RenderContext& ctx);
@@ -16,11 +16,16 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
-#include <cmath>
+#include <algorithm>
+#include <mutex>
 #include <set>
 #include <unordered_map>
+#include <vector>
 
+#include <QCryptographicHash>
+#include <QDateTime>
 #include <QDir>
+#include <QDirIterator>
 #include <QFile>
 #include <QFileInfo>
 #include <QHash>
@@ -28,15 +33,18 @@
 #include <QResource>
 #include <QSGTexture>
 
-#include <ktar.h>
-
 #include "io/JsonSerializer.h"
+#include "io/TarArchive.h"
+#include "ui/AssetPreloader.h"
+#include "ui/ImageCacheFile.h"
 #include "ui/WorldSurface.h"
 #include "utils/Constants.h"
 #include "utils/Exception.h"
 #include "utils/Hash.h"
 #include "utils/Logging.h"
+#include "utils/LruCache.h"
 #include "utils/PathBuilder.h"
+#include "utils/Settings.h"
 
 namespace std {
 
@@ -62,6 +70,9 @@ const QString hexagonMask{"hexagonMask.png"};
 } // namespace
 
 static bool hasAllMandatoryImages(const WorldSurface& surface);
+static QString imageCacheFilePath(const QString& dir, const WorldSurface::Storage& storage);
+static void hashFileStamp(QCryptographicHash& hash, const QString& name, const QFileInfo& file);
+static std::size_t textureSize(const QSGTexture* texture);
 
 const std::vector<QString> staticImages{};
 
@@ -78,6 +89,7 @@ public:
         WorldSurfaceRules::Type rulesType;
         std::unordered_map<QString, QString> banners;
         std::unordered_map<QString, QColor> colors;
+        std::unordered_map<QString, QColor> terrainColors;
         std::unordered_map<QString, QString> graphicAssets;
     };
 
@@ -92,10 +104,30 @@ public:
     virtual void activate() = 0;
     virtual void deactivate() = 0;
 
-    QSGTexture* getTexture(const QString& path, QQuickWindow* window) const;
-    QImage getImage(const QString& path) const;
+    std::shared_ptr<QSGTexture> getTexture(const QString& path, QQuickWindow* window) const;
+    bool prepareTexture(const QString& path, QQuickWindow* window) const;
+    QImage getImage(const QString& path, QImage::Format format = QImage::Format_Invalid) const;
     virtual QUrl getImageUrl(const QString& path) const = 0;
 
+    /**
+     * Feed the stamp of the surface's content to the hash.
+     *
+     * The stamp is made of the paths, sizes and modification times of the
+     * files, no content is read, so this is cheap enough to be done on
+     * the GUI thread at every activation.
+     */
+    virtual void hashContentStamp(QCryptographicHash& hash) const = 0;
+
+    bool loadImageCache(const QString& path);
+    void saveImageCache(const QString& path, const std::set<QString>& paths) const;
+
+    void beginFrame(QQuickWindow* window) const;
+
+    void setImageCacheBudget(std::size_t budget);
+    void setTextureCacheBudget(std::size_t budget);
+    utils::CacheStats getImageCacheStats() const;
+    utils::CacheStats getTextureCacheStats() const;
+
     const QString& getPath() const
     {
         return this->path;
@@ -110,23 +142,54 @@ protected:
     Header parseHeader(const QByteArray& header);
     void cache(const QString& path, const QImage& image) const
     {
-        this->imageCache.insert({path, image});
+        std::lock_guard<std::mutex> lock(this->imageCacheMutex);
+        this->imageCache.insert(path, image, static_cast<std::size_t>(image.bytesPerLine()) * image.height());
+        this->imageCache.trim();
     }
     QImage lookup(const QString& path) const
     {
-        auto it = this->imageCache.find(path);
-        return it == this->imageCache.end() ? QImage() : it->second;
+        std::lock_guard<std::mutex> lock(this->imageCacheMutex);
+
+        const auto it = this->mappedImages.find(path);
+        if (it != this->mappedImages.end())
+        {
+            ++this->mappedImageHits;
+            return it->second;
+        }
+
+        const QImage* image = this->imageCache.find(path);
+        return image == nullptr ? QImage() : *image;
     }
 
     virtual QImage loadImage(const QString& path) const = 0;
 
 private:
+    // Texture-nodes hold a reference to the textures they display,
+    // textures are only evicted when the cache's is the only one left.
+    struct Texture
+    {
+        std::shared_ptr<QSGTexture> texture;
+    };
+
     QString path;
     QString name;
-    mutable std::unordered_map<QString, QImage> imageCache;
-    mutable std::unordered_map<std::pair<QString, QQuickWindow*>,
-        std::unique_ptr<QSGTexture, utils::DelayedQObjectDeleter>>
-        textures;
+    // Must outlive the image-cache, the images loaded from the
+    // image-cache file refer to its mapped data.
+    std::unique_ptr<ImageCacheFile> imageCacheFile;
+    // The images are decoded by the preloader threads, while they are
+    // read from the GUI and render threads.
+    mutable std::mutex imageCacheMutex;
+    // The images of the image-cache file are file-backed, their pages can
+    // be reclaimed by the OS at any time, so they don't count against the
+    // budget and are never evicted.
+    std::unordered_map<QString, QImage> mappedImages;
+    mutable std::size_t mappedImageHits{0};
+    mutable utils::LruCache<QString, QImage> imageCache;
+    // Each window's textures are only used on its render thread, the
+    // mutex is for windows with separate render threads and for querying
+    // the stats.
+    mutable std::mutex texturesMutex;
+    mutable utils::LruCache<std::pair<QString, QQuickWindow*>, Texture> textures;
 };
 
 class DirectoryStorage : public WorldSurface::Storage
@@ -138,6 +201,7 @@ public:
     void activate() override;
     void deactivate() override;
     QUrl getImageUrl(const QString& path) const override;
+    void hashContentStamp(QCryptographicHash& hash) const override;
 
 private:
     QImage loadImage(const QString& path) const override;
@@ -156,11 +220,15 @@ public:
     void activate() override;
     void deactivate() override;
     QUrl getImageUrl(const QString& path) const override;
+    void hashContentStamp(QCryptographicHash& hash) const override;
 
 private:
     QImage loadImage(const QString& path) const override;
 
-    QByteArray resourceData;
+    // Mapped for the lifetime of the storage, the resource data is
+    // registered directly from the mapped region.
+    std::unique_ptr<io::TarArchive> package;
+    const uchar* resourceData{nullptr};
 };
 
 const QString ArchiveStorage::rootPath{":/surface"};
@@ -194,6 +262,7 @@ WorldSurface::WorldSurface(QString path, core::World* world, QObject* parent)
     this->rulesEntryPoint = std::move(header.rulesEntryPoint);
     this->banners = std::move(header.banners);
     this->colors = std::move(header.colors);
+    this->terrainColors = std::move(header.terrainColors);
     this->graphicAssetsByName = std::move(header.graphicAssets);
 
     int id = 0;
@@ -204,8 +273,15 @@ WorldSurface::WorldSurface(QString path, core::World* world, QObject* parent)
         ++id;
     }
 
-    this->rules = createWorldSurfaceRules(*this);
-    this->rules->loadRules(this->storage->getPath(), this->rulesEntryPoint);
+    this->rules = this->createRules();
+
+    const QString workDir = utils::settingsValue(utils::SettingsKey::workDir).toString();
+    if (!workDir.isEmpty())
+        this->imageCacheDir = workDir / utils::paths::cache;
+
+    const std::size_t mebibyte = 1024 * 1024;
+    this->setImageCacheBudget(utils::settingsValue(utils::SettingsKey::imageCacheBudget).toULongLong() * mebibyte);
+    this->setTextureCacheBudget(utils::settingsValue(utils::SettingsKey::textureCacheBudget).toULongLong() * mebibyte);
 
     wInfo.format("Created WorldSurface `{}' with {} storage @ {}", this->name, storageName, this->storage->getPath());
 }
@@ -224,50 +300,153 @@ WorldSurface::~WorldSurface()
 
 bool WorldSurface::hexContains(const QPoint& p) const
 {
-    const int x = p.x();
-    const int y = p.y();
-    const int w = this->tileSize;
-    const int h = this->tileSize;
-
-    if (x < 0 || x >= w || y < 0 || y >= h)
-        return false;
+    return this->hexMask.contains(p);
+}
 
-    QRgb pixel = this->hexMask.pixel(x, y);
+bool WorldSurface::hexContains(const QPointF& p) const
+{
+    return this->hexMask.contains(p);
+}
 
-    return (pixel == 0xffffffff);
+std::unique_ptr<WorldSurfaceRules> WorldSurface::createRules()
+{
+    auto rules = createWorldSurfaceRules(*this);
+    rules->loadRules(this->storage->getPath(), this->rulesEntryPoint);
+    return rules;
 }
 
-bool WorldSurface::hexContains(const QPointF& p) const
+void WorldSurface::activate()
 {
-    const qreal x = p.x();
-    const qreal y = p.y();
-    const qreal w = static_cast<qreal>(this->tileSize);
-    const qreal h = static_cast<qreal>(this->tileSize);
+    storage->activate();
 
-    if (x < 0.0 || x >= w || y < 0.0 || y >= h)
-        return false;
+    this->hexMask = HexMask(storage->getImage(hexagonMask));
 
-    const int xc = static_cast<int>(ceil(x));
-    const int yc = static_cast<int>(ceil(y));
-    const int xf = static_cast<int>(floor(x));
-    const int yf = static_cast<int>(floor(y));
+    std::set<QString> graphicAssetPaths;
+    for (const auto& graphicAsset : this->graphicAssetsById)
+        graphicAssetPaths.insert(graphicAsset.second);
 
-    QRgb pixelc = this->hexMask.pixel(xc, yc);
-    QRgb pixelf = this->hexMask.pixel(xf, yf);
+    // Only the graphic assets are cached on disk, these are the bulk
+    // of the images.
+    QString cachePath;
+    bool cacheLoaded = false;
+    if (!this->imageCacheDir.isEmpty())
+    {
+        cachePath = imageCacheFilePath(this->imageCacheDir, *this->storage);
+        cacheLoaded = this->storage->loadImageCache(cachePath);
+    }
+
+    std::vector<QString> paths;
+    if (!cacheLoaded)
+        paths.insert(paths.end(), graphicAssetPaths.begin(), graphicAssetPaths.end());
+    for (const auto& banner : this->banners)
+        paths.push_back(banner.second);
+
+    this->texturesPrepared.clear();
+    this->preloader = std::make_unique<AssetPreloader>(std::move(paths),
+        [this, graphicAssetPaths](const QString& path) {
+            // Graphic assets are only used as textures, store them in
+            // the format the scene-graph uploads.
+            if (graphicAssetPaths.count(path))
+                this->storage->getImage(path, QImage::Format_ARGB32_Premultiplied);
+            else
+                this->storage->getImage(path);
+        },
+        [this, graphicAssetPaths, cachePath, cacheLoaded](int loaded, int total) {
+            // Throttle the notifications to whole percents.
+            if (loaded * 100 / total != (loaded - 1) * 100 / total)
+                emit loadingProgressChanged();
+
+            if (loaded == total)
+            {
+                wInfo.format("Preloaded all {} assets of WorldSurface `{}'", total, this->name);
+
+                if (!cacheLoaded && !cachePath.isEmpty())
+                    this->storage->saveImageCache(cachePath, graphicAssetPaths);
 
-    return (pixelc == 0xffffffff || pixelf == 0xffffffff);
+                emit assetsLoaded();
+            }
+        });
 }
 
-void WorldSurface::activate()
+void WorldSurface::waitForAssets()
 {
-    storage->activate();
-
-    this->hexMask = storage->getImage(hexagonMask);
+    if (this->preloader)
+        this->preloader->wait();
 }
 
 void WorldSurface::deactivate()
 {
+    // The preloader reads from the storage, stop it first.
+    this->preloader.reset();
     this->storage->deactivate();
+
+    const auto images = this->storage->getImageCacheStats();
+    const auto textures = this->storage->getTextureCacheStats();
+
+    wDebug.format("Image-cache of WorldSurface `{}': {} hits, {} misses, {} evictions, {} bytes resident",
+        this->name,
+        images.hits,
+        images.misses,
+        images.evictions,
+        images.residentBytes);
+    wDebug.format("Texture-cache of WorldSurface `{}': {} hits, {} misses, {} evictions, {} bytes resident",
+        this->name,
+        textures.hits,
+        textures.misses,
+        textures.evictions,
+        textures.residentBytes);
+}
+
+void WorldSurface::setImageCacheBudget(std::size_t budget)
+{
+    this->storage->setImageCacheBudget(budget);
+}
+
+void WorldSurface::setTextureCacheBudget(std::size_t budget)
+{
+    this->storage->setTextureCacheBudget(budget);
+}
+
+utils::CacheStats WorldSurface::getImageCacheStats() const
+{
+    return this->storage->getImageCacheStats();
+}
+
+utils::CacheStats WorldSurface::getTextureCacheStats() const
+{
+    return this->storage->getTextureCacheStats();
+}
+
+qreal WorldSurface::getLoadingProgress() const
+{
+    if (!this->preloader || this->preloader->getTotalCount() == 0)
+        return 1.0;
+
+    return static_cast<qreal>(this->preloader->getLoadedCount()) / this->preloader->getTotalCount();
+}
+
+bool WorldSurface::areAssetsLoaded() const
+{
+    return !this->preloader || this->preloader->isDone();
+}
+
+void WorldSurface::prepareTextures(QQuickWindow* window) const
+{
+    this->storage->beginFrame(window);
+
+    if (this->texturesPrepared.count(window))
+        return;
+
+    // Only decoded images are turned into textures, so this never
+    // blocks on decoding. Called again on each frame until done.
+    const bool done = this->areAssetsLoaded();
+    bool allPrepared = true;
+
+    for (const auto& graphicAsset : this->graphicAssetsById)
+        allPrepared = this->storage->prepareTexture(graphicAsset.second, window) && allPrepared;
+
+    if (done && allPrepared)
+        this->texturesPrepared.insert(window);
 }
 
 int WorldSurface::getAssetIdFor(const QString& assetName)
@@ -275,12 +454,12 @@ int WorldSurface::getAssetIdFor(const QString& assetName)
     return this->graphicAssetNameToId.at(assetName);
 }
 
-QSGTexture* WorldSurface::getTexture(AssetId id, QQuickWindow* window) const
+std::shared_ptr<QSGTexture> WorldSurface::getTexture(AssetId id, QQuickWindow* window) const
 {
     return storage->getTexture(this->graphicAssetsById.at(id), window);
 }
 
-QSGTexture* WorldSurface::getTexture(const QString& path, QQuickWindow* window) const
+std::shared_ptr<QSGTexture> WorldSurface::getTexture(const QString& path, QQuickWindow* window) const
 {
     return storage->getTexture(path, window);
 }
@@ -315,6 +494,16 @@ QColor WorldSurface::colorFor(const core::Color& color) const
     return this->colors.at(color.getName());
 }
 
+QColor WorldSurface::colorForTerrain(const QString& terrainType) const
+{
+    const auto it = this->terrainColors.find(terrainType);
+    if (it != this->terrainColors.end())
+        return it->second;
+
+    // Derive a stable, muted color from the name.
+    return QColor::fromHsv(static_cast<int>(qHash(terrainType) % 360), 80, 160);
+}
+
 QString findWorldSurface(const QString& surface, const QString& worldPath)
 {
     if (QFile(surface).exists())
@@ -366,43 +555,215 @@ bool isWorldSurfaceSane(const QString& path, core::World* world)
 
 // Local functions
 
-QSGTexture* WorldSurface::Storage::getTexture(const QString& path, QQuickWindow* window) const
+std::shared_ptr<QSGTexture> WorldSurface::Storage::getTexture(const QString& path, QQuickWindow* window) const
 {
-    QSGTexture* texture{nullptr};
-
     const auto textureKey = std::make_pair(path, window);
-    const auto it = this->textures.find(textureKey);
 
-    if (it == this->textures.end())
     {
-        texture = window->createTextureFromImage(this->getImage(path));
+        std::lock_guard<std::mutex> lock(this->texturesMutex);
 
-        if (texture != nullptr)
-        {
-            this->textures.emplace(textureKey, std::unique_ptr<QSGTexture, utils::DelayedQObjectDeleter>(texture));
-            wDebug << "Created texture for " << path;
-        }
+        if (const Texture* texture = this->textures.find(textureKey))
+            return texture->texture;
     }
-    else
+
+    // Might have to decode the image, don't hold the lock meanwhile. Only
+    // this window's render thread creates textures with this key.
+    const QImage image = this->getImage(path);
+
+    QSGTexture* texture = window->createTextureFromImage(image);
+    if (texture == nullptr)
+        return nullptr;
+
+    std::lock_guard<std::mutex> lock(this->texturesMutex);
+
+    const Texture& inserted = this->textures.insert(textureKey,
+        Texture{std::shared_ptr<QSGTexture>(texture, utils::DelayedQObjectDeleter())},
+        textureSize(texture));
+    wDebug << "Created texture for " << path;
+
+    return inserted.texture;
+}
+
+bool WorldSurface::Storage::prepareTexture(const QString& path, QQuickWindow* window) const
+{
+    const auto textureKey = std::make_pair(path, window);
+
     {
-        texture = it->second.get();
+        std::lock_guard<std::mutex> lock(this->texturesMutex);
+
+        if (this->textures.contains(textureKey))
+            return true;
     }
 
-    return texture;
+    const auto image = this->lookup(path);
+    if (image.isNull())
+        return false;
+
+    std::lock_guard<std::mutex> lock(this->texturesMutex);
+
+    // Don't push out textures which are actually used, the rest will
+    // be created on-demand.
+    if (!this->textures.fits(static_cast<std::size_t>(image.width()) * image.height() * 4))
+        return true;
+
+    auto texture = window->createTextureFromImage(image);
+    if (texture == nullptr)
+        return false;
+
+    this->textures.insert(textureKey,
+        Texture{std::shared_ptr<QSGTexture>(texture, utils::DelayedQObjectDeleter())},
+        textureSize(texture));
+
+    return true;
+}
+
+/*
+ * Only textures which are not held by any texture-node are evicted. Nodes
+ * of items which don't re-render every frame keep theirs alive for as
+ * long as they display them.
+ */
+void WorldSurface::Storage::beginFrame(QQuickWindow* window) const
+{
+    std::lock_guard<std::mutex> lock(this->texturesMutex);
+
+    this->textures.trim([window](const std::pair<QString, QQuickWindow*>& key, const Texture& texture) {
+        return key.second == window && texture.texture.use_count() == 1;
+    });
 }
 
-QImage WorldSurface::Storage::getImage(const QString& path) const
+void WorldSurface::Storage::setImageCacheBudget(std::size_t budget)
+{
+    std::lock_guard<std::mutex> lock(this->imageCacheMutex);
+    this->imageCache.setBudget(budget);
+    this->imageCache.trim();
+}
+
+void WorldSurface::Storage::setTextureCacheBudget(std::size_t budget)
+{
+    // Evicted lazily, in beginFrame().
+    std::lock_guard<std::mutex> lock(this->texturesMutex);
+    this->textures.setBudget(budget);
+}
+
+utils::CacheStats WorldSurface::Storage::getImageCacheStats() const
+{
+    std::lock_guard<std::mutex> lock(this->imageCacheMutex);
+    auto stats = this->imageCache.getStats();
+    stats.hits += this->mappedImageHits;
+    stats.entries += this->mappedImages.size();
+    return stats;
+}
+
+utils::CacheStats WorldSurface::Storage::getTextureCacheStats() const
+{
+    std::lock_guard<std::mutex> lock(this->texturesMutex);
+    return this->textures.getStats();
+}
+
+QImage WorldSurface::Storage::getImage(const QString& path, QImage::Format format) const
 {
     auto image = this->lookup(path);
 
     if (image.isNull())
     {
-        return loadImage(path);
+        // Two threads might race to load the same image, that only
+        // wastes some work, both will end up with an equivalent image.
+        image = loadImage(path);
+
+        if (format != QImage::Format_Invalid && image.format() != format)
+            image = image.convertToFormat(format);
+
+        this->cache(path, image);
     }
 
     return image;
 }
 
+bool WorldSurface::Storage::loadImageCache(const QString& path)
+{
+    if (this->imageCacheFile)
+        return true;
+
+    if (!QFile::exists(path))
+    {
+        wInfo.format("No image-cache found at `{}', images will be decoded", path);
+        return false;
+    }
+
+    try
+    {
+        this->imageCacheFile = std::make_unique<ImageCacheFile>(path);
+    }
+    catch (utils::IOError& e)
+    {
+        wWarning.format("Ignoring unusable image-cache: {}", e.what());
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(this->imageCacheMutex);
+
+        for (const auto& image : this->imageCacheFile->getImages())
+            this->mappedImages.emplace(image.first, image.second);
+    }
+
+    wInfo.format("Loaded {} images from image-cache `{}'", this->imageCacheFile->getImages().size(), path);
+
+    return true;
+}
+
+void WorldSurface::Storage::saveImageCache(const QString& path, const std::set<QString>& paths) const
+{
+    ImageCacheFile::Images images;
+    images.reserve(paths.size());
+
+    for (const auto& imagePath : paths)
+    {
+        // Might have been evicted since, in which case it is decoded again.
+        QImage image;
+        try
+        {
+            image = this->getImage(imagePath, QImage::Format_ARGB32_Premultiplied);
+        }
+        catch (utils::Exception&)
+        {
+        }
+
+        if (image.isNull())
+        {
+            wWarning.format("Not writing image-cache, image `{}' failed to load", imagePath);
+            return;
+        }
+        images.emplace_back(imagePath, std::move(image));
+    }
+
+    const QFileInfo info(path);
+    QDir dir = info.dir();
+
+    try
+    {
+        if (!dir.mkpath("."))
+            throw utils::IOError(fmt::format("Failed to create directory `{}'", dir.path()));
+
+        ImageCacheFile::write(path, images);
+    }
+    catch (utils::IOError& e)
+    {
+        wWarning.format("Failed to write image-cache: {}", e.what());
+        return;
+    }
+
+    wInfo.format("Wrote {} images to image-cache `{}'", images.size(), path);
+
+    // Remove the stale caches of this surface, with a different content-hash.
+    const QString prefix = info.fileName().section('-', 0, 0);
+    for (const auto& stale : dir.entryList({prefix + "-*." + utils::fileExtensions::imageCache}, QDir::Files))
+    {
+        if (stale != info.fileName())
+            dir.remove(stale);
+    }
+}
+
 WorldSurface::Storage::Header WorldSurface::Storage::parseHeader(const QByteArray& rawHeader)
 {
     io::JsonSerializer serializer;
@@ -430,6 +791,16 @@ WorldSurface::Storage::Header WorldSurface::Storage::parseHeader(const QByteArra
             header.colors.emplace(color.first, color.second.asColor());
         }
 
+        // Optional, surfaces are not required to provide terrain colors.
+        const auto terrainColorsIt = obj.find("terrainColors");
+        if (terrainColorsIt != obj.end())
+        {
+            for (const auto& color : terrainColorsIt->second.asMap())
+            {
+                header.terrainColors.emplace(color.first, color.second.asColor());
+            }
+        }
+
         for (const auto& graphicAsset : obj.at("graphicAssets").asMap())
         {
             header.graphicAssets.emplace(graphicAsset.first, graphicAsset.second.asString());
@@ -495,19 +866,33 @@ QUrl DirectoryStorage::getImageUrl(const QString& path) const
     return QUrl::fromLocalFile(this->getPath() / path);
 }
 
-WorldSurface::Storage::Header ArchiveStorage::load()
+void DirectoryStorage::hashContentStamp(QCryptographicHash& hash) const
 {
-    KTar package(this->getPath());
-    if (!package.open(QIODevice::ReadOnly))
+    const QDir surfaceDir(this->getPath());
+
+    std::vector<QFileInfo> files;
+    QDirIterator it(this->getPath(), QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext())
     {
-        throw utils::IOError(
-            "Failed to open surface package " + this->getPath() + ". " + package.device()->errorString());
+        it.next();
+        files.push_back(it.fileInfo());
     }
 
-    const KArchiveDirectory* rootDir = package.directory();
-    const QStringList entries = rootDir->entries();
-    const auto& it = std::find_if(entries.cbegin(), entries.cend(), [](const QString& s) {
-        return s.endsWith("." + utils::fileExtensions::surfaceMetadata);
+    std::sort(files.begin(), files.end(), [](const QFileInfo& a, const QFileInfo& b) {
+        return a.filePath() < b.filePath();
+    });
+
+    for (const auto& file : files)
+        hashFileStamp(hash, surfaceDir.relativeFilePath(file.filePath()), file);
+}
+
+WorldSurface::Storage::Header ArchiveStorage::load()
+{
+    this->package = std::make_unique<io::TarArchive>(this->getPath());
+
+    const auto& entries = this->package->getEntries();
+    const auto it = std::find_if(entries.cbegin(), entries.cend(), [](const auto& entry) {
+        return !entry.first.contains('/') && entry.first.endsWith("." + utils::fileExtensions::surfaceMetadata);
     });
 
     if (it == entries.cend())
@@ -515,58 +900,39 @@ WorldSurface::Storage::Header ArchiveStorage::load()
         throw utils::IOError("No metadata file found in surface package " + this->getPath());
     }
 
-    const KArchiveEntry* headerEntry = rootDir->entry(*it);
-    if (headerEntry->isDirectory())
-    {
-        throw utils::IOError("Metadata file is not a file in surface package " + this->getPath());
-    }
-
-    const KArchiveFile* headerFile = dynamic_cast<const KArchiveFile*>(headerEntry);
+    const io::TarArchive::Entry& header = it->second;
+    const auto headerData = reinterpret_cast<const char*>(header.data);
 
-    return this->parseHeader(headerFile->data());
+    return this->parseHeader(QByteArray::fromRawData(headerData, static_cast<int>(header.size)));
 }
 
 void ArchiveStorage::activate()
 {
-    KTar package(this->getPath());
-    if (!package.open(QIODevice::ReadOnly))
-    {
-        throw utils::IOError(
-            "Failed to open surface package " + this->getPath() + ": " + package.device()->errorString());
-    }
-    const KArchiveDirectory* rootDir = package.directory();
-    const QStringList entries = rootDir->entries();
     const QString rccEntryName = this->getName() + "." + utils::fileExtensions::qResourceData;
+    const io::TarArchive::Entry* rccEntry = this->package->findEntry(rccEntryName);
 
-    if (std::find(entries.cbegin(), entries.cend(), rccEntryName) == entries.cend())
+    if (rccEntry == nullptr)
     {
         throw utils::IOError("No rcc file found in surface package " + this->getPath());
     }
 
-    const KArchiveEntry* rccEntry = rootDir->entry(rccEntryName);
-    if (rccEntry->isDirectory())
-    {
-        throw utils::IOError("rcc file is not a file in surface package " + this->getPath());
-    }
-
-    const KArchiveFile* rccFile = dynamic_cast<const KArchiveFile*>(rccEntry);
-    this->resourceData = rccFile->data();
-
-    const unsigned char* data = reinterpret_cast<const uchar*>(this->resourceData.data());
-    if (!QResource::registerResource(data))
+    if (!QResource::registerResource(rccEntry->data))
     {
         throw utils::IOError("Failed to register  " + this->getPath());
     }
+
+    this->resourceData = rccEntry->data;
 }
 
 void ArchiveStorage::deactivate()
 {
-    const unsigned char* data = reinterpret_cast<const uchar*>(this->resourceData.data());
-    if (!QResource::unregisterResource(data))
+    if (!QResource::unregisterResource(this->resourceData))
     {
         throw utils::IOError("Failed to unregister  " + this->getPath());
     }
 
+    this->resourceData = nullptr;
+
     wInfo << "Succesfully deactivated surface " << this->getName();
 }
 
@@ -580,6 +946,16 @@ QUrl ArchiveStorage::getImageUrl(const QString& path) const
     return QUrl::fromLocalFile(QStringLiteral("qrc://") + path);
 }
 
+/*
+ * The package is only ever replaced as a whole so its own stamp stands in
+ * for the stamps of the entries.
+ */
+void ArchiveStorage::hashContentStamp(QCryptographicHash& hash) const
+{
+    const QFileInfo package(this->getPath());
+    hashFileStamp(hash, package.fileName(), package);
+}
+
 static bool hasAllMandatoryImages(const WorldSurface& surface)
 {
     const auto isImageMissing = [&](const QString& path) { return surface.getImage(path).isNull(); };
@@ -602,5 +978,33 @@ static bool hasAllMandatoryImages(const WorldSurface& surface)
     return true;
 }
 
+static QString imageCacheFilePath(const QString& dir, const WorldSurface::Storage& storage)
+{
+    QCryptographicHash contentHash(QCryptographicHash::Md5);
+    storage.hashContentStamp(contentHash);
+
+    const QByteArray pathHash = QCryptographicHash::hash(storage.getPath().toUtf8(), QCryptographicHash::Md5);
+
+    return dir / QString("%1-%2.%3").arg(QString::fromLatin1(pathHash.toHex()),
+                     QString::fromLatin1(contentHash.result().toHex()),
+                     utils::fileExtensions::imageCache);
+}
+
+static void hashFileStamp(QCryptographicHash& hash, const QString& name, const QFileInfo& file)
+{
+    const qint64 size = file.size();
+    const qint64 modified = file.lastModified().toMSecsSinceEpoch();
+
+    hash.addData(name.toUtf8());
+    hash.addData(reinterpret_cast<const char*>(&size), sizeof(size));
+    hash.addData(reinterpret_cast<const char*>(&modified), sizeof(modified));
+}
+
+static std::size_t textureSize(const QSGTexture* texture)
+{
+    const QSize size = texture->textureSize();
+    return static_cast<std::size_t>(size.width()) * size.height() * 4;
+}
+
 } // namespace ui
 } // namespace warmonger
@@ -22,6 +22,7 @@
 #define W_UI_WORLD_SURFACE_H
 
 #include <memory>
+#include <unordered_set>
 
 #include <QColor>
 #include <QImage>
@@ -29,7 +30,9 @@
 #include <QUrl>
 
 #include "core/World.h"
+#include "ui/HexMask.h"
 #include "ui/WorldSurfaceRules.h"
+#include "utils/LruCache.h"
 #include "utils/Utils.h"
 
 class QQuickWindow;
@@ -38,6 +41,8 @@ class QSGTexture;
 namespace warmonger {
 namespace ui {
 
+class AssetPreloader;
+
 /**
  * Graphical representation of a world.
  *
@@ -67,6 +72,7 @@ class WorldSurface : public QObject
     Q_PROPERTY(QString description READ getDescription NOTIFY descriptionChanged)
     Q_PROPERTY(int tileSize READ getTileSize CONSTANT)
     Q_PROPERTY(int gridSize READ getGridSize CONSTANT)
+    Q_PROPERTY(qreal loadingProgress READ getLoadingProgress NOTIFY loadingProgressChanged)
 
 public:
     class Storage;
@@ -155,6 +161,19 @@ public:
         return *this->rules;
     }
 
+    /**
+     * Create a new, independent instance of the rules.
+     *
+     * The rules returned by getRules() are bound to the GUI thread.
+     * Threads that wish to use the rules should create their own
+     * instance with this method, on the thread that will use it.
+     *
+     * \returns the created and loaded rules
+     *
+     * \throws utils::ScriptError if loading the rules fails
+     */
+    std::unique_ptr<WorldSurfaceRules> createRules();
+
     /**
      * Does the hexagon contain the point?
      *
@@ -181,23 +200,121 @@ public:
      */
     bool hexContains(const QPointF& p) const;
 
+    /**
+     * Get the hexagon-mask.
+     *
+     * Use for testing many points at once.
+     * \see HexMask::contains(const QPoint*, std::size_t, bool*) const
+     *
+     * \returns the hexagon-mask, empty if the surface is not active
+     */
+    const HexMask& getHexMask() const
+    {
+        return this->hexMask;
+    }
+
     /**
      * Activate the surface.
      *
      * Loads the resource file and registers it with the Qt resource system.
      * This will possibly overwrite any previosly loaded surface. Make sure
      * you call deactivate on the previously activated surface.
+     * Starts decoding all the images of the surface in the background,
+     * see WorldSurface::getLoadingProgress().
      */
     void activate();
 
     /**
      * Deactivate the surface.
      *
-     * Unregisters the resources associated with this surface from the Qt
-     * resource system.
+     * Cancels the background decoding of the images and unregisters the
+     * resources associated with this surface from the Qt resource system.
      */
     void deactivate();
 
+    /**
+     * Wait for the background decoding of the images to finish.
+     */
+    void waitForAssets();
+
+    /**
+     * Set the directory of the decoded-image cache.
+     *
+     * The decoded graphic assets are written to a file in this directory,
+     * keyed by the surface's path and the sizes and modification times of
+     * its files, so that subsequent activations can use them without
+     * decoding them again. Defaults to
+     * the `cache' directory in the work directory, if that is set.
+     * Takes effect on the next activation.
+     *
+     * \param dir the directory, an empty string disables the cache
+     */
+    void setImageCacheDir(const QString& dir)
+    {
+        this->imageCacheDir = dir;
+    }
+
+    const QString& getImageCacheDir() const
+    {
+        return this->imageCacheDir;
+    }
+
+    /**
+     * Set the memory budget of the decoded images.
+     *
+     * The least recently used images are evicted when the budget is
+     * exceeded. Evicted images are decoded again when requested. Images
+     * loaded from the on-disk image-cache don't count against the budget.
+     * Defaults to the `imageCacheBudget' setting.
+     *
+     * \param budget the budget in bytes
+     */
+    void setImageCacheBudget(std::size_t budget);
+
+    /**
+     * Set the memory budget of the textures.
+     *
+     * The least recently used textures are evicted when the budget is
+     * exceeded, see WorldSurface::prepareTextures() for when.
+     * Defaults to the `textureCacheBudget' setting.
+     *
+     * \param budget the budget in bytes
+     */
+    void setTextureCacheBudget(std::size_t budget);
+
+    utils::CacheStats getImageCacheStats() const;
+    utils::CacheStats getTextureCacheStats() const;
+
+    /**
+     * The progress of the background decoding of the images.
+     *
+     * \returns the ratio of the decoded images, in the [0, 1] range
+     */
+    qreal getLoadingProgress() const;
+
+    /**
+     * Have all images been decoded?
+     */
+    bool areAssetsLoaded() const;
+
+    /**
+     * Create the textures of the already decoded assets for the window.
+     *
+     * Meant to be called at the start of each frame, so that the textures
+     * are created before they are needed, as the images become available.
+     * Textures are only created while they fit into the texture budget.
+     * This is also when textures are evicted, if the texture-cache is over
+     * budget. Only textures which nobody holds a reference to (see
+     * WorldSurface::getTexture()) are evicted, so textures displayed by
+     * items which don't re-render every frame stay valid.
+     *
+     * Warning: Only call this function on the rendering thread, i.e.
+     * from the QQuickItem::updatePaintedNode() overrides!
+     *
+     * \param window the window to which the textures belong to
+     */
+    void prepareTextures(QQuickWindow* window) const;
+
     /**
      * Get the asset id for the asset.
      *
@@ -212,6 +329,16 @@ public:
      */
     AssetId getAssetIdFor(const QString& assetName);
 
+    /**
+     * Get the asset ids of all the assets, by name.
+     *
+     * \see WorldSurface::getAssetIdFor()
+     */
+    const std::unordered_map<QString, AssetId>& getAssetIds() const
+    {
+        return this->graphicAssetNameToId;
+    }
+
     /**
      * Get the QSGTexture for the asset id and window.
      *
@@ -221,22 +348,24 @@ public:
      * Warning: Only call this function on the rendering thread, i.e.
      * from the QQuickItem::updatePaintedNode() overrides!
      *
-     * Warning: The returned texture is owned by the surface, do not delete
-     * it and do not allow any QSGNodes to take ownership!
+     * The returned texture is shared with the surface's texture-cache.
+     * Hold on to the reference for as long as the texture is displayed,
+     * e.g. in the texture-node, the texture is not evicted while it is
+     * held. Do not allow any QSGNodes to take ownership!
      *
      * \param id the asset id to get the texture for
      * \param window the window to which the texture belongs to
      *
      * \return the texture
      */
-    QSGTexture* getTexture(AssetId id, QQuickWindow* window) const;
+    std::shared_ptr<QSGTexture> getTexture(AssetId id, QQuickWindow* window) const;
 
     /**
      * Get the QSGTexture for the path and window.
      *
      * DEPRECATED! Use the AssetId overload.
      */
-    QSGTexture* getTexture(const QString& path, QQuickWindow* window) const;
+    std::shared_ptr<QSGTexture> getTexture(const QString& path, QQuickWindow* window) const;
 
     /**
      * Get the image for the asset id.
@@ -289,6 +418,20 @@ public:
      */
     QColor colorFor(const core::Color& color) const;
 
+    /**
+     * The representative color of the terrain-type.
+     *
+     * Used where drawing the actual terrain is not feasible, e.g. on the
+     * minimap. Surfaces can define these colors in the optional
+     * `terrainColors' header field, for terrain-types not defined there a
+     * color is derived from the name.
+     *
+     * \param terrainType the terrain-type
+     *
+     * \returns the color
+     */
+    QColor colorForTerrain(const QString& terrainType) const;
+
 signals:
     /**
      * Emitted when the name changes.
@@ -310,6 +453,20 @@ signals:
      */
     void tileHeightChanged();
 
+    /**
+     * Emitted when the loading progress changes.
+     *
+     * Emitted from the loading threads.
+     */
+    void loadingProgressChanged();
+
+    /**
+     * Emitted when all images were decoded.
+     *
+     * Emitted from a loading thread.
+     */
+    void assetsLoaded();
+
 private:
     void parseHeader(const QByteArray& header);
 
@@ -322,7 +479,7 @@ private:
 
     int tileSize;
     int gridSize;
-    QImage hexMask;
+    HexMask hexMask;
 
     QString rulesEntryPoint;
     WorldSurfaceRules::Type rulesType;
@@ -330,9 +487,14 @@ private:
 
     std::unordered_map<QString, QString> banners;
     std::unordered_map<QString, QColor> colors;
+    std::unordered_map<QString, QColor> terrainColors;
     std::unordered_map<QString, QString> graphicAssetsByName; // name -> path
     std::unordered_map<AssetId, QString> graphicAssetsById; // id -> path
     std::unordered_map<QString, AssetId> graphicAssetNameToId; // name -> id
+
+    QString imageCacheDir;
+    std::unique_ptr<AssetPreloader> preloader;
+    mutable std::unordered_set<QQuickWindow*> texturesPrepared;
 };
 
 /**
@@ -21,11 +21,53 @@
 #include "core/Map.h"
 #include "ui/LuaWorldSurfaceRules.h"
 #include "ui/WorldSurface.h"
+#include "utils/Exception.h"
 #include "utils/Utils.h"
 
 namespace warmonger {
 namespace ui {
 
+namespace graphics {
+
+void Map::reserve(std::size_t mapNodeCount, std::size_t layerCount, std::size_t gridTileCount)
+{
+    this->mapNodes.reserve(mapNodeCount);
+    this->layers.reserve(layerCount);
+    this->gridTiles.reserve(gridTileCount);
+}
+
+void Map::beginMapNode(core::MapNode* mapNode)
+{
+    const std::size_t layerIndex = this->layers.size();
+    this->mapNodes.push_back(MapNode{mapNode, Range{layerIndex, layerIndex}});
+}
+
+void Map::beginLayer()
+{
+    if (this->mapNodes.empty())
+        throw utils::ValueError("Cannot begin layer: there is no map-node to add it to");
+
+    const std::size_t gridTileIndex = this->gridTiles.size();
+    this->layers.push_back(Range{gridTileIndex, gridTileIndex});
+    ++this->mapNodes.back().layers.end;
+}
+
+void Map::addGridTile(const GridTile& gridTile)
+{
+    this->addGridTiles(&gridTile, 1);
+}
+
+void Map::addGridTiles(const GridTile* first, std::size_t count)
+{
+    if (this->mapNodes.empty() || this->mapNodes.back().layers.size() == 0)
+        throw utils::ValueError("Cannot add grid-tile: there is no layer to add it to");
+
+    this->gridTiles.insert(this->gridTiles.end(), first, first + count);
+    this->layers.back().end += count;
+}
+
+} // namespace graphics
+
 WorldSurfaceRules::WorldSurfaceRules(WorldSurface& worldSurface)
     : worldSurface(worldSurface)
 {
@@ -22,6 +22,7 @@
 #define W_UI_WORLD_SURFACE_RULES_H
 
 #include <memory>
+#include <vector>
 
 #include <QObject>
 
@@ -29,8 +30,8 @@ namespace warmonger {
 
 namespace core {
 
-class Map;
 class MapNode;
+class MapSnapshot;
 
 } // namespace core
 
@@ -49,20 +50,74 @@ struct GridTile
     int assetId;
 };
 
-struct MapNodeLayer
+/**
+ * Half-open [begin, end) range of indexes into one of Map's arrays.
+ */
+struct Range
 {
-    std::vector<GridTile> gridTiles;
+    std::size_t begin;
+    std::size_t end;
+
+    std::size_t size() const
+    {
+        return this->end - this->begin;
+    }
 };
 
 struct MapNode
 {
     core::MapNode* mapNode;
-    std::vector<MapNodeLayer> layers;
+    // range in Map::layers
+    Range layers;
 };
 
+/**
+ * The graphical representation of the map.
+ *
+ * A flat render-command buffer: the grid-tiles of all layers of all
+ * map-nodes are stored in a single contiguous array, layers and map-nodes
+ * refer to their content by index ranges.
+ * The map is built front-to-back: Map::beginMapNode() starts a new
+ * map-node, Map::beginLayer() starts a new layer in the current map-node,
+ * Map::addGridTile() and Map::addGridTiles() append to the current layer.
+ */
 struct Map
 {
     std::vector<MapNode> mapNodes;
+    // each range is in gridTiles
+    std::vector<Range> layers;
+    std::vector<GridTile> gridTiles;
+
+    /**
+     * Reserve capacity to avoid reallocations while building.
+     */
+    void reserve(std::size_t mapNodeCount, std::size_t layerCount, std::size_t gridTileCount);
+
+    /**
+     * Start a new map-node.
+     */
+    void beginMapNode(core::MapNode* mapNode);
+
+    /**
+     * Start a new layer in the current map-node.
+     *
+     * \throws utils::ValueError if there is no current map-node
+     */
+    void beginLayer();
+
+    /**
+     * Append the grid-tile to the current layer.
+     *
+     * \throws utils::ValueError if there is no current layer
+     */
+    void addGridTile(const GridTile& gridTile);
+
+    /**
+     * Append the grid-tiles to the current layer.
+     *
+     * \throws utils::ValueError if there is no current layer
+     */
+    void addGridTiles(const GridTile* first, std::size_t count);
 };
 
 } // namespace graphics
@@ -100,7 +155,21 @@ public:
      */
     virtual void loadRules(const QString& basePath, const QString& mainRulesFile) = 0;
 
-    virtual graphics::Map renderMap(core::Map& map) = 0;
+    /**
+     * Render the map.
+     *
+     * Translates the map into its graphical representation. The map is
+     * passed in as a snapshot so that rendering can run on any thread.
+     * An instance should only be used from a single thread, use
+     * WorldSurface::createRules() to get an instance for each thread.
+     *
+     * \param map the snapshot of the map to render
+     *
+     * \returns the graphical representation of the map
+     *
+     * \throws utils::ScriptError if rendering fails
+     */
+    virtual graphics::Map renderMap(const core::MapSnapshot& map) = 0;
 
     WorldSurface& getWorldSurface() const
     {
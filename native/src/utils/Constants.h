@@ -56,6 +56,9 @@ const QString surfacePackage{"wsp"};
 // Warmonger Surface Metadata
 const QString surfaceMetadata{"wsm"};
 
+// Warmonger Image Cache
+const QString imageCache{"wic"};
+
 // Qt Resource Definition
 const QString qResourceDefinition{"qrc"};
 
@@ -72,6 +75,9 @@ const QString maps{"maps"};
 // Relative path of the surfaces directory in the world directory
 const QString surfaces{"surfaces"};
 
+// Relative path of the cache directory in the work directory
+const QString cache{"cache"};
+
 } // namespace paths
 
 namespace searchPaths {
@@ -23,19 +23,129 @@
 
 #include "utils/Logging.h"
 
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
 #include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #include "Version.h"
+#include "utils/MpscQueue.h"
 
 namespace warmonger {
 namespace utils {
 
+namespace {
+
 const char loggerName[] = "console";
 
+// Sized so that a record is 512 bytes, longer messages are stored on
+// the heap.
+const std::size_t recordTextSize{496};
+
+struct LogRecord
+{
+    spdlog::level::level_enum level;
+    std::size_t size;
+    char text[recordTextSize];
+    std::unique_ptr<std::string> longText;
+};
+
+/*
+ * Writes the log messages on a background thread.
+ */
+class AsyncLogWriter
+{
+public:
+    AsyncLogWriter(std::shared_ptr<spdlog::logger> logger, LogOverflowPolicy policy, std::size_t queueCapacity);
+    ~AsyncLogWriter();
+
+    void push(spdlog::level::level_enum level, const std::string& text);
+    void flush();
+
+private:
+    void waitForProgress();
+    void run();
+    void drain();
+
+    std::shared_ptr<spdlog::logger> logger;
+    const LogOverflowPolicy policy;
+    MpscQueue<LogRecord> queue;
+
+    std::atomic<bool> stopping;
+    std::atomic<bool> sleeping;
+    std::atomic<std::size_t> dropped;
+    std::atomic<std::size_t> flushRequested;
+    std::atomic<std::size_t> flushCompleted;
+
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    // Signalled by the writer after each iteration, for the producers
+    // waiting for room in the queue and for flush().
+    std::condition_variable progress;
+    std::size_t iterations;
+    std::thread writer;
+};
+
+/*
+ * Appends to a string which keeps its capacity across messages.
+ */
+class LogStreamBuffer : public std::streambuf
+{
+public:
+    std::string& str()
+    {
+        return this->data;
+    }
+
+protected:
+    int_type overflow(int_type ch) override
+    {
+        if (!traits_type::eq_int_type(ch, traits_type::eof()))
+            this->data.push_back(traits_type::to_char_type(ch));
+        return ch;
+    }
+
+    std::streamsize xsputn(const char* s, std::streamsize n) override
+    {
+        this->data.append(s, static_cast<std::size_t>(n));
+        return n;
+    }
+
+private:
+    std::string data;
+};
+
+struct LogStream
+{
+    LogStream()
+        : stream(&buffer)
+    {
+        this->buffer.str().reserve(256);
+    }
+
+    LogStreamBuffer buffer;
+    std::ostream stream;
+};
+
+} // namespace
+
+std::atomic<LogLevel> detail::logLevel{LogLevel::Debug};
+
 static std::shared_ptr<spdlog::logger> wLogger;
+// Declared after wLogger so that it is destroyed (and drained) first.
+static std::unique_ptr<AsyncLogWriter> asyncWriter;
+
+// A stack, as building a message can log too (e.g. in an operator<<).
+static thread_local std::vector<std::unique_ptr<LogStream>> logStreams;
+static thread_local std::size_t logStreamsInUse{0};
 
 static void qtMessageHandler(QtMsgType type, const QMessageLogContext& ctx, const QString& msg);
-static void log(LogLevel level, const std::string& file, const char* function, int line, const std::string& msg);
+static std::ostream& acquireLogStream();
+static std::string& releaseLogStream();
+static void log(LogLevel level, const char* file, const char* function, int line, const std::string& msg);
 
 LogConfig LogConfig::File(std::string file)
 {
@@ -54,6 +164,10 @@ LogConfig LogConfig::Stream(std::ostream& s)
 
 void initLogging(const LogConfig& cfg)
 {
+    // Drain the queued messages into the previous logger.
+    asyncWriter.reset();
+    spdlog::drop(loggerName);
+
     switch (cfg.getSinkType())
     {
         case LogSinkType::Console: {
@@ -71,8 +185,30 @@ void initLogging(const LogConfig& cfg)
         break;
     }
 
-    spdlog::set_level(spdlog::level::debug);
+    // Filtering is done by isLogLevelEnabled(), before the message is
+    // built, let everything through spdlog.
+    spdlog::set_level(spdlog::level::trace);
+    setLogLevel(cfg.getLevel());
     qInstallMessageHandler(qtMessageHandler);
+
+    if (cfg.isAsync())
+        asyncWriter = std::make_unique<AsyncLogWriter>(wLogger, cfg.getOverflowPolicy(), cfg.getQueueCapacity());
+}
+
+void setLogLevel(LogLevel level)
+{
+    detail::logLevel.store(level, std::memory_order_relaxed);
+}
+
+LogLevel getLogLevel()
+{
+    return detail::logLevel.load(std::memory_order_relaxed);
+}
+
+void flushLogging()
+{
+    if (asyncWriter)
+        asyncWriter->flush();
 }
 
 LogEntry::LogEntry(LogLevel level, const char* file, const char* function, int line)
@@ -80,12 +216,151 @@ LogEntry::LogEntry(LogLevel level, const char* file, const char* function, int l
     , file(file)
     , function(function)
     , line(line)
+    , msg(acquireLogStream())
 {
 }
 
 LogEntry::~LogEntry()
 {
-    log(this->level, this->file, this->function, this->line, this->msg.str());
+    log(this->level, this->file, this->function, this->line, releaseLogStream());
+}
+
+AsyncLogWriter::AsyncLogWriter(
+    std::shared_ptr<spdlog::logger> logger, LogOverflowPolicy policy, std::size_t queueCapacity)
+    : logger(std::move(logger))
+    , policy(policy)
+    , queue(queueCapacity)
+    , stopping(false)
+    , sleeping(false)
+    , dropped(0)
+    , flushRequested(0)
+    , flushCompleted(0)
+    , iterations(0)
+    , writer(&AsyncLogWriter::run, this)
+{
+}
+
+AsyncLogWriter::~AsyncLogWriter()
+{
+    this->stopping = true;
+    this->wakeUp.notify_one();
+    this->writer.join();
+}
+
+void AsyncLogWriter::push(spdlog::level::level_enum level, const std::string& text)
+{
+    const auto fill = [&](LogRecord& record) {
+        record.level = level;
+        record.size = text.size();
+
+        if (text.size() <= recordTextSize)
+            std::memcpy(record.text, text.data(), text.size());
+        else
+            record.longText = std::make_unique<std::string>(text);
+    };
+
+    while (!this->queue.tryPush(fill))
+    {
+        if (this->policy == LogOverflowPolicy::Drop)
+        {
+            ++this->dropped;
+            return;
+        }
+
+        this->waitForProgress();
+    }
+
+    if (this->sleeping.load(std::memory_order_acquire))
+        this->wakeUp.notify_one();
+}
+
+void AsyncLogWriter::flush()
+{
+    // Everything pushed before the request is written by the first
+    // writer iteration that sees the request.
+    const std::size_t request = ++this->flushRequested;
+
+    while (this->flushCompleted < request)
+        this->waitForProgress();
+}
+
+/*
+ * Wakes up the writer and waits until it completes an iteration. An
+ * iteration completed between the caller's last check and taking the
+ * lock is not noticed, the caller then just waits for the next one.
+ */
+void AsyncLogWriter::waitForProgress()
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+
+    const std::size_t iteration = this->iterations;
+
+    this->wakeUp.notify_one();
+    this->progress.wait(lock, [this, iteration] { return this->iterations != iteration; });
+}
+
+void AsyncLogWriter::run()
+{
+    while (true)
+    {
+        const std::size_t flushRequest = this->flushRequested;
+        const bool stop = this->stopping;
+
+        this->drain();
+
+        const std::size_t droppedCount = this->dropped.exchange(0);
+        if (droppedCount > 0)
+        {
+            this->logger->log(spdlog::level::warn,
+                fmt::format("Dropped {} log messages, the log queue was full", droppedCount).c_str());
+        }
+
+        if (flushRequest != this->flushCompleted)
+        {
+            this->logger->flush();
+            this->flushCompleted = flushRequest;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            ++this->iterations;
+        }
+        this->progress.notify_all();
+
+        if (stop)
+            break;
+
+        // Producers only notify when the writer is sleeping, the timeout
+        // bounds the latency of a missed notification.
+        this->sleeping.store(true, std::memory_order_release);
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->wakeUp.wait_for(lock, std::chrono::milliseconds(10));
+        }
+        this->sleeping.store(false, std::memory_order_release);
+    }
+
+    this->logger->flush();
+}
+
+void AsyncLogWriter::drain()
+{
+    std::string text;
+
+    const auto write = [&](LogRecord& record) {
+        if (record.longText)
+            text = std::move(*record.longText);
+        else
+            text.assign(record.text, record.size);
+
+        record.longText.reset();
+
+        this->logger->log(record.level, text);
+    };
+
+    while (this->queue.tryPop(write))
+    {
+    }
 }
 
 static void qtMessageHandler(QtMsgType type, const QMessageLogContext& ctx, const QString& msg)
@@ -111,11 +386,36 @@ static void qtMessageHandler(QtMsgType type, const QMessageLogContext& ctx, cons
             break;
     }
 
-    const auto file = ctx.file ? std::string{ctx.file} : std::string{};
-    log(lvl, file, nullptr, ctx.line, msg.toStdString());
+    if (isLogLevelEnabled(lvl))
+        log(lvl, ctx.file, nullptr, ctx.line, msg.toStdString());
 }
 
-static void log(LogLevel level, const std::string& file, const char* function, int line, const std::string& msg)
+static std::ostream& acquireLogStream()
+{
+    if (logStreamsInUse == logStreams.size())
+        logStreams.push_back(std::make_unique<LogStream>());
+
+    LogStream& logStream = *logStreams[logStreamsInUse++];
+
+    logStream.buffer.str().clear();
+
+    // Undo any formatting changes of the previous message.
+    std::ostream& stream = logStream.stream;
+    stream.clear();
+    stream.flags(std::ios_base::dec | std::ios_base::skipws);
+    stream.precision(6);
+    stream.width(0);
+    stream.fill(' ');
+
+    return stream;
+}
+
+static std::string& releaseLogStream()
+{
+    return logStreams[--logStreamsInUse]->buffer.str();
+}
+
+static void log(LogLevel level, const char* file, const char* function, int line, const std::string& msg)
 {
     spdlog::level::level_enum lvl;
     switch (level)
@@ -141,28 +441,41 @@ static void log(LogLevel level, const std::string& file, const char* function, i
             break;
     }
 
-    std::stringstream s;
+    const bool hasFile = file != nullptr && file[0] != '\0';
 
-    if (!file.empty() || function)
+    // Reused, to avoid allocating for each message.
+    thread_local std::string s;
+    s.clear();
+
+    if (hasFile || function)
     {
-        s << "[";
-        if (!file.empty())
-            s << file;
+        s += "[";
+        if (hasFile)
+            s += file;
 
         if (line >= 0)
-            s << ":" << line;
+        {
+            s += ":";
+            s += std::to_string(line);
+        }
 
-        if (!file.empty() && function && line >= 0)
-            s << " ";
+        if (hasFile && function && line >= 0)
+            s += " ";
 
         if (function)
-            s << function << "()";
+        {
+            s += function;
+            s += "()";
+        }
 
-        s << "] ";
+        s += "] ";
     }
-    s << msg;
+    s += msg;
 
-    wLogger->log(lvl, s.str());
+    if (asyncWriter)
+        asyncWriter->push(lvl, s);
+    else
+        wLogger->log(lvl, s);
 }
 
 } // namespace utils
@@ -21,10 +21,22 @@
 #ifndef W_UTILS_LOGGING_H
 #define W_UTILS_LOGGING_H
 
-#include <sstream>
+#include <atomic>
+#include <ostream>
+#include <string>
 
 #include <fmt/format.h>
 
+/**
+ * The minimum log level compiled in.
+ *
+ * The numeric value of the utils::LogLevel, set by the build system.
+ * Log statements of lower levels are compiled out entirely.
+ */
+#ifndef WARMONGER_MIN_LOG_LEVEL
+#define WARMONGER_MIN_LOG_LEVEL 0
+#endif
+
 namespace warmonger {
 namespace utils {
 
@@ -37,6 +49,34 @@ enum class LogLevel : char
     Error
 };
 
+namespace detail {
+
+extern std::atomic<LogLevel> logLevel;
+
+} // namespace detail
+
+/**
+ * Will messages of this level be logged?
+ *
+ * Checks both the compile-time minimum level and the runtime one. The
+ * former is a constant, so the check is folded away by the compiler for
+ * compiled-out levels.
+ */
+inline bool isLogLevelEnabled(LogLevel level)
+{
+    return static_cast<int>(level) >= WARMONGER_MIN_LOG_LEVEL &&
+        level >= detail::logLevel.load(std::memory_order_relaxed);
+}
+
+/**
+ * Set the runtime minimum log level.
+ *
+ * Levels below the compile-time minimum stay disabled regardless.
+ */
+void setLogLevel(LogLevel level);
+
+LogLevel getLogLevel();
+
 enum class LogSinkType
 {
     Console,
@@ -44,6 +84,18 @@ enum class LogSinkType
     Stream
 };
 
+/**
+ * What to do when the queue of the asynchronous logger is full.
+ *
+ * Block: wait for the writer to make room.
+ * Drop: drop the message, the number of dropped messages is logged.
+ */
+enum class LogOverflowPolicy
+{
+    Block,
+    Drop
+};
+
 /**
  * Logging configuration.
  */
@@ -80,6 +132,54 @@ public:
         return *this->stream;
     }
 
+    /**
+     * Log asynchronously.
+     *
+     * Messages are formatted on the logging thread and passed through
+     * a lock-free queue to a background thread which writes them to the
+     * sink. Use flushLogging() to wait for the queued messages to be
+     * written.
+     *
+     * \param policy what to do when the queue is full
+     * \param queueCapacity the number of messages the queue can hold
+     */
+    LogConfig& setAsync(LogOverflowPolicy policy = LogOverflowPolicy::Block, std::size_t queueCapacity = 8192)
+    {
+        this->async = true;
+        this->overflowPolicy = policy;
+        this->queueCapacity = queueCapacity;
+        return *this;
+    }
+
+    bool isAsync() const
+    {
+        return this->async;
+    }
+
+    LogOverflowPolicy getOverflowPolicy() const
+    {
+        return this->overflowPolicy;
+    }
+
+    std::size_t getQueueCapacity() const
+    {
+        return this->queueCapacity;
+    }
+
+    /**
+     * Set the runtime minimum log level, defaults to LogLevel::Debug.
+     */
+    LogConfig& setLevel(LogLevel level)
+    {
+        this->level = level;
+        return *this;
+    }
+
+    LogLevel getLevel() const
+    {
+        return this->level;
+    }
+
 private:
     LogConfig(LogSinkType sinkType, std::string file, std::ostream* stream)
         : sinkType(sinkType)
@@ -91,15 +191,36 @@ private:
     LogSinkType sinkType;
     std::string file;
     std::ostream* stream{};
+    bool async{false};
+    LogOverflowPolicy overflowPolicy{LogOverflowPolicy::Block};
+    std::size_t queueCapacity{0};
+    LogLevel level{LogLevel::Debug};
 };
 
 void initLogging(const LogConfig& cfg = LogConfig::Console());
 
+/**
+ * Wait for the queued messages to be written.
+ *
+ * Only has an effect when logging asynchronously.
+ */
+void flushLogging();
+
+/**
+ * A log message being built.
+ *
+ * The message is streamed into a buffer that belongs to the thread and
+ * is reused across messages, so building a message doesn't allocate,
+ * once the buffer has grown large enough.
+ */
 struct LogEntry
 {
     LogEntry(LogLevel level, const char* file, const char* function, int line);
     ~LogEntry();
 
+    LogEntry(const LogEntry&) = delete;
+    LogEntry& operator=(const LogEntry&) = delete;
+
     template <typename T>
     inline LogEntry& operator<<(T&& v)
     {
@@ -115,13 +236,30 @@ struct LogEntry
     }
 
     LogLevel level;
-    std::string file;
+    const char* file;
     const char* function;
     int line;
-    std::stringstream msg;
+    std::ostream& msg;
+};
+
+/**
+ * Turns the log statement into a void expression, so that it can be
+ * used in the conditional operator in wLog.
+ */
+struct LogVoidify
+{
+    void operator&(const LogEntry&)
+    {
+    }
 };
 
-#define wLog(lvl) ::warmonger::utils::LogEntry(lvl, __FILE__, __FUNCTION__, __LINE__)
+// The arguments of disabled log statements are not evaluated. operator&
+// binds weaker than operator<<, so the whole statement is the right-hand
+// side of the conditional operator.
+#define wLog(lvl)                                                                                                      \
+    !::warmonger::utils::isLogLevelEnabled(lvl)                                                                        \
+        ? (void)0                                                                                                      \
+        : ::warmonger::utils::LogVoidify() & ::warmonger::utils::LogEntry(lvl, __FILE__, __FUNCTION__, __LINE__)
 #define wTrace wLog(::warmonger::utils::LogLevel::Trace)
 #define wDebug wLog(::warmonger::utils::LogLevel::Debug)
 #define wInfo wLog(::warmonger::utils::LogLevel::Info)
@@ -0,0 +1,241 @@
+/** \file
+ * LruCache class.
+ *
+ * \copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef W_UTILS_LRU_CACHE_H
+#define W_UTILS_LRU_CACHE_H
+
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <list>
+#include <unordered_map>
+
+namespace warmonger {
+namespace utils {
+
+/**
+ * Statistics of a cache.
+ */
+struct CacheStats
+{
+    std::size_t hits = 0;
+    std::size_t misses = 0;
+    std::size_t evictions = 0;
+    std::size_t entries = 0;
+    std::size_t residentBytes = 0;
+    std::size_t budgetBytes = 0;
+};
+
+/**
+ * Least-recently-used cache with a memory budget.
+ *
+ * Each entry has a size in bytes, supplied on insertion. Entries are
+ * evicted, least recently used first, by LruCache::trim(), until the size
+ * of all entries is within the budget. Insertion doesn't evict so that
+ * the owner can decide when it is safe to do so.
+ * Not thread-safe.
+ */
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class LruCache
+{
+public:
+    /**
+     * Construct an empty cache.
+     *
+     * \param budget the budget in bytes
+     */
+    explicit LruCache(std::size_t budget = std::numeric_limits<std::size_t>::max())
+        : budget(budget)
+    {
+    }
+
+    LruCache(const LruCache&) = delete;
+    LruCache& operator=(const LruCache&) = delete;
+
+    /**
+     * Find the entry and mark it as the most recently used one.
+     *
+     * Counts as a hit or a miss in the stats.
+     *
+     * \returns the value or nullptr if not found
+     */
+    Value* find(const Key& key)
+    {
+        const auto it = this->index.find(key);
+
+        if (it == this->index.end())
+        {
+            ++this->stats.misses;
+            return nullptr;
+        }
+
+        ++this->stats.hits;
+        this->entries.splice(this->entries.begin(), this->entries, it->second);
+
+        return &it->second->value;
+    }
+
+    /**
+     * Is the entry in the cache?
+     *
+     * Doesn't touch the stats nor the recency of the entry.
+     */
+    bool contains(const Key& key) const
+    {
+        return this->index.count(key) != 0;
+    }
+
+    /**
+     * Insert the entry as the most recently used one.
+     *
+     * Replaces the existing entry with the same key, if any.
+     *
+     * \param key the key
+     * \param value the value
+     * \param size the size of the entry in bytes
+     *
+     * \returns the inserted value
+     */
+    Value& insert(const Key& key, Value value, std::size_t size)
+    {
+        this->erase(key);
+
+        this->entries.push_front(Entry{key, std::move(value), size});
+        this->index.emplace(key, this->entries.begin());
+        this->residentBytes += size;
+
+        return this->entries.front().value;
+    }
+
+    void erase(const Key& key)
+    {
+        const auto it = this->index.find(key);
+        if (it == this->index.end())
+            return;
+
+        this->residentBytes -= it->second->size;
+        this->entries.erase(it->second);
+        this->index.erase(it);
+    }
+
+    /**
+     * Erase all entries for which `predicate(key, value)' returns true.
+     *
+     * Doesn't count as evictions in the stats.
+     */
+    template <typename Predicate>
+    void eraseIf(Predicate&& predicate)
+    {
+        for (auto it = this->entries.begin(); it != this->entries.end();)
+        {
+            if (predicate(it->key, it->value))
+            {
+                this->residentBytes -= it->size;
+                this->index.erase(it->key);
+                it = this->entries.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+
+    /**
+     * Evict entries until the cache is within budget.
+     *
+     * Entries are considered least recently used first, only the ones for
+     * which `canEvict(key, value)' returns true are evicted.
+     */
+    template <typename Predicate>
+    void trim(Predicate&& canEvict)
+    {
+        for (auto it = this->entries.end(); this->residentBytes > this->budget && it != this->entries.begin();)
+        {
+            --it;
+
+            if (!canEvict(it->key, it->value))
+                continue;
+
+            this->residentBytes -= it->size;
+            this->index.erase(it->key);
+            it = this->entries.erase(it);
+            ++this->stats.evictions;
+        }
+    }
+
+    void trim()
+    {
+        this->trim([](const Key&, const Value&) { return true; });
+    }
+
+    /**
+     * Would an entry of the size fit into the budget?
+     */
+    bool fits(std::size_t size) const
+    {
+        return size <= this->budget && this->residentBytes <= this->budget - size;
+    }
+
+    void setBudget(std::size_t budget)
+    {
+        this->budget = budget;
+    }
+
+    std::size_t getBudget() const
+    {
+        return this->budget;
+    }
+
+    void clear()
+    {
+        this->index.clear();
+        this->entries.clear();
+        this->residentBytes = 0;
+    }
+
+    CacheStats getStats() const
+    {
+        CacheStats stats = this->stats;
+        stats.entries = this->entries.size();
+        stats.residentBytes = this->residentBytes;
+        stats.budgetBytes = this->budget;
+        return stats;
+    }
+
+private:
+    struct Entry
+    {
+        Key key;
+        Value value;
+        std::size_t size;
+    };
+
+    std::size_t budget;
+    std::size_t residentBytes = 0;
+    std::list<Entry> entries;
+    std::unordered_map<Key, typename std::list<Entry>::iterator, Hash> index;
+    CacheStats stats;
+};
+
+} // namespace utils
+} // namespace warmonger
+
+#endif // W_UTILS_LRU_CACHE_H
@@ -100,6 +100,10 @@ void initLuaScript(sol::state& lua, const QString& basePath, const QString& main
 
 static void wLuaLog(sol::this_state L, utils::LogLevel logLevel, const std::string& msg)
 {
+    // Don't bother walking the stack for disabled levels.
+    if (!utils::isLogLevelEnabled(logLevel))
+        return;
+
     // TODO: trim source files
     lua_Debug info;
     int level = 1;
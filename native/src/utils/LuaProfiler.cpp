@@ -0,0 +1,256 @@
+/**
+ * Copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "utils/LuaProfiler.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+
+#include <fmt/format.h>
+#include <lua.hpp>
+
+#include "utils/Logging.h"
+
+namespace warmonger {
+namespace utils {
+
+// The address of this is the key of the profiler in the Lua registry.
+static const char registryKey{};
+
+static std::string functionName(const lua_Debug& ar);
+
+bool LuaProfiler::isRequested()
+{
+    return std::getenv("WARMONGER_LUA_PROFILE") != nullptr;
+}
+
+LuaProfiler::LuaProfiler(lua_State* state, std::string name)
+    : state(state)
+    , name(std::move(name))
+{
+    lua_pushlightuserdata(this->state, this);
+    lua_rawsetp(this->state, LUA_REGISTRYINDEX, &registryKey);
+
+    lua_sethook(this->state, &LuaProfiler::hook, LUA_MASKCALL | LUA_MASKRET, 0);
+}
+
+LuaProfiler::~LuaProfiler()
+{
+    lua_sethook(this->state, nullptr, 0, 0);
+
+    lua_pushnil(this->state);
+    lua_rawsetp(this->state, LUA_REGISTRYINDEX, &registryKey);
+}
+
+void LuaProfiler::reset()
+{
+    this->functions.clear();
+    this->frames.clear();
+}
+
+std::vector<LuaFunctionStats> LuaProfiler::getStats() const
+{
+    std::vector<LuaFunctionStats> stats;
+    stats.reserve(this->functions.size());
+
+    for (const auto& function : this->functions)
+    {
+        if (function.second.stats.calls > 0)
+            stats.push_back(function.second.stats);
+    }
+
+    std::sort(stats.begin(), stats.end(), [](const LuaFunctionStats& a, const LuaFunctionStats& b) {
+        return a.selfTime > b.selfTime;
+    });
+
+    return stats;
+}
+
+void LuaProfiler::writeReport(std::ostream& out) const
+{
+    using Milliseconds = std::chrono::duration<double, std::milli>;
+
+    const auto stats = this->getStats();
+
+    out << fmt::format("Lua profile of {} ({} functions)\n", this->name, stats.size());
+    out << fmt::format("{:>10} {:>12} {:>12}  {}\n", "calls", "self [ms]", "total [ms]", "function");
+
+    for (const auto& function : stats)
+    {
+        out << fmt::format("{:>10} {:>12.3f} {:>12.3f}  {}{}\n",
+            function.calls,
+            Milliseconds(function.selfTime).count(),
+            Milliseconds(function.totalTime).count(),
+            function.native ? "[C] " : "",
+            function.name);
+    }
+}
+
+void LuaProfiler::logReport() const
+{
+    std::stringstream report;
+    this->writeReport(report);
+
+    wInfo << report.str();
+}
+
+void LuaProfiler::hook(lua_State* state, lua_Debug* ar)
+{
+    lua_rawgetp(state, LUA_REGISTRYINDEX, &registryKey);
+    auto profiler = static_cast<LuaProfiler*>(lua_touserdata(state, -1));
+    lua_pop(state, 1);
+
+    // Coroutines inherit the hook, but their frames would be mixed up
+    // with the main thread's.
+    if (profiler == nullptr || profiler->state != state)
+        return;
+
+    switch (ar->event)
+    {
+        case LUA_HOOKCALL:
+            profiler->enter(state, ar);
+            break;
+        case LUA_HOOKTAILCALL:
+            // The frame of the caller is replaced by that of the callee,
+            // there will be a single return event for both.
+            profiler->leave(nullptr);
+            profiler->enter(state, ar);
+            break;
+        case LUA_HOOKRET:
+            profiler->leave(profiler->lookup(state, ar));
+            break;
+    }
+}
+
+LuaProfiler::Function* LuaProfiler::lookup(lua_State* state, lua_Debug* ar)
+{
+    lua_getinfo(state, "S", ar);
+
+    FunctionKey key;
+    const bool native = ar->what[0] == 'C';
+
+    if (native)
+    {
+        // All the C functions share the same "source", identify them by
+        // the closure instead.
+        lua_getinfo(state, "f", ar);
+        key = FunctionKey{lua_topointer(state, -1), -1};
+        lua_pop(state, 1);
+    }
+    else
+    {
+        // Identify Lua functions by their prototype, so that closures
+        // created from the same code are aggregated together.
+        key = FunctionKey{ar->source, ar->linedefined};
+    }
+
+    auto it = this->functions.find(key);
+    if (it == this->functions.end())
+    {
+        const LuaFunctionStats stats{
+            std::string(), native, 0, std::chrono::nanoseconds(0), std::chrono::nanoseconds(0)};
+        it = this->functions.emplace(key, Function{stats, false, 0}).first;
+    }
+
+    Function& function = it->second;
+
+    if (!function.named && ar->event != LUA_HOOKRET)
+    {
+        lua_getinfo(state, "n", ar);
+
+        if (ar->name != nullptr || function.stats.name.empty())
+        {
+            function.stats.name = functionName(*ar);
+            function.named = ar->name != nullptr || ar->what[0] == 'm';
+        }
+    }
+
+    return &function;
+}
+
+void LuaProfiler::enter(lua_State* state, lua_Debug* ar)
+{
+    // If the function is called directly by the host, there can be no
+    // open frames. Any left are from calls aborted by an error.
+    lua_Debug caller;
+    if (!lua_getstack(state, 1, &caller))
+    {
+        while (!this->frames.empty())
+            this->leave(nullptr);
+    }
+
+    Function* function = this->lookup(state, ar);
+
+    ++function->activeCalls;
+
+    this->frames.push_back(Frame{function, std::chrono::steady_clock::now(), std::chrono::nanoseconds(0)});
+}
+
+void LuaProfiler::leave(const Function* returning)
+{
+    const auto now = std::chrono::steady_clock::now();
+
+    // Close the frames which were unwound by an error, up to and
+    // including the one of the returning function. If the returning
+    // function has no frame (it was called before the profiler was
+    // attached) there is nothing to do.
+    if (returning != nullptr &&
+        std::none_of(this->frames.begin(), this->frames.end(), [returning](const Frame& frame) {
+            return frame.function == returning;
+        }))
+    {
+        return;
+    }
+
+    while (!this->frames.empty())
+    {
+        const Frame frame = this->frames.back();
+        this->frames.pop_back();
+
+        const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(now - frame.start);
+
+        LuaFunctionStats& stats = frame.function->stats;
+
+        ++stats.calls;
+        stats.selfTime += elapsed - frame.childTime;
+
+        if (--frame.function->activeCalls == 0)
+            stats.totalTime += elapsed;
+
+        if (!this->frames.empty())
+            this->frames.back().childTime += elapsed;
+
+        if (returning == nullptr || frame.function == returning)
+            break;
+    }
+}
+
+static std::string functionName(const lua_Debug& ar)
+{
+    if (ar.what[0] == 'C')
+        return ar.name ? ar.name : "?";
+
+    if (ar.what[0] == 'm')
+        return fmt::format("main chunk ({})", ar.short_src);
+
+    return fmt::format("{} ({}:{})", ar.name ? ar.name : "?", ar.short_src, ar.linedefined);
+}
+
+} // namespace utils
+} // namespace warmonger
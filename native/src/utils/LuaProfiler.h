@@ -0,0 +1,180 @@
+/** \file
+ * LuaProfiler class.
+ *
+ * \copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef W_UTILS_LUA_PROFILER_H
+#define W_UTILS_LUA_PROFILER_H
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct lua_State;
+struct lua_Debug;
+
+namespace warmonger {
+namespace utils {
+
+/**
+ * The aggregated profile of a single function.
+ */
+struct LuaFunctionStats
+{
+    std::string name;
+    bool native;
+    std::uint64_t calls;
+    // Time spent in the function itself, excluding the functions it called.
+    std::chrono::nanoseconds selfTime;
+    // Time spent in the function, including the functions it called.
+    // Recursive calls are only accounted for once.
+    std::chrono::nanoseconds totalTime;
+};
+
+/**
+ * Hook-based profiler for a Lua state.
+ *
+ * Installs call and return hooks on the state with lua_sethook() and
+ * aggregates the call count, the self and the total time of each
+ * function. C functions, which includes all the C++ bindings exposed via
+ * sol, are profiled just like Lua ones, so time spent in the bindings
+ * shows up as well.
+ * Only the main thread of the state is profiled, coroutines are not.
+ * Frames which are unwound by an error are closed when their caller
+ * returns.
+ * The profiler has to be destroyed before the state it's attached to, and
+ * it is only to be used on the thread which runs the state.
+ * The hooks add a clock read and a hash lookup to every call, so the
+ * profiler is meant to be created on demand, see isRequested().
+ */
+class LuaProfiler
+{
+public:
+    /**
+     * Is Lua profiling requested by the user?
+     *
+     * It is, if the WARMONGER_LUA_PROFILE environment variable is set.
+     */
+    static bool isRequested();
+
+    /**
+     * Attach the profiler to the Lua state.
+     *
+     * \param state the Lua state
+     * \param name the name of the profiled state, used in the report
+     */
+    LuaProfiler(lua_State* state, std::string name);
+
+    /**
+     * Detach the profiler from the Lua state.
+     */
+    ~LuaProfiler();
+
+    LuaProfiler(const LuaProfiler&) = delete;
+    LuaProfiler& operator=(const LuaProfiler&) = delete;
+
+    const std::string& getName() const
+    {
+        return this->name;
+    }
+
+    /**
+     * Discard the collected profile.
+     */
+    void reset();
+
+    /**
+     * Get the collected profile.
+     *
+     * Functions which are still running are not included.
+     *
+     * \returns the stats of the profiled functions, sorted by self time
+     * (descending)
+     */
+    std::vector<LuaFunctionStats> getStats() const;
+
+    /**
+     * Write a human-readable report of the collected profile.
+     *
+     * \param out the stream to write the report to
+     */
+    void writeReport(std::ostream& out) const;
+
+    /**
+     * Write the report to the log, at info level.
+     */
+    void logReport() const;
+
+private:
+    struct FunctionKey
+    {
+        const void* id;
+        int line;
+
+        bool operator==(const FunctionKey& other) const
+        {
+            return this->id == other.id && this->line == other.line;
+        }
+    };
+
+    struct FunctionKeyHash
+    {
+        std::size_t operator()(const FunctionKey& key) const
+        {
+            return std::hash<const void*>()(key.id) ^ (std::hash<int>()(key.line) << 1);
+        }
+    };
+
+    struct Function
+    {
+        LuaFunctionStats stats;
+        // Functions called from C don't have a name, so the name is
+        // updated on the first call that has one.
+        bool named;
+        // Number of active (not yet returned) invocations, used to avoid
+        // double-counting the total time of recursive calls.
+        unsigned int activeCalls;
+    };
+
+    struct Frame
+    {
+        Function* function;
+        std::chrono::steady_clock::time_point start;
+        std::chrono::nanoseconds childTime;
+    };
+
+    static void hook(lua_State* state, lua_Debug* ar);
+
+    Function* lookup(lua_State* state, lua_Debug* ar);
+    void enter(lua_State* state, lua_Debug* ar);
+    void leave(const Function* returning);
+
+    lua_State* state;
+    std::string name;
+    std::unordered_map<FunctionKey, Function, FunctionKeyHash> functions;
+    std::vector<Frame> frames;
+};
+
+} // namespace utils
+} // namespace warmonger
+
+#endif // W_UTILS_LUA_PROFILER_H
@@ -0,0 +1,166 @@
+/** \file
+ * MpscQueue class.
+ *
+ * \copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef W_UTILS_MPSC_QUEUE_H
+#define W_UTILS_MPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace warmonger {
+namespace utils {
+
+/**
+ * Bounded, lock-free, multi-producer single-consumer queue.
+ *
+ * Each slot has a sequence number which tells whether it is free for the
+ * producers or ready for the consumer, so producers only contend on the
+ * enqueue position (a single CAS) and never block each other or the
+ * consumer. Elements are filled and consumed in-place, the slots are
+ * allocated up-front and reused.
+ *
+ * Only one thread may consume at a time.
+ */
+template <typename T>
+class MpscQueue
+{
+public:
+    /**
+     * Construct the queue.
+     *
+     * \param capacity the capacity, rounded up to the next power of two
+     */
+    explicit MpscQueue(std::size_t capacity)
+        : capacity(roundUpToPowerOfTwo(capacity))
+        , mask(this->capacity - 1)
+        , slots(std::make_unique<Slot[]>(this->capacity))
+        , enqueuePos(0)
+        , dequeuePos(0)
+    {
+        for (std::size_t i = 0; i < this->capacity; ++i)
+            this->slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    /**
+     * Try to push an element.
+     *
+     * \param fill called with the slot's element to fill it in
+     *
+     * \returns false if the queue is full
+     */
+    template <typename Fill>
+    bool tryPush(Fill&& fill)
+    {
+        std::size_t pos = this->enqueuePos.load(std::memory_order_relaxed);
+        Slot* slot;
+
+        while (true)
+        {
+            slot = &this->slots[pos & this->mask];
+
+            const std::size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos);
+
+            if (diff == 0)
+            {
+                if (this->enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = this->enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        fill(slot->value);
+        slot->sequence.store(pos + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    /**
+     * Try to pop an element.
+     *
+     * Must only be called from the consumer thread.
+     *
+     * \param consume called with the slot's element, the slot is reused
+     * after it returns
+     *
+     * \returns false if the queue is empty
+     */
+    template <typename Consume>
+    bool tryPop(Consume&& consume)
+    {
+        const std::size_t pos = this->dequeuePos.load(std::memory_order_relaxed);
+        Slot& slot = this->slots[pos & this->mask];
+
+        if (slot.sequence.load(std::memory_order_acquire) != pos + 1)
+            return false;
+
+        consume(slot.value);
+
+        slot.sequence.store(pos + this->capacity, std::memory_order_release);
+        this->dequeuePos.store(pos + 1, std::memory_order_relaxed);
+
+        return true;
+    }
+
+    std::size_t getCapacity() const
+    {
+        return this->capacity;
+    }
+
+private:
+    struct Slot
+    {
+        std::atomic<std::size_t> sequence;
+        T value;
+    };
+
+    static std::size_t roundUpToPowerOfTwo(std::size_t n)
+    {
+        std::size_t capacity = 2;
+        while (capacity < n)
+            capacity *= 2;
+        return capacity;
+    }
+
+    const std::size_t capacity;
+    const std::size_t mask;
+    std::unique_ptr<Slot[]> slots;
+
+    // On separate cache-lines, to avoid false sharing between the
+    // producers and the consumer.
+    alignas(64) std::atomic<std::size_t> enqueuePos;
+    alignas(64) std::atomic<std::size_t> dequeuePos;
+};
+
+} // namespace utils
+} // namespace warmonger
+
+#endif // W_UTILS_MPSC_QUEUE_H
@@ -0,0 +1,205 @@
+/**
+ * Copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "utils/Profiling.h"
+
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace warmonger {
+namespace utils {
+
+namespace {
+
+struct ZoneRecord
+{
+    const char* name;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point end;
+};
+
+/*
+ * The zones recorded by a thread.
+ *
+ * The mutex is only ever contended when the zones are written out or
+ * cleared, the owning thread is the only one recording.
+ */
+struct ThreadZones
+{
+    std::mutex mutex;
+    int threadId;
+    std::vector<ZoneRecord> zones;
+};
+
+/*
+ * All the per-thread buffers.
+ *
+ * Buffers are kept after their thread exits, so that its zones can
+ * still be written out.
+ */
+struct ProfileRegistry
+{
+    std::mutex mutex;
+    std::chrono::steady_clock::time_point epoch{std::chrono::steady_clock::now()};
+    std::vector<std::shared_ptr<ThreadZones>> threads;
+};
+
+} // namespace
+
+std::atomic<bool> detail::profilingEnabled{false};
+
+static ProfileRegistry& registry();
+static ThreadZones& threadZones();
+static void writeJsonString(std::ostream& out, const char* str);
+
+void startProfiling()
+{
+    {
+        auto& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+
+        for (auto& thread : reg.threads)
+        {
+            std::lock_guard<std::mutex> threadLock(thread->mutex);
+            thread->zones.clear();
+        }
+
+        reg.epoch = std::chrono::steady_clock::now();
+    }
+
+    detail::profilingEnabled = true;
+}
+
+void stopProfiling()
+{
+    detail::profilingEnabled = false;
+}
+
+void writeChromeTrace(std::ostream& out)
+{
+    auto& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+
+    const auto toMicroseconds = [](std::chrono::steady_clock::duration d) {
+        return std::chrono::duration<double, std::micro>(d).count();
+    };
+
+    const auto flags = out.flags();
+    const auto precision = out.precision();
+
+    out << std::fixed << std::setprecision(3);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+    bool first = true;
+    for (auto& thread : reg.threads)
+    {
+        std::lock_guard<std::mutex> threadLock(thread->mutex);
+
+        for (const auto& zone : thread->zones)
+        {
+            if (!first)
+                out << ",";
+            first = false;
+
+            out << "\n{\"name\":";
+            writeJsonString(out, zone.name);
+            out << ",\"cat\":\"warmonger\",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread->threadId
+                << ",\"ts\":" << toMicroseconds(zone.start - reg.epoch)
+                << ",\"dur\":" << toMicroseconds(zone.end - zone.start) << "}";
+        }
+    }
+
+    out << "\n]}\n";
+
+    out.flags(flags);
+    out.precision(precision);
+}
+
+void detail::recordProfileZone(
+    const char* name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+{
+    auto& zones = threadZones();
+
+    std::lock_guard<std::mutex> lock(zones.mutex);
+    zones.zones.push_back(ZoneRecord{name, start, end});
+}
+
+static ProfileRegistry& registry()
+{
+    // Leaked, so that it outlives any thread recording zones during
+    // static destruction.
+    static ProfileRegistry* reg = new ProfileRegistry();
+    return *reg;
+}
+
+static ThreadZones& threadZones()
+{
+    thread_local std::shared_ptr<ThreadZones> zones;
+
+    if (!zones)
+    {
+        zones = std::make_shared<ThreadZones>();
+        zones->zones.reserve(1024);
+
+        auto& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+
+        zones->threadId = static_cast<int>(reg.threads.size()) + 1;
+        reg.threads.push_back(zones);
+    }
+
+    return *zones;
+}
+
+static void writeJsonString(std::ostream& out, const char* str)
+{
+    static const char hexDigits[] = "0123456789abcdef";
+
+    out << '"';
+
+    for (const char* c = str; *c != '\0'; ++c)
+    {
+        switch (*c)
+        {
+            case '"':
+                out << "\\\"";
+                break;
+            case '\\':
+                out << "\\\\";
+                break;
+            case '\n':
+                out << "\\n";
+                break;
+            case '\t':
+                out << "\\t";
+                break;
+            default:
+                if (static_cast<unsigned char>(*c) < 0x20)
+                    out << "\\u00" << hexDigits[(*c >> 4) & 0xf] << hexDigits[*c & 0xf];
+                else
+                    out << *c;
+        }
+    }
+
+    out << '"';
+}
+
+} // namespace utils
+} // namespace warmonger
@@ -0,0 +1,118 @@
+/** \file
+ * Lightweight instrumentation for profiling hot paths.
+ *
+ * \copyright (C) 2015-2018 Botond Dénes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef W_UTILS_PROFILING_H
+#define W_UTILS_PROFILING_H
+
+#include <atomic>
+#include <chrono>
+#include <ostream>
+
+namespace warmonger {
+namespace utils {
+
+namespace detail {
+
+extern std::atomic<bool> profilingEnabled;
+
+void recordProfileZone(
+    const char* name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end);
+
+} // namespace detail
+
+/**
+ * Start recording profile zones.
+ *
+ * Clears the previously recorded zones.
+ */
+void startProfiling();
+
+/**
+ * Stop recording profile zones.
+ *
+ * The recorded zones are kept, until the next startProfiling().
+ */
+void stopProfiling();
+
+inline bool isProfiling()
+{
+    return detail::profilingEnabled.load(std::memory_order_relaxed);
+}
+
+/**
+ * Write the recorded zones in the Chrome trace-event format.
+ *
+ * The output can be loaded into chrome://tracing or Perfetto.
+ * Can be called while profiling, zones which are still open are not
+ * included.
+ *
+ * \param out the stream to write the JSON to
+ */
+void writeChromeTrace(std::ostream& out);
+
+/**
+ * A scoped, named section of code to be profiled.
+ *
+ * The time between the construction and destruction of the zone is
+ * recorded, if profiling is enabled. When it isn't, the cost is a relaxed
+ * atomic load. Zones are recorded into per-thread buffers, so recording
+ * doesn't contend across threads.
+ * Use the wProfileZone() and wProfileFunction() macros.
+ */
+class ProfileZone
+{
+public:
+    /**
+     * Open the zone.
+     *
+     * \param name the name of the zone, it must outlive the profiling
+     * session, use string literals
+     */
+    explicit ProfileZone(const char* name)
+        : name(isProfiling() ? name : nullptr)
+    {
+        if (this->name)
+            this->start = std::chrono::steady_clock::now();
+    }
+
+    ~ProfileZone()
+    {
+        if (this->name)
+            detail::recordProfileZone(this->name, this->start, std::chrono::steady_clock::now());
+    }
+
+    ProfileZone(const ProfileZone&) = delete;
+    ProfileZone& operator=(const ProfileZone&) = delete;
+
+private:
+    const char* name;
+    std::chrono::steady_clock::time_point start;
+};
+
+#define W_PROFILE_CONCAT_IMPL(a, b) a##b
+#define W_PROFILE_CONCAT(a, b) W_PROFILE_CONCAT_IMPL(a, b)
+
+#define wProfileZone(name) ::warmonger::utils::ProfileZone W_PROFILE_CONCAT(wProfileZone, __LINE__)(name)
+#define wProfileFunction() wProfileZone(__PRETTY_FUNCTION__)
+
+} // namespace utils
+} // namespace warmonger
+
+#endif // W_UTILS_PROFILING_H
@@ -32,12 +32,16 @@ namespace utils {
 
 const QString separator{"/"};
 
-const std::map<SettingsKey, QVariant> defaultValues{};
+const std::map<SettingsKey, QVariant> defaultValues{
+    {SettingsKey::imageCacheBudget, 512}, {SettingsKey::textureCacheBudget, 512}};
 
 const std::map<WorldSettingsKey, QVariant> worldDefaultValues{};
 
 const std::map<SettingsKey, QString> settingsKeyToString{
-    {SettingsKey::worldsDir, "worldsDir"}, {SettingsKey::workDir, "workDir"}};
+    {SettingsKey::worldsDir, "worldsDir"},
+    {SettingsKey::workDir, "workDir"},
+    {SettingsKey::imageCacheBudget, "imageCacheBudget"},
+    {SettingsKey::textureCacheBudget, "textureCacheBudget"}};
 
 const std::map<WorldSettingsKey, QString> worldSettingsKeyToString{{WorldSettingsKey::preferredSurface, "surface"}};
 
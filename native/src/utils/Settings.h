@@ -29,7 +29,9 @@ namespace utils {
 enum class SettingsKey
 {
     worldsDir,
-    workDir
+    workDir,
+    imageCacheBudget, // MiB
+    textureCacheBudget // MiB
 };
 
 enum class WorldSettingsKey
@@ -16,10 +16,14 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include <cstdlib>
+#include <fstream>
+
 #include <Godot.hpp>
 #include <backward.hpp>
 
 #include "utils/Logging.h"
+#include "utils/Profiling.h"
 #include "utils/Settings.h"
 #include "warmonger/Context.h"
 
@@ -33,11 +37,25 @@ extern "C" void GDN_EXPORT godot_gdnative_init(godot_gdnative_init_options* o)
 {
     godot::Godot::gdnative_init(o);
     warmonger::utils::initSettings();
-    warmonger::utils::initLogging();
+    // Keep the writing of the log off the game's threads.
+    warmonger::utils::initLogging(warmonger::utils::LogConfig::Console().setAsync());
+
+    // The trace of the session is written to this path on exit.
+    if (std::getenv("WARMONGER_PROFILE"))
+        warmonger::utils::startProfiling();
 }
 
 extern "C" void GDN_EXPORT godot_gdnative_terminate(godot_gdnative_terminate_options* o)
 {
+    if (const char* profilePath = std::getenv("WARMONGER_PROFILE"))
+    {
+        warmonger::utils::stopProfiling();
+
+        std::ofstream profile(profilePath);
+        warmonger::utils::writeChromeTrace(profile);
+    }
+
+    warmonger::utils::flushLogging();
     godot::Godot::gdnative_terminate(o);
 }
 